@@ -0,0 +1,38 @@
+dnl
+dnl Optionally build everything with the compiler's runtime
+dnl sanitizers, so 'make check' catches races & memory errors
+dnl
+AC_DEFUN([ENTANGLE_SANITIZERS],[
+    AC_ARG_ENABLE([sanitizers],
+                  AS_HELP_STRING([--enable-sanitizers@<:@=LIST@:>@],
+                                 [Build with the comma separated sanitizers, eg thread, or address,undefined (the default)]),
+                  [set_sanitizers="$enableval"],
+                  [set_sanitizers=no])
+
+    SANITIZER_CFLAGS=
+    if test "$set_sanitizers" != "no"
+    then
+      if test "$set_sanitizers" = "yes"
+      then
+        set_sanitizers="address,undefined"
+      fi
+
+      SANITIZER_CFLAGS="-fsanitize=$set_sanitizers -fno-omit-frame-pointer"
+
+      dnl Each sanitizer needs its own runtime library, and some,
+      dnl such as thread & address, cannot be combined
+      AC_MSG_CHECKING([whether $CC supports $SANITIZER_CFLAGS])
+      CFLAGS="$CFLAGS $SANITIZER_CFLAGS"
+      LDFLAGS="$LDFLAGS $SANITIZER_CFLAGS"
+      AC_LINK_IFELSE([AC_LANG_PROGRAM([], [])],
+                     [AC_MSG_RESULT([yes])],
+                     [AC_MSG_RESULT([no])
+                      AC_MSG_ERROR([Unable to build with sanitizers $set_sanitizers])])
+
+      dnl Applied globally, so the libraries, plugins & tests
+      dnl all share the one runtime
+      AC_MSG_NOTICE([building with sanitizers $set_sanitizers])
+    fi
+
+    AC_SUBST([SANITIZER_CFLAGS])
+])
@@ -23,6 +23,8 @@
 
 #include "entangle-debug.h"
 #include "entangle-camera-automata.h"
+#include "entangle-capture-latency.h"
+#include "entangle-session-writer.h"
 
 #define ENTANGLE_CAMERA_AUTOMATA_GET_PRIVATE(obj)                                    \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_CAMERA_AUTOMATA, EntangleCameraAutomataPrivate))
@@ -35,8 +37,12 @@ struct _EntangleCameraAutomataPrivate {
 
     char *deleteImageDup;
 
+    /* Downloads held back while the session writer is congested */
+    GQueue *deferred;
+
     gulong sigFileAdd;
     gulong sigFileDownload;
+    gulong sigCongested;
 };
 
 G_DEFINE_TYPE(EntangleCameraAutomata, entangle_camera_automata, G_TYPE_OBJECT);
@@ -111,6 +117,11 @@ static void entangle_camera_automata_finalize(GObject *object)
 
     ENTANGLE_DEBUG("Finalize camera automata %p", object);
 
+    /* Deferred downloads hold a reference, so the queue is empty */
+    g_queue_free(priv->deferred);
+    g_signal_handler_disconnect(entangle_session_writer_get_default(),
+                                priv->sigCongested);
+
     if (priv->camera)
         g_object_unref(priv->camera);
     if (priv->session)
@@ -189,9 +200,21 @@ EntangleCameraAutomata *entangle_camera_automata_new(void)
 }
 
 
+static void do_entangle_camera_automata_congested(GObject *src,
+                                                  GParamSpec *pspec,
+                                                  gpointer opaque);
+
 static void entangle_camera_automata_init(EntangleCameraAutomata *automata)
 {
-    automata->priv = ENTANGLE_CAMERA_AUTOMATA_GET_PRIVATE(automata);
+    EntangleCameraAutomataPrivate *priv;
+
+    priv = automata->priv = ENTANGLE_CAMERA_AUTOMATA_GET_PRIVATE(automata);
+
+    priv->deferred = g_queue_new();
+    priv->sigCongested = g_signal_connect(entangle_session_writer_get_default(),
+                                          "notify::congested",
+                                          G_CALLBACK(do_entangle_camera_automata_congested),
+                                          automata);
 }
 
 
@@ -233,6 +256,101 @@ static void entangle_camera_automata_data_free(EntangleCameraAutomataData *data)
 }
 
 
+/*
+ * A file being written to the session in the background. It is
+ * attached to the camera file, so that the file is only deleted
+ * from the camera once it is safely on disk.
+ */
+typedef struct {
+    gint refs;
+    EntangleCameraAutomata *automata;
+    /* The session the shot was taken for, which may have
+     * been replaced by the time the write completes */
+    EntangleSession *session;
+    EntangleImage *image;
+    gboolean written;
+    GError *error;
+    EntangleCameraAutomataData *deleteData;
+} EntangleCameraAutomataWrite;
+
+#define ENTANGLE_CAMERA_AUTOMATA_WRITE "entangle-session-write"
+
+static void entangle_camera_automata_write_unref(EntangleCameraAutomataWrite *pending)
+{
+    if (--pending->refs)
+        return;
+
+    g_object_unref(pending->automata);
+    if (pending->session)
+        g_object_unref(pending->session);
+    g_object_unref(pending->image);
+    if (pending->error)
+        g_error_free(pending->error);
+    g_free(pending);
+}
+
+
+static void do_entangle_camera_delete_finish(GObject *src,
+                                             GAsyncResult *res,
+                                             gpointer opaque);
+
+static void entangle_camera_automata_delete(EntangleCameraAutomataData *data,
+                                            EntangleCameraAutomataWrite *pending)
+{
+    EntangleCameraAutomataPrivate *priv = data->automata->priv;
+
+    /* Keep the only copy of a shot that never reached the disk */
+    if (pending && pending->error) {
+        g_simple_async_result_set_from_error(data->result, pending->error);
+        g_simple_async_result_complete(data->result);
+        entangle_camera_automata_data_free(data);
+        return;
+    }
+
+    if (!priv->camera) {
+        g_simple_async_result_complete(data->result);
+        entangle_camera_automata_data_free(data);
+        return;
+    }
+
+    entangle_camera_delete_file_async(priv->camera,
+                                      data->file,
+                                      NULL,
+                                      do_entangle_camera_delete_finish,
+                                      data);
+}
+
+
+static void do_entangle_camera_file_written(GObject *src,
+                                            GAsyncResult *res,
+                                            gpointer opaque)
+{
+    EntangleCameraAutomataWrite *pending = opaque;
+    const char *localpath = entangle_image_get_filename(pending->image);
+
+    pending->written = TRUE;
+    if (!entangle_session_writer_write_finish(ENTANGLE_SESSION_WRITER(src),
+                                              res, &pending->error)) {
+        g_warning("Unable to save %s: %s", localpath, pending->error->message);
+        /* Only the in-memory copy exists, so don't offer it */
+        if (pending->session)
+            entangle_session_remove(pending->session, pending->image);
+    } else {
+        ENTANGLE_DEBUG("Saved to %s", localpath);
+        entangle_capture_latency_mark_file(entangle_capture_latency_get_default(),
+                                           localpath,
+                                           ENTANGLE_CAPTURE_STAGE_WRITTEN);
+    }
+
+    if (pending->deleteData) {
+        entangle_camera_automata_delete(pending->deleteData, pending);
+        pending->deleteData = NULL;
+    }
+
+    entangle_camera_automata_write_unref(pending);
+}
+
+
 static void do_entangle_camera_file_download(EntangleCamera *cam G_GNUC_UNUSED,
                                              EntangleCameraFile *file,
                                              void *opaque)
@@ -241,23 +359,80 @@ static void do_entangle_camera_file_download(EntangleCamera *cam G_GNUC_UNUSED,
 
     EntangleCameraAutomata *automata = opaque;
     EntangleCameraAutomataPrivate *priv = automata->priv;
+    EntangleCameraAutomataWrite *pending;
     EntangleImage *image;
     gchar *localpath;
+    GByteArray *data;
+    GBytes *bytes;
 
     ENTANGLE_DEBUG("File download %p %p %p", cam, file, automata);
 
-    localpath = entangle_session_next_filename(priv->session, file);
+    if (!(localpath = entangle_session_next_filename(priv->session, file))) {
+        ENTANGLE_DEBUG("No filename available");
+        return;
+    }
 
-    if (!entangle_camera_file_save_path(file, localpath, NULL)) {
-        ENTANGLE_DEBUG("Failed save path");
+    /* Without the data in memory there is nothing to write
+     * behind, so just save it directly */
+    if (!(data = entangle_camera_file_get_data(file))) {
+        if (!entangle_camera_file_save_path(file, localpath, NULL)) {
+            ENTANGLE_DEBUG("Failed save path");
+            goto cleanup;
+        }
+        ENTANGLE_DEBUG("Saved to %s", localpath);
+        entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                      ENTANGLE_CAPTURE_STAGE_WRITTEN);
+        entangle_capture_latency_bind(entangle_capture_latency_get_default(),
+                                      localpath);
+        image = entangle_image_new_file(localpath);
+        entangle_session_add(priv->session, image);
+        entangle_capture_latency_mark_file(entangle_capture_latency_get_default(),
+                                           localpath,
+                                           ENTANGLE_CAPTURE_STAGE_SESSION_ADDED);
+        g_object_unref(image);
         goto cleanup;
     }
-    ENTANGLE_DEBUG("Saved to %s", localpath);
+
+    bytes = g_bytes_new_with_free_func(data->data, data->len,
+                                       (GDestroyNotify)g_byte_array_unref,
+                                       g_byte_array_ref(data));
+
+    /* Let the loaders decode the buffer we already have in
+     * memory, rather than read the file straight back in */
     image = entangle_image_new_file(localpath);
+    entangle_image_set_data(image, bytes);
 
-    entangle_session_add(priv->session, image);
+    entangle_capture_latency_bind(entangle_capture_latency_get_default(),
+                                  localpath);
 
-    g_object_unref(image);
+    pending = g_new0(EntangleCameraAutomataWrite, 1);
+    pending->refs = 2;
+    pending->automata = g_object_ref(automata);
+    if (priv->session)
+        pending->session = g_object_ref(priv->session);
+    pending->image = image;
+    g_object_set_data_full(G_OBJECT(file),
+                           ENTANGLE_CAMERA_AUTOMATA_WRITE,
+                           pending,
+                           (GDestroyNotify)entangle_camera_automata_write_unref);
+
+    entangle_session_writer_write_async(entangle_session_writer_get_default(),
+                                        localpath,
+                                        bytes,
+                                        NULL,
+                                        do_entangle_camera_file_written,
+                                        pending);
+    g_bytes_unref(bytes);
+
+    /* The loaders start decoding from memory while the write
+     * is still in progress, so the caches are ready by the
+     * time the file lands in the session directory */
+    if (priv->session) {
+        entangle_session_add(priv->session, image);
+        entangle_capture_latency_mark_file(entangle_capture_latency_get_default(),
+                                           localpath,
+                                           ENTANGLE_CAPTURE_STAGE_SESSION_ADDED);
+    }
 
  cleanup:
     g_free(localpath);
@@ -301,11 +476,13 @@ static void do_entangle_camera_download_finish(GObject *src,
     }
 
     if (priv->deleteFile) {
-        entangle_camera_delete_file_async(camera,
-                                          data->file,
-                                          NULL,
-                                          do_entangle_camera_delete_finish,
-                                          data);
+        EntangleCameraAutomataWrite *pending =
+            g_object_get_data(G_OBJECT(data->file), ENTANGLE_CAMERA_AUTOMATA_WRITE);
+
+        if (pending && !pending->written)
+            pending->deleteData = data;
+        else
+            entangle_camera_automata_delete(data, pending);
     } else {
         g_simple_async_result_complete(data->result);
         entangle_camera_automata_data_free(data);
@@ -313,6 +490,51 @@ static void do_entangle_camera_download_finish(GObject *src,
 }
 
 
+/*
+ * While the session writer is congested, files are left on the
+ * camera rather than piling up more data in memory, which also
+ * holds back the completion of the capture that produced them.
+ */
+static void entangle_camera_automata_download(EntangleCameraAutomataData *data)
+{
+    EntangleCameraAutomataPrivate *priv = data->automata->priv;
+
+    if (!priv->camera) {
+        g_simple_async_result_complete(data->result);
+        entangle_camera_automata_data_free(data);
+        return;
+    }
+
+    if (entangle_session_writer_get_congested(entangle_session_writer_get_default())) {
+        ENTANGLE_DEBUG("Deferring download of %s",
+                       entangle_camera_file_get_name(data->file));
+        g_queue_push_tail(priv->deferred, data);
+        return;
+    }
+
+    entangle_camera_download_file_async(priv->camera,
+                                        data->file,
+                                        NULL,
+                                        do_entangle_camera_download_finish,
+                                        data);
+}
+
+
+static void do_entangle_camera_automata_congested(GObject *src,
+                                                  GParamSpec *pspec G_GNUC_UNUSED,
+                                                  gpointer opaque)
+{
+    EntangleCameraAutomata *automata = opaque;
+    EntangleCameraAutomataPrivate *priv = automata->priv;
+
+    while (!g_queue_is_empty(priv->deferred) &&
+           !entangle_session_writer_get_congested(ENTANGLE_SESSION_WRITER(src))) {
+        EntangleCameraAutomataData *data = g_queue_pop_head(priv->deferred);
+        entangle_camera_automata_download(data);
+    }
+}
+
+
 static void do_entangle_camera_file_add_finish(GObject *src G_GNUC_UNUSED,
                                                GAsyncResult *res G_GNUC_UNUSED,
                                                gpointer opaque G_GNUC_UNUSED)
@@ -347,6 +569,9 @@ static void do_entangle_camera_file_add(EntangleCamera *camera,
 
     data->file = g_object_ref(file);
 
+    entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                  ENTANGLE_CAPTURE_STAGE_FILE_ADDED);
+
     if (priv->deleteImageDup) {
         gsize len = strlen(priv->deleteImageDup);
         if (strncmp(entangle_camera_file_get_name(file),
@@ -363,11 +588,7 @@ static void do_entangle_camera_file_add(EntangleCamera *camera,
         }
     }
 
-    entangle_camera_download_file_async(camera,
-                                        data->file,
-                                        NULL,
-                                        do_entangle_camera_download_finish,
-                                        data);
+    entangle_camera_automata_download(data);
 }
 
 
@@ -383,6 +604,7 @@ static void do_entangle_camera_capture_finish(GObject *src,
     g_signal_emit_by_name(data->automata, "camera-capture-end");
 
     if (!(data->file = entangle_camera_capture_image_finish(camera, res, &error))) {
+        entangle_capture_latency_abort(entangle_capture_latency_get_default());
         g_simple_async_result_set_from_error(data->result,
                                              error);
         g_error_free(error);
@@ -392,6 +614,7 @@ static void do_entangle_camera_capture_finish(GObject *src,
     }
 
     if (g_cancellable_is_cancelled(data->cancel)) {
+        entangle_capture_latency_abort(entangle_capture_latency_get_default());
         if (priv->deleteFile) {
             entangle_camera_delete_file_async(camera,
                                               data->file,
@@ -403,11 +626,9 @@ static void do_entangle_camera_capture_finish(GObject *src,
             entangle_camera_automata_data_free(data);
         }
     } else {
-        entangle_camera_download_file_async(camera,
-                                            data->file,
-                                            NULL,
-                                            do_entangle_camera_download_finish,
-                                            data);
+        entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                      ENTANGLE_CAPTURE_STAGE_FILE_ADDED);
+        entangle_camera_automata_download(data);
     }
 }
 
@@ -432,6 +653,8 @@ void entangle_camera_automata_capture_async(EntangleCameraAutomata *automata,
                                              NULL,
                                              result);
 
+    entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                  ENTANGLE_CAPTURE_STAGE_REQUEST);
     g_signal_emit_by_name(automata, "camera-capture-begin");
     entangle_camera_capture_image_async(priv->camera,
                                         cancel,
@@ -556,6 +779,8 @@ static void do_entangle_camera_preview_finish(GObject *src,
                                                 do_entangle_camera_discard_finish,
                                                 data);
     } else if (g_cancellable_is_cancelled(data->confirm)) {
+        entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                      ENTANGLE_CAPTURE_STAGE_REQUEST);
         g_signal_emit_by_name(data->automata, "camera-capture-begin");
         g_cancellable_reset(data->confirm);
         entangle_camera_capture_image_async(priv->camera,
@@ -624,6 +849,13 @@ void entangle_camera_automata_set_camera(EntangleCameraAutomata *automata,
     EntangleCameraAutomataPrivate *priv = automata->priv;
 
     if (priv->camera) {
+        /* The deferred files belong to the old camera */
+        while (!g_queue_is_empty(priv->deferred)) {
+            EntangleCameraAutomataData *data = g_queue_pop_head(priv->deferred);
+            g_simple_async_result_complete(data->result);
+            entangle_camera_automata_data_free(data);
+        }
+
         g_signal_handler_disconnect(priv->camera, priv->sigFileDownload);
         g_signal_handler_disconnect(priv->camera, priv->sigFileAdd);
 
@@ -0,0 +1,346 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <gphoto2.h>
+
+#include "entangle-debug.h"
+#include "entangle-camera-backend.h"
+#include "entangle-camera-list-private.h"
+#include "entangle-camera-simulator.h"
+#include "entangle-camera-trace.h"
+#include "entangle-metrics.h"
+#include "entangle-tracer.h"
+
+
+static gpointer do_gphoto_open(const char *model,
+                               const char *port,
+                               CameraAbilities *cap,
+                               GError **error)
+{
+    Camera *cam;
+
+    if (gp_camera_new(&cam) != GP_OK)
+        return NULL;
+
+    if (!entangle_camera_list_setup_camera(cam, model, port, cap, error)) {
+        gp_camera_unref(cam);
+        return NULL;
+    }
+
+    return cam;
+}
+
+
+static void do_gphoto_free(gpointer handle)
+{
+    gp_camera_unref(handle);
+}
+
+
+static int do_gphoto_init(gpointer handle, GPContext *ctx)
+{
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_init");
+    ret = gp_camera_init(handle, ctx);
+    ENTANGLE_TRACE_END("gp_camera_init");
+    return ret;
+}
+
+
+static int do_gphoto_exit(gpointer handle, GPContext *ctx)
+{
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_exit");
+    ret = gp_camera_exit(handle, ctx);
+    ENTANGLE_TRACE_END("gp_camera_exit");
+    return ret;
+}
+
+
+static gboolean do_gphoto_has_single_config(gpointer handle G_GNUC_UNUSED,
+                                            gboolean set G_GNUC_UNUSED)
+{
+#ifdef HAVE_GPHOTO_SINGLE_CONFIG
+    Camera *cam = handle;
+
+    /* libgphoto emulates the single widget APIs with a full
+     * config fetch for drivers lacking them, which is worse
+     * than one full reload, so only use them when native */
+    if (set)
+        return cam->functions->set_single_config != NULL;
+    return cam->functions->get_single_config != NULL;
+#else
+    return FALSE;
+#endif
+}
+
+
+static int do_gphoto_get_config(gpointer handle, CameraWidget **widgets,
+                                GPContext *ctx)
+{
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_get_config");
+    ret = gp_camera_get_config(handle, widgets, ctx);
+    ENTANGLE_TRACE_END("gp_camera_get_config");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_GET_CONFIG,
+                             g_get_monotonic_time() - start);
+    return ret;
+}
+
+
+static int do_gphoto_set_config(gpointer handle, CameraWidget *widgets,
+                                GPContext *ctx)
+{
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_set_config");
+    ret = gp_camera_set_config(handle, widgets, ctx);
+    ENTANGLE_TRACE_END("gp_camera_set_config");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_SET_CONFIG,
+                             g_get_monotonic_time() - start);
+    return ret;
+}
+
+
+static int do_gphoto_get_single_config(gpointer handle G_GNUC_UNUSED,
+                                       const char *name G_GNUC_UNUSED,
+                                       CameraWidget **widget G_GNUC_UNUSED,
+                                       GPContext *ctx G_GNUC_UNUSED)
+{
+#ifdef HAVE_GPHOTO_SINGLE_CONFIG
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_get_single_config");
+    ret = gp_camera_get_single_config(handle, name, widget, ctx);
+    ENTANGLE_TRACE_END("gp_camera_get_single_config");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_GET_CONFIG,
+                             g_get_monotonic_time() - start);
+    return ret;
+#else
+    return GP_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+
+static int do_gphoto_set_single_config(gpointer handle G_GNUC_UNUSED,
+                                       const char *name G_GNUC_UNUSED,
+                                       CameraWidget *widget G_GNUC_UNUSED,
+                                       GPContext *ctx G_GNUC_UNUSED)
+{
+#ifdef HAVE_GPHOTO_SINGLE_CONFIG
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_set_single_config");
+    ret = gp_camera_set_single_config(handle, name, widget, ctx);
+    ENTANGLE_TRACE_END("gp_camera_set_single_config");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_SET_CONFIG,
+                             g_get_monotonic_time() - start);
+    return ret;
+#else
+    return GP_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+
+static int do_gphoto_capture(gpointer handle, CameraCaptureType type,
+                             CameraFilePath *path, GPContext *ctx)
+{
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_capture");
+    ret = gp_camera_capture(handle, type, path, ctx);
+    ENTANGLE_TRACE_END("gp_camera_capture");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_CAPTURE,
+                             g_get_monotonic_time() - start);
+    return ret;
+}
+
+
+static int do_gphoto_capture_preview(gpointer handle, CameraFile *file,
+                                     GPContext *ctx)
+{
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_capture_preview");
+    ret = gp_camera_capture_preview(handle, file, ctx);
+    ENTANGLE_TRACE_END("gp_camera_capture_preview");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_PREVIEW,
+                             g_get_monotonic_time() - start);
+    return ret;
+}
+
+
+static int do_gphoto_file_get(gpointer handle, const char *folder,
+                              const char *name, CameraFileType type,
+                              CameraFile *file, GPContext *ctx)
+{
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_file_get");
+    ret = gp_camera_file_get(handle, folder, name, type, file, ctx);
+    ENTANGLE_TRACE_END("gp_camera_file_get");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_DOWNLOAD,
+                             g_get_monotonic_time() - start);
+    return ret;
+}
+
+
+static int do_gphoto_file_delete(gpointer handle, const char *folder,
+                                 const char *name, GPContext *ctx)
+{
+    gint64 start = g_get_monotonic_time();
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_file_delete");
+    ret = gp_camera_file_delete(handle, folder, name, ctx);
+    ENTANGLE_TRACE_END("gp_camera_file_delete");
+    entangle_metrics_observe(ENTANGLE_METRICS_HISTOGRAM_CAMERA_DELETE,
+                             g_get_monotonic_time() - start);
+    return ret;
+}
+
+
+static int do_gphoto_wait_for_event(gpointer handle, int timeout,
+                                    CameraEventType *type, void **data,
+                                    GPContext *ctx)
+{
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_wait_for_event");
+    ret = gp_camera_wait_for_event(handle, timeout, type, data, ctx);
+    ENTANGLE_TRACE_END("gp_camera_wait_for_event");
+    return ret;
+}
+
+
+static int do_gphoto_get_summary(gpointer handle, CameraText *text,
+                                 GPContext *ctx)
+{
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_get_summary");
+    ret = gp_camera_get_summary(handle, text, ctx);
+    ENTANGLE_TRACE_END("gp_camera_get_summary");
+    return ret;
+}
+
+
+static int do_gphoto_get_manual(gpointer handle, CameraText *text,
+                                GPContext *ctx)
+{
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_get_manual");
+    ret = gp_camera_get_manual(handle, text, ctx);
+    ENTANGLE_TRACE_END("gp_camera_get_manual");
+    return ret;
+}
+
+
+static int do_gphoto_get_about(gpointer handle, CameraText *text,
+                               GPContext *ctx)
+{
+    int ret;
+
+    ENTANGLE_TRACE_BEGIN("gp_camera_get_about");
+    ret = gp_camera_get_about(handle, text, ctx);
+    ENTANGLE_TRACE_END("gp_camera_get_about");
+    return ret;
+}
+
+
+const EntangleCameraBackend entangle_camera_backend_gphoto = {
+    .name = "gphoto",
+    .open = do_gphoto_open,
+    .free = do_gphoto_free,
+    .init = do_gphoto_init,
+    .exit = do_gphoto_exit,
+    .has_single_config = do_gphoto_has_single_config,
+    .get_config = do_gphoto_get_config,
+    .set_config = do_gphoto_set_config,
+    .get_single_config = do_gphoto_get_single_config,
+    .set_single_config = do_gphoto_set_single_config,
+    .capture = do_gphoto_capture,
+    .capture_preview = do_gphoto_capture_preview,
+    .file_get = do_gphoto_file_get,
+    .file_delete = do_gphoto_file_delete,
+    .wait_for_event = do_gphoto_wait_for_event,
+    .get_summary = do_gphoto_get_summary,
+    .get_manual = do_gphoto_get_manual,
+    .get_about = do_gphoto_get_about,
+};
+
+
+/*
+ * The backend is picked from the port the camera was
+ * detected on, so the camera list can offer non-gphoto
+ * devices alongside real ones.
+ */
+const EntangleCameraBackend *entangle_camera_backend_for_device(const char *port)
+{
+    if (port && g_str_has_prefix(port, ENTANGLE_CAMERA_SIMULATOR_PORT)) {
+        ENTANGLE_DEBUG("Using simulator backend for %s", port);
+        return &entangle_camera_backend_simulator;
+    }
+    if (port && g_str_has_prefix(port, ENTANGLE_CAMERA_TRACE_PORT)) {
+        ENTANGLE_DEBUG("Using replay backend for %s", port);
+        return &entangle_camera_backend_replay;
+    }
+
+    return &entangle_camera_backend_gphoto;
+}
+
+
+/*
+ * As above, but with the device wrapped by the trace
+ * recorder when recording is enabled. Replays are not
+ * recorded again.
+ */
+const EntangleCameraBackend *entangle_camera_backend_for_port(const char *port)
+{
+    if (port && entangle_camera_trace_get_recording() &&
+        !g_str_has_prefix(port, ENTANGLE_CAMERA_TRACE_PORT))
+        return &entangle_camera_backend_recorder;
+
+    return entangle_camera_backend_for_device(port);
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,99 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_CAMERA_BACKEND_H__
+#define __ENTANGLE_CAMERA_BACKEND_H__
+
+#include <glib.h>
+#include <gphoto2.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The device operations used by EntangleCamera. The default
+ * backend passes straight through to libgphoto2, while others
+ * can stand in for a real camera. Config widgets, files and
+ * events keep their gphoto2 representation so the camera code
+ * is the same whichever backend is in use. Each operation
+ * returns a gphoto2 GP_OK / GP_ERROR_* code. These are not
+ * part of the public API.
+ */
+#ifndef __GI_SCANNER__
+typedef struct _EntangleCameraBackend EntangleCameraBackend;
+
+struct _EntangleCameraBackend {
+    const char *name;
+
+    gpointer (*open)(const char *model,
+                     const char *port,
+                     CameraAbilities *cap,
+                     GError **error);
+    void (*free)(gpointer handle);
+
+    int (*init)(gpointer handle, GPContext *ctx);
+    int (*exit)(gpointer handle, GPContext *ctx);
+
+    gboolean (*has_single_config)(gpointer handle, gboolean set);
+
+    int (*get_config)(gpointer handle, CameraWidget **widgets,
+                      GPContext *ctx);
+    int (*set_config)(gpointer handle, CameraWidget *widgets,
+                      GPContext *ctx);
+    int (*get_single_config)(gpointer handle, const char *name,
+                             CameraWidget **widget, GPContext *ctx);
+    int (*set_single_config)(gpointer handle, const char *name,
+                             CameraWidget *widget, GPContext *ctx);
+
+    int (*capture)(gpointer handle, CameraCaptureType type,
+                   CameraFilePath *path, GPContext *ctx);
+    int (*capture_preview)(gpointer handle, CameraFile *file,
+                           GPContext *ctx);
+    int (*file_get)(gpointer handle, const char *folder, const char *name,
+                    CameraFileType type, CameraFile *file, GPContext *ctx);
+    int (*file_delete)(gpointer handle, const char *folder, const char *name,
+                       GPContext *ctx);
+    int (*wait_for_event)(gpointer handle, int timeout,
+                          CameraEventType *type, void **data,
+                          GPContext *ctx);
+
+    int (*get_summary)(gpointer handle, CameraText *text, GPContext *ctx);
+    int (*get_manual)(gpointer handle, CameraText *text, GPContext *ctx);
+    int (*get_about)(gpointer handle, CameraText *text, GPContext *ctx);
+};
+
+extern const EntangleCameraBackend entangle_camera_backend_gphoto;
+
+const EntangleCameraBackend *entangle_camera_backend_for_port(const char *port);
+const EntangleCameraBackend *entangle_camera_backend_for_device(const char *port);
+#endif
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_CAMERA_BACKEND_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
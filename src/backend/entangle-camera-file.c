@@ -27,6 +27,7 @@
 
 #include "entangle-debug.h"
 #include "entangle-camera-file.h"
+#include "entangle-metrics.h"
 
 #define ENTANGLE_CAMERA_FILE_GET_PRIVATE(obj)                                    \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_CAMERA_FILE, EntangleCameraFilePrivate))
@@ -37,6 +38,7 @@ struct _EntangleCameraFilePrivate {
     char *mimetype;
 
     GByteArray *data;
+    gsize dataBytes;
 };
 
 G_DEFINE_TYPE(EntangleCameraFile, entangle_camera_file, G_TYPE_OBJECT);
@@ -50,6 +52,17 @@ enum {
 };
 
 
+static EntangleMetricsMemory *entangle_camera_file_memory(void)
+{
+    static gsize memory = 0;
+
+    if (g_once_init_enter(&memory))
+        g_once_init_leave(&memory, (gsize)entangle_metrics_memory_owner("EntangleCameraFile"));
+
+    return (EntangleMetricsMemory *)memory;
+}
+
+
 static void entangle_camera_file_get_property(GObject *object,
                                           guint prop_id,
                                           GValue *value,
@@ -107,9 +120,7 @@ static void entangle_camera_file_set_property(GObject *object,
             break;
 
         case PROP_DATA:
-            if (priv->data)
-                g_byte_array_unref(priv->data);
-            priv->data = g_value_dup_boxed(value);
+            entangle_camera_file_set_data(file, g_value_get_boxed(value));
             break;
 
         default:
@@ -129,8 +140,7 @@ static void entangle_camera_file_finalize(GObject *object)
     g_free(priv->name);
     g_free(priv->mimetype);
 
-    if (priv->data)
-        g_byte_array_unref(priv->data);
+    entangle_camera_file_set_data(file, NULL);
 
     G_OBJECT_CLASS(entangle_camera_file_parent_class)->finalize(object);
 }
@@ -413,11 +423,18 @@ void entangle_camera_file_set_data(EntangleCameraFile *file, GByteArray *data)
     g_return_if_fail(ENTANGLE_IS_CAMERA_FILE(file));
 
     EntangleCameraFilePrivate *priv = file->priv;
-    if (priv->data)
+    if (priv->data) {
+        entangle_metrics_memory_free(entangle_camera_file_memory(), priv->dataBytes);
         g_byte_array_unref(priv->data);
+    }
     priv->data = data;
-    if (priv->data)
+    if (priv->data) {
         g_byte_array_ref(priv->data);
+        /* The array may be changed behind our back, so
+         * remember the size that was accounted */
+        priv->dataBytes = priv->data->len;
+        entangle_metrics_memory_alloc(entangle_camera_file_memory(), priv->dataBytes);
+    }
 }
 
 
@@ -0,0 +1,55 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_CAMERA_LIST_PRIVATE_H__
+#define __ENTANGLE_CAMERA_LIST_PRIVATE_H__
+
+#include <gphoto2.h>
+
+#include "entangle-camera-list.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The gphoto2 abilities & port lists are expensive to load,
+ * so a single copy is shared by all camera lists and cameras
+ * in the process. These helpers are not part of the public API.
+ */
+#ifndef __GI_SCANNER__
+gboolean entangle_camera_list_setup_camera(Camera *cam,
+                                           const char *model,
+                                           const char *port,
+                                           CameraAbilities *cap,
+                                           GError **error);
+#endif
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_CAMERA_LIST_PRIVATE_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -28,6 +28,9 @@
 
 #include "entangle-debug.h"
 #include "entangle-camera-list.h"
+#include "entangle-camera-list-private.h"
+#include "entangle-camera-simulator.h"
+#include "entangle-camera-trace.h"
 #include "entangle-device-manager.h"
 
 #define ENTANGLE_CAMERA_LIST_GET_PRIVATE(obj)                           \
@@ -41,8 +44,6 @@ struct _EntangleCameraListPrivate {
     EntangleDeviceManager *devManager;
 
     GPContext *ctx;
-    CameraAbilitiesList *caps;
-    GPPortInfoList *ports;
 };
 
 G_DEFINE_TYPE(EntangleCameraList, entangle_camera_list, G_TYPE_OBJECT);
@@ -53,6 +54,133 @@ enum {
     PROP_ACTIVE,
 };
 
+#define ENTANGLE_CAMERA_LIST_ERROR entangle_camera_list_error_quark ()
+
+static GQuark entangle_camera_list_error_quark(void)
+{
+    return g_quark_from_static_string("entangle-camera-list-error-quark");
+}
+
+/*
+ * Loading the abilities list dlopens and queries every camlib,
+ * so it is done once per process, on first use, and shared by
+ * every list & camera. It is never modified once loaded, so
+ * can be read without the lock. The port list is reloaded when
+ * an active list refreshes, to pick up hotplugged devices.
+ */
+static GMutex entangle_camera_list_cache_lock;
+static CameraAbilitiesList *entangle_camera_list_caps;
+static GPPortInfoList *entangle_camera_list_ports;
+
+
+/* Must be called with the cache lock held */
+static CameraAbilitiesList *entangle_camera_list_get_caps(GError **error)
+{
+    CameraAbilitiesList *caps;
+
+    if (entangle_camera_list_caps)
+        return entangle_camera_list_caps;
+
+    ENTANGLE_DEBUG("Loading gphoto2 abilities");
+    if (gp_abilities_list_new(&caps) != GP_OK) {
+        g_set_error(error, ENTANGLE_CAMERA_LIST_ERROR, 0,
+                    _("Cannot initialize gphoto2 abilities"));
+        return NULL;
+    }
+
+    if (gp_abilities_list_load(caps, NULL) != GP_OK) {
+        gp_abilities_list_free(caps);
+        g_set_error(error, ENTANGLE_CAMERA_LIST_ERROR, 0,
+                    _("Cannot load gphoto2 abilities"));
+        return NULL;
+    }
+
+    return entangle_camera_list_caps = caps;
+}
+
+
+/* Must be called with the cache lock held */
+static GPPortInfoList *entangle_camera_list_get_ports(gboolean reload,
+                                                      GError **error)
+{
+    GPPortInfoList *ports;
+
+    if (entangle_camera_list_ports && !reload)
+        return entangle_camera_list_ports;
+
+    ENTANGLE_DEBUG("Loading gphoto2 ports");
+    if (gp_port_info_list_new(&ports) != GP_OK) {
+        g_set_error(error, ENTANGLE_CAMERA_LIST_ERROR, 0,
+                    _("Cannot initialize gphoto2 ports"));
+        return NULL;
+    }
+
+    if (gp_port_info_list_load(ports) != GP_OK) {
+        gp_port_info_list_free(ports);
+        g_set_error(error, ENTANGLE_CAMERA_LIST_ERROR, 0,
+                    _("Cannot load gphoto2 ports"));
+        return NULL;
+    }
+
+    if (entangle_camera_list_ports)
+        gp_port_info_list_free(entangle_camera_list_ports);
+    return entangle_camera_list_ports = ports;
+}
+
+
+/*
+ * Configure the gphoto2 camera with the abilities of @model
+ * and the port info for @port, from the shared cache. The
+ * camera copies what it needs, so nothing is retained.
+ */
+gboolean entangle_camera_list_setup_camera(Camera *cam,
+                                           const char *model,
+                                           const char *port,
+                                           CameraAbilities *cap,
+                                           GError **error)
+{
+    CameraAbilitiesList *caps;
+    GPPortInfoList *ports;
+    GPPortInfo info;
+    gboolean ret = FALSE;
+    int i;
+
+    g_mutex_lock(&entangle_camera_list_cache_lock);
+
+    if (!(caps = entangle_camera_list_get_caps(error)))
+        goto cleanup;
+
+    if (!(ports = entangle_camera_list_get_ports(FALSE, error)))
+        goto cleanup;
+
+    /* Port may have appeared since the last refresh */
+    if ((i = gp_port_info_list_lookup_path(ports, port)) < 0) {
+        if (!(ports = entangle_camera_list_get_ports(TRUE, error)))
+            goto cleanup;
+        i = gp_port_info_list_lookup_path(ports, port);
+    }
+    if (i < 0 || gp_port_info_list_get_info(ports, i, &info) != GP_OK) {
+        g_set_error(error, ENTANGLE_CAMERA_LIST_ERROR, 0,
+                    _("Cannot find gphoto2 port %s"), port);
+        goto cleanup;
+    }
+
+    if ((i = gp_abilities_list_lookup_model(caps, model)) < 0 ||
+        gp_abilities_list_get_abilities(caps, i, cap) != GP_OK) {
+        g_set_error(error, ENTANGLE_CAMERA_LIST_ERROR, 0,
+                    _("Cannot find gphoto2 abilities for %s"), model);
+        goto cleanup;
+    }
+
+    gp_camera_set_abilities(cam, *cap);
+    gp_camera_set_port_info(cam, info);
+
+    ret = TRUE;
+ cleanup:
+    g_mutex_unlock(&entangle_camera_list_cache_lock);
+    return ret;
+}
+
 
 static void entangle_camera_list_udev_event(EntangleDeviceManager *manager G_GNUC_UNUSED,
                                             char *port G_GNUC_UNUSED,
@@ -130,10 +258,6 @@ static void entangle_camera_list_finalize(GObject *object)
     if (priv->devManager)
         g_object_unref(priv->devManager);
 
-    if (priv->ports)
-        gp_port_info_list_free(priv->ports);
-    if (priv->caps)
-        gp_abilities_list_free(priv->caps);
     gp_context_unref(priv->ctx);
 
     G_OBJECT_CLASS(entangle_camera_list_parent_class)->finalize(object);
@@ -261,40 +385,58 @@ static void entangle_camera_list_init(EntangleCameraList *list)
                         NULL);
 
     priv->ctx = gp_context_new();
-
-    if (gp_abilities_list_new(&priv->caps) != GP_OK)
-        g_error(_("Cannot initialize gphoto2 abilities"));
-
-    if (gp_abilities_list_load(priv->caps, priv->ctx) != GP_OK)
-        g_error(_("Cannot load gphoto2 abilities"));
 }
 
 
 static gboolean
 entangle_camera_list_refresh_active(EntangleCameraList *list,
-                                    GError **error G_GNUC_UNUSED)
+                                    GError **error)
 {
     g_return_val_if_fail(ENTANGLE_IS_CAMERA_LIST(list), FALSE);
 
     EntangleCameraListPrivate *priv = list->priv;
+    CameraAbilitiesList *caps;
+    GPPortInfoList *ports;
     CameraList *cams = NULL;
     GHashTable *toRemove;
     GHashTableIter iter;
     gpointer key, value;
 
-    if (priv->ports)
-        gp_port_info_list_free(priv->ports);
-    if (gp_port_info_list_new(&priv->ports) != GP_OK)
-        return FALSE;
-    if (gp_port_info_list_load(priv->ports) != GP_OK)
+    g_mutex_lock(&entangle_camera_list_cache_lock);
+
+    if (!(caps = entangle_camera_list_get_caps(error)) ||
+        !(ports = entangle_camera_list_get_ports(TRUE, error))) {
+        g_mutex_unlock(&entangle_camera_list_cache_lock);
         return FALSE;
+    }
 
     ENTANGLE_DEBUG("Detecting cameras");
 
-    if (gp_list_new(&cams) != GP_OK)
+    if (gp_list_new(&cams) != GP_OK) {
+        g_mutex_unlock(&entangle_camera_list_cache_lock);
         return FALSE;
+    }
 
-    gp_abilities_list_detect(priv->caps, priv->ports, cams, priv->ctx);
+    gp_abilities_list_detect(caps, ports, cams, priv->ctx);
+
+    g_mutex_unlock(&entangle_camera_list_cache_lock);
+
+    if (entangle_camera_simulator_get_port())
+        gp_list_append(cams, ENTANGLE_CAMERA_SIMULATOR_MODEL,
+                       entangle_camera_simulator_get_port());
+    if (entangle_camera_trace_get_replay_port()) {
+        CameraAbilities cap;
+        GError *tmperr = NULL;
+
+        if (entangle_camera_trace_get_abilities(entangle_camera_trace_get_replay_port(),
+                                                &cap, &tmperr)) {
+            gp_list_append(cams, cap.model,
+                           entangle_camera_trace_get_replay_port());
+        } else {
+            ENTANGLE_DEBUG("Unable to load camera trace: %s", tmperr->message);
+            g_error_free(tmperr);
+        }
+    }
 
     for (int i = 0; i < gp_list_count(cams); i++) {
         const char *model, *port;
@@ -310,8 +452,15 @@ entangle_camera_list_refresh_active(EntangleCameraList *list,
         if (cam)
             continue;
 
-        n = gp_abilities_list_lookup_model(priv->caps, model);
-        gp_abilities_list_get_abilities(priv->caps, n, &cap);
+        if (g_str_has_prefix(port, ENTANGLE_CAMERA_SIMULATOR_PORT)) {
+            entangle_camera_simulator_get_abilities(&cap);
+        } else if (g_str_has_prefix(port, ENTANGLE_CAMERA_TRACE_PORT)) {
+            if (!entangle_camera_trace_get_abilities(port, &cap, NULL))
+                continue;
+        } else {
+            n = gp_abilities_list_lookup_model(caps, model);
+            gp_abilities_list_get_abilities(caps, n, &cap);
+        }
 
         /* For back compat, libgphoto2 always adds a default
          * USB camera called 'usb:'. We ignore that, since we
@@ -365,21 +514,28 @@ entangle_camera_list_refresh_active(EntangleCameraList *list,
 
 static gboolean
 entangle_camera_list_refresh_supported(EntangleCameraList *list,
-                                       GError **error G_GNUC_UNUSED)
+                                       GError **error)
 {
     g_return_val_if_fail(ENTANGLE_IS_CAMERA_LIST(list), FALSE);
 
-    EntangleCameraListPrivate *priv = list->priv;
+    CameraAbilitiesList *caps;
     int cnt;
     gsize i;
 
-    cnt = gp_abilities_list_count(priv->caps);
+    g_mutex_lock(&entangle_camera_list_cache_lock);
+
+    caps = entangle_camera_list_get_caps(error);
+    g_mutex_unlock(&entangle_camera_list_cache_lock);
+    if (!caps)
+        return FALSE;
+
+    cnt = gp_abilities_list_count(caps);
 
     for (i = 0; i < cnt; i++) {
         CameraAbilities cap;
         EntangleCamera *cam;
 
-        gp_abilities_list_get_abilities(priv->caps, i, &cap);
+        gp_abilities_list_get_abilities(caps, i, &cap);
 
         cam = entangle_camera_new(cap.model, NULL,
                                   cap.operations & GP_OPERATION_CAPTURE_IMAGE ? TRUE : FALSE,
@@ -411,12 +567,6 @@ gboolean entangle_camera_list_refresh(EntangleCameraList *list,
     if (!priv->devManager && priv->active) {
         priv->devManager = entangle_device_manager_new();
 
-        if (gp_port_info_list_new(&priv->ports) != GP_OK)
-            g_error(_("Cannot initialize gphoto2 ports"));
-
-        if (gp_port_info_list_load(priv->ports) != GP_OK)
-            g_error(_("Cannot load gphoto2 ports"));
-
         g_signal_connect(priv->devManager, "device-added",
                          G_CALLBACK(entangle_camera_list_udev_event), list);
         g_signal_connect(priv->devManager, "device-removed",
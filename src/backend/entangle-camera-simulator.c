@@ -0,0 +1,967 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gphoto2.h>
+
+#include "entangle-debug.h"
+#include "entangle-camera-simulator.h"
+
+#define ENTANGLE_CAMERA_SIMULATOR_ERROR entangle_camera_simulator_error_quark ()
+
+static GQuark entangle_camera_simulator_error_quark(void)
+{
+    return g_quark_from_static_string("entangle-camera-simulator-error-quark");
+}
+
+#define ENTANGLE_CAMERA_SIMULATOR_FOLDER "/store_00010001/DCIM/100SIMUL"
+
+static char *entangle_camera_simulator_port;
+
+
+/*
+ * The simulated controls mirror the paths used by the PTP
+ * drivers, so the viewfinder, focus, clock & capture target
+ * code paths all find what they look for. Choices are '|'
+ * separated, or "min|max|step" for ranges.
+ */
+static const struct {
+    const char *section;
+    const char *name;
+    const char *label;
+    CameraWidgetType type;
+    const char *choices;
+    const char *value;
+    guint code;
+} entangle_camera_simulator_controls[] = {
+    { "settings", "datetime", "Camera Date and Time",
+      GP_WIDGET_DATE, NULL, "0", 0 },
+    { "settings", "capturetarget", "Capture Target",
+      GP_WIDGET_MENU, "Internal RAM|Memory card", "Internal RAM", 0 },
+    { "status", "batterylevel", "Battery Level",
+      GP_WIDGET_TEXT, NULL, "100%", 0x5001 },
+    { "imgsettings", "imagequality", "Image Quality",
+      GP_WIDGET_RADIO, "JPEG Basic|JPEG Normal|JPEG Fine", "JPEG Fine", 0x5004 },
+    { "imgsettings", "whitebalance", "WhiteBalance",
+      GP_WIDGET_RADIO, "Automatic|Daylight|Tungsten|Flash", "Automatic", 0x5005 },
+    { "imgsettings", "iso", "ISO Speed",
+      GP_WIDGET_RADIO, "100|200|400|800|1600|3200", "100", 0x500f },
+    { "capturesettings", "f-number", "F-Number",
+      GP_WIDGET_RADIO, "f/2.8|f/4|f/5.6|f/8|f/11|f/16", "f/8", 0x5007 },
+    { "capturesettings", "shutterspeed", "Shutter Speed",
+      GP_WIDGET_RADIO, "1/1000|1/500|1/250|1/125|1/60|1/30", "1/125", 0x500d },
+    { "capturesettings", "exposurecompensation", "Exposure Compensation",
+      GP_WIDGET_RANGE, "-3|3|0.333", "0", 0x5010 },
+    { "actions", "viewfinder", "Viewfinder",
+      GP_WIDGET_TOGGLE, NULL, "0", 0 },
+    { "actions", "autofocusdrive", "Drive Autofocus",
+      GP_WIDGET_TOGGLE, NULL, "0", 0 },
+    { "actions", "manualfocusdrive", "Drive Manual Focus",
+      GP_WIDGET_RANGE, "-32767|32767|1", "0", 0 },
+};
+
+static const struct {
+    const char *name;
+    const char *label;
+} entangle_camera_simulator_sections[] = {
+    { "actions", "Camera Actions" },
+    { "settings", "Camera Settings" },
+    { "status", "Camera Status Information" },
+    { "imgsettings", "Image Settings" },
+    { "capturesettings", "Capture Settings" },
+};
+
+
+typedef struct _EntangleCameraSimulator EntangleCameraSimulator;
+typedef struct _EntangleCameraSimulatorEvent EntangleCameraSimulatorEvent;
+
+struct _EntangleCameraSimulator {
+    /* Tunables, from the [simulator] key file group */
+    char *directory;
+    char *previewDirectory;
+    guint width;
+    guint height;
+    guint previewWidth;
+    guint previewHeight;
+    guint fileSize;        /* bytes, generated images are padded to this */
+    guint captureLatency;  /* ms */
+    guint previewLatency;  /* ms */
+    guint configLatency;   /* ms, per config fetch or save */
+    guint throughput;      /* KiB/s for downloads, 0 for unlimited */
+    guint eventInterval;   /* ms between property change bursts, 0 for none */
+    guint eventBurst;      /* property changes per burst */
+    guint shutterInterval; /* ms between camera-side shots, 0 for none */
+
+    GPtrArray *captureFiles;
+    GPtrArray *previewFiles;
+    guint captureIndex;
+    guint previewIndex;
+    guint frame;
+    guint shot;
+    guint eventProp;
+
+    GHashTable *values; /* control name -> value string */
+    GHashTable *files;  /* folder/name -> GBytes */
+    GQueue *events;
+    gint64 nextEvent;
+    gint64 nextShutter;
+};
+
+struct _EntangleCameraSimulatorEvent {
+    CameraEventType type;
+    void *data; /* malloc()d, as the caller free()s it */
+};
+
+
+/**
+ * entangle_camera_simulator_setup:
+ * @config: (allow-none): path to the simulator key file
+ *
+ * Make the simulated camera appear in active camera lists
+ * created from now on. An empty or NULL @config uses the
+ * built in defaults.
+ */
+void entangle_camera_simulator_setup(const char *config)
+{
+    g_free(entangle_camera_simulator_port);
+    entangle_camera_simulator_port = g_strdup_printf("%s%s",
+                                                     ENTANGLE_CAMERA_SIMULATOR_PORT,
+                                                     config ? config : "");
+}
+
+
+/**
+ * entangle_camera_simulator_get_port:
+ *
+ * Get the port the simulated camera is attached to
+ *
+ * Returns: (transfer none): the port, or NULL if the simulator is disabled
+ */
+const char *entangle_camera_simulator_get_port(void)
+{
+    return entangle_camera_simulator_port;
+}
+
+
+void entangle_camera_simulator_get_abilities(CameraAbilities *cap)
+{
+    memset(cap, 0, sizeof(*cap));
+    g_strlcpy(cap->model, ENTANGLE_CAMERA_SIMULATOR_MODEL, sizeof(cap->model));
+    cap->status = GP_DRIVER_STATUS_PRODUCTION;
+    cap->port = GP_PORT_NONE;
+    cap->operations = GP_OPERATION_CAPTURE_IMAGE |
+        GP_OPERATION_CAPTURE_PREVIEW |
+        GP_OPERATION_CONFIG;
+    cap->file_operations = GP_FILE_OPERATION_DELETE;
+    cap->folder_operations = GP_FOLDER_OPERATION_NONE;
+}
+
+
+static guint do_sim_get_uint(GKeyFile *config,
+                             const char *key,
+                             guint def)
+{
+    GError *error = NULL;
+    gint val;
+
+    if (!config)
+        return def;
+
+    val = g_key_file_get_integer(config, "simulator", key, &error);
+    if (error) {
+        g_error_free(error);
+        return def;
+    }
+    return val < 0 ? 0 : val;
+}
+
+
+static gint do_sim_compare_path(gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0(*(const char **)a, *(const char **)b);
+}
+
+
+static GPtrArray *do_sim_scan_directory(const char *dirname)
+{
+    GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+    GDir *dir;
+    const char *name;
+
+    if (!dirname)
+        return files;
+
+    if (!(dir = g_dir_open(dirname, 0, NULL))) {
+        ENTANGLE_DEBUG("Cannot open simulator directory %s", dirname);
+        return files;
+    }
+
+    while ((name = g_dir_read_name(dir))) {
+        char *path = g_build_filename(dirname, name, NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+            g_ptr_array_add(files, path);
+        else
+            g_free(path);
+    }
+    g_dir_close(dir);
+
+    /* Directory order is arbitrary, but replays should not be */
+    g_ptr_array_sort(files, do_sim_compare_path);
+
+    ENTANGLE_DEBUG("Found %u simulator files in %s", files->len, dirname);
+    return files;
+}
+
+
+static void do_sim_sleep(guint ms)
+{
+    if (ms)
+        g_usleep(ms * 1000ll);
+}
+
+
+static void do_sim_transfer(EntangleCameraSimulator *sim, gsize len)
+{
+    if (sim->throughput)
+        g_usleep((len * 1000000ll) / (sim->throughput * 1024ll));
+}
+
+
+/*
+ * A cheap moving pattern, so consecutive frames differ
+ * and live view visibly updates
+ */
+static GBytes *do_sim_generate_frame(guint width,
+                                     guint height,
+                                     guint frame,
+                                     gsize padding)
+{
+    GdkPixbuf *pixbuf;
+    guchar *pixels;
+    int stride;
+    gchar *buf = NULL;
+    gsize len;
+    GError *error = NULL;
+
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    pixels = gdk_pixbuf_get_pixels(pixbuf);
+    stride = gdk_pixbuf_get_rowstride(pixbuf);
+
+    for (guint y = 0; y < height; y++) {
+        guchar *row = pixels + (y * stride);
+        for (guint x = 0; x < width; x++) {
+            row[(x * 3) + 0] = (x + (frame * 8)) & 0xff;
+            row[(x * 3) + 1] = (y + (frame * 4)) & 0xff;
+            row[(x * 3) + 2] = ((x ^ y) + frame) & 0xff;
+        }
+    }
+
+    if (!gdk_pixbuf_save_to_buffer(pixbuf, &buf, &len, "jpeg", &error,
+                                   "quality", "90", NULL)) {
+        ENTANGLE_DEBUG("Unable to generate frame: %s", error->message);
+        g_error_free(error);
+        g_object_unref(pixbuf);
+        return NULL;
+    }
+    g_object_unref(pixbuf);
+
+    /* Decoders stop at the JPEG EOI marker, so trailing
+     * padding just inflates the transfer size */
+    if (padding > len) {
+        buf = g_realloc(buf, padding);
+        memset(buf + len, 0, padding - len);
+        len = padding;
+    }
+
+    return g_bytes_new_take(buf, len);
+}
+
+
+static GBytes *do_sim_load_file(GPtrArray *files, guint *index)
+{
+    const char *path = g_ptr_array_index(files, *index % files->len);
+    gchar *buf;
+    gsize len;
+
+    (*index)++;
+    if (!g_file_get_contents(path, &buf, &len, NULL)) {
+        ENTANGLE_DEBUG("Unable to read simulator file %s", path);
+        return NULL;
+    }
+
+    return g_bytes_new_take(buf, len);
+}
+
+
+static const char *do_sim_file_extension(EntangleCameraSimulator *sim)
+{
+    const char *path, *ext;
+
+    if (!sim->captureFiles->len)
+        return ".JPG";
+
+    path = g_ptr_array_index(sim->captureFiles,
+                             sim->captureIndex % sim->captureFiles->len);
+    if ((ext = strrchr(path, '.')) && !strchr(ext, '/'))
+        return ext;
+    return "";
+}
+
+
+static int do_sim_take_shot(EntangleCameraSimulator *sim,
+                            CameraFilePath *path)
+{
+    char *name;
+    GBytes *data;
+
+    name = g_strdup_printf("IMG_%04u%s", ++sim->shot,
+                           do_sim_file_extension(sim));
+
+    if (sim->captureFiles->len)
+        data = do_sim_load_file(sim->captureFiles, &sim->captureIndex);
+    else
+        data = do_sim_generate_frame(sim->width, sim->height,
+                                     sim->shot, sim->fileSize);
+    if (!data) {
+        g_free(name);
+        return GP_ERROR_IO_READ;
+    }
+
+    g_strlcpy(path->folder, ENTANGLE_CAMERA_SIMULATOR_FOLDER, sizeof(path->folder));
+    g_strlcpy(path->name, name, sizeof(path->name));
+    g_hash_table_insert(sim->files,
+                        g_strdup_printf("%s/%s", path->folder, path->name),
+                        data);
+
+    ENTANGLE_DEBUG("Simulated shot %s/%s %zu bytes",
+                   path->folder, path->name, g_bytes_get_size(data));
+    g_free(name);
+    return GP_OK;
+}
+
+
+static int do_sim_set_file_data(CameraFile *file,
+                                const char *name,
+                                GBytes *data)
+{
+    gsize len;
+    const char *src = g_bytes_get_data(data, &len);
+    char *dst;
+    const char *ext = strrchr(name, '.');
+
+    /* CameraFile releases its data with free() */
+    if (!(dst = malloc(len)))
+        return GP_ERROR_NO_MEMORY;
+    memcpy(dst, src, len);
+
+    gp_file_set_name(file, name);
+    if (ext && (g_ascii_strcasecmp(ext, ".jpg") == 0 ||
+                g_ascii_strcasecmp(ext, ".jpeg") == 0))
+        gp_file_set_mime_type(file, GP_MIME_JPEG);
+    else
+        gp_file_set_mime_type(file, GP_MIME_RAW);
+    return gp_file_set_data_and_size(file, dst, len);
+}
+
+
+static void do_sim_free(gpointer handle)
+{
+    EntangleCameraSimulator *sim = handle;
+    EntangleCameraSimulatorEvent *ev;
+
+    if (!sim)
+        return;
+
+    while ((ev = g_queue_pop_head(sim->events))) {
+        free(ev->data);
+        g_free(ev);
+    }
+    g_queue_free(sim->events);
+    g_hash_table_unref(sim->files);
+    g_hash_table_unref(sim->values);
+    g_ptr_array_unref(sim->captureFiles);
+    g_ptr_array_unref(sim->previewFiles);
+    g_free(sim->directory);
+    g_free(sim->previewDirectory);
+    g_free(sim);
+}
+
+
+static gpointer do_sim_open(const char *model G_GNUC_UNUSED,
+                            const char *port,
+                            CameraAbilities *cap,
+                            GError **error)
+{
+    EntangleCameraSimulator *sim;
+    GKeyFile *config = NULL;
+    const char *filename = port + strlen(ENTANGLE_CAMERA_SIMULATOR_PORT);
+    GError *tmperr = NULL;
+
+    if (*filename) {
+        config = g_key_file_new();
+        if (!g_key_file_load_from_file(config, filename,
+                                       G_KEY_FILE_NONE, &tmperr)) {
+            g_set_error(error, ENTANGLE_CAMERA_SIMULATOR_ERROR, 0,
+                        _("Unable to load simulator configuration %s: %s"),
+                        filename, tmperr->message);
+            g_error_free(tmperr);
+            g_key_file_free(config);
+            return NULL;
+        }
+    }
+
+    sim = g_new0(EntangleCameraSimulator, 1);
+    if (config) {
+        sim->directory = g_key_file_get_string(config, "simulator",
+                                               "directory", NULL);
+        sim->previewDirectory = g_key_file_get_string(config, "simulator",
+                                                      "preview-directory", NULL);
+    }
+    sim->width = do_sim_get_uint(config, "width", 3000);
+    sim->height = do_sim_get_uint(config, "height", 2000);
+    sim->previewWidth = do_sim_get_uint(config, "preview-width", 640);
+    sim->previewHeight = do_sim_get_uint(config, "preview-height", 426);
+    sim->fileSize = do_sim_get_uint(config, "file-size", 0);
+    sim->captureLatency = do_sim_get_uint(config, "capture-latency", 500);
+    sim->previewLatency = do_sim_get_uint(config, "preview-latency", 40);
+    sim->configLatency = do_sim_get_uint(config, "config-latency", 50);
+    sim->throughput = do_sim_get_uint(config, "throughput", 20 * 1024);
+    sim->eventInterval = do_sim_get_uint(config, "event-interval", 0);
+    sim->eventBurst = do_sim_get_uint(config, "event-burst", 1);
+    sim->shutterInterval = do_sim_get_uint(config, "shutter-interval", 0);
+
+    if (sim->width == 0 || sim->height == 0 ||
+        sim->previewWidth == 0 || sim->previewHeight == 0) {
+        g_set_error(error, ENTANGLE_CAMERA_SIMULATOR_ERROR, 0,
+                    _("Simulator image dimensions must be non-zero"));
+        g_free(sim->directory);
+        g_free(sim->previewDirectory);
+        g_free(sim);
+        if (config)
+            g_key_file_free(config);
+        return NULL;
+    }
+
+    sim->captureFiles = do_sim_scan_directory(sim->directory);
+    sim->previewFiles = do_sim_scan_directory(sim->previewDirectory);
+    sim->values = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    sim->files = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       g_free, (GDestroyNotify)g_bytes_unref);
+    sim->events = g_queue_new();
+
+    for (gsize i = 0; i < G_N_ELEMENTS(entangle_camera_simulator_controls); i++)
+        g_hash_table_insert(sim->values,
+                            (gpointer)entangle_camera_simulator_controls[i].name,
+                            g_strdup(entangle_camera_simulator_controls[i].value));
+
+    entangle_camera_simulator_get_abilities(cap);
+
+    if (config)
+        g_key_file_free(config);
+    return sim;
+}
+
+
+static int do_sim_init(gpointer handle, GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    gint64 now = g_get_monotonic_time();
+
+    sim->nextEvent = now + (sim->eventInterval * 1000ll);
+    sim->nextShutter = now + (sim->shutterInterval * 1000ll);
+
+    return GP_OK;
+}
+
+
+static int do_sim_exit(gpointer handle, GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    EntangleCameraSimulatorEvent *ev;
+
+    while ((ev = g_queue_pop_head(sim->events))) {
+        free(ev->data);
+        g_free(ev);
+    }
+
+    return GP_OK;
+}
+
+
+static gboolean do_sim_has_single_config(gpointer handle G_GNUC_UNUSED,
+                                         gboolean set G_GNUC_UNUSED)
+{
+    return TRUE;
+}
+
+
+static gssize do_sim_find_control(const char *name)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(entangle_camera_simulator_controls); i++) {
+        if (g_str_equal(entangle_camera_simulator_controls[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+
+static CameraWidget *do_sim_build_control(EntangleCameraSimulator *sim,
+                                          gsize idx)
+{
+    CameraWidget *widget;
+    const char *value = g_hash_table_lookup(sim->values,
+                                            entangle_camera_simulator_controls[idx].name);
+    const char *choices = entangle_camera_simulator_controls[idx].choices;
+    gchar **bits = choices ? g_strsplit(choices, "|", 0) : NULL;
+    int ival;
+    float fval;
+
+    gp_widget_new(entangle_camera_simulator_controls[idx].type,
+                  entangle_camera_simulator_controls[idx].label,
+                  &widget);
+    gp_widget_set_name(widget, entangle_camera_simulator_controls[idx].name);
+
+    switch (entangle_camera_simulator_controls[idx].type) {
+    case GP_WIDGET_RADIO:
+    case GP_WIDGET_MENU:
+        for (gsize i = 0; bits && bits[i]; i++)
+            gp_widget_add_choice(widget, bits[i]);
+        /* fallthrough */
+    case GP_WIDGET_TEXT:
+        gp_widget_set_value(widget, value);
+        break;
+
+    case GP_WIDGET_RANGE:
+        gp_widget_set_range(widget,
+                            g_ascii_strtod(bits[0], NULL),
+                            g_ascii_strtod(bits[1], NULL),
+                            g_ascii_strtod(bits[2], NULL));
+        fval = g_ascii_strtod(value, NULL);
+        gp_widget_set_value(widget, &fval);
+        break;
+
+    case GP_WIDGET_TOGGLE:
+    case GP_WIDGET_DATE:
+        ival = atoi(value);
+        gp_widget_set_value(widget, &ival);
+        break;
+
+    case GP_WIDGET_WINDOW:
+    case GP_WIDGET_SECTION:
+    case GP_WIDGET_BUTTON:
+    default:
+        break;
+    }
+
+    /* Constructing the widget is not a user edit */
+    gp_widget_set_changed(widget, 0);
+    g_strfreev(bits);
+    return widget;
+}
+
+
+static void do_sim_store_control(EntangleCameraSimulator *sim,
+                                 CameraWidget *widget)
+{
+    const char *name;
+    gssize idx;
+    const char *sval;
+    int ival;
+    float fval;
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    gp_widget_get_name(widget, &name);
+    if ((idx = do_sim_find_control(name)) < 0)
+        return;
+
+    switch (entangle_camera_simulator_controls[idx].type) {
+    case GP_WIDGET_RADIO:
+    case GP_WIDGET_MENU:
+    case GP_WIDGET_TEXT:
+        gp_widget_get_value(widget, &sval);
+        g_hash_table_insert(sim->values,
+                            (gpointer)entangle_camera_simulator_controls[idx].name,
+                            g_strdup(sval));
+        break;
+
+    case GP_WIDGET_RANGE:
+        gp_widget_get_value(widget, &fval);
+        g_hash_table_insert(sim->values,
+                            (gpointer)entangle_camera_simulator_controls[idx].name,
+                            g_strdup(g_ascii_dtostr(buf, sizeof(buf), fval)));
+        break;
+
+    case GP_WIDGET_TOGGLE:
+    case GP_WIDGET_DATE:
+        gp_widget_get_value(widget, &ival);
+        g_hash_table_insert(sim->values,
+                            (gpointer)entangle_camera_simulator_controls[idx].name,
+                            g_strdup_printf("%d", ival));
+        break;
+
+    case GP_WIDGET_WINDOW:
+    case GP_WIDGET_SECTION:
+    case GP_WIDGET_BUTTON:
+    default:
+        break;
+    }
+
+    ENTANGLE_DEBUG("Simulator control %s=%s", name,
+                   (char *)g_hash_table_lookup(sim->values, name));
+}
+
+
+static int do_sim_get_config(gpointer handle, CameraWidget **widgets,
+                             GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    CameraWidget *root;
+
+    do_sim_sleep(sim->configLatency);
+
+    gp_widget_new(GP_WIDGET_WINDOW, "Camera and Driver Configuration", &root);
+    gp_widget_set_name(root, "main");
+
+    for (gsize i = 0; i < G_N_ELEMENTS(entangle_camera_simulator_sections); i++) {
+        CameraWidget *section;
+
+        gp_widget_new(GP_WIDGET_SECTION,
+                      entangle_camera_simulator_sections[i].label,
+                      &section);
+        gp_widget_set_name(section, entangle_camera_simulator_sections[i].name);
+        gp_widget_append(root, section);
+
+        for (gsize j = 0; j < G_N_ELEMENTS(entangle_camera_simulator_controls); j++) {
+            if (!g_str_equal(entangle_camera_simulator_controls[j].section,
+                             entangle_camera_simulator_sections[i].name))
+                continue;
+            gp_widget_append(section, do_sim_build_control(sim, j));
+        }
+    }
+
+    *widgets = root;
+    return GP_OK;
+}
+
+
+static void do_sim_store_changed(EntangleCameraSimulator *sim,
+                                 CameraWidget *widget)
+{
+    int count = gp_widget_count_children(widget);
+
+    if (count > 0) {
+        for (int i = 0; i < count; i++) {
+            CameraWidget *child;
+            if (gp_widget_get_child(widget, i, &child) == GP_OK)
+                do_sim_store_changed(sim, child);
+        }
+    } else if (gp_widget_changed(widget)) {
+        do_sim_store_control(sim, widget);
+    }
+}
+
+
+static int do_sim_set_config(gpointer handle, CameraWidget *widgets,
+                             GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+
+    do_sim_sleep(sim->configLatency);
+    do_sim_store_changed(sim, widgets);
+    return GP_OK;
+}
+
+
+static int do_sim_get_single_config(gpointer handle, const char *name,
+                                    CameraWidget **widget,
+                                    GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    gssize idx;
+
+    if ((idx = do_sim_find_control(name)) < 0)
+        return GP_ERROR_BAD_PARAMETERS;
+
+    do_sim_sleep(sim->configLatency);
+    *widget = do_sim_build_control(sim, idx);
+    return GP_OK;
+}
+
+
+static int do_sim_set_single_config(gpointer handle, const char *name,
+                                    CameraWidget *widget,
+                                    GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+
+    if (do_sim_find_control(name) < 0)
+        return GP_ERROR_BAD_PARAMETERS;
+
+    do_sim_sleep(sim->configLatency);
+    do_sim_store_control(sim, widget);
+    return GP_OK;
+}
+
+
+static int do_sim_capture(gpointer handle, CameraCaptureType type,
+                          CameraFilePath *path, GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+
+    if (type != GP_CAPTURE_IMAGE)
+        return GP_ERROR_NOT_SUPPORTED;
+
+    do_sim_sleep(sim->captureLatency);
+    return do_sim_take_shot(sim, path);
+}
+
+
+static int do_sim_capture_preview(gpointer handle, CameraFile *file,
+                                  GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    GBytes *data;
+    int ret;
+
+    do_sim_sleep(sim->previewLatency);
+
+    if (sim->previewFiles->len)
+        data = do_sim_load_file(sim->previewFiles, &sim->previewIndex);
+    else
+        data = do_sim_generate_frame(sim->previewWidth, sim->previewHeight,
+                                     sim->frame++, 0);
+    if (!data)
+        return GP_ERROR_IO_READ;
+
+    ret = do_sim_set_file_data(file, "preview.jpg", data);
+    g_bytes_unref(data);
+    return ret;
+}
+
+
+static int do_sim_file_get(gpointer handle, const char *folder,
+                           const char *name, CameraFileType type,
+                           CameraFile *file, GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    char *key;
+    GBytes *data;
+
+    if (type != GP_FILE_TYPE_NORMAL)
+        return GP_ERROR_NOT_SUPPORTED;
+
+    key = g_strdup_printf("%s/%s", folder, name);
+    data = g_hash_table_lookup(sim->files, key);
+    g_free(key);
+    if (!data)
+        return GP_ERROR_FILE_NOT_FOUND;
+
+    do_sim_transfer(sim, g_bytes_get_size(data));
+    return do_sim_set_file_data(file, name, data);
+}
+
+
+static int do_sim_file_delete(gpointer handle, const char *folder,
+                              const char *name, GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    char *key = g_strdup_printf("%s/%s", folder, name);
+    gboolean found = g_hash_table_remove(sim->files, key);
+
+    g_free(key);
+    return found ? GP_OK : GP_ERROR_FILE_NOT_FOUND;
+}
+
+
+static void do_sim_queue_event(EntangleCameraSimulator *sim,
+                               CameraEventType type,
+                               void *data)
+{
+    EntangleCameraSimulatorEvent *ev = g_new0(EntangleCameraSimulatorEvent, 1);
+
+    ev->type = type;
+    ev->data = data;
+    g_queue_push_tail(sim->events, ev);
+}
+
+
+static void do_sim_queue_property_burst(EntangleCameraSimulator *sim)
+{
+    for (guint i = 0; i < sim->eventBurst; i++) {
+        gsize idx;
+        char msg[64];
+
+        /* Cycle through the controls which have a PTP code */
+        do {
+            idx = sim->eventProp++ % G_N_ELEMENTS(entangle_camera_simulator_controls);
+        } while (!entangle_camera_simulator_controls[idx].code);
+
+        g_snprintf(msg, sizeof(msg), "PTP Property %04x changed",
+                   entangle_camera_simulator_controls[idx].code);
+        do_sim_queue_event(sim, GP_EVENT_UNKNOWN, strdup(msg));
+    }
+}
+
+
+static void do_sim_queue_shutter(EntangleCameraSimulator *sim)
+{
+    CameraFilePath *path = malloc(sizeof(*path));
+
+    if (!path)
+        return;
+
+    if (do_sim_take_shot(sim, path) != GP_OK) {
+        free(path);
+        return;
+    }
+
+    do_sim_queue_event(sim, GP_EVENT_FILE_ADDED, path);
+    do_sim_queue_event(sim, GP_EVENT_CAPTURE_COMPLETE, NULL);
+}
+
+
+static int do_sim_wait_for_event(gpointer handle, int timeout,
+                                 CameraEventType *type, void **data,
+                                 GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+    EntangleCameraSimulatorEvent *ev;
+    gint64 now = g_get_monotonic_time();
+    gint64 deadline = now + (timeout * 1000ll);
+    gint64 next = G_MAXINT64;
+
+    if (g_queue_is_empty(sim->events)) {
+        if (sim->eventInterval)
+            next = MIN(next, sim->nextEvent);
+        if (sim->shutterInterval)
+            next = MIN(next, sim->nextShutter);
+
+        if (next > deadline) {
+            if (deadline > now)
+                g_usleep(deadline - now);
+            *type = GP_EVENT_TIMEOUT;
+            *data = NULL;
+            return GP_OK;
+        }
+
+        if (next > now)
+            g_usleep(next - now);
+
+        if (sim->eventInterval && sim->nextEvent <= next) {
+            do_sim_queue_property_burst(sim);
+            sim->nextEvent += sim->eventInterval * 1000ll;
+        }
+        if (sim->shutterInterval && sim->nextShutter <= next) {
+            do_sim_queue_shutter(sim);
+            sim->nextShutter += sim->shutterInterval * 1000ll;
+        }
+    }
+
+    if (!(ev = g_queue_pop_head(sim->events))) {
+        *type = GP_EVENT_TIMEOUT;
+        *data = NULL;
+        return GP_OK;
+    }
+
+    *type = ev->type;
+    *data = ev->data;
+    g_free(ev);
+    return GP_OK;
+}
+
+
+static int do_sim_get_summary(gpointer handle, CameraText *text,
+                              GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraSimulator *sim = handle;
+
+    g_snprintf(text->text, sizeof(text->text),
+               "Model: %s\n"
+               "Capture: %ux%u, %s\n"
+               "Preview: %ux%u, %s\n"
+               "Shots taken: %u\n",
+               ENTANGLE_CAMERA_SIMULATOR_MODEL,
+               sim->width, sim->height,
+               sim->directory ? sim->directory : "generated",
+               sim->previewWidth, sim->previewHeight,
+               sim->previewDirectory ? sim->previewDirectory : "generated",
+               sim->shot);
+    return GP_OK;
+}
+
+
+static int do_sim_get_manual(gpointer handle G_GNUC_UNUSED, CameraText *text,
+                             GPContext *ctx G_GNUC_UNUSED)
+{
+    g_strlcpy(text->text,
+              "Keys in the [simulator] group of the configuration file:\n"
+              "directory, preview-directory, width, height,\n"
+              "preview-width, preview-height, file-size,\n"
+              "capture-latency, preview-latency, config-latency,\n"
+              "throughput, event-interval, event-burst, shutter-interval\n",
+              sizeof(text->text));
+    return GP_OK;
+}
+
+
+static int do_sim_get_about(gpointer handle G_GNUC_UNUSED, CameraText *text,
+                            GPContext *ctx G_GNUC_UNUSED)
+{
+    g_strlcpy(text->text, "Entangle simulated camera", sizeof(text->text));
+    return GP_OK;
+}
+
+
+const EntangleCameraBackend entangle_camera_backend_simulator = {
+    .name = "simulator",
+    .open = do_sim_open,
+    .free = do_sim_free,
+    .init = do_sim_init,
+    .exit = do_sim_exit,
+    .has_single_config = do_sim_has_single_config,
+    .get_config = do_sim_get_config,
+    .set_config = do_sim_set_config,
+    .get_single_config = do_sim_get_single_config,
+    .set_single_config = do_sim_set_single_config,
+    .capture = do_sim_capture,
+    .capture_preview = do_sim_capture_preview,
+    .file_get = do_sim_file_get,
+    .file_delete = do_sim_file_delete,
+    .wait_for_event = do_sim_wait_for_event,
+    .get_summary = do_sim_get_summary,
+    .get_manual = do_sim_get_manual,
+    .get_about = do_sim_get_about,
+};
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
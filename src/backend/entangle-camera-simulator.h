@@ -0,0 +1,58 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_CAMERA_SIMULATOR_H__
+#define __ENTANGLE_CAMERA_SIMULATOR_H__
+
+#include "entangle-camera-backend.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A synthetic camera, for exercising the capture path without
+ * a physical body. It appears in the active camera list on the
+ * port "sim:<config>", where <config> is an optional key file
+ * tuning its latency, throughput, file sizes & event pattern.
+ */
+#define ENTANGLE_CAMERA_SIMULATOR_PORT "sim:"
+#define ENTANGLE_CAMERA_SIMULATOR_MODEL "Entangle Simulator"
+
+void entangle_camera_simulator_setup(const char *config);
+const char *entangle_camera_simulator_get_port(void);
+
+#ifndef __GI_SCANNER__
+extern const EntangleCameraBackend entangle_camera_backend_simulator;
+
+void entangle_camera_simulator_get_abilities(CameraAbilities *cap);
+#endif
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_CAMERA_SIMULATOR_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
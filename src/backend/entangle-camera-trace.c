@@ -0,0 +1,1424 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <gphoto2.h>
+
+#include "entangle-debug.h"
+#include "entangle-camera-trace.h"
+
+#define ENTANGLE_CAMERA_TRACE_ERROR entangle_camera_trace_error_quark ()
+
+static GQuark entangle_camera_trace_error_quark(void)
+{
+    return g_quark_from_static_string("entangle-camera-trace-error-quark");
+}
+
+#define ENTANGLE_CAMERA_TRACE_MAGIC "# entangle camera trace 1"
+#define ENTANGLE_CAMERA_TRACE_MAX_DEPTH 16
+
+/*
+ * The trace is line oriented text. Each operation is one line
+ *
+ *   START \t DURATION \t OP \t RESULT [\t FIELD...]
+ *
+ * with times in microseconds since the camera was opened, and
+ * string fields escaped with g_strescape. Config widget trees
+ * follow their operation as lines starting with '>'. Payloads
+ * are either an offset & length into the companion ".data"
+ * file, or "-" & the length when only sizes were recorded.
+ */
+typedef enum {
+    ENTANGLE_CAMERA_TRACE_OPEN,
+    ENTANGLE_CAMERA_TRACE_INIT,
+    ENTANGLE_CAMERA_TRACE_EXIT,
+    ENTANGLE_CAMERA_TRACE_GET_CONFIG,
+    ENTANGLE_CAMERA_TRACE_SET_CONFIG,
+    ENTANGLE_CAMERA_TRACE_GET_SINGLE_CONFIG,
+    ENTANGLE_CAMERA_TRACE_SET_SINGLE_CONFIG,
+    ENTANGLE_CAMERA_TRACE_CAPTURE,
+    ENTANGLE_CAMERA_TRACE_CAPTURE_PREVIEW,
+    ENTANGLE_CAMERA_TRACE_FILE_GET,
+    ENTANGLE_CAMERA_TRACE_FILE_DELETE,
+    ENTANGLE_CAMERA_TRACE_WAIT_FOR_EVENT,
+    ENTANGLE_CAMERA_TRACE_GET_SUMMARY,
+    ENTANGLE_CAMERA_TRACE_GET_MANUAL,
+    ENTANGLE_CAMERA_TRACE_GET_ABOUT,
+
+    ENTANGLE_CAMERA_TRACE_LAST
+} EntangleCameraTraceOp;
+
+static const char *const entangle_camera_trace_ops[] = {
+    "open",
+    "init",
+    "exit",
+    "get-config",
+    "set-config",
+    "get-single-config",
+    "set-single-config",
+    "capture",
+    "capture-preview",
+    "file-get",
+    "file-delete",
+    "wait-for-event",
+    "get-summary",
+    "get-manual",
+    "get-about",
+};
+G_STATIC_ASSERT(G_N_ELEMENTS(entangle_camera_trace_ops) == ENTANGLE_CAMERA_TRACE_LAST);
+
+static char *entangle_camera_trace_record_dir;
+static gboolean entangle_camera_trace_record_payloads;
+static char *entangle_camera_trace_replay_port;
+
+
+/**
+ * entangle_camera_trace_setup_record:
+ * @dir: (allow-none): directory to write traces to
+ * @payloads: whether to save file data, or just sizes
+ *
+ * Record a trace of every camera connected from now on,
+ * or stop recording if @dir is NULL
+ */
+void entangle_camera_trace_setup_record(const char *dir,
+                                        gboolean payloads)
+{
+    g_free(entangle_camera_trace_record_dir);
+    entangle_camera_trace_record_dir = g_strdup(dir);
+    entangle_camera_trace_record_payloads = payloads;
+}
+
+
+/**
+ * entangle_camera_trace_setup_replay:
+ * @filename: (allow-none): the trace to replay
+ *
+ * Make a camera replaying @filename appear in active
+ * camera lists created from now on.
+ */
+void entangle_camera_trace_setup_replay(const char *filename)
+{
+    g_free(entangle_camera_trace_replay_port);
+    entangle_camera_trace_replay_port = filename ?
+        g_strdup_printf("%s%s", ENTANGLE_CAMERA_TRACE_PORT, filename) : NULL;
+}
+
+
+/**
+ * entangle_camera_trace_get_recording:
+ *
+ * Determine if cameras are recording traces
+ *
+ * Returns: TRUE if recording is enabled
+ */
+gboolean entangle_camera_trace_get_recording(void)
+{
+    return entangle_camera_trace_record_dir != NULL;
+}
+
+
+/**
+ * entangle_camera_trace_get_replay_port:
+ *
+ * Get the port of the replayed camera
+ *
+ * Returns: (transfer none): the port, or NULL if not replaying
+ */
+const char *entangle_camera_trace_get_replay_port(void)
+{
+    return entangle_camera_trace_replay_port;
+}
+
+
+/*
+ * Recording
+ */
+
+typedef struct _EntangleCameraRecorder EntangleCameraRecorder;
+
+struct _EntangleCameraRecorder {
+    const EntangleCameraBackend *inner;
+    gpointer handle;
+
+    FILE *trace;
+    FILE *data;     /* NULL when only recording sizes */
+    guint64 dataOffset;
+    gint64 base;
+};
+
+
+static gint64 do_trace_now(EntangleCameraRecorder *rec)
+{
+    return g_get_monotonic_time() - rec->base;
+}
+
+
+static void do_trace_add_str(GString *str, const char *val)
+{
+    gchar *tmp = g_strescape(val ? val : "", NULL);
+
+    g_string_append_c(str, '\t');
+    g_string_append(str, tmp);
+    g_free(tmp);
+}
+
+
+static void do_trace_add_int(GString *str, gint64 val)
+{
+    g_string_append_printf(str, "\t%" G_GINT64_FORMAT, val);
+}
+
+
+static void do_trace_add_double(GString *str, double val)
+{
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_c(str, '\t');
+    g_string_append(str, g_ascii_dtostr(buf, sizeof(buf), val));
+}
+
+
+static GString *do_trace_begin(EntangleCameraRecorder *rec,
+                               EntangleCameraTraceOp op,
+                               gint64 start,
+                               int ret)
+{
+    GString *str = g_string_new("");
+
+    g_string_append_printf(str, "%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s\t%d",
+                           start, do_trace_now(rec) - start,
+                           entangle_camera_trace_ops[op], ret);
+    return str;
+}
+
+
+static void do_trace_end(EntangleCameraRecorder *rec,
+                         GString *str)
+{
+    g_string_append_c(str, '\n');
+    /* Flushed per operation so a trace survives the crash
+     * it may have been recorded to diagnose */
+    if (fwrite(str->str, str->len, 1, rec->trace) != 1 ||
+        fflush(rec->trace) != 0)
+        ENTANGLE_DEBUG("Unable to write trace: %s", g_strerror(errno));
+    g_string_free(str, TRUE);
+}
+
+
+static void do_trace_add_payload(EntangleCameraRecorder *rec,
+                                 GString *str,
+                                 CameraFile *file)
+{
+    const char *data = NULL;
+    unsigned long len = 0;
+    const char *mime = NULL;
+
+    gp_file_get_mime_type(file, &mime);
+    gp_file_get_data_and_size(file, &data, &len);
+
+    do_trace_add_str(str, mime);
+    if (rec->data && len &&
+        fwrite(data, len, 1, rec->data) == 1) {
+        do_trace_add_int(str, rec->dataOffset);
+        rec->dataOffset += len;
+    } else {
+        g_string_append(str, "\t-");
+    }
+    do_trace_add_int(str, len);
+}
+
+
+static void do_trace_add_widget(GString *str,
+                                CameraWidget *widget,
+                                int depth)
+{
+    CameraWidgetType type;
+    const char *name = NULL, *label = NULL, *sval = NULL;
+    int readonly = 0, ival = 0, count;
+    float fval = 0, min = 0, max = 0, step = 0;
+
+    gp_widget_get_type(widget, &type);
+    gp_widget_get_name(widget, &name);
+    gp_widget_get_label(widget, &label);
+    gp_widget_get_readonly(widget, &readonly);
+
+    g_string_append_printf(str, "\n>\t%d\t%d", depth, type);
+    do_trace_add_str(str, name);
+    do_trace_add_str(str, label);
+    do_trace_add_int(str, readonly);
+
+    switch (type) {
+    case GP_WIDGET_TEXT:
+        gp_widget_get_value(widget, &sval);
+        do_trace_add_str(str, sval);
+        break;
+
+    case GP_WIDGET_RADIO:
+    case GP_WIDGET_MENU:
+        gp_widget_get_value(widget, &sval);
+        do_trace_add_str(str, sval);
+        count = gp_widget_count_choices(widget);
+        for (int i = 0; i < count; i++) {
+            const char *choice = NULL;
+            gp_widget_get_choice(widget, i, &choice);
+            do_trace_add_str(str, choice);
+        }
+        break;
+
+    case GP_WIDGET_RANGE:
+        gp_widget_get_value(widget, &fval);
+        gp_widget_get_range(widget, &min, &max, &step);
+        do_trace_add_double(str, fval);
+        do_trace_add_double(str, min);
+        do_trace_add_double(str, max);
+        do_trace_add_double(str, step);
+        break;
+
+    case GP_WIDGET_TOGGLE:
+    case GP_WIDGET_DATE:
+        gp_widget_get_value(widget, &ival);
+        do_trace_add_int(str, ival);
+        break;
+
+    case GP_WIDGET_WINDOW:
+    case GP_WIDGET_SECTION:
+    case GP_WIDGET_BUTTON:
+    default:
+        break;
+    }
+
+    count = gp_widget_count_children(widget);
+    for (int i = 0; i < count; i++) {
+        CameraWidget *child;
+        if (gp_widget_get_child(widget, i, &child) == GP_OK)
+            do_trace_add_widget(str, child, depth + 1);
+    }
+}
+
+
+static char *do_trace_filename(const char *model)
+{
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    gchar *base = g_strdup_printf("%s-%s.trace", model, stamp);
+    gchar *filename;
+
+    g_strdelimit(base, "/\\ ", '_');
+    filename = g_build_filename(entangle_camera_trace_record_dir, base, NULL);
+
+    g_free(base);
+    g_free(stamp);
+    g_date_time_unref(now);
+    return filename;
+}
+
+
+static void do_rec_free(gpointer handle)
+{
+    EntangleCameraRecorder *rec = handle;
+
+    if (!rec)
+        return;
+
+    rec->inner->free(rec->handle);
+    if (rec->data)
+        fclose(rec->data);
+    fclose(rec->trace);
+    g_free(rec);
+}
+
+
+static gpointer do_rec_open(const char *model,
+                            const char *port,
+                            CameraAbilities *cap,
+                            GError **error)
+{
+    EntangleCameraRecorder *rec = g_new0(EntangleCameraRecorder, 1);
+    gchar *filename = NULL;
+    gchar *datafile = NULL;
+    gint64 start;
+    GString *str;
+
+    rec->inner = entangle_camera_backend_for_device(port);
+    rec->base = g_get_monotonic_time();
+
+    if (g_mkdir_with_parents(entangle_camera_trace_record_dir, 0777) < 0) {
+        g_set_error(error, ENTANGLE_CAMERA_TRACE_ERROR, 0,
+                    _("Unable to create trace directory %s: %s"),
+                    entangle_camera_trace_record_dir, g_strerror(errno));
+        goto error;
+    }
+
+    filename = do_trace_filename(model);
+    if (!(rec->trace = fopen(filename, "w"))) {
+        g_set_error(error, ENTANGLE_CAMERA_TRACE_ERROR, 0,
+                    _("Unable to create trace %s: %s"),
+                    filename, g_strerror(errno));
+        goto error;
+    }
+
+    if (entangle_camera_trace_record_payloads) {
+        datafile = g_strdup_printf("%s.data", filename);
+        if (!(rec->data = fopen(datafile, "w"))) {
+            g_set_error(error, ENTANGLE_CAMERA_TRACE_ERROR, 0,
+                        _("Unable to create trace data %s: %s"),
+                        datafile, g_strerror(errno));
+            goto error;
+        }
+    }
+
+    start = do_trace_now(rec);
+    if (!(rec->handle = rec->inner->open(model, port, cap, error)))
+        goto error;
+
+    ENTANGLE_DEBUG("Recording camera trace to %s", filename);
+    fprintf(rec->trace, "%s\n", ENTANGLE_CAMERA_TRACE_MAGIC);
+    str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_OPEN, start, GP_OK);
+    do_trace_add_str(str, model);
+    do_trace_add_str(str, port);
+    do_trace_add_int(str, cap->operations);
+    do_trace_add_int(str, cap->file_operations);
+    do_trace_end(rec, str);
+
+    g_free(filename);
+    g_free(datafile);
+    return rec;
+
+ error:
+    if (rec->data)
+        fclose(rec->data);
+    if (rec->trace)
+        fclose(rec->trace);
+    g_free(rec);
+    g_free(filename);
+    g_free(datafile);
+    return NULL;
+}
+
+
+static int do_rec_init(gpointer handle, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->init(rec->handle, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_INIT, start, ret);
+
+    /* The single config support is only known once initialized */
+    if (ret == GP_OK) {
+        do_trace_add_int(str, rec->inner->has_single_config(rec->handle, FALSE));
+        do_trace_add_int(str, rec->inner->has_single_config(rec->handle, TRUE));
+    }
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_exit(gpointer handle, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->exit(rec->handle, ctx);
+
+    do_trace_end(rec, do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_EXIT, start, ret));
+    return ret;
+}
+
+
+static gboolean do_rec_has_single_config(gpointer handle, gboolean set)
+{
+    EntangleCameraRecorder *rec = handle;
+
+    return rec->inner->has_single_config(rec->handle, set);
+}
+
+
+static int do_rec_get_config(gpointer handle, CameraWidget **widgets,
+                             GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->get_config(rec->handle, widgets, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_GET_CONFIG, start, ret);
+
+    if (ret == GP_OK)
+        do_trace_add_widget(str, *widgets, 0);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_set_config(gpointer handle, CameraWidget *widgets,
+                             GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->set_config(rec->handle, widgets, ctx);
+
+    do_trace_end(rec, do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_SET_CONFIG, start, ret));
+    return ret;
+}
+
+
+static int do_rec_get_single_config(gpointer handle, const char *name,
+                                    CameraWidget **widget, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->get_single_config(rec->handle, name, widget, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_GET_SINGLE_CONFIG, start, ret);
+
+    do_trace_add_str(str, name);
+    if (ret == GP_OK)
+        do_trace_add_widget(str, *widget, 0);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_set_single_config(gpointer handle, const char *name,
+                                    CameraWidget *widget, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->set_single_config(rec->handle, name, widget, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_SET_SINGLE_CONFIG, start, ret);
+
+    do_trace_add_str(str, name);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_capture(gpointer handle, CameraCaptureType type,
+                          CameraFilePath *path, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->capture(rec->handle, type, path, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_CAPTURE, start, ret);
+
+    do_trace_add_int(str, type);
+    if (ret == GP_OK) {
+        do_trace_add_str(str, path->folder);
+        do_trace_add_str(str, path->name);
+    }
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_capture_preview(gpointer handle, CameraFile *file,
+                                  GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->capture_preview(rec->handle, file, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_CAPTURE_PREVIEW, start, ret);
+
+    if (ret == GP_OK)
+        do_trace_add_payload(rec, str, file);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_file_get(gpointer handle, const char *folder,
+                           const char *name, CameraFileType type,
+                           CameraFile *file, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->file_get(rec->handle, folder, name, type, file, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_FILE_GET, start, ret);
+
+    do_trace_add_str(str, folder);
+    do_trace_add_str(str, name);
+    do_trace_add_int(str, type);
+    if (ret == GP_OK)
+        do_trace_add_payload(rec, str, file);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_file_delete(gpointer handle, const char *folder,
+                              const char *name, GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->file_delete(rec->handle, folder, name, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_FILE_DELETE, start, ret);
+
+    do_trace_add_str(str, folder);
+    do_trace_add_str(str, name);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_wait_for_event(gpointer handle, int timeout,
+                                 CameraEventType *type, void **data,
+                                 GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+    gint64 start = do_trace_now(rec);
+    int ret = rec->inner->wait_for_event(rec->handle, timeout, type, data, ctx);
+    GString *str = do_trace_begin(rec, ENTANGLE_CAMERA_TRACE_WAIT_FOR_EVENT, start, ret);
+
+    do_trace_add_int(str, timeout);
+    if (ret == GP_OK) {
+        do_trace_add_int(str, *type);
+        switch (*type) {
+        case GP_EVENT_UNKNOWN:
+            do_trace_add_str(str, *data);
+            break;
+
+        case GP_EVENT_FILE_ADDED:
+        case GP_EVENT_FOLDER_ADDED: {
+            CameraFilePath *path = *data;
+            do_trace_add_str(str, path->folder);
+            do_trace_add_str(str, path->name);
+        }   break;
+
+        case GP_EVENT_TIMEOUT:
+        case GP_EVENT_CAPTURE_COMPLETE:
+        default:
+            break;
+        }
+    }
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_get_text(EntangleCameraRecorder *rec,
+                           EntangleCameraTraceOp op,
+                           int (*func)(gpointer, CameraText *, GPContext *),
+                           CameraText *text,
+                           GPContext *ctx)
+{
+    gint64 start = do_trace_now(rec);
+    int ret = func(rec->handle, text, ctx);
+    GString *str = do_trace_begin(rec, op, start, ret);
+
+    if (ret == GP_OK)
+        do_trace_add_str(str, text->text);
+    do_trace_end(rec, str);
+    return ret;
+}
+
+
+static int do_rec_get_summary(gpointer handle, CameraText *text,
+                              GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+
+    return do_rec_get_text(rec, ENTANGLE_CAMERA_TRACE_GET_SUMMARY,
+                           rec->inner->get_summary, text, ctx);
+}
+
+
+static int do_rec_get_manual(gpointer handle, CameraText *text,
+                             GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+
+    return do_rec_get_text(rec, ENTANGLE_CAMERA_TRACE_GET_MANUAL,
+                           rec->inner->get_manual, text, ctx);
+}
+
+
+static int do_rec_get_about(gpointer handle, CameraText *text,
+                            GPContext *ctx)
+{
+    EntangleCameraRecorder *rec = handle;
+
+    return do_rec_get_text(rec, ENTANGLE_CAMERA_TRACE_GET_ABOUT,
+                           rec->inner->get_about, text, ctx);
+}
+
+
+const EntangleCameraBackend entangle_camera_backend_recorder = {
+    .name = "recorder",
+    .open = do_rec_open,
+    .free = do_rec_free,
+    .init = do_rec_init,
+    .exit = do_rec_exit,
+    .has_single_config = do_rec_has_single_config,
+    .get_config = do_rec_get_config,
+    .set_config = do_rec_set_config,
+    .get_single_config = do_rec_get_single_config,
+    .set_single_config = do_rec_set_single_config,
+    .capture = do_rec_capture,
+    .capture_preview = do_rec_capture_preview,
+    .file_get = do_rec_file_get,
+    .file_delete = do_rec_file_delete,
+    .wait_for_event = do_rec_wait_for_event,
+    .get_summary = do_rec_get_summary,
+    .get_manual = do_rec_get_manual,
+    .get_about = do_rec_get_about,
+};
+
+
+/*
+ * Replay
+ */
+
+typedef struct _EntangleCameraTraceRecord EntangleCameraTraceRecord;
+typedef struct _EntangleCameraReplay EntangleCameraReplay;
+
+struct _EntangleCameraTraceRecord {
+    gint64 start;
+    gint64 duration;
+    int ret;
+    gchar **fields;
+    GPtrArray *widgets; /* gchar ** per widget line */
+};
+
+struct _EntangleCameraReplay {
+    GPtrArray *records[ENTANGLE_CAMERA_TRACE_LAST];
+    guint next[ENTANGLE_CAMERA_TRACE_LAST];
+
+    GMappedFile *data;
+    gint64 due;    /* monotonic time the current op completes */
+    gint64 origin; /* trace time of init */
+    gint64 base;   /* monotonic time of init */
+    gboolean hasSingleConfig;
+    gboolean hasSingleConfigSet;
+};
+
+
+static void do_trace_record_free(gpointer opaque)
+{
+    EntangleCameraTraceRecord *record = opaque;
+
+    g_strfreev(record->fields);
+    if (record->widgets)
+        g_ptr_array_unref(record->widgets);
+    g_free(record);
+}
+
+
+static const char *do_trace_field(EntangleCameraTraceRecord *record,
+                                  guint idx)
+{
+    if (idx >= g_strv_length(record->fields))
+        return "";
+    return record->fields[idx];
+}
+
+
+static gchar **do_trace_split(const char *line)
+{
+    gchar **fields = g_strsplit(line, "\t", -1);
+
+    for (gsize i = 0; fields[i]; i++) {
+        gchar *tmp = g_strcompress(fields[i]);
+        g_free(fields[i]);
+        fields[i] = tmp;
+    }
+    return fields;
+}
+
+
+static gboolean do_trace_load(const char *filename,
+                              GPtrArray **records,
+                              gboolean headerOnly,
+                              GError **error)
+{
+    gchar *content = NULL;
+    gchar **lines = NULL;
+    EntangleCameraTraceRecord *last = NULL;
+    gboolean ret = FALSE;
+
+    if (!g_file_get_contents(filename, &content, NULL, error))
+        return FALSE;
+
+    lines = g_strsplit(content, "\n", -1);
+    if (!lines[0] || !g_str_equal(lines[0], ENTANGLE_CAMERA_TRACE_MAGIC)) {
+        g_set_error(error, ENTANGLE_CAMERA_TRACE_ERROR, 0,
+                    _("%s is not a camera trace"), filename);
+        goto cleanup;
+    }
+
+    for (gsize i = 1; lines[i]; i++) {
+        gchar **fields;
+        EntangleCameraTraceRecord *record;
+        int op;
+
+        if (lines[i][0] == '\0' || lines[i][0] == '#')
+            continue;
+
+        if (lines[i][0] == '>') {
+            if (last) {
+                if (!last->widgets)
+                    last->widgets = g_ptr_array_new_with_free_func((GDestroyNotify)g_strfreev);
+                g_ptr_array_add(last->widgets, do_trace_split(lines[i] + 2));
+            }
+            continue;
+        }
+
+        fields = do_trace_split(lines[i]);
+        if (g_strv_length(fields) < 4) {
+            g_strfreev(fields);
+            last = NULL;
+            continue;
+        }
+
+        for (op = 0; op < ENTANGLE_CAMERA_TRACE_LAST; op++) {
+            if (g_str_equal(fields[2], entangle_camera_trace_ops[op]))
+                break;
+        }
+        if (op == ENTANGLE_CAMERA_TRACE_LAST) {
+            ENTANGLE_DEBUG("Skipping unknown trace op '%s'", fields[2]);
+            g_strfreev(fields);
+            last = NULL;
+            continue;
+        }
+
+        record = g_new0(EntangleCameraTraceRecord, 1);
+        record->start = g_ascii_strtoll(fields[0], NULL, 10);
+        record->duration = g_ascii_strtoll(fields[1], NULL, 10);
+        record->ret = atoi(fields[3]);
+        record->fields = g_strdupv(fields + 4);
+        g_strfreev(fields);
+
+        g_ptr_array_add(records[op], record);
+        last = record;
+
+        if (headerOnly && op == ENTANGLE_CAMERA_TRACE_OPEN)
+            break;
+    }
+
+    if (!records[ENTANGLE_CAMERA_TRACE_OPEN]->len) {
+        g_set_error(error, ENTANGLE_CAMERA_TRACE_ERROR, 0,
+                    _("Camera trace %s has no open record"), filename);
+        goto cleanup;
+    }
+
+    ret = TRUE;
+ cleanup:
+    g_strfreev(lines);
+    g_free(content);
+    return ret;
+}
+
+
+static void do_trace_fill_abilities(EntangleCameraTraceRecord *open,
+                                    CameraAbilities *cap)
+{
+    memset(cap, 0, sizeof(*cap));
+    g_strlcpy(cap->model, do_trace_field(open, 0), sizeof(cap->model));
+    cap->status = GP_DRIVER_STATUS_PRODUCTION;
+    cap->port = GP_PORT_NONE;
+    cap->operations = atoi(do_trace_field(open, 2));
+    cap->file_operations = atoi(do_trace_field(open, 3));
+    cap->folder_operations = GP_FOLDER_OPERATION_NONE;
+}
+
+
+/*
+ * entangle_camera_trace_get_abilities:
+ *
+ * Get the abilities of the camera recorded in the trace
+ * named by @port, which includes its model name
+ */
+gboolean entangle_camera_trace_get_abilities(const char *port,
+                                             CameraAbilities *cap,
+                                             GError **error)
+{
+    const char *filename = port + strlen(ENTANGLE_CAMERA_TRACE_PORT);
+    GPtrArray *records[ENTANGLE_CAMERA_TRACE_LAST];
+    gboolean ret;
+
+    for (int i = 0; i < ENTANGLE_CAMERA_TRACE_LAST; i++)
+        records[i] = g_ptr_array_new_with_free_func(do_trace_record_free);
+
+    if ((ret = do_trace_load(filename, records, TRUE, error)))
+        do_trace_fill_abilities(g_ptr_array_index(records[ENTANGLE_CAMERA_TRACE_OPEN], 0),
+                                cap);
+
+    for (int i = 0; i < ENTANGLE_CAMERA_TRACE_LAST; i++)
+        g_ptr_array_unref(records[i]);
+    return ret;
+}
+
+
+static void do_replay_free(gpointer handle)
+{
+    EntangleCameraReplay *replay = handle;
+
+    if (!replay)
+        return;
+
+    for (int i = 0; i < ENTANGLE_CAMERA_TRACE_LAST; i++)
+        g_ptr_array_unref(replay->records[i]);
+    if (replay->data)
+        g_mapped_file_unref(replay->data);
+    g_free(replay);
+}
+
+
+static gpointer do_replay_open(const char *model G_GNUC_UNUSED,
+                               const char *port,
+                               CameraAbilities *cap,
+                               GError **error)
+{
+    const char *filename = port + strlen(ENTANGLE_CAMERA_TRACE_PORT);
+    EntangleCameraReplay *replay = g_new0(EntangleCameraReplay, 1);
+    gchar *datafile;
+
+    for (int i = 0; i < ENTANGLE_CAMERA_TRACE_LAST; i++)
+        replay->records[i] = g_ptr_array_new_with_free_func(do_trace_record_free);
+
+    if (!do_trace_load(filename, replay->records, FALSE, error)) {
+        do_replay_free(replay);
+        return NULL;
+    }
+
+    /* Payloads are optional, sizes alone are enough to
+     * reproduce the transfer timing */
+    datafile = g_strdup_printf("%s.data", filename);
+    if (g_file_test(datafile, G_FILE_TEST_EXISTS))
+        replay->data = g_mapped_file_new(datafile, FALSE, NULL);
+    g_free(datafile);
+
+    do_trace_fill_abilities(g_ptr_array_index(replay->records[ENTANGLE_CAMERA_TRACE_OPEN], 0),
+                            cap);
+
+    ENTANGLE_DEBUG("Replaying camera trace %s with%s payloads",
+                   filename, replay->data ? "" : "out");
+    return replay;
+}
+
+
+/*
+ * An op completes the recorded duration after it was
+ * issued, however long rebuilding its result took, so
+ * the replay reproduces the camera's latency
+ */
+static void do_replay_begin(EntangleCameraReplay *replay,
+                            EntangleCameraTraceRecord *record)
+{
+    replay->due = g_get_monotonic_time() + MAX(record->duration, 0);
+}
+
+
+static int do_replay_end(EntangleCameraReplay *replay, int ret)
+{
+    gint64 now = g_get_monotonic_time();
+
+    if (replay->due > now)
+        g_usleep(replay->due - now);
+    return ret;
+}
+
+
+/*
+ * Each kind of operation is replayed in recorded order,
+ * independently of the others, so a replayed session
+ * which issues a few more or less commands than the
+ * original does not fall out of step. Other than events,
+ * a kind which runs out of records starts over.
+ */
+static EntangleCameraTraceRecord *do_replay_next(EntangleCameraReplay *replay,
+                                                 EntangleCameraTraceOp op)
+{
+    GPtrArray *records = replay->records[op];
+    EntangleCameraTraceRecord *record;
+
+    if (!records->len)
+        return NULL;
+
+    record = g_ptr_array_index(records, replay->next[op] % records->len);
+    replay->next[op]++;
+
+    do_replay_begin(replay, record);
+    return record;
+}
+
+
+/*
+ * Ops which name a control or file must be answered by a
+ * record for that same control or file, so the next one
+ * whose leading fields match @keys is used. Anything else
+ * means the replayed session has diverged from the trace,
+ * which must not be papered over with some other record.
+ */
+static EntangleCameraTraceRecord *do_replay_find(EntangleCameraReplay *replay,
+                                                 EntangleCameraTraceOp op,
+                                                 const char *const *keys)
+{
+    GPtrArray *records = replay->records[op];
+    gchar *want;
+
+    for (guint i = 0; i < records->len; i++) {
+        guint idx = (replay->next[op] + i) % records->len;
+        EntangleCameraTraceRecord *record = g_ptr_array_index(records, idx);
+        guint j;
+
+        for (j = 0; keys[j]; j++) {
+            if (!g_str_equal(do_trace_field(record, j), keys[j]))
+                break;
+        }
+        if (keys[j])
+            continue;
+
+        replay->next[op] = idx + 1;
+        do_replay_begin(replay, record);
+        return record;
+    }
+
+    want = g_strjoinv(" ", (gchar **)keys);
+    g_warning("Camera replay diverged from trace: no %s record for %s",
+              entangle_camera_trace_ops[op], want);
+    g_free(want);
+    return NULL;
+}
+
+
+static int do_replay_simple(gpointer handle, EntangleCameraTraceOp op)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record = do_replay_next(replay, op);
+
+    if (!record)
+        return GP_ERROR_NOT_SUPPORTED;
+    return do_replay_end(replay, record->ret);
+}
+
+
+static int do_replay_init(gpointer handle, GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+
+    if (!(record = do_replay_next(replay, ENTANGLE_CAMERA_TRACE_INIT)))
+        return GP_OK;
+
+    do_replay_end(replay, GP_OK);
+    replay->origin = record->start + record->duration;
+    replay->base = g_get_monotonic_time();
+    replay->hasSingleConfig = atoi(do_trace_field(record, 0));
+    replay->hasSingleConfigSet = atoi(do_trace_field(record, 1));
+    return record->ret;
+}
+
+
+static int do_replay_exit(gpointer handle, GPContext *ctx G_GNUC_UNUSED)
+{
+    return do_replay_simple(handle, ENTANGLE_CAMERA_TRACE_EXIT);
+}
+
+
+static gboolean do_replay_has_single_config(gpointer handle, gboolean set)
+{
+    EntangleCameraReplay *replay = handle;
+
+    return set ? replay->hasSingleConfigSet : replay->hasSingleConfig;
+}
+
+
+static CameraWidget *do_replay_build_widgets(GPtrArray *lines)
+{
+    CameraWidget *stack[ENTANGLE_CAMERA_TRACE_MAX_DEPTH] = { NULL };
+    CameraWidget *root = NULL;
+
+    for (gsize i = 0; lines && i < lines->len; i++) {
+        gchar **fields = g_ptr_array_index(lines, i);
+        guint nfields = g_strv_length(fields);
+        CameraWidget *widget;
+        CameraWidgetType type;
+        int depth, ival;
+        float fval;
+
+        if (nfields < 5)
+            continue;
+
+        depth = atoi(fields[0]);
+        type = atoi(fields[1]);
+        if (depth < 0 || depth >= ENTANGLE_CAMERA_TRACE_MAX_DEPTH ||
+            (depth > 0 && !stack[depth - 1]) ||
+            (depth == 0 && root))
+            continue;
+
+        gp_widget_new(type, fields[3], &widget);
+        gp_widget_set_name(widget, fields[2]);
+        gp_widget_set_readonly(widget, atoi(fields[4]));
+
+        switch (type) {
+        case GP_WIDGET_RADIO:
+        case GP_WIDGET_MENU:
+            for (guint j = 6; j < nfields; j++)
+                gp_widget_add_choice(widget, fields[j]);
+            /* fallthrough */
+        case GP_WIDGET_TEXT:
+            if (nfields > 5)
+                gp_widget_set_value(widget, fields[5]);
+            break;
+
+        case GP_WIDGET_RANGE:
+            if (nfields > 8)
+                gp_widget_set_range(widget,
+                                    g_ascii_strtod(fields[6], NULL),
+                                    g_ascii_strtod(fields[7], NULL),
+                                    g_ascii_strtod(fields[8], NULL));
+            if (nfields > 5) {
+                fval = g_ascii_strtod(fields[5], NULL);
+                gp_widget_set_value(widget, &fval);
+            }
+            break;
+
+        case GP_WIDGET_TOGGLE:
+        case GP_WIDGET_DATE:
+            if (nfields > 5) {
+                ival = atoi(fields[5]);
+                gp_widget_set_value(widget, &ival);
+            }
+            break;
+
+        case GP_WIDGET_WINDOW:
+        case GP_WIDGET_SECTION:
+        case GP_WIDGET_BUTTON:
+        default:
+            break;
+        }
+        gp_widget_set_changed(widget, 0);
+
+        if (depth == 0)
+            root = widget;
+        else
+            gp_widget_append(stack[depth - 1], widget);
+        stack[depth] = widget;
+        for (int j = depth + 1; j < ENTANGLE_CAMERA_TRACE_MAX_DEPTH; j++)
+            stack[j] = NULL;
+    }
+
+    return root;
+}
+
+
+static int do_replay_get_config(gpointer handle, CameraWidget **widgets,
+                                GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+
+    if (!(record = do_replay_next(replay, ENTANGLE_CAMERA_TRACE_GET_CONFIG)))
+        return GP_ERROR_NOT_SUPPORTED;
+    if (record->ret != GP_OK)
+        return do_replay_end(replay, record->ret);
+    if (!(*widgets = do_replay_build_widgets(record->widgets)))
+        return do_replay_end(replay, GP_ERROR_CORRUPTED_DATA);
+    return do_replay_end(replay, GP_OK);
+}
+
+
+static int do_replay_set_config(gpointer handle,
+                                CameraWidget *widgets G_GNUC_UNUSED,
+                                GPContext *ctx G_GNUC_UNUSED)
+{
+    return do_replay_simple(handle, ENTANGLE_CAMERA_TRACE_SET_CONFIG);
+}
+
+
+static int do_replay_get_single_config(gpointer handle, const char *name,
+                                       CameraWidget **widget,
+                                       GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+    const char *keys[] = { name, NULL };
+
+    if (!(record = do_replay_find(replay, ENTANGLE_CAMERA_TRACE_GET_SINGLE_CONFIG, keys)))
+        return GP_ERROR;
+    if (record->ret != GP_OK)
+        return do_replay_end(replay, record->ret);
+    if (!(*widget = do_replay_build_widgets(record->widgets)))
+        return do_replay_end(replay, GP_ERROR_CORRUPTED_DATA);
+    return do_replay_end(replay, GP_OK);
+}
+
+
+static int do_replay_set_single_config(gpointer handle,
+                                       const char *name,
+                                       CameraWidget *widget G_GNUC_UNUSED,
+                                       GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+    const char *keys[] = { name, NULL };
+
+    if (!(record = do_replay_find(replay, ENTANGLE_CAMERA_TRACE_SET_SINGLE_CONFIG, keys)))
+        return GP_ERROR;
+    return do_replay_end(replay, record->ret);
+}
+
+
+static int do_replay_capture(gpointer handle,
+                             CameraCaptureType type G_GNUC_UNUSED,
+                             CameraFilePath *path,
+                             GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+
+    if (!(record = do_replay_next(replay, ENTANGLE_CAMERA_TRACE_CAPTURE)))
+        return GP_ERROR_NOT_SUPPORTED;
+    if (record->ret != GP_OK)
+        return do_replay_end(replay, record->ret);
+
+    g_strlcpy(path->folder, do_trace_field(record, 1), sizeof(path->folder));
+    g_strlcpy(path->name, do_trace_field(record, 2), sizeof(path->name));
+    return do_replay_end(replay, GP_OK);
+}
+
+
+/*
+ * When only sizes were recorded the file is zero filled,
+ * which keeps transfer & copy costs realistic even though
+ * the data will not decode
+ */
+static int do_replay_set_payload(EntangleCameraReplay *replay,
+                                 EntangleCameraTraceRecord *record,
+                                 guint idx,
+                                 const char *name,
+                                 CameraFile *file)
+{
+    const char *mime = do_trace_field(record, idx);
+    const char *offset = do_trace_field(record, idx + 1);
+    gsize len = g_ascii_strtoull(do_trace_field(record, idx + 2), NULL, 10);
+    guint64 off;
+    char *data;
+
+    if (!(data = calloc(1, len ? len : 1)))
+        return GP_ERROR_NO_MEMORY;
+
+    if (replay->data && !g_str_equal(offset, "-")) {
+        off = g_ascii_strtoull(offset, NULL, 10);
+        if (off + len <= g_mapped_file_get_length(replay->data))
+            memcpy(data, g_mapped_file_get_contents(replay->data) + off, len);
+    }
+
+    gp_file_set_name(file, name);
+    if (*mime)
+        gp_file_set_mime_type(file, mime);
+    return gp_file_set_data_and_size(file, data, len);
+}
+
+
+static int do_replay_capture_preview(gpointer handle, CameraFile *file,
+                                     GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+
+    if (!(record = do_replay_next(replay, ENTANGLE_CAMERA_TRACE_CAPTURE_PREVIEW)))
+        return GP_ERROR_NOT_SUPPORTED;
+    if (record->ret != GP_OK)
+        return do_replay_end(replay, record->ret);
+
+    return do_replay_end(replay,
+                         do_replay_set_payload(replay, record, 0, "preview.jpg", file));
+}
+
+
+static int do_replay_file_get(gpointer handle,
+                              const char *folder,
+                              const char *name,
+                              CameraFileType type,
+                              CameraFile *file,
+                              GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+    gchar *typestr = g_strdup_printf("%d", type);
+    const char *keys[] = { folder, name, typestr, NULL };
+
+    record = do_replay_find(replay, ENTANGLE_CAMERA_TRACE_FILE_GET, keys);
+    g_free(typestr);
+    if (!record)
+        return GP_ERROR;
+    if (record->ret != GP_OK)
+        return do_replay_end(replay, record->ret);
+
+    return do_replay_end(replay,
+                         do_replay_set_payload(replay, record, 3, name, file));
+}
+
+
+static int do_replay_file_delete(gpointer handle,
+                                 const char *folder,
+                                 const char *name,
+                                 GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+    const char *keys[] = { folder, name, NULL };
+
+    if (!(record = do_replay_find(replay, ENTANGLE_CAMERA_TRACE_FILE_DELETE, keys)))
+        return GP_ERROR;
+    return do_replay_end(replay, record->ret);
+}
+
+
+/*
+ * Events are delivered at the same offset from camera init
+ * as they originally arrived, rather than after the recorded
+ * wait, so bursts & gaps are reproduced however often the
+ * replaying session polls.
+ */
+static int do_replay_wait_for_event(gpointer handle, int timeout,
+                                    CameraEventType *type, void **data,
+                                    GPContext *ctx G_GNUC_UNUSED)
+{
+    EntangleCameraReplay *replay = handle;
+    GPtrArray *records = replay->records[ENTANGLE_CAMERA_TRACE_WAIT_FOR_EVENT];
+    guint *next = &replay->next[ENTANGLE_CAMERA_TRACE_WAIT_FOR_EVENT];
+    EntangleCameraTraceRecord *record = NULL;
+    gint64 now = g_get_monotonic_time();
+    gint64 deadline = now + (timeout * 1000ll);
+    gint64 due = G_MAXINT64;
+
+    *type = GP_EVENT_TIMEOUT;
+    *data = NULL;
+
+    while (*next < records->len) {
+        record = g_ptr_array_index(records, *next);
+        if (record->ret == GP_OK &&
+            atoi(do_trace_field(record, 1)) != GP_EVENT_TIMEOUT)
+            break;
+        (*next)++;
+        record = NULL;
+    }
+
+    if (record)
+        due = replay->base + (record->start + record->duration - replay->origin);
+
+    if (due > deadline) {
+        if (deadline > now)
+            g_usleep(deadline - now);
+        return GP_OK;
+    }
+
+    if (due > now)
+        g_usleep(due - now);
+    (*next)++;
+
+    *type = atoi(do_trace_field(record, 1));
+    switch (*type) {
+    case GP_EVENT_UNKNOWN:
+        *data = strdup(do_trace_field(record, 2));
+        break;
+
+    case GP_EVENT_FILE_ADDED:
+    case GP_EVENT_FOLDER_ADDED: {
+        CameraFilePath *path;
+        if (!(path = calloc(1, sizeof(*path))))
+            return GP_ERROR_NO_MEMORY;
+        g_strlcpy(path->folder, do_trace_field(record, 2), sizeof(path->folder));
+        g_strlcpy(path->name, do_trace_field(record, 3), sizeof(path->name));
+        *data = path;
+    }   break;
+
+    case GP_EVENT_TIMEOUT:
+    case GP_EVENT_CAPTURE_COMPLETE:
+    default:
+        break;
+    }
+
+    return GP_OK;
+}
+
+
+static int do_replay_get_text(gpointer handle,
+                              EntangleCameraTraceOp op,
+                              CameraText *text)
+{
+    EntangleCameraReplay *replay = handle;
+    EntangleCameraTraceRecord *record;
+
+    if (!(record = do_replay_next(replay, op)))
+        return GP_ERROR_NOT_SUPPORTED;
+    if (record->ret == GP_OK)
+        g_strlcpy(text->text, do_trace_field(record, 0), sizeof(text->text));
+    return do_replay_end(replay, record->ret);
+}
+
+
+static int do_replay_get_summary(gpointer handle, CameraText *text,
+                                 GPContext *ctx G_GNUC_UNUSED)
+{
+    return do_replay_get_text(handle, ENTANGLE_CAMERA_TRACE_GET_SUMMARY, text);
+}
+
+
+static int do_replay_get_manual(gpointer handle, CameraText *text,
+                                GPContext *ctx G_GNUC_UNUSED)
+{
+    return do_replay_get_text(handle, ENTANGLE_CAMERA_TRACE_GET_MANUAL, text);
+}
+
+
+static int do_replay_get_about(gpointer handle, CameraText *text,
+                               GPContext *ctx G_GNUC_UNUSED)
+{
+    return do_replay_get_text(handle, ENTANGLE_CAMERA_TRACE_GET_ABOUT, text);
+}
+
+
+const EntangleCameraBackend entangle_camera_backend_replay = {
+    .name = "replay",
+    .open = do_replay_open,
+    .free = do_replay_free,
+    .init = do_replay_init,
+    .exit = do_replay_exit,
+    .has_single_config = do_replay_has_single_config,
+    .get_config = do_replay_get_config,
+    .set_config = do_replay_set_config,
+    .get_single_config = do_replay_get_single_config,
+    .set_single_config = do_replay_set_single_config,
+    .capture = do_replay_capture,
+    .capture_preview = do_replay_capture_preview,
+    .file_get = do_replay_file_get,
+    .file_delete = do_replay_file_delete,
+    .wait_for_event = do_replay_wait_for_event,
+    .get_summary = do_replay_get_summary,
+    .get_manual = do_replay_get_manual,
+    .get_about = do_replay_get_about,
+};
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,65 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_CAMERA_TRACE_H__
+#define __ENTANGLE_CAMERA_TRACE_H__
+
+#include "entangle-camera-backend.h"
+
+G_BEGIN_DECLS
+
+/*
+ * When recording, every camera opened logs each backend
+ * operation, with its timing, result, events & payloads (or
+ * just payload sizes), to a trace file. A trace can later be
+ * replayed, on the port "replay:<trace>", to reproduce the
+ * session offline with the original timing.
+ */
+#define ENTANGLE_CAMERA_TRACE_PORT "replay:"
+
+void entangle_camera_trace_setup_record(const char *dir,
+                                        gboolean payloads);
+void entangle_camera_trace_setup_replay(const char *filename);
+
+gboolean entangle_camera_trace_get_recording(void);
+const char *entangle_camera_trace_get_replay_port(void);
+
+#ifndef __GI_SCANNER__
+extern const EntangleCameraBackend entangle_camera_backend_recorder;
+extern const EntangleCameraBackend entangle_camera_backend_replay;
+
+gboolean entangle_camera_trace_get_abilities(const char *port,
+                                             CameraAbilities *cap,
+                                             GError **error);
+#endif
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_CAMERA_TRACE_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -28,10 +28,14 @@
 #include <gphoto2.h>
 #include <string.h>
 #include <math.h>
+#include <errno.h>
 
 #include "entangle-debug.h"
 #include "entangle-camera.h"
 #include "entangle-camera-enums.h"
+#include "entangle-camera-backend.h"
+#include "entangle-capture-latency.h"
+#include "entangle-metrics.h"
 #include "entangle-control-button.h"
 #include "entangle-control-choice.h"
 #include "entangle-control-date.h"
@@ -39,6 +43,7 @@
 #include "entangle-control-range.h"
 #include "entangle-control-text.h"
 #include "entangle-control-toggle.h"
+#include "entangle-tracer.h"
 
 #define ENTANGLE_CAMERA_GET_PRIVATE(obj)                                \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_CAMERA, EntangleCameraPrivate))
@@ -56,20 +61,49 @@
 #define g_cond_free(c) g_free(c)
 #endif
 
+/* Preview frames handed out at once: one being shown,
+ * one being captured, and one spare */
+#define ENTANGLE_CAMERA_PREVIEW_FILES 3
+
+/* Control changes arriving within this many milliseconds
+ * of each other are announced by a single signal */
+#define ENTANGLE_CAMERA_CONTROLS_NOTIFY_MS 100
+
+/* Prefix of the event text when a device property changes */
+#define ENTANGLE_CAMERA_PTP_PROPERTY "PTP Property "
+
+/* Full reloads which must agree on the control behind a
+ * vendor property before the mapping is trusted */
+#define ENTANGLE_CAMERA_LEARN_CONFIRMATIONS 2
+
+/* A control which may be behind a vendor PTP property */
+typedef struct {
+    char *path;
+    int matches;
+} EntangleCameraGuess;
+
 struct _EntangleCameraPrivate {
     GMutex *lock;
     GCond *jobCond;
     gboolean jobActive;
 
     GPContext *ctx;
-    CameraAbilitiesList *caps;
-    GPPortInfoList *ports;
-    Camera *cam;
-
+    const EntangleCameraBackend *backend;
+    gpointer cam;
 
     CameraWidget *widgets;
     EntangleControlGroup *controls;
     GHashTable *controlPaths;
+    GHashTable *controlProps;    /* PTP property code -> control path */
+    GHashTable *controlGuesses;  /* PTP property code -> learning state */
+    GHashTable *controlsPending; /* control paths awaiting refresh */
+    GHashTable *controlsUnknown; /* unmapped PTP property codes */
+    GPtrArray *controlsUpdated;
+    GHashTable *controlsNotify;  /* changed control paths awaiting signal */
+    gboolean controlsNotifyAll;  /* an unmapped control changed too */
+    guint controlsNotifyTimer;
+    gboolean controlsStale;
+    char *controlsFingerprint;
 
     EntangleProgress *progress;
 
@@ -81,11 +115,20 @@ struct _EntangleCameraPrivate {
     char *manual;
     char *summary;
     char *driver;
+    gboolean manualFetching;
+    gboolean summaryFetching;
+    gboolean driverFetching;
 
     gboolean hasCapture;
     gboolean hasPreview;
     gboolean hasSettings;
     gboolean hasViewfinder;
+    gboolean hasSingleConfig;
+    gboolean hasSingleConfigSet;
+
+    EntangleCameraFile *previewFiles[ENTANGLE_CAMERA_PREVIEW_FILES];
+    GByteArray *previewData[ENTANGLE_CAMERA_PREVIEW_FILES];
+    gint previewIdle[ENTANGLE_CAMERA_PREVIEW_FILES];
 };
 
 G_DEFINE_TYPE(EntangleCamera, entangle_camera, G_TYPE_OBJECT);
@@ -120,6 +163,19 @@ static gboolean do_load_controls(EntangleCamera *cam,
                                  const char *path,
                                  CameraWidget *widget,
                                  GError **error);
+static void do_restore_schema(EntangleCamera *cam);
+static void entangle_camera_preview_file_toggle(gpointer data,
+                                                GObject *object,
+                                                gboolean is_last_ref);
+
+static void entangle_camera_guess_free(gpointer opaque)
+{
+    EntangleCameraGuess *guess = opaque;
+
+    g_free(guess->path);
+    g_free(guess);
+}
+
 
 struct EntangleCameraEventData {
     EntangleCamera *cam;
@@ -159,18 +215,78 @@ static void entangle_camera_emit_deferred(EntangleCamera *cam,
 }
 
 
+static gboolean entangle_camera_emit_controls_timeout(gpointer opaque)
+{
+    EntangleCamera *cam = opaque;
+    EntangleCameraPrivate *priv = cam->priv;
+    gchar **paths = NULL;
+
+    g_mutex_lock(priv->lock);
+    if (!priv->controlsNotifyAll) {
+        GHashTableIter iter;
+        gpointer key;
+        gsize i = 0;
+
+        paths = g_new0(gchar *, g_hash_table_size(priv->controlsNotify) + 1);
+        g_hash_table_iter_init(&iter, priv->controlsNotify);
+        while (g_hash_table_iter_next(&iter, &key, NULL))
+            paths[i++] = g_strdup(key);
+    }
+    g_hash_table_remove_all(priv->controlsNotify);
+    priv->controlsNotifyAll = FALSE;
+    priv->controlsNotifyTimer = 0;
+    g_mutex_unlock(priv->lock);
+
+    g_signal_emit_by_name(cam, "camera-controls-changed");
+    g_signal_emit_by_name(cam, "camera-control-paths-changed", paths);
+
+    g_strfreev(paths);
+    return FALSE;
+}
+
+
+/*
+ * Note that the control at @path, or an unknown control
+ * if @path is NULL, has changed. A burst of changes, such
+ * as the camera emits when the mode dial turns, is
+ * announced once when the window since the first closes.
+ *
+ * Called with the camera lock held
+ */
+static void entangle_camera_queue_controls_changed(EntangleCamera *cam,
+                                                   const char *path)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+
+    if (path)
+        g_hash_table_add(priv->controlsNotify, g_strdup(path));
+    else
+        priv->controlsNotifyAll = TRUE;
+
+    if (!priv->controlsNotifyTimer)
+        priv->controlsNotifyTimer = g_timeout_add_full(G_PRIORITY_DEFAULT,
+                                                       ENTANGLE_CAMERA_CONTROLS_NOTIFY_MS,
+                                                       entangle_camera_emit_controls_timeout,
+                                                       g_object_ref(cam),
+                                                       g_object_unref);
+}
+
+
 static void entangle_camera_begin_job(EntangleCamera *cam)
 {
     EntangleCameraPrivate *priv = cam->priv;
 
     g_object_ref(cam);
 
+    ENTANGLE_TRACE_BEGIN("camera-job-wait");
     while (priv->jobActive) {
         g_cond_wait(priv->jobCond, priv->lock);
     }
+    ENTANGLE_TRACE_END("camera-job-wait");
 
     priv->jobActive = TRUE;
     g_mutex_unlock(priv->lock);
+    ENTANGLE_TRACE_BEGIN("camera-job");
 }
 
 
@@ -178,6 +294,7 @@ static void entangle_camera_end_job(EntangleCamera *cam)
 {
     EntangleCameraPrivate *priv = cam->priv;
 
+    ENTANGLE_TRACE_END("camera-job");
     priv->jobActive = FALSE;
     g_cond_broadcast(priv->jobCond);
     g_mutex_lock(priv->lock);
@@ -204,15 +321,15 @@ static void entangle_camera_get_property(GObject *object,
             break;
 
         case PROP_MANUAL:
-            g_value_set_string(value, priv->manual);
+            g_value_take_string(value, entangle_camera_get_manual(cam));
             break;
 
         case PROP_SUMMARY:
-            g_value_set_string(value, priv->summary);
+            g_value_take_string(value, entangle_camera_get_summary(cam));
             break;
 
         case PROP_DRIVER:
-            g_value_set_string(value, priv->driver);
+            g_value_take_string(value, entangle_camera_get_driver(cam));
             break;
 
         case PROP_PROGRESS:
@@ -258,6 +375,7 @@ static void entangle_camera_set_property(GObject *object,
         case PROP_PORT:
             g_free(priv->port);
             priv->port = g_value_dup_string(value);
+            priv->backend = entangle_camera_backend_for_port(priv->port);
             break;
 
         case PROP_PROGRESS:
@@ -297,11 +415,19 @@ static void entangle_camera_finalize(GObject *object)
 
     ENTANGLE_DEBUG("Finalize camera %p", object);
 
+    for (int i = 0; i < ENTANGLE_CAMERA_PREVIEW_FILES; i++) {
+        if (priv->previewFiles[i])
+            g_object_remove_toggle_ref(G_OBJECT(priv->previewFiles[i]),
+                                       entangle_camera_preview_file_toggle,
+                                       &priv->previewIdle[i]);
+        if (priv->previewData[i])
+            g_byte_array_unref(priv->previewData[i]);
+    }
     if (priv->progress)
         g_object_unref(priv->progress);
     if (priv->cam) {
-        gp_camera_exit(priv->cam, priv->ctx);
-        gp_camera_free(priv->cam);
+        priv->backend->exit(priv->cam, priv->ctx);
+        priv->backend->free(priv->cam);
     }
     if (priv->widgets)
         gp_widget_unref(priv->widgets);
@@ -309,10 +435,12 @@ static void entangle_camera_finalize(GObject *object)
         g_object_unref(priv->controls);
     if (priv->controlPaths)
         g_hash_table_unref(priv->controlPaths);
-    if (priv->ports)
-        gp_port_info_list_free(priv->ports);
-    if (priv->caps)
-        gp_abilities_list_free(priv->caps);
+    g_hash_table_unref(priv->controlProps);
+    g_hash_table_unref(priv->controlGuesses);
+    g_hash_table_unref(priv->controlsPending);
+    g_hash_table_unref(priv->controlsUnknown);
+    g_hash_table_unref(priv->controlsNotify);
+    g_free(priv->controlsFingerprint);
     gp_context_unref(priv->ctx);
     g_free(priv->driver);
     g_free(priv->summary);
@@ -413,6 +541,16 @@ static void entangle_camera_class_init(EntangleCameraClass *klass)
                  G_TYPE_NONE,
                  0);
 
+    g_signal_new("camera-control-paths-changed",
+                 G_TYPE_FROM_CLASS(klass),
+                 G_SIGNAL_RUN_FIRST,
+                 G_STRUCT_OFFSET(EntangleCameraClass, camera_control_paths_changed),
+                 NULL, NULL,
+                 g_cclosure_marshal_VOID__BOXED,
+                 G_TYPE_NONE,
+                 1,
+                 G_TYPE_STRV);
+
 
     g_object_class_install_property(object_class,
                                     PROP_MODEL,
@@ -552,6 +690,16 @@ static void entangle_camera_init(EntangleCamera *cam)
     cam->priv = ENTANGLE_CAMERA_GET_PRIVATE(cam);
     cam->priv->lock = g_mutex_new();
     cam->priv->jobCond = g_cond_new();
+    cam->priv->backend = &entangle_camera_backend_gphoto;
+    cam->priv->controlProps = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                    NULL, g_free);
+    cam->priv->controlsPending = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       g_free, NULL);
+    cam->priv->controlGuesses = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                      NULL, entangle_camera_guess_free);
+    cam->priv->controlsUnknown = g_hash_table_new(g_direct_hash, g_direct_equal);
+    cam->priv->controlsNotify = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                      g_free, NULL);
 }
 
 
@@ -755,10 +903,7 @@ gboolean entangle_camera_connect(EntangleCamera *cam,
     g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), FALSE);
 
     EntangleCameraPrivate *priv = cam->priv;
-    int i;
-    GPPortInfo port;
     CameraAbilities cap;
-    CameraText txt;
     int err;
     gboolean ret = FALSE;
 
@@ -771,31 +916,12 @@ gboolean entangle_camera_connect(EntangleCamera *cam,
         goto cleanup;
     }
 
-    priv->ctx = gp_context_new();
-
-    if (gp_abilities_list_new(&priv->caps) != GP_OK) {
-        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
-                    _("Cannot initialize gphoto2 abilities"));
-        goto cleanup;
-    }
-
-    if (gp_abilities_list_load(priv->caps, priv->ctx) != GP_OK) {
-        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
-                    _("Cannot load gphoto2 abilities"));
-        goto cleanup;
-    }
-
-    if (gp_port_info_list_new(&priv->ports) != GP_OK) {
-        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
-                    _("Cannot initialize gphoto2 ports"));
+    if (!(priv->cam = priv->backend->open(priv->model, priv->port,
+                                          &cap, error)))
         goto cleanup;
-    }
 
-    if (gp_port_info_list_load(priv->ports) != GP_OK) {
-        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
-                    _("Cannot load gphoto2 ports"));
-        goto cleanup;
-    }
+    if (!priv->ctx)
+        priv->ctx = gp_context_new();
 
     gp_context_set_error_func(priv->ctx,
                               do_entangle_camera_error,
@@ -806,22 +932,12 @@ gboolean entangle_camera_connect(EntangleCamera *cam,
                                   do_entangle_camera_progress_stop,
                                   cam);
 
-    i = gp_port_info_list_lookup_path(priv->ports, priv->port);
-    gp_port_info_list_get_info(priv->ports, i, &port);
-
-    i = gp_abilities_list_lookup_model(priv->caps, priv->model);
-    gp_abilities_list_get_abilities(priv->caps, i, &cap);
-
-    gp_camera_new(&priv->cam);
-    gp_camera_set_abilities(priv->cam, cap);
-    gp_camera_set_port_info(priv->cam, port);
-
     entangle_camera_begin_job(cam);
-    err = gp_camera_init(priv->cam, priv->ctx);
+    err = priv->backend->init(priv->cam, priv->ctx);
     entangle_camera_end_job(cam);
 
     if (err != GP_OK) {
-        gp_camera_unref(priv->cam);
+        priv->backend->free(priv->cam);
         priv->cam = NULL;
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to initialize camera"));
@@ -837,15 +953,11 @@ gboolean entangle_camera_connect(EntangleCamera *cam,
     if (cap.operations & GP_OPERATION_CONFIG)
         priv->hasSettings = TRUE;
     priv->hasViewfinder = FALSE;
+    priv->hasSingleConfig = priv->backend->has_single_config(priv->cam, FALSE);
+    priv->hasSingleConfigSet = priv->backend->has_single_config(priv->cam, TRUE);
 
-    gp_camera_get_summary(priv->cam, &txt, priv->ctx);
-    priv->summary = g_strdup(txt.text);
-
-    gp_camera_get_manual(priv->cam, &txt, priv->ctx);
-    priv->manual = g_strdup(txt.text);
-
-    gp_camera_get_about(priv->cam, &txt, priv->ctx);
-    priv->driver = g_strdup(txt.text);
+    if (priv->hasSettings)
+        do_restore_schema(cam);
 
     ENTANGLE_DEBUG("ok");
     ret = TRUE;
@@ -952,7 +1064,7 @@ gboolean entangle_camera_disconnect(EntangleCamera *cam,
     }
 
     entangle_camera_begin_job(cam);
-    gp_camera_exit(priv->cam, priv->ctx);
+    priv->backend->exit(priv->cam, priv->ctx);
     entangle_camera_end_job(cam);
 
     if (priv->widgets) {
@@ -967,26 +1079,27 @@ gboolean entangle_camera_disconnect(EntangleCamera *cam,
         g_hash_table_unref(priv->controlPaths);
         priv->controlPaths = NULL;
     }
+    g_hash_table_remove_all(priv->controlProps);
+    g_hash_table_remove_all(priv->controlGuesses);
+    g_hash_table_remove_all(priv->controlsPending);
+    g_hash_table_remove_all(priv->controlsUnknown);
+    priv->controlsStale = FALSE;
+    g_free(priv->controlsFingerprint);
+    priv->controlsFingerprint = NULL;
 
     g_free(priv->driver);
     g_free(priv->manual);
     g_free(priv->summary);
     priv->driver = priv->manual = priv->summary = NULL;
 
-    if (priv->ports) {
-        gp_port_info_list_free(priv->ports);
-        priv->ports = NULL;
-    }
-    if (priv->caps) {
-        gp_abilities_list_free(priv->caps);
-        priv->caps = NULL;
-    }
     gp_context_unref(priv->ctx);
     priv->ctx = NULL;
 
-    gp_camera_unref(priv->cam);
+    priv->backend->free(priv->cam);
     priv->cam = NULL;
     priv->hasViewfinder = FALSE;
+    priv->hasSingleConfig = FALSE;
+    priv->hasSingleConfigSet = FALSE;
 
     ret = TRUE;
  cleanup:
@@ -1085,27 +1198,124 @@ gboolean entangle_camera_get_connected(EntangleCamera *cam)
 }
 
 
+struct EntangleCameraTextData {
+    char **text;
+    gboolean *fetching;
+    int (*func)(gpointer, CameraText *, GPContext *);
+    const char *prop;
+    gboolean fetched;
+};
+
+
+static void entangle_camera_text_helper(GSimpleAsyncResult *result,
+                                        GObject *object,
+                                        GCancellable *cancellable G_GNUC_UNUSED)
+{
+    EntangleCamera *cam = ENTANGLE_CAMERA(object);
+    EntangleCameraPrivate *priv = cam->priv;
+    struct EntangleCameraTextData *data = g_simple_async_result_get_op_res_gpointer(result);
+    CameraText txt;
+    int err;
+
+    g_mutex_lock(priv->lock);
+
+    if (!*data->text && priv->cam) {
+        entangle_camera_begin_job(cam);
+        err = data->func(priv->cam, &txt, priv->ctx);
+        entangle_camera_end_job(cam);
+
+        /* May have been disconnected, or raced, while unlocked */
+        if (err == GP_OK && !*data->text && priv->cam) {
+            *data->text = g_strdup(txt.text);
+            data->fetched = TRUE;
+        }
+    }
+    *data->fetching = FALSE;
+
+    g_mutex_unlock(priv->lock);
+}
+
+
+static void entangle_camera_text_done(GObject *source,
+                                      GAsyncResult *result,
+                                      gpointer opaque G_GNUC_UNUSED)
+{
+    struct EntangleCameraTextData *data =
+        g_simple_async_result_get_op_res_gpointer(G_SIMPLE_ASYNC_RESULT(result));
+
+    if (data->fetched)
+        g_object_notify(source, data->prop);
+}
+
+
+/*
+ * The summary, manual & driver text are rarely looked at,
+ * and need camera I/O, which may have to wait behind a
+ * capture. So the getters only ever return what is cached,
+ * and the first access after connecting fetches the text
+ * in the background, notifying @prop once it arrives.
+ */
+static char *entangle_camera_get_text(EntangleCamera *cam,
+                                      char **text,
+                                      gboolean *fetching,
+                                      int (*func)(gpointer, CameraText *, GPContext *),
+                                      const char *prop)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    GSimpleAsyncResult *result;
+    struct EntangleCameraTextData *data;
+    gboolean fetch = FALSE;
+    char *ret;
+
+    g_mutex_lock(priv->lock);
+    ret = g_strdup(*text);
+    if (!*text && priv->cam && !*fetching)
+        fetch = *fetching = TRUE;
+    g_mutex_unlock(priv->lock);
+
+    if (!fetch)
+        return ret;
+
+    data = g_new0(struct EntangleCameraTextData, 1);
+    data->text = text;
+    data->fetching = fetching;
+    data->func = func;
+    data->prop = prop;
+
+    result = g_simple_async_result_new(G_OBJECT(cam),
+                                       entangle_camera_text_done,
+                                       NULL,
+                                       entangle_camera_get_text);
+    g_simple_async_result_set_op_res_gpointer(result, data, g_free);
+    g_simple_async_result_run_in_thread(result,
+                                        entangle_camera_text_helper,
+                                        G_PRIORITY_DEFAULT,
+                                        NULL);
+    g_object_unref(result);
+
+    return ret;
+}
+
+
 /**
  * entangle_camera_get_summary:
  * @cam: (transfer none): the camera
  *
  * Get the camera summary text. This is only available
- * while the camera is connected
+ * while the camera is connected. The text is fetched in
+ * the background on first use, so until #EntangleCamera:summary
+ * is notified this returns NULL
  *
- * Returns: (transfer full): the camera summary
+ * Returns: (transfer full)(allow-none): the camera summary
  */
 char *entangle_camera_get_summary(EntangleCamera *cam)
 {
     g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), NULL);
 
-    EntangleCameraPrivate *priv = cam->priv;
-    char *ret;
-
-    g_mutex_lock(priv->lock);
-    ret = g_strdup(priv->summary);
-    g_mutex_unlock(priv->lock);
-
-    return ret;
+    return entangle_camera_get_text(cam, &cam->priv->summary,
+                                    &cam->priv->summaryFetching,
+                                    cam->priv->backend->get_summary,
+                                    "summary");
 }
 
 
@@ -1115,22 +1325,20 @@ char *entangle_camera_get_summary(EntangleCamera *cam)
  * @cam: (transfer none): the camera
  *
  * Get the camera manual text. This is only available
- * while the camera is connected
+ * while the camera is connected. The text is fetched in
+ * the background on first use, so until #EntangleCamera:manual
+ * is notified this returns NULL
  *
- * Returns: (transfer full): the camera manual
+ * Returns: (transfer full)(allow-none): the camera manual
  */
 char *entangle_camera_get_manual(EntangleCamera *cam)
 {
     g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), NULL);
 
-    EntangleCameraPrivate *priv = cam->priv;
-    char *ret;
-
-    g_mutex_lock(priv->lock);
-    ret = g_strdup(priv->manual);
-    g_mutex_unlock(priv->lock);
-
-    return ret;
+    return entangle_camera_get_text(cam, &cam->priv->manual,
+                                    &cam->priv->manualFetching,
+                                    cam->priv->backend->get_manual,
+                                    "manual");
 }
 
 
@@ -1139,22 +1347,20 @@ char *entangle_camera_get_manual(EntangleCamera *cam)
  * @cam: (transfer none): the camera
  *
  * Get the camera driver information text. This is only available
- * while the camera is connected
+ * while the camera is connected. The text is fetched in
+ * the background on first use, so until #EntangleCamera:driver
+ * is notified this returns NULL
  *
- * Returns: (transfer full): the camera driver information
+ * Returns: (transfer full)(allow-none): the camera driver information
  */
 char *entangle_camera_get_driver(EntangleCamera *cam)
 {
     g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), NULL);
 
-    EntangleCameraPrivate *priv = cam->priv;
-    char *ret;
-
-    g_mutex_lock(priv->lock);
-    ret = g_strdup(priv->driver);
-    g_mutex_unlock(priv->lock);
-
-    return ret;
+    return entangle_camera_get_text(cam, &cam->priv->driver,
+                                    &cam->priv->driverFetching,
+                                    cam->priv->backend->get_about,
+                                    "driver");
 }
 
 
@@ -1194,15 +1400,19 @@ EntangleCameraFile *entangle_camera_capture_image(EntangleCamera *cam,
     ENTANGLE_DEBUG("Starting capture");
     entangle_camera_reset_last_error(cam);
     entangle_camera_begin_job(cam);
-    err = gp_camera_capture(priv->cam,
-                            GP_CAPTURE_IMAGE,
-                            &camerapath,
-                            priv->ctx);
+    entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                  ENTANGLE_CAPTURE_STAGE_JOB_START);
+    err = priv->backend->capture(priv->cam,
+                                 GP_CAPTURE_IMAGE,
+                                 &camerapath,
+                                 priv->ctx);
     entangle_camera_end_job(cam);
     if (err!= GP_OK) {
         ENTANGLE_ERROR(error, _("Unable to capture image: %s"), priv->lastError);
         goto cleanup;
     }
+    entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                  ENTANGLE_CAPTURE_STAGE_CAPTURED);
 
     file = entangle_camera_file_new(camerapath.folder,
                                     camerapath.name);
@@ -1293,6 +1503,89 @@ EntangleCameraFile *entangle_camera_capture_image_finish(EntangleCamera *cam,
 }
 
 
+/*
+ * The pool holds a toggle reference on each of its files,
+ * so is told as soon as the last user of one lets go,
+ * from whichever thread that happens in
+ */
+static void entangle_camera_preview_file_toggle(gpointer data,
+                                                GObject *object G_GNUC_UNUSED,
+                                                gboolean is_last_ref)
+{
+    gint *idle = data;
+
+    g_atomic_int_set(idle, is_last_ref);
+}
+
+
+/*
+ * Live view produces a frame every few tens of milliseconds,
+ * so rather than a new file and buffer for each, the files
+ * are recycled once nothing but the pool refers to them.
+ * The buffer keeps its capacity, so a frame no larger than
+ * an earlier one is copied in without allocating. Anyone
+ * wanting the data after dropping the file must copy it.
+ */
+static EntangleCameraFile *entangle_camera_preview_file(EntangleCamera *cam,
+                                                        const guint8 *rawdata,
+                                                        gsize rawdatalen)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    EntangleCameraFile *file = NULL;
+    GByteArray *data = NULL;
+    int slot = -1;
+    int i;
+
+    for (i = 0; i < ENTANGLE_CAMERA_PREVIEW_FILES; i++) {
+        if (!priv->previewFiles[i]) {
+            if (slot == -1)
+                slot = i;
+        } else if (g_atomic_int_compare_and_exchange(&priv->previewIdle[i],
+                                                     TRUE, FALSE)) {
+            file = g_object_ref(priv->previewFiles[i]);
+            slot = i;
+            break;
+        }
+    }
+
+    if (!file) {
+        file = entangle_camera_file_new(NULL, NULL);
+        if (slot != -1) {
+            priv->previewFiles[slot] = file;
+            g_object_add_toggle_ref(G_OBJECT(file),
+                                    entangle_camera_preview_file_toggle,
+                                    &priv->previewIdle[slot]);
+        }
+    }
+
+    /* The buffer is only written over while the pool's file
+     * still holds it, as it is then private to the two */
+    if (slot != -1 &&
+        priv->previewData[slot] &&
+        priv->previewData[slot] == entangle_camera_file_get_data(file)) {
+        data = g_byte_array_ref(priv->previewData[slot]);
+        g_byte_array_set_size(data, 0);
+        entangle_metrics_liveview_buffer(TRUE);
+    } else {
+        data = g_byte_array_sized_new(rawdatalen);
+        entangle_metrics_liveview_buffer(FALSE);
+        if (slot != -1 && priv->previewFiles[slot] == file) {
+            if (priv->previewData[slot])
+                g_byte_array_unref(priv->previewData[slot]);
+            priv->previewData[slot] = g_byte_array_ref(data);
+        }
+    }
+
+    g_byte_array_append(data, rawdata, rawdatalen);
+
+    /* Setting it again accounts for the new length */
+    entangle_camera_file_set_data(file, data);
+    g_byte_array_unref(data);
+
+    return file;
+}
+
+
 /**
  * entangle_camera_preview_image:
  * @cam: (transfer none): the camera
@@ -1305,6 +1598,10 @@ EntangleCameraFile *entangle_camera_capture_image_finish(EntangleCamera *cam,
  *
  * This block execution of the caller until completion.
  *
+ * The returned file is recycled for a later preview once
+ * it is released, so its data must be copied if it is to
+ * be kept any longer than the file.
+ *
  * Returns: (transfer full): the captured image or NULL
  */
 EntangleCameraFile *entangle_camera_preview_image(EntangleCamera *cam,
@@ -1316,7 +1613,6 @@ EntangleCameraFile *entangle_camera_preview_image(EntangleCamera *cam,
     EntangleCameraFile *file = NULL;
     CameraFile *datafile = NULL;
     const char *mimetype = NULL;
-    GByteArray *data = NULL;
     const char *rawdata;
     unsigned long int rawdatalen;
     const char *name;
@@ -1334,9 +1630,9 @@ EntangleCameraFile *entangle_camera_preview_image(EntangleCamera *cam,
     ENTANGLE_DEBUG("Starting preview");
     entangle_camera_reset_last_error(cam);
     entangle_camera_begin_job(cam);
-    err = gp_camera_capture_preview(priv->cam,
-                                    datafile,
-                                    priv->ctx);
+    err = priv->backend->capture_preview(priv->cam,
+                                         datafile,
+                                         priv->ctx);
     entangle_camera_end_job(cam);
 
     if (err != GP_OK) {
@@ -1355,17 +1651,12 @@ EntangleCameraFile *entangle_camera_preview_image(EntangleCamera *cam,
         goto cleanup;
     }
 
-    file = entangle_camera_file_new(NULL, NULL);
+    file = entangle_camera_preview_file(cam, (const guint8 *)rawdata, rawdatalen);
 
     if (gp_file_get_mime_type(datafile, &mimetype) == GP_OK)
         entangle_camera_file_set_mimetype(file, mimetype);
 
-    data = g_byte_array_new();
-    g_byte_array_append(data, (const guint8 *)rawdata, rawdatalen);
-
-    entangle_camera_file_set_data(file, data);
-    g_byte_array_unref(data);
-
+    entangle_metrics_add(ENTANGLE_METRICS_COUNTER_LIVEVIEW_FRAMES, 1);
     entangle_camera_emit_deferred(cam, "camera-file-previewed", G_OBJECT(file));
 
  cleanup:
@@ -1479,6 +1770,7 @@ gboolean entangle_camera_download_file(EntangleCamera *cam,
     unsigned long int datalen;
     GByteArray *filedata;
     gboolean ret = FALSE;
+    gint64 start, elapsed;
     int err;
 
     g_mutex_lock(priv->lock);
@@ -1497,12 +1789,14 @@ gboolean entangle_camera_download_file(EntangleCamera *cam,
     ENTANGLE_DEBUG("Getting file data");
     entangle_camera_reset_last_error(cam);
     entangle_camera_begin_job(cam);
-    err = gp_camera_file_get(priv->cam,
-                             entangle_camera_file_get_folder(file),
-                             entangle_camera_file_get_name(file),
-                             GP_FILE_TYPE_NORMAL,
-                             datafile,
-                             priv->ctx);
+    start = g_get_monotonic_time();
+    err = priv->backend->file_get(priv->cam,
+                                  entangle_camera_file_get_folder(file),
+                                  entangle_camera_file_get_name(file),
+                                  GP_FILE_TYPE_NORMAL,
+                                  datafile,
+                                  priv->ctx);
+    elapsed = g_get_monotonic_time() - start;
     g_usleep(1000*100);
     entangle_camera_end_job(cam);
 
@@ -1517,12 +1811,16 @@ gboolean entangle_camera_download_file(EntangleCamera *cam,
         goto cleanup;
     }
 
+    entangle_metrics_download(datalen, elapsed);
+
     filedata = g_byte_array_new();
     g_byte_array_append(filedata, (const guint8*)data, datalen);
 
     entangle_camera_file_set_data(file, filedata);
     g_byte_array_unref(filedata);
 
+    entangle_capture_latency_mark(entangle_capture_latency_get_default(),
+                                  ENTANGLE_CAPTURE_STAGE_DOWNLOADED);
     entangle_camera_emit_deferred(cam, "camera-file-downloaded", G_OBJECT(file));
 
     ret = TRUE;
@@ -1648,10 +1946,10 @@ gboolean entangle_camera_delete_file(EntangleCamera *cam,
 
     entangle_camera_reset_last_error(cam);
     entangle_camera_begin_job(cam);
-    err = gp_camera_file_delete(priv->cam,
-                                entangle_camera_file_get_folder(file),
-                                entangle_camera_file_get_name(file),
-                                priv->ctx);
+    err = priv->backend->file_delete(priv->cam,
+                                     entangle_camera_file_get_folder(file),
+                                     entangle_camera_file_get_name(file),
+                                     priv->ctx);
     g_usleep(1000*100);
     entangle_camera_end_job(cam);
 
@@ -1744,6 +2042,116 @@ gboolean entangle_camera_delete_file_finish(EntangleCamera *cam,
 }
 
 
+/*
+ * Standard PTP device properties and the name of the gphoto
+ * widget exposing them. Vendor properties (0xDxxx) overlap
+ * between manufacturers, so those are learnt at runtime
+ */
+static const struct {
+    guint code;
+    const char *name;
+} entangle_camera_ptp_props[] = {
+    { 0x5001, "batterylevel" },
+    { 0x5003, "imagesize" },
+    { 0x5004, "imagequality" },
+    { 0x5005, "whitebalance" },
+    { 0x5007, "f-number" },
+    { 0x5008, "focallength" },
+    { 0x500a, "focusmode" },
+    { 0x500b, "exposuremetermode" },
+    { 0x500c, "flashmode" },
+    { 0x500d, "shutterspeed" },
+    { 0x500e, "expprogram" },
+    { 0x500f, "iso" },
+    { 0x5010, "exposurecompensation" },
+    { 0x5013, "capturemode" },
+};
+
+
+static const char *entangle_camera_find_control_path(EntangleCamera *cam,
+                                                     guint code)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    GHashTableIter iter;
+    gpointer key;
+    const char *name = NULL;
+    const char *path;
+    gsize i;
+
+    if ((path = g_hash_table_lookup(priv->controlProps, GUINT_TO_POINTER(code))))
+        return path;
+
+    for (i = 0; i < G_N_ELEMENTS(entangle_camera_ptp_props); i++) {
+        if (entangle_camera_ptp_props[i].code == code) {
+            name = entangle_camera_ptp_props[i].name;
+            break;
+        }
+    }
+    if (!name)
+        return NULL;
+
+    g_hash_table_iter_init(&iter, priv->controlPaths);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        const char *leaf = strrchr(key, '/');
+        if (leaf && g_str_equal(leaf + 1, name)) {
+            path = g_strdup(key);
+            g_hash_table_insert(priv->controlProps, GUINT_TO_POINTER(code),
+                                (gpointer)path);
+            return path;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Record a "PTP Property xxxx changed" event so that the next
+ * entangle_camera_refresh_controls only has to fetch the
+ * affected widget, instead of the entire config tree.
+ *
+ * Returns the path of the affected control, or NULL if
+ * it is not known
+ */
+static const char *entangle_camera_queue_control_refresh(EntangleCamera *cam,
+                                                         const char *event)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    const char *prop;
+    const char *path;
+    char *end;
+    guint code;
+
+    if (!priv->controls) {
+        priv->controlsStale = TRUE;
+        return NULL;
+    }
+
+    if (!(prop = strstr(event, ENTANGLE_CAMERA_PTP_PROPERTY))) {
+        ENTANGLE_DEBUG("No property in '%s'", event);
+        priv->controlsStale = TRUE;
+        return NULL;
+    }
+    prop += strlen(ENTANGLE_CAMERA_PTP_PROPERTY);
+    code = strtoul(prop, &end, 16);
+    if (end == prop) {
+        ENTANGLE_DEBUG("Cannot parse property in '%s'", event);
+        priv->controlsStale = TRUE;
+        return NULL;
+    }
+
+    if ((path = entangle_camera_find_control_path(cam, code))) {
+        ENTANGLE_DEBUG("Property %04x maps to control '%s'", code, path);
+        g_hash_table_add(priv->controlsPending, g_strdup(path));
+    } else {
+        ENTANGLE_DEBUG("Property %04x has no known control", code);
+        g_hash_table_add(priv->controlsUnknown, GUINT_TO_POINTER(code));
+        priv->controlsStale = TRUE;
+    }
+    return path;
+}
+
+
 /**
  * entangle_camera_process_events:
  * @cam: (transfer none): the camera
@@ -1752,7 +2160,9 @@ gboolean entangle_camera_delete_file_finish(EntangleCamera *cam,
  * Wait upto @waitms milliseconds for events to arrive from
  * the camera. Signals will be emitted for any interesting
  * events that arrive. Multiple events will be processed
- * until @waitms is exceeded.
+ * until @waitms is exceeded. Control change events are
+ * coalesced over a short window, across calls, so a burst
+ * of them emits camera-controls-changed only once.
  *
  * This can only be invoked when the camera is connected.
  *
@@ -1792,7 +2202,7 @@ gboolean entangle_camera_process_events(EntangleCamera *cam,
     donems = 0;
     do {
         entangle_camera_begin_job(cam);
-        err = gp_camera_wait_for_event(priv->cam, waitms - donems, &eventType, &eventData, priv->ctx);
+        err = priv->backend->wait_for_event(priv->cam, waitms - donems, &eventType, &eventData, priv->ctx);
         entangle_camera_end_job(cam);
 
         if (err != GP_OK) {
@@ -1810,15 +2220,17 @@ gboolean entangle_camera_process_events(EntangleCamera *cam,
         switch (eventType) {
         case GP_EVENT_UNKNOWN:
             if (eventData &&
-                strstr((char*)eventData, "PTP Property") &&
+                strstr((char*)eventData, ENTANGLE_CAMERA_PTP_PROPERTY) &&
                 strstr((char*)eventData, "changed")) {
                 ENTANGLE_DEBUG("Config changed '%s'", (char *)eventData);
                 /* For some reason, every time we request the camera config
                  * with gp_camera_get_config, it will be followed by an
                  * event with key 'd10d'. So we must ignore that event
                  */
-                if (strstr(eventData, "d10d") == NULL)
-                    entangle_camera_emit_deferred(cam, "camera-controls-changed", NULL);
+                if (strstr(eventData, "d10d") == NULL) {
+                    const char *path = entangle_camera_queue_control_refresh(cam, eventData);
+                    entangle_camera_queue_controls_changed(cam, path);
+                }
             } else {
                 ENTANGLE_DEBUG("Unknown event '%s'", (char *)eventData);
             }
@@ -2146,6 +2558,17 @@ static gboolean entangle_str_equal_null(gchar *a, gchar *b)
 }
 
 
+static void do_note_control_updated(EntangleCamera *cam,
+                                    EntangleControl *ctrl)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+
+    if (priv->controlsUpdated)
+        g_ptr_array_add(priv->controlsUpdated,
+                        g_strdup(entangle_control_get_path(ctrl)));
+}
+
+
 /*
  * XXX this method causes signals to be emitted from controls
  * in non-main threads, if triggered via an _async() method.
@@ -2221,6 +2644,7 @@ static gboolean do_load_controls(EntangleCamera *cam,
                 ENTANGLE_DEBUG("Add choice '%s'", choice);
                 entangle_control_choice_add_entry(ENTANGLE_CONTROL_CHOICE(ctrl), choice);
             }
+            do_note_control_updated(cam, ctrl);
             g_object_set(ctrl, "value", newValue, NULL);
         }
         g_free(oldValue);
@@ -2241,6 +2665,7 @@ static gboolean do_load_controls(EntangleCamera *cam,
                            entangle_control_get_path(ctrl),
                            entangle_control_get_label(ctrl),
                            (double)oldValue, (double)newValue);
+            do_note_control_updated(cam, ctrl);
             g_object_set(ctrl, "value", (double)newValue, NULL);
         }
     }   break;
@@ -2255,6 +2680,7 @@ static gboolean do_load_controls(EntangleCamera *cam,
                            entangle_control_get_path(ctrl),
                            entangle_control_get_label(ctrl),
                            oldValue, newValue);
+            do_note_control_updated(cam, ctrl);
             g_object_set(ctrl, "value", newValue, NULL);
         }
         g_free(oldValue);
@@ -2272,6 +2698,7 @@ static gboolean do_load_controls(EntangleCamera *cam,
                            entangle_control_get_path(ctrl),
                            entangle_control_get_label(ctrl),
                            oldValue, newValue);
+            do_note_control_updated(cam, ctrl);
             g_object_set(ctrl, "value", newValue, NULL);
         }
     }   break;
@@ -2291,7 +2718,7 @@ static gboolean do_load_controls(EntangleCamera *cam,
 static gboolean do_save_controls(EntangleCamera *cam,
                                  const char *path,
                                  CameraWidget *widget,
-                                 gboolean *dirty,
+                                 GPtrArray *dirty,
                                  GError **error)
 {
     EntangleCameraPrivate *priv = cam->priv;
@@ -2343,7 +2770,7 @@ static gboolean do_save_controls(EntangleCamera *cam,
             g_object_get(ctrl, "value", &value, NULL);
             gp_widget_set_value(widget, value);
             g_free(value);
-            *dirty = TRUE;
+            g_ptr_array_add(dirty, widget);
         }
         break;
 
@@ -2351,7 +2778,7 @@ static gboolean do_save_controls(EntangleCamera *cam,
         if (entangle_control_get_dirty(ctrl)) {
             int value = 0;
             g_object_get(ctrl, "value", &value, NULL);
-            *dirty = TRUE;
+            g_ptr_array_add(dirty, widget);
         }
         break;
 
@@ -2360,7 +2787,7 @@ static gboolean do_save_controls(EntangleCamera *cam,
             float value = 0.0;
             g_object_get(ctrl, "value", &value, NULL);
             gp_widget_set_value(widget, &value);
-            *dirty = TRUE;
+            g_ptr_array_add(dirty, widget);
         }
         break;
 
@@ -2370,7 +2797,7 @@ static gboolean do_save_controls(EntangleCamera *cam,
             g_object_get(ctrl, "value", &value, NULL);
             gp_widget_set_value(widget, value);
             g_free(value);
-            *dirty = TRUE;
+            g_ptr_array_add(dirty, widget);
         }
         break;
 
@@ -2381,7 +2808,7 @@ static gboolean do_save_controls(EntangleCamera *cam,
             g_object_get(ctrl, "value", &value, NULL);
             i = value ? 1 : 0;
             gp_widget_set_value(widget, &i);
-            *dirty = TRUE;
+            g_ptr_array_add(dirty, widget);
         }
         break;
 
@@ -2397,44 +2824,364 @@ static gboolean do_save_controls(EntangleCamera *cam,
 }
 
 
-/**
- * entangle_camera_load_controls:
- * @cam: (transfer none): the camera
- *
- * Loads the configuration controls from the camera.
- *
- * This can only be invoked when the camera is connected.
- *
- * This block execution of the caller until completion.
- *
- * Returns: TRUE if the controls were loaded, FALSE on error
+/*
+ * The structure of the control tree is fixed for a given camera
+ * model & firmware, so it is cached on disk, letting the controls
+ * be shown immediately on connect, ahead of the (slow) first full
+ * config fetch which fills in their values.
+ *
+ * Each control is a group "control N", numbered in tree order,
+ * holding its path and the number of its parent. Widget names
+ * are not safe to use as group names, and the order of groups
+ * in a key file is not something to rely on.
  */
-gboolean entangle_camera_load_controls(EntangleCamera *cam,
-                                       GError **error)
+#define ENTANGLE_CAMERA_SCHEMA_VERSION 2
+
+static char *do_schema_filename(EntangleCamera *cam)
 {
-    g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), FALSE);
+    EntangleCameraPrivate *priv = cam->priv;
+    char *model = g_strdup(priv->model);
+    char *name;
+    char *file;
+
+    g_strcanon(model, G_CSET_A_2_Z G_CSET_a_2_z G_CSET_DIGITS "-_.", '_');
+    name = g_strdup_printf("%s.schema", model);
+    file = g_build_filename(g_get_user_cache_dir(),
+                            "entangle", "controls", name, NULL);
+    g_free(name);
+    g_free(model);
+    return file;
+}
+
+
+/*
+ * Digest of the widget tree structure, to detect when a cached
+ * schema no longer matches the camera, eg after a firmware
+ * update. Choices are excluded since they vary with the mode
+ * the camera is in.
+ */
+static void do_fingerprint_widgets(GChecksum *sum,
+                                   CameraWidget *widget)
+{
+    CameraWidgetType type;
+    const char *name;
+
+    if (gp_widget_get_type(widget, &type) != GP_OK ||
+        gp_widget_get_name(widget, &name) != GP_OK)
+        return;
+
+    g_checksum_update(sum, (const guchar *)name, strlen(name) + 1);
+    g_checksum_update(sum, (const guchar *)&type, sizeof(type));
+
+    if (type == GP_WIDGET_RANGE) {
+        float range[3];
+        gp_widget_get_range(widget, &range[0], &range[1], &range[2]);
+        g_checksum_update(sum, (const guchar *)range, sizeof(range));
+    }
+
+    for (int i = 0; i < gp_widget_count_children(widget); i++) {
+        CameraWidget *child;
+        if (gp_widget_get_child(widget, i, &child) == GP_OK)
+            do_fingerprint_widgets(sum, child);
+    }
+    g_checksum_update(sum, (const guchar *)"", 1);
+}
+
 
+static char *do_schema_group(int idx)
+{
+    return g_strdup_printf("control %d", idx);
+}
+
+
+static void do_save_schema_control(GKeyFile *schema,
+                                   EntangleControl *ctrl,
+                                   int parent,
+                                   int *count)
+{
+    int idx = (*count)++;
+    char *group = do_schema_group(idx);
+    const char *type = NULL;
+
+    if (ENTANGLE_IS_CONTROL_GROUP(ctrl)) {
+        type = "group";
+    } else if (ENTANGLE_IS_CONTROL_BUTTON(ctrl)) {
+        type = "button";
+    } else if (ENTANGLE_IS_CONTROL_CHOICE(ctrl)) {
+        EntangleControlChoice *choice = ENTANGLE_CONTROL_CHOICE(ctrl);
+        int n = entangle_control_choice_entry_count(choice);
+        const char **entries = g_new0(const char *, n + 1);
+        for (int i = 0; i < n; i++)
+            entries[i] = entangle_control_choice_entry_get(choice, i);
+        g_key_file_set_string_list(schema, group, "choices", entries, n);
+        g_free(entries);
+        type = "choice";
+    } else if (ENTANGLE_IS_CONTROL_DATE(ctrl)) {
+        type = "date";
+    } else if (ENTANGLE_IS_CONTROL_RANGE(ctrl)) {
+        EntangleControlRange *range = ENTANGLE_CONTROL_RANGE(ctrl);
+        g_key_file_set_double(schema, group, "min",
+                              entangle_control_range_get_min(range));
+        g_key_file_set_double(schema, group, "max",
+                              entangle_control_range_get_max(range));
+        g_key_file_set_double(schema, group, "step",
+                              entangle_control_range_get_step(range));
+        type = "range";
+    } else if (ENTANGLE_IS_CONTROL_TEXT(ctrl)) {
+        type = "text";
+    } else if (ENTANGLE_IS_CONTROL_TOGGLE(ctrl)) {
+        type = "toggle";
+    } else {
+        g_warn_if_reached();
+        g_key_file_remove_group(schema, group, NULL);
+        (*count)--;
+        g_free(group);
+        return;
+    }
+
+    g_key_file_set_string(schema, group, "path", entangle_control_get_path(ctrl));
+    g_key_file_set_integer(schema, group, "parent", parent);
+    g_key_file_set_string(schema, group, "type", type);
+    g_key_file_set_integer(schema, group, "id", entangle_control_get_id(ctrl));
+    g_key_file_set_string(schema, group, "label", entangle_control_get_label(ctrl));
+    g_key_file_set_string(schema, group, "info", entangle_control_get_info(ctrl));
+    g_key_file_set_boolean(schema, group, "readonly", entangle_control_get_readonly(ctrl));
+
+    if (ENTANGLE_IS_CONTROL_GROUP(ctrl)) {
+        EntangleControlGroup *grp = ENTANGLE_CONTROL_GROUP(ctrl);
+        for (guint i = 0; i < entangle_control_group_count(grp); i++)
+            do_save_schema_control(schema, entangle_control_group_get(grp, i),
+                                   idx, count);
+    }
+    g_free(group);
+}
+
+
+static void do_save_schema(EntangleCamera *cam)
+{
     EntangleCameraPrivate *priv = cam->priv;
-    gboolean ret = FALSE;
-    int err;
+    GKeyFile *schema = g_key_file_new();
+    char *file = do_schema_filename(cam);
+    char *dir = g_path_get_dirname(file);
+    GError *error = NULL;
+    gchar *data;
+    gsize len;
+    int count = 0;
+
+    g_key_file_set_integer(schema, "schema", "version",
+                           ENTANGLE_CAMERA_SCHEMA_VERSION);
+    g_key_file_set_string(schema, "schema", "fingerprint",
+                          priv->controlsFingerprint);
+    g_key_file_set_boolean(schema, "schema", "viewfinder",
+                           priv->hasViewfinder);
+    do_save_schema_control(schema, ENTANGLE_CONTROL(priv->controls), -1, &count);
+    g_key_file_set_integer(schema, "schema", "controls", count);
+
+    data = g_key_file_to_data(schema, &len, NULL);
+    if (g_mkdir_with_parents(dir, 0777) < 0 ||
+        !g_file_set_contents(file, data, len, &error)) {
+        ENTANGLE_DEBUG("Unable to save control schema %s: %s",
+                       file, error ? error->message : g_strerror(errno));
+        g_clear_error(&error);
+    } else {
+        ENTANGLE_DEBUG("Saved control schema %s", file);
+    }
 
-    g_mutex_lock(priv->lock);
+    g_free(data);
+    g_free(dir);
+    g_free(file);
+    g_key_file_free(schema);
+}
 
-    if (priv->cam == NULL) {
-        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
-                    _("Unable to load controls, camera is not connected"));
+
+static EntangleControl *do_restore_schema_control(GKeyFile *schema,
+                                                  const char *group)
+{
+    EntangleControl *ret = NULL;
+    gchar *path = g_key_file_get_string(schema, group, "path", NULL);
+    gchar *type = g_key_file_get_string(schema, group, "type", NULL);
+    gchar *label = g_key_file_get_string(schema, group, "label", NULL);
+    gchar *info = g_key_file_get_string(schema, group, "info", NULL);
+    int id = g_key_file_get_integer(schema, group, "id", NULL);
+    gboolean ro = g_key_file_get_boolean(schema, group, "readonly", NULL);
+
+    if (!path || !type || !label || !info)
+        goto cleanup;
+
+    if (g_str_equal(type, "group")) {
+        ret = ENTANGLE_CONTROL(entangle_control_group_new(path, id, label, info, ro));
+    } else if (g_str_equal(type, "button")) {
+        ret = ENTANGLE_CONTROL(entangle_control_button_new(path, id, label, info, ro));
+    } else if (g_str_equal(type, "choice")) {
+        gchar **choices = g_key_file_get_string_list(schema, group, "choices", NULL, NULL);
+        ret = ENTANGLE_CONTROL(entangle_control_choice_new(path, id, label, info, ro));
+        for (gsize i = 0; choices && choices[i]; i++)
+            entangle_control_choice_add_entry(ENTANGLE_CONTROL_CHOICE(ret), choices[i]);
+        g_strfreev(choices);
+    } else if (g_str_equal(type, "date")) {
+        ret = ENTANGLE_CONTROL(entangle_control_date_new(path, id, label, info, ro));
+    } else if (g_str_equal(type, "range")) {
+        ret = ENTANGLE_CONTROL(entangle_control_range_new(path, id, label, info, ro,
+                                                          g_key_file_get_double(schema, group, "min", NULL),
+                                                          g_key_file_get_double(schema, group, "max", NULL),
+                                                          g_key_file_get_double(schema, group, "step", NULL)));
+    } else if (g_str_equal(type, "text")) {
+        ret = ENTANGLE_CONTROL(entangle_control_text_new(path, id, label, info, ro));
+    } else if (g_str_equal(type, "toggle")) {
+        ret = ENTANGLE_CONTROL(entangle_control_toggle_new(path, id, label, info, ro));
+    }
+
+ cleanup:
+    g_free(path);
+    g_free(type);
+    g_free(label);
+    g_free(info);
+    return ret;
+}
+
+
+/*
+ * Build the controls from the cached schema for this camera
+ * model, if any. The controls will have no values until the
+ * first full fetch, which also verifies the fingerprint.
+ * Must be called with the lock held
+ */
+static void do_restore_schema(EntangleCamera *cam)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    GKeyFile *schema = g_key_file_new();
+    char *file = do_schema_filename(cam);
+    EntangleControl *root = NULL;
+    GHashTable *paths = NULL;
+    GPtrArray *ctrls = NULL;
+    int count;
+
+    if (!g_key_file_load_from_file(schema, file, G_KEY_FILE_NONE, NULL))
+        goto cleanup;
+
+    if (g_key_file_get_integer(schema, "schema", "version", NULL) !=
+        ENTANGLE_CAMERA_SCHEMA_VERSION) {
+        ENTANGLE_DEBUG("Ignoring control schema %s with wrong version", file);
         goto cleanup;
     }
 
+    paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    ctrls = g_ptr_array_new();
+    count = g_key_file_get_integer(schema, "schema", "controls", NULL);
+    for (int i = 0; i < count; i++) {
+        char *group = do_schema_group(i);
+        EntangleControl *ctrl;
+        EntangleControl *parent;
+        int parentidx;
+
+        ctrl = do_restore_schema_control(schema, group);
+        parentidx = g_key_file_get_integer(schema, group, "parent", NULL);
+        g_free(group);
+        if (!ctrl) {
+            ENTANGLE_DEBUG("Malformed control %d in schema %s", i, file);
+            goto error;
+        }
+
+        if (i == 0) {
+            if (!ENTANGLE_IS_CONTROL_GROUP(ctrl)) {
+                g_object_unref(ctrl);
+                goto error;
+            }
+            root = ctrl;
+        } else {
+            /* Parents always come before their children */
+            parent = parentidx >= 0 && parentidx < i ?
+                g_ptr_array_index(ctrls, parentidx) : NULL;
+            if (!parent || !ENTANGLE_IS_CONTROL_GROUP(parent)) {
+                ENTANGLE_DEBUG("Orphan control %s in schema %s",
+                               entangle_control_get_path(ctrl), file);
+                g_object_unref(ctrl);
+                goto error;
+            }
+            entangle_control_group_add(ENTANGLE_CONTROL_GROUP(parent), ctrl);
+            g_object_unref(ctrl);
+        }
+        g_ptr_array_add(ctrls, ctrl);
+        g_hash_table_insert(paths, g_strdup(entangle_control_get_path(ctrl)), ctrl);
+    }
+
+    if (!root)
+        goto error;
+
+    ENTANGLE_DEBUG("Restored controls from schema %s", file);
+    priv->controls = ENTANGLE_CONTROL_GROUP(root);
+    priv->controlPaths = paths;
+    priv->controlsFingerprint = g_key_file_get_string(schema, "schema",
+                                                      "fingerprint", NULL);
+    priv->hasViewfinder = g_key_file_get_boolean(schema, "schema",
+                                                 "viewfinder", NULL);
+    root = NULL;
+    paths = NULL;
+
+ error:
+    if (root)
+        g_object_unref(root);
+    if (paths)
+        g_hash_table_unref(paths);
+    if (ctrls)
+        g_ptr_array_unref(ctrls);
+ cleanup:
+    g_free(file);
+    g_key_file_free(schema);
+}
+
+
+/*
+ * Fetch the full widget tree from the camera and update the
+ * controls. Must be called with the lock held, and the camera
+ * connected
+ */
+static gboolean do_fetch_controls(EntangleCamera *cam,
+                                  GError **error)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    CameraWidget *widgets = NULL;
+    GChecksum *sum;
+    gchar *fingerprint;
+    gboolean rebuilt = FALSE;
+    gboolean ret = FALSE;
+    int err;
+
+    g_hash_table_remove_all(priv->controlsPending);
+    g_hash_table_remove_all(priv->controlsUnknown);
+    priv->controlsStale = FALSE;
+
     entangle_camera_begin_job(cam);
     ENTANGLE_DEBUG("Loading control values");
-    err = gp_camera_get_config(priv->cam, &priv->widgets, priv->ctx);
+    err = priv->backend->get_config(priv->cam, &widgets, priv->ctx);
     if (err != GP_OK) {
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to fetch camera control configuration"));
         goto endjob;
     }
 
+    if (priv->widgets)
+        gp_widget_unref(priv->widgets);
+    priv->widgets = widgets;
+
+    sum = g_checksum_new(G_CHECKSUM_SHA1);
+    do_fingerprint_widgets(sum, priv->widgets);
+    fingerprint = g_strdup(g_checksum_get_string(sum));
+    g_checksum_free(sum);
+
+    if (priv->controls &&
+        g_strcmp0(priv->controlsFingerprint, fingerprint) != 0) {
+        ENTANGLE_DEBUG("Control structure changed, rebuilding");
+        g_object_unref(priv->controls);
+        priv->controls = NULL;
+        g_hash_table_unref(priv->controlPaths);
+        priv->controlPaths = NULL;
+        g_hash_table_remove_all(priv->controlProps);
+        g_hash_table_remove_all(priv->controlGuesses);
+    }
+    g_free(priv->controlsFingerprint);
+    priv->controlsFingerprint = fingerprint;
+
     if (priv->controls == NULL) {
         ENTANGLE_DEBUG("Building controls");
         priv->controlPaths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
@@ -2452,12 +3199,80 @@ gboolean entangle_camera_load_controls(EntangleCamera *cam,
             ENTANGLE_DEBUG("No viewfinder widget");
             priv->hasViewfinder = FALSE;
         }
+        rebuilt = TRUE;
     }
 
     ret = do_load_controls(cam, "", priv->widgets, error);
 
+    /* Saved after loading values, so choices are populated */
+    if (ret && rebuilt)
+        do_save_schema(cam);
+
  endjob:
     entangle_camera_end_job(cam);
+    return ret;
+}
+
+
+static gboolean do_refresh_control(EntangleCamera *cam,
+                                   const char *path,
+                                   GError **error)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    CameraWidget *widget = NULL;
+    const char *name = strrchr(path, '/') + 1;
+    gchar *parent = g_path_get_dirname(path);
+    gboolean ret = FALSE;
+    int err;
+
+    ENTANGLE_DEBUG("Refreshing control '%s'", path);
+    if ((err = priv->backend->get_single_config(priv->cam, name,
+                                                &widget, priv->ctx)) != GP_OK) {
+        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
+                    _("Unable to fetch camera control %s: %s %d"),
+                    path, gp_port_result_as_string(err), err);
+        goto cleanup;
+    }
+
+    ret = do_load_controls(cam, parent, widget, error);
+
+ cleanup:
+    if (widget)
+        gp_widget_free(widget);
+    g_free(parent);
+    return ret;
+}
+
+
+/**
+ * entangle_camera_load_controls:
+ * @cam: (transfer none): the camera
+ *
+ * Loads the configuration controls from the camera.
+ *
+ * This can only be invoked when the camera is connected.
+ *
+ * This block execution of the caller until completion.
+ *
+ * Returns: TRUE if the controls were loaded, FALSE on error
+ */
+gboolean entangle_camera_load_controls(EntangleCamera *cam,
+                                       GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), FALSE);
+
+    EntangleCameraPrivate *priv = cam->priv;
+    gboolean ret = FALSE;
+
+    g_mutex_lock(priv->lock);
+
+    if (priv->cam == NULL) {
+        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
+                    _("Unable to load controls, camera is not connected"));
+        goto cleanup;
+    }
+
+    ret = do_fetch_controls(cam, error);
 
  cleanup:
     g_mutex_unlock(priv->lock);
@@ -2530,11 +3345,222 @@ gboolean entangle_camera_load_controls_finish(EntangleCamera *cam,
 }
 
 
+/*
+ * After a full reload triggered by a single unmapped property,
+ * if exactly one control (not otherwise accounted for) changed
+ * value, it is a guess at the control for that property. Some
+ * other control may have changed by coincidence, so the guess
+ * is only remembered, letting future events for the property
+ * use the incremental refresh, once that many reloads in a row
+ * agree. Any reload which disagrees starts over.
+ */
+static void do_learn_control_path(EntangleCamera *cam,
+                                  guint code,
+                                  GHashTable *pending)
+{
+    EntangleCameraPrivate *priv = cam->priv;
+    EntangleCameraGuess *guess;
+    const char *candidate = NULL;
+    gsize i;
+
+    for (i = 0; i < priv->controlsUpdated->len; i++) {
+        const char *path = g_ptr_array_index(priv->controlsUpdated, i);
+
+        if (g_hash_table_contains(pending, path))
+            continue;
+        if (candidate && !g_str_equal(candidate, path)) {
+            candidate = NULL;
+            break;
+        }
+        candidate = path;
+    }
+
+    guess = g_hash_table_lookup(priv->controlGuesses, GUINT_TO_POINTER(code));
+    if (!candidate) {
+        if (guess)
+            ENTANGLE_DEBUG("Property %04x no longer looks like control '%s'",
+                           code, guess->path);
+        g_hash_table_remove(priv->controlGuesses, GUINT_TO_POINTER(code));
+        return;
+    }
+
+    if (!guess || !g_str_equal(guess->path, candidate)) {
+        guess = g_new0(EntangleCameraGuess, 1);
+        guess->path = g_strdup(candidate);
+        g_hash_table_insert(priv->controlGuesses, GUINT_TO_POINTER(code), guess);
+    }
+
+    if (++guess->matches < ENTANGLE_CAMERA_LEARN_CONFIRMATIONS) {
+        ENTANGLE_DEBUG("Property %04x may map to control '%s'",
+                       code, candidate);
+        return;
+    }
+
+    ENTANGLE_DEBUG("Learnt property %04x maps to control '%s'",
+                   code, candidate);
+    g_hash_table_insert(priv->controlProps, GUINT_TO_POINTER(code),
+                        g_strdup(candidate));
+    g_hash_table_remove(priv->controlGuesses, GUINT_TO_POINTER(code));
+}
+
+
+/**
+ * entangle_camera_refresh_controls:
+ * @cam: (transfer none): the camera
+ *
+ * Refreshes the configuration controls which the camera has
+ * reported as changed since they were last loaded. Where the
+ * changed controls are known and the driver supports it, only
+ * those widgets are fetched from the camera, otherwise this
+ * falls back to reloading all controls.
+ *
+ * This can only be invoked when the camera is connected.
+ *
+ * This block execution of the caller until completion.
+ *
+ * Returns: TRUE if the controls were refreshed, FALSE on error
+ */
+gboolean entangle_camera_refresh_controls(EntangleCamera *cam,
+                                          GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), FALSE);
+
+    EntangleCameraPrivate *priv = cam->priv;
+    GHashTable *pending = NULL;
+    gpointer code = NULL;
+    gboolean ret = FALSE;
+
+    g_mutex_lock(priv->lock);
+
+    if (priv->cam == NULL) {
+        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
+                    _("Unable to refresh controls, camera is not connected"));
+        goto cleanup;
+    }
+
+    pending = priv->controlsPending;
+    priv->controlsPending = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free, NULL);
+
+    if (priv->controls && priv->hasSingleConfig && !priv->controlsStale) {
+        GHashTableIter iter;
+        gpointer path;
+        GError *tmperr = NULL;
+
+        ret = TRUE;
+        entangle_camera_begin_job(cam);
+        g_hash_table_iter_init(&iter, pending);
+        while (ret && g_hash_table_iter_next(&iter, &path, NULL))
+            ret = do_refresh_control(cam, path, &tmperr);
+        entangle_camera_end_job(cam);
+
+        if (ret)
+            goto cleanup;
+
+        ENTANGLE_DEBUG("Incremental refresh failed, reloading all: %s",
+                       tmperr->message);
+        g_error_free(tmperr);
+    }
+
+    if (priv->controls &&
+        g_hash_table_size(priv->controlsUnknown) == 1) {
+        GHashTableIter iter;
+        g_hash_table_iter_init(&iter, priv->controlsUnknown);
+        g_hash_table_iter_next(&iter, &code, NULL);
+        priv->controlsUpdated = g_ptr_array_new_with_free_func(g_free);
+    }
+
+    ret = do_fetch_controls(cam, error);
+
+    if (priv->controlsUpdated) {
+        if (ret)
+            do_learn_control_path(cam, GPOINTER_TO_UINT(code), pending);
+        g_ptr_array_unref(priv->controlsUpdated);
+        priv->controlsUpdated = NULL;
+    }
+
+ cleanup:
+    if (pending)
+        g_hash_table_unref(pending);
+    g_mutex_unlock(priv->lock);
+    return ret;
+}
+
+
+static void entangle_camera_refresh_controls_helper(GSimpleAsyncResult *result,
+                                                    GObject *object,
+                                                    GCancellable *cancellable G_GNUC_UNUSED)
+{
+    GError *error = NULL;
+
+    if (!entangle_camera_refresh_controls(ENTANGLE_CAMERA(object), &error)) {
+        g_simple_async_result_set_from_error(result, error);
+        g_error_free(error);
+    }
+}
+
+
+/**
+ * entangle_camera_refresh_controls_async:
+ * @cam: (transfer none): the camera
+ *
+ * Refreshes the configuration controls which the camera has
+ * reported as changed since they were last loaded.
+ *
+ * This can only be invoked when the camera is connected.
+ *
+ * This will execute in the background, and invoke @callback
+ * when complete, whereupon entangle_camera_refresh_controls_finish
+ * can be used to check the status
+ */
+void entangle_camera_refresh_controls_async(EntangleCamera *cam,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA(cam));
+
+    GSimpleAsyncResult *result = g_simple_async_result_new(G_OBJECT(cam),
+                                                           callback,
+                                                           user_data,
+                                                           entangle_camera_refresh_controls_async);
+
+    g_simple_async_result_run_in_thread(result,
+                                        entangle_camera_refresh_controls_helper,
+                                        G_PRIORITY_DEFAULT,
+                                        cancellable);
+    g_object_unref(result);
+}
+
+
+/**
+ * entangle_camera_refresh_controls_finish:
+ * @cam: (transfer none): the camera
+ *
+ * Check the completion status of a previous call to
+ * entangle_camera_refresh_controls_async.
+ *
+ * Returns: TRUE if the controls were refreshed, FALSE on error
+ */
+gboolean entangle_camera_refresh_controls_finish(EntangleCamera *cam,
+                                                 GAsyncResult *result,
+                                                 GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAMERA(cam), FALSE);
+
+    return !g_simple_async_result_propagate_error(G_SIMPLE_ASYNC_RESULT(result),
+                                                  error);
+}
+
+
 /**
  * entangle_camera_save_controls:
  * @cam: (transfer none): the camera
  *
- * Saves the configuration controls to the camera.
+ * Saves the configuration controls to the camera. Only
+ * controls which have been modified are written, as a
+ * single job. Where the driver supports it, each modified
+ * widget is set individually, rather than the entire tree.
  *
  * This can only be invoked when the camera is connected.
  *
@@ -2549,7 +3575,7 @@ gboolean entangle_camera_save_controls(EntangleCamera *cam,
 
     EntangleCameraPrivate *priv = cam->priv;
     gboolean ret = FALSE;
-    gboolean dirty = FALSE;
+    GPtrArray *dirty = g_ptr_array_new();
     int err;
 
     g_mutex_lock(priv->lock);
@@ -2566,24 +3592,49 @@ gboolean entangle_camera_save_controls(EntangleCamera *cam,
         goto cleanup;
     }
 
+    if (priv->widgets == NULL) {
+        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
+                    _("Unable to save controls, values are not yet loaded"));
+        goto cleanup;
+    }
+
     entangle_camera_begin_job(cam);
 
     ENTANGLE_DEBUG("Saving controls for %p", cam);
 
     if (!do_save_controls(cam, "", priv->widgets,
-                          &dirty, error))
+                          dirty, error))
         goto endjob;
 
-    if (!dirty) {
+    if (dirty->len == 0) {
         ENTANGLE_DEBUG("No widgets dirty, skipping");
         goto done;
     }
 
-    if ((err = gp_camera_set_config(priv->cam, priv->widgets, priv->ctx)) != GP_OK) {
-        g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
-                    _("Unable to save camera control configuration: %s %d"),
-                    gp_port_result_as_string(err), err);
-        goto endjob;
+    if (priv->hasSingleConfigSet) {
+        /* Only push the widgets which changed, rather than
+         * having the driver walk & write the entire tree */
+        for (gsize i = 0; i < dirty->len; i++) {
+            CameraWidget *widget = g_ptr_array_index(dirty, i);
+            const char *name;
+
+            gp_widget_get_name(widget, &name);
+            ENTANGLE_DEBUG("Saving control '%s'", name);
+            if ((err = priv->backend->set_single_config(priv->cam, name,
+                                                        widget, priv->ctx)) != GP_OK) {
+                g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
+                            _("Unable to save camera control %s: %s %d"),
+                            name, gp_port_result_as_string(err), err);
+                goto endjob;
+            }
+        }
+    } else {
+        if ((err = priv->backend->set_config(priv->cam, priv->widgets, priv->ctx)) != GP_OK) {
+            g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
+                        _("Unable to save camera control configuration: %s %d"),
+                        gp_port_result_as_string(err), err);
+            goto endjob;
+        }
     }
 
     if (!do_load_controls(cam, "", priv->widgets, error))
@@ -2597,6 +3648,7 @@ gboolean entangle_camera_save_controls(EntangleCamera *cam,
 
  cleanup:
     g_mutex_unlock(priv->lock);
+    g_ptr_array_unref(dirty);
     return ret;
 }
 
@@ -2798,9 +3850,9 @@ gboolean entangle_camera_set_viewfinder(EntangleCamera *cam,
         goto cleanup;
     }
 
-    if ((err = gp_camera_set_config(priv->cam,
-                                    priv->widgets,
-                                    priv->ctx)) != GP_OK) {
+    if ((err = priv->backend->set_config(priv->cam,
+                                         priv->widgets,
+                                         priv->ctx)) != GP_OK) {
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to save camera control configuration: %s %d"),
                     gp_port_result_as_string(err), err);
@@ -2977,9 +4029,9 @@ gboolean entangle_camera_autofocus(EntangleCamera *cam,
         goto cleanup;
     }
 
-    if ((err = gp_camera_set_config(priv->cam,
-                                    priv->widgets,
-                                    priv->ctx)) != GP_OK) {
+    if ((err = priv->backend->set_config(priv->cam,
+                                         priv->widgets,
+                                         priv->ctx)) != GP_OK) {
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to save camera control configuration: %s %d"),
                     gp_port_result_as_string(err), err);
@@ -3172,9 +4224,9 @@ gboolean entangle_camera_manualfocus(EntangleCamera *cam,
         }
     }
 
-    if ((err = gp_camera_set_config(priv->cam,
-                                    priv->widgets,
-                                    priv->ctx)) != GP_OK) {
+    if ((err = priv->backend->set_config(priv->cam,
+                                         priv->widgets,
+                                         priv->ctx)) != GP_OK) {
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to save camera control configuration: %s %d"),
                     gp_port_result_as_string(err), err);
@@ -3368,9 +4420,9 @@ gboolean entangle_camera_set_clock(EntangleCamera *cam,
         goto cleanup;
     }
 
-    if ((err = gp_camera_set_config(priv->cam,
-                                    priv->widgets,
-                                    priv->ctx)) != GP_OK) {
+    if ((err = priv->backend->set_config(priv->cam,
+                                         priv->widgets,
+                                         priv->ctx)) != GP_OK) {
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to save camera control configuration: %s %d"),
                     gp_port_result_as_string(err), err);
@@ -3546,9 +4598,9 @@ gboolean entangle_camera_set_capture_target(EntangleCamera *cam,
         goto cleanup;
     }
 
-    if ((err = gp_camera_set_config(priv->cam,
-                                    priv->widgets,
-                                    priv->ctx)) != GP_OK) {
+    if ((err = priv->backend->set_config(priv->cam,
+                                         priv->widgets,
+                                         priv->ctx)) != GP_OK) {
         g_set_error(error, ENTANGLE_CAMERA_ERROR, 0,
                     _("Unable to save camera control configuration: %s %d"),
                     gp_port_result_as_string(err), err);
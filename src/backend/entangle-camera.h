@@ -63,6 +63,8 @@ struct _EntangleCameraClass
 
     void (*camera_connected)(EntangleCamera *cam);
     void (*camera_disconnected)(EntangleCamera *cam);
+
+    void (*camera_control_paths_changed)(EntangleCamera *cam, gchar **paths);
 };
 
 
@@ -251,6 +253,16 @@ gboolean entangle_camera_load_controls_finish(EntangleCamera *cam,
                                               GAsyncResult *result,
                                               GError **error);
 
+gboolean entangle_camera_refresh_controls(EntangleCamera *cam,
+                                          GError **error);
+void entangle_camera_refresh_controls_async(EntangleCamera *cam,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer user_data);
+gboolean entangle_camera_refresh_controls_finish(EntangleCamera *cam,
+                                                 GAsyncResult *result,
+                                                 GError **error);
+
 gboolean entangle_camera_save_controls(EntangleCamera *cam,
                                        GError **error);
 void entangle_camera_save_controls_async(EntangleCamera *cam,
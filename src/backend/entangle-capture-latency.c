@@ -0,0 +1,648 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "entangle-debug.h"
+#include "entangle-capture-latency.h"
+
+#define ENTANGLE_CAPTURE_LATENCY_GET_PRIVATE(obj)                       \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_CAPTURE_LATENCY, EntangleCaptureLatencyPrivate))
+
+/* Completed shots kept for the rolling percentiles */
+#define ENTANGLE_CAPTURE_LATENCY_HISTORY 100
+
+/* Shots saved to disk, but not yet displayed. Shots which
+ * are never displayed are completed without a paint time
+ * once this many newer ones are waiting. Likewise shots not
+ * yet saved are discarded once this many newer ones are
+ * in flight, as their request never produced a file */
+#define ENTANGLE_CAPTURE_LATENCY_PENDING 8
+
+#define ENTANGLE_CAPTURE_LATENCY_LOG "entangle-latency.csv"
+
+typedef struct _EntangleCaptureShot EntangleCaptureShot;
+
+struct _EntangleCaptureShot {
+    char *filename;
+    gint64 stamps[ENTANGLE_CAPTURE_STAGE_LAST];
+};
+
+struct _EntangleCaptureLatencyPrivate {
+    GMutex lock;
+
+    /* Shots not yet saved to a file, in request order */
+    GQueue *inflight;
+    GQueue *pending;
+    GQueue *history;
+
+    gboolean logEnabled;
+    /* Appends completed shots to the CSV, off the paint path */
+    GThreadPool *logPool;
+};
+
+G_DEFINE_TYPE(EntangleCaptureLatency, entangle_capture_latency, G_TYPE_OBJECT);
+
+static void entangle_capture_latency_log_worker(gpointer data,
+                                                gpointer opaque);
+
+enum {
+    PROP_0,
+    PROP_LOG_ENABLED,
+};
+
+static const char *const entangle_capture_latency_stages[] = {
+    "request",
+    "job-start",
+    "captured",
+    "file-added",
+    "downloaded",
+    "session-added",
+    "written",
+    "decoded",
+    "painted",
+};
+
+
+static void entangle_capture_shot_free(gpointer opaque)
+{
+    EntangleCaptureShot *shot = opaque;
+
+    if (!shot)
+        return;
+    g_free(shot->filename);
+    g_free(shot);
+}
+
+
+static EntangleCaptureShot *entangle_capture_shot_copy(EntangleCaptureShot *shot)
+{
+    EntangleCaptureShot *copy = g_new0(EntangleCaptureShot, 1);
+
+    copy->filename = g_strdup(shot->filename);
+    memcpy(copy->stamps, shot->stamps, sizeof(copy->stamps));
+
+    return copy;
+}
+
+
+/* Stages are relative to the first one seen, since shots
+ * triggered on the camera body have no request time */
+static gint64 entangle_capture_shot_elapsed(EntangleCaptureShot *shot,
+                                            EntangleCaptureStage stage)
+{
+    if (!shot->stamps[stage])
+        return -1;
+
+    for (int i = 0; i < ENTANGLE_CAPTURE_STAGE_LAST; i++) {
+        if (shot->stamps[i])
+            return shot->stamps[stage] - shot->stamps[i];
+    }
+
+    return -1;
+}
+
+
+static void entangle_capture_latency_get_property(GObject *object,
+                                                  guint prop_id,
+                                                  GValue *value,
+                                                  GParamSpec *pspec)
+{
+    EntangleCaptureLatency *latency = ENTANGLE_CAPTURE_LATENCY(object);
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+
+    switch (prop_id)
+        {
+        case PROP_LOG_ENABLED:
+            g_value_set_boolean(value, priv->logEnabled);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+}
+
+
+static void entangle_capture_latency_set_property(GObject *object,
+                                                  guint prop_id,
+                                                  const GValue *value,
+                                                  GParamSpec *pspec)
+{
+    EntangleCaptureLatency *latency = ENTANGLE_CAPTURE_LATENCY(object);
+
+    switch (prop_id)
+        {
+        case PROP_LOG_ENABLED:
+            entangle_capture_latency_set_log_enabled(latency, g_value_get_boolean(value));
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+}
+
+
+static void entangle_capture_latency_finalize(GObject *object)
+{
+    EntangleCaptureLatency *latency = ENTANGLE_CAPTURE_LATENCY(object);
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+
+    /* Let any queued rows reach the log first */
+    g_thread_pool_free(priv->logPool, FALSE, TRUE);
+    g_queue_free_full(priv->inflight, entangle_capture_shot_free);
+    g_queue_free_full(priv->pending, entangle_capture_shot_free);
+    g_queue_free_full(priv->history, entangle_capture_shot_free);
+    g_mutex_clear(&priv->lock);
+
+    G_OBJECT_CLASS(entangle_capture_latency_parent_class)->finalize(object);
+}
+
+
+static void entangle_capture_latency_class_init(EntangleCaptureLatencyClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = entangle_capture_latency_finalize;
+    object_class->get_property = entangle_capture_latency_get_property;
+    object_class->set_property = entangle_capture_latency_set_property;
+
+    g_object_class_install_property(object_class,
+                                    PROP_LOG_ENABLED,
+                                    g_param_spec_boolean("log-enabled",
+                                                         "Log enabled",
+                                                         "Append completed shots to a CSV file in the session",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
+    g_signal_new("shot-completed",
+                 G_TYPE_FROM_CLASS(klass),
+                 G_SIGNAL_RUN_FIRST,
+                 G_STRUCT_OFFSET(EntangleCaptureLatencyClass, shot_completed),
+                 NULL, NULL,
+                 g_cclosure_marshal_VOID__STRING,
+                 G_TYPE_NONE,
+                 1,
+                 G_TYPE_STRING);
+
+    g_type_class_add_private(klass, sizeof(EntangleCaptureLatencyPrivate));
+}
+
+
+static void entangle_capture_latency_init(EntangleCaptureLatency *latency)
+{
+    EntangleCaptureLatencyPrivate *priv;
+
+    priv = latency->priv = ENTANGLE_CAPTURE_LATENCY_GET_PRIVATE(latency);
+
+    g_mutex_init(&priv->lock);
+    priv->inflight = g_queue_new();
+    priv->pending = g_queue_new();
+    priv->history = g_queue_new();
+    /* A single thread keeps the rows in completion order */
+    priv->logPool = g_thread_pool_new(entangle_capture_latency_log_worker,
+                                      latency, 1, FALSE, NULL);
+}
+
+
+/**
+ * entangle_capture_latency_get_default:
+ *
+ * Get the process wide capture latency recorder. The camera
+ * stages are recorded from camera worker threads, while the
+ * decode & paint stages are recorded from the main thread.
+ *
+ * Returns: (transfer none): the capture latency recorder
+ */
+EntangleCaptureLatency *entangle_capture_latency_get_default(void)
+{
+    static gsize latency = 0;
+
+    if (g_once_init_enter(&latency)) {
+        EntangleCaptureLatency *tmp = g_object_new(ENTANGLE_TYPE_CAPTURE_LATENCY, NULL);
+        g_once_init_leave(&latency, (gsize)tmp);
+    }
+
+    return ENTANGLE_CAPTURE_LATENCY((gpointer)latency);
+}
+
+
+/**
+ * entangle_capture_latency_set_log_enabled:
+ * @latency: (transfer none): the capture latency recorder
+ * @enabled: whether to log completed shots
+ *
+ * If @enabled is TRUE, each completed shot is appended as a row
+ * to a CSV file alongside its image in the session directory
+ */
+void entangle_capture_latency_set_log_enabled(EntangleCaptureLatency *latency,
+                                              gboolean enabled)
+{
+    g_return_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency));
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+
+    g_mutex_lock(&priv->lock);
+    priv->logEnabled = enabled;
+    g_mutex_unlock(&priv->lock);
+    g_object_notify(G_OBJECT(latency), "log-enabled");
+}
+
+
+/**
+ * entangle_capture_latency_get_log_enabled:
+ * @latency: (transfer none): the capture latency recorder
+ *
+ * Determine if completed shots are logged to the session
+ *
+ * Returns: TRUE if shots are logged
+ */
+gboolean entangle_capture_latency_get_log_enabled(EntangleCaptureLatency *latency)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency), FALSE);
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+
+    return priv->logEnabled;
+}
+
+
+/**
+ * entangle_capture_latency_mark:
+ * @latency: (transfer none): the capture latency recorder
+ * @stage: the stage just reached
+ *
+ * Record that a shot in flight, which is not yet saved to a
+ * file, has reached @stage. Shots progress through the camera
+ * in the order they were requested, so the stage is recorded
+ * against the oldest shot which has not reached it yet. A
+ * request starts a new shot, as does a file added without any
+ * request, as happens when the shutter is pressed on the
+ * camera body.
+ */
+void entangle_capture_latency_mark(EntangleCaptureLatency *latency,
+                                   EntangleCaptureStage stage)
+{
+    g_return_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency));
+    g_return_if_fail(stage < ENTANGLE_CAPTURE_STAGE_LAST);
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+    EntangleCaptureShot *shot = NULL;
+    gint64 now = g_get_monotonic_time();
+    GList *tmp;
+
+    g_mutex_lock(&priv->lock);
+    if (stage != ENTANGLE_CAPTURE_STAGE_REQUEST) {
+        for (tmp = priv->inflight->head; tmp && !shot; tmp = tmp->next) {
+            if (!((EntangleCaptureShot *)tmp->data)->stamps[stage])
+                shot = tmp->data;
+        }
+    }
+
+    if (!shot &&
+        (stage == ENTANGLE_CAPTURE_STAGE_REQUEST ||
+         stage == ENTANGLE_CAPTURE_STAGE_FILE_ADDED)) {
+        shot = g_new0(EntangleCaptureShot, 1);
+        g_queue_push_tail(priv->inflight, shot);
+
+        /* Earlier requests which never produced a file */
+        while (g_queue_get_length(priv->inflight) > ENTANGLE_CAPTURE_LATENCY_PENDING)
+            entangle_capture_shot_free(g_queue_pop_head(priv->inflight));
+    }
+
+    if (shot)
+        shot->stamps[stage] = now;
+    g_mutex_unlock(&priv->lock);
+}
+
+
+/**
+ * entangle_capture_latency_abort:
+ * @latency: (transfer none): the capture latency recorder
+ *
+ * Record that the oldest requested shot whose file has not
+ * yet been added failed or was cancelled, so that it does
+ * not take the stages of the shots requested after it.
+ */
+void entangle_capture_latency_abort(EntangleCaptureLatency *latency)
+{
+    g_return_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency));
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+    GList *tmp;
+
+    g_mutex_lock(&priv->lock);
+    for (tmp = priv->inflight->head; tmp; tmp = tmp->next) {
+        EntangleCaptureShot *shot = tmp->data;
+        if (shot->stamps[ENTANGLE_CAPTURE_STAGE_REQUEST] &&
+            !shot->stamps[ENTANGLE_CAPTURE_STAGE_FILE_ADDED]) {
+            entangle_capture_shot_free(shot);
+            g_queue_delete_link(priv->inflight, tmp);
+            break;
+        }
+    }
+    g_mutex_unlock(&priv->lock);
+}
+
+
+static void entangle_capture_latency_log_worker(gpointer data,
+                                                gpointer opaque G_GNUC_UNUSED)
+{
+    EntangleCaptureShot *shot = data;
+    gchar *dir = g_path_get_dirname(shot->filename);
+    gchar *path = g_build_filename(dir, ENTANGLE_CAPTURE_LATENCY_LOG, NULL);
+    gchar *base = g_path_get_basename(shot->filename);
+    FILE *fp;
+
+    if (!(fp = fopen(path, "a"))) {
+        ENTANGLE_DEBUG("Unable to open %s", path);
+        goto cleanup;
+    }
+
+    if (ftell(fp) == 0) {
+        fprintf(fp, "filename");
+        for (int i = 0; i < ENTANGLE_CAPTURE_STAGE_LAST; i++)
+            fprintf(fp, ",%s_ms", entangle_capture_latency_stages[i]);
+        fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "%s", base);
+    for (int i = 0; i < ENTANGLE_CAPTURE_STAGE_LAST; i++) {
+        gint64 elapsed = entangle_capture_shot_elapsed(shot, i);
+        if (elapsed < 0)
+            fprintf(fp, ",");
+        else
+            fprintf(fp, ",%.1f", elapsed / 1000.0);
+    }
+    fprintf(fp, "\n");
+    fclose(fp);
+
+ cleanup:
+    g_free(base);
+    g_free(path);
+    g_free(dir);
+    entangle_capture_shot_free(shot);
+}
+
+
+/* Called with the lock held */
+static void entangle_capture_latency_complete(EntangleCaptureLatency *latency,
+                                              EntangleCaptureShot *shot)
+{
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+
+    ENTANGLE_DEBUG("Shot %s completed in %" G_GINT64_FORMAT " us",
+                   shot->filename,
+                   entangle_capture_shot_elapsed(shot, ENTANGLE_CAPTURE_STAGE_PAINTED));
+
+    if (priv->logEnabled)
+        g_thread_pool_push(priv->logPool,
+                           entangle_capture_shot_copy(shot), NULL);
+
+    g_queue_push_tail(priv->history, shot);
+    while (g_queue_get_length(priv->history) > ENTANGLE_CAPTURE_LATENCY_HISTORY)
+        entangle_capture_shot_free(g_queue_pop_head(priv->history));
+}
+
+
+/**
+ * entangle_capture_latency_bind:
+ * @latency: (transfer none): the capture latency recorder
+ * @filename: the file the shot is being saved to
+ *
+ * Record that the oldest shot in flight whose file was added
+ * is being saved as @filename, after which its remaining
+ * stages are recorded against the file with
+ * entangle_capture_latency_mark_file().
+ */
+void entangle_capture_latency_bind(EntangleCaptureLatency *latency,
+                                   const char *filename)
+{
+    g_return_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency));
+    g_return_if_fail(filename != NULL);
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+    EntangleCaptureShot *shot;
+    GList *tmp;
+
+    g_mutex_lock(&priv->lock);
+    for (tmp = priv->inflight->head; tmp; tmp = tmp->next) {
+        shot = tmp->data;
+        if (shot->stamps[ENTANGLE_CAPTURE_STAGE_FILE_ADDED])
+            break;
+    }
+    if (!tmp)
+        tmp = priv->inflight->head;
+    if (!tmp)
+        goto cleanup;
+    shot = tmp->data;
+    g_queue_delete_link(priv->inflight, tmp);
+
+    shot->filename = g_strdup(filename);
+    g_queue_push_tail(priv->pending, shot);
+
+    while (g_queue_get_length(priv->pending) > ENTANGLE_CAPTURE_LATENCY_PENDING)
+        entangle_capture_latency_complete(latency, g_queue_pop_head(priv->pending));
+
+ cleanup:
+    g_mutex_unlock(&priv->lock);
+}
+
+
+static gint entangle_capture_shot_compare_filename(gconstpointer a,
+                                                   gconstpointer b)
+{
+    const EntangleCaptureShot *shot = a;
+
+    return g_strcmp0(shot->filename, b);
+}
+
+
+/**
+ * entangle_capture_latency_mark_file:
+ * @latency: (transfer none): the capture latency recorder
+ * @filename: the file of the shot
+ * @stage: the stage just reached
+ *
+ * Record that the shot saved as @filename has reached @stage.
+ * Reaching the painted stage completes the shot. Files which
+ * were not captured in this session are ignored, so this is
+ * cheap to call on every decode & paint. This must only be
+ * called from the main thread.
+ */
+void entangle_capture_latency_mark_file(EntangleCaptureLatency *latency,
+                                        const char *filename,
+                                        EntangleCaptureStage stage)
+{
+    g_return_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency));
+    g_return_if_fail(stage < ENTANGLE_CAPTURE_STAGE_LAST);
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+    EntangleCaptureShot *shot;
+    GList *tmp;
+    gchar *completed = NULL;
+
+    if (!filename)
+        return;
+
+    g_mutex_lock(&priv->lock);
+    if (!(tmp = g_queue_find_custom(priv->pending, filename,
+                                    entangle_capture_shot_compare_filename)))
+        goto cleanup;
+    shot = tmp->data;
+
+    if (!shot->stamps[stage])
+        shot->stamps[stage] = g_get_monotonic_time();
+
+    if (stage == ENTANGLE_CAPTURE_STAGE_PAINTED) {
+        g_queue_delete_link(priv->pending, tmp);
+        completed = g_strdup(shot->filename);
+        entangle_capture_latency_complete(latency, shot);
+    }
+
+ cleanup:
+    g_mutex_unlock(&priv->lock);
+    if (completed) {
+        g_signal_emit_by_name(latency, "shot-completed", completed);
+        g_free(completed);
+    }
+}
+
+
+/**
+ * entangle_capture_latency_get_elapsed:
+ * @latency: (transfer none): the capture latency recorder
+ * @filename: the file of the shot
+ * @stage: the stage to query
+ *
+ * Get the time from the start of the shot saved as @filename
+ * until it reached @stage
+ *
+ * Returns: the elapsed microseconds, or -1 if unknown
+ */
+gint64 entangle_capture_latency_get_elapsed(EntangleCaptureLatency *latency,
+                                            const char *filename,
+                                            EntangleCaptureStage stage)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency), -1);
+    g_return_val_if_fail(stage < ENTANGLE_CAPTURE_STAGE_LAST, -1);
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+    GList *tmp;
+    gint64 elapsed = -1;
+
+    if (!filename)
+        return -1;
+
+    g_mutex_lock(&priv->lock);
+    if ((tmp = g_queue_find_custom(priv->pending, filename,
+                                   entangle_capture_shot_compare_filename)) ||
+        (tmp = g_queue_find_custom(priv->history, filename,
+                                   entangle_capture_shot_compare_filename)))
+        elapsed = entangle_capture_shot_elapsed(tmp->data, stage);
+    g_mutex_unlock(&priv->lock);
+
+    return elapsed;
+}
+
+
+static int entangle_capture_latency_compare_elapsed(gconstpointer a,
+                                                    gconstpointer b)
+{
+    gint64 ea = *(const gint64 *)a;
+    gint64 eb = *(const gint64 *)b;
+
+    return ea < eb ? -1 : ea > eb ? 1 : 0;
+}
+
+
+/**
+ * entangle_capture_latency_get_percentile:
+ * @latency: (transfer none): the capture latency recorder
+ * @stage: the stage to query
+ * @percentile: the percentile, from 0 to 100
+ *
+ * Get the given percentile of the time taken to reach @stage
+ * over the most recently completed shots
+ *
+ * Returns: the elapsed microseconds, or -1 if no shots reached @stage
+ */
+gint64 entangle_capture_latency_get_percentile(EntangleCaptureLatency *latency,
+                                               EntangleCaptureStage stage,
+                                               double percentile)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAPTURE_LATENCY(latency), -1);
+    g_return_val_if_fail(stage < ENTANGLE_CAPTURE_STAGE_LAST, -1);
+
+    EntangleCaptureLatencyPrivate *priv = latency->priv;
+    GArray *samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+    gint64 ret = -1;
+    GList *tmp;
+
+    g_mutex_lock(&priv->lock);
+    for (tmp = priv->history->head; tmp; tmp = tmp->next) {
+        gint64 elapsed = entangle_capture_shot_elapsed(tmp->data, stage);
+        if (elapsed >= 0)
+            g_array_append_val(samples, elapsed);
+    }
+    g_mutex_unlock(&priv->lock);
+
+    if (samples->len) {
+        gsize idx = (gsize)ceil((CLAMP(percentile, 0, 100) / 100.0) * samples->len);
+        if (idx > 0)
+            idx--;
+        g_array_sort(samples, entangle_capture_latency_compare_elapsed);
+        ret = g_array_index(samples, gint64, MIN(idx, samples->len - 1));
+    }
+
+    g_array_unref(samples);
+    return ret;
+}
+
+
+/**
+ * entangle_capture_latency_stage_name:
+ * @stage: the capture stage
+ *
+ * Returns: a short name for @stage
+ */
+const char *entangle_capture_latency_stage_name(EntangleCaptureStage stage)
+{
+    g_return_val_if_fail(stage < ENTANGLE_CAPTURE_STAGE_LAST, NULL);
+
+    return entangle_capture_latency_stages[stage];
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
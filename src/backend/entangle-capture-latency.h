@@ -0,0 +1,108 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_CAPTURE_LATENCY_H__
+#define __ENTANGLE_CAPTURE_LATENCY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define ENTANGLE_TYPE_CAPTURE_LATENCY            (entangle_capture_latency_get_type ())
+#define ENTANGLE_CAPTURE_LATENCY(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), ENTANGLE_TYPE_CAPTURE_LATENCY, EntangleCaptureLatency))
+#define ENTANGLE_CAPTURE_LATENCY_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), ENTANGLE_TYPE_CAPTURE_LATENCY, EntangleCaptureLatencyClass))
+#define ENTANGLE_IS_CAPTURE_LATENCY(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ENTANGLE_TYPE_CAPTURE_LATENCY))
+#define ENTANGLE_IS_CAPTURE_LATENCY_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ENTANGLE_TYPE_CAPTURE_LATENCY))
+#define ENTANGLE_CAPTURE_LATENCY_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), ENTANGLE_TYPE_CAPTURE_LATENCY, EntangleCaptureLatencyClass))
+
+
+typedef struct _EntangleCaptureLatency EntangleCaptureLatency;
+typedef struct _EntangleCaptureLatencyPrivate EntangleCaptureLatencyPrivate;
+typedef struct _EntangleCaptureLatencyClass EntangleCaptureLatencyClass;
+
+/* In the order they normally occur for a shot */
+typedef enum {
+    ENTANGLE_CAPTURE_STAGE_REQUEST,
+    ENTANGLE_CAPTURE_STAGE_JOB_START,
+    ENTANGLE_CAPTURE_STAGE_CAPTURED,
+    ENTANGLE_CAPTURE_STAGE_FILE_ADDED,
+    ENTANGLE_CAPTURE_STAGE_DOWNLOADED,
+    ENTANGLE_CAPTURE_STAGE_SESSION_ADDED,
+    ENTANGLE_CAPTURE_STAGE_WRITTEN,
+    ENTANGLE_CAPTURE_STAGE_DECODED,
+    ENTANGLE_CAPTURE_STAGE_PAINTED,
+
+    ENTANGLE_CAPTURE_STAGE_LAST,
+} EntangleCaptureStage;
+
+struct _EntangleCaptureLatency
+{
+    GObject parent;
+
+    EntangleCaptureLatencyPrivate *priv;
+};
+
+struct _EntangleCaptureLatencyClass
+{
+    GObjectClass parent_class;
+
+    void (*shot_completed)(EntangleCaptureLatency *latency, const char *filename);
+};
+
+
+GType entangle_capture_latency_get_type(void) G_GNUC_CONST;
+
+EntangleCaptureLatency *entangle_capture_latency_get_default(void);
+
+void entangle_capture_latency_set_log_enabled(EntangleCaptureLatency *latency,
+                                              gboolean enabled);
+gboolean entangle_capture_latency_get_log_enabled(EntangleCaptureLatency *latency);
+
+void entangle_capture_latency_mark(EntangleCaptureLatency *latency,
+                                   EntangleCaptureStage stage);
+void entangle_capture_latency_abort(EntangleCaptureLatency *latency);
+void entangle_capture_latency_bind(EntangleCaptureLatency *latency,
+                                   const char *filename);
+void entangle_capture_latency_mark_file(EntangleCaptureLatency *latency,
+                                        const char *filename,
+                                        EntangleCaptureStage stage);
+
+gint64 entangle_capture_latency_get_elapsed(EntangleCaptureLatency *latency,
+                                            const char *filename,
+                                            EntangleCaptureStage stage);
+gint64 entangle_capture_latency_get_percentile(EntangleCaptureLatency *latency,
+                                               EntangleCaptureStage stage,
+                                               double percentile);
+
+const char *entangle_capture_latency_stage_name(EntangleCaptureStage stage);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_CAPTURE_LATENCY_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
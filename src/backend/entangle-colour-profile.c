@@ -25,6 +25,7 @@
 
 #include "entangle-debug.h"
 #include "entangle-colour-profile.h"
+#include "entangle-tracer.h"
 
 #define DEBUG_CMS 0
 
@@ -573,6 +574,7 @@ GdkPixbuf *entangle_colour_profile_transform_apply(EntangleColourProfileTransfor
         return srcpixbuf;
     }
 
+    ENTANGLE_TRACE_BEGIN("colour-transform");
     dstpixbuf = gdk_pixbuf_copy(srcpixbuf);
 
     switch (priv->renderIntent) {
@@ -622,6 +624,7 @@ GdkPixbuf *entangle_colour_profile_transform_apply(EntangleColourProfileTransfor
 #endif
 
     cmsDeleteTransform(transform);
+    ENTANGLE_TRACE_END("colour-transform");
     return dstpixbuf;
 }
 
@@ -29,6 +29,7 @@
 
 struct _EntangleImageLoaderPrivate {
     gboolean embeddedPreview;
+    gboolean rawHistogram;
 };
 
 G_DEFINE_TYPE(EntangleImageLoader, entangle_image_loader, ENTANGLE_TYPE_PIXBUF_LOADER);
@@ -37,6 +38,7 @@ G_DEFINE_TYPE(EntangleImageLoader, entangle_image_loader, ENTANGLE_TYPE_PIXBUF_L
 enum {
     PROP_0,
     PROP_EMBEDDED_PREVIEW,
+    PROP_RAW_HISTOGRAM,
 };
 
 
@@ -54,6 +56,10 @@ static void entangle_image_loader_get_property(GObject *object,
             g_value_set_boolean(value, priv->embeddedPreview);
             break;
 
+        case PROP_RAW_HISTOGRAM:
+            g_value_set_boolean(value, priv->rawHistogram);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         }
@@ -73,6 +79,10 @@ static void entangle_image_loader_set_property(GObject *object,
             entangle_image_loader_set_embedded_preview(loader, g_value_get_boolean(value));
             break;
 
+        case PROP_RAW_HISTOGRAM:
+            entangle_image_loader_set_raw_histogram(loader, g_value_get_boolean(value));
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         }
@@ -81,19 +91,58 @@ static void entangle_image_loader_set_property(GObject *object,
 
 static GdkPixbuf *entangle_image_loader_pixbuf_load(EntanglePixbufLoader *loader G_GNUC_UNUSED,
                                                     EntangleImage *image,
-                                                    GExiv2Metadata **metadata)
+                                                    GExiv2Metadata **metadata,
+                                                    GCancellable *cancel)
 {
     EntangleImageLoaderPrivate *priv = (ENTANGLE_IMAGE_LOADER(loader))->priv;
-    if (priv->embeddedPreview)
-        return entangle_pixbuf_open_image(image,
-                                          ENTANGLE_PIXBUF_IMAGE_SLOT_PREVIEW,
-                                          TRUE,
-                                          metadata);
-    else
+    EntangleRawHistogram *histogram;
+    GdkPixbuf *pixbuf;
+
+    if (!priv->embeddedPreview)
         return entangle_pixbuf_open_image(image,
                                           ENTANGLE_PIXBUF_IMAGE_SLOT_MASTER,
                                           TRUE,
-                                          metadata);
+                                          priv->rawHistogram,
+                                          metadata,
+                                          cancel);
+
+    pixbuf = entangle_pixbuf_open_image(image,
+                                        ENTANGLE_PIXBUF_IMAGE_SLOT_PREVIEW,
+                                        TRUE,
+                                        priv->rawHistogram,
+                                        metadata,
+                                        cancel);
+
+    /* The preview never unpacks the sensor data, so that is
+     * done separately, but only once per image */
+    if (pixbuf && priv->rawHistogram &&
+        !g_cancellable_is_cancelled(cancel)) {
+        if ((histogram = entangle_image_get_raw_histogram(image)))
+            g_object_unref(histogram);
+        else
+            entangle_pixbuf_open_raw_histogram(image, cancel);
+    }
+
+    return pixbuf;
+}
+
+
+/* When the whole file is needed to decode it, read it in one
+ * sequential pass before it reaches the decode threads. The
+ * embedded preview of a raw file is only a small part of it,
+ * so that is left to be read in place, unless the sensor data
+ * is to be unpacked for the histogram too */
+static gboolean entangle_image_loader_pixbuf_prefetch(EntanglePixbufLoader *loader,
+                                                      EntangleImage *image)
+{
+    EntangleImageLoaderPrivate *priv = (ENTANGLE_IMAGE_LOADER(loader))->priv;
+
+    if (priv->embeddedPreview &&
+        !priv->rawHistogram &&
+        entangle_pixbuf_is_raw(image))
+        return FALSE;
+
+    return TRUE;
 }
 
 
@@ -117,7 +166,19 @@ static void entangle_image_loader_class_init(EntangleImageLoaderClass *klass)
                                                          G_PARAM_STATIC_NICK |
                                                          G_PARAM_STATIC_BLURB));
 
+    g_object_class_install_property(object_class,
+                                    PROP_RAW_HISTOGRAM,
+                                    g_param_spec_boolean("raw-histogram",
+                                                         "Raw histogram",
+                                                         "Analyse raw sensor data",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
     loader_class->pixbuf_load = entangle_image_loader_pixbuf_load;
+    loader_class->pixbuf_prefetch = entangle_image_loader_pixbuf_prefetch;
 
     g_type_class_add_private(klass, sizeof(EntangleImageLoaderPrivate));
 }
@@ -155,6 +216,48 @@ void entangle_image_loader_set_embedded_preview(EntangleImageLoader *loader, gbo
 }
 
 
+/**
+ * entangle_image_loader_get_raw_histogram:
+ * @loader: the image loader
+ *
+ * Determine if raw files are analysed to produce a histogram
+ * of their sensor data, when only their preview is loaded
+ *
+ * Returns: TRUE if raw files are analysed
+ */
+gboolean entangle_image_loader_get_raw_histogram(EntangleImageLoader *loader)
+{
+    g_return_val_if_fail(ENTANGLE_IS_IMAGE_LOADER(loader), FALSE);
+
+    EntangleImageLoaderPrivate *priv = loader->priv;
+    return priv->rawHistogram;
+}
+
+
+/**
+ * entangle_image_loader_set_raw_histogram:
+ * @loader: the image loader
+ * @enable: TRUE to analyse raw files
+ *
+ * If @enable is TRUE, then when loading the embedded preview
+ * of a raw file, the sensor data is also unpacked to attach
+ * a histogram to the image. This is always done when loading
+ * the master image, since the data is unpacked anyway.
+ */
+void entangle_image_loader_set_raw_histogram(EntangleImageLoader *loader, gboolean enable)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_LOADER(loader));
+
+    EntangleImageLoaderPrivate *priv = loader->priv;
+
+    if (priv->rawHistogram == enable)
+        return;
+    priv->rawHistogram = enable;
+    if (enable && priv->embeddedPreview)
+        entangle_pixbuf_loader_trigger_reload(ENTANGLE_PIXBUF_LOADER(loader));
+}
+
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -61,6 +61,9 @@ void entangle_image_loader_remove(EntangleImageLoader *loader, EntangleImage *im
 gboolean entangle_image_loader_get_embedded_preview(EntangleImageLoader *loader);
 void entangle_image_loader_set_embedded_preview(EntangleImageLoader *loader, gboolean enable);
 
+gboolean entangle_image_loader_get_raw_histogram(EntangleImageLoader *loader);
+void entangle_image_loader_set_raw_histogram(EntangleImageLoader *loader, gboolean enable);
+
 
 G_END_DECLS
 
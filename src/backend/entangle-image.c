@@ -37,8 +37,15 @@ struct _EntangleImagePrivate {
 
     gboolean dirty;
     struct stat st;
+
+    /* Protected by entangle_image_data_lock */
+    GBytes *data;
+    EntangleRawHistogram *rawHistogram;
 };
 
+/* Data is released by the main thread while workers decode it */
+static GMutex entangle_image_data_lock;
+
 G_DEFINE_TYPE(EntangleImage, entangle_image, G_TYPE_OBJECT);
 
 enum {
@@ -124,6 +131,9 @@ static void entangle_image_finalize(GObject *object)
         g_object_unref(priv->pixbuf);
     if (priv->metadata)
         g_object_unref(priv->metadata);
+    entangle_image_set_data(image, NULL);
+    if (priv->rawHistogram)
+        g_object_unref(priv->rawHistogram);
 
     g_free(priv->filename);
 
@@ -383,6 +393,126 @@ void entangle_image_set_metadata(EntangleImage *image,
 }
 
 
+/**
+ * entangle_image_set_data:
+ * @image: (transfer none): the image instance
+ * @data: (transfer none)(allow-none): the file contents
+ *
+ * Set an in-memory copy of the file contents, such as the
+ * buffer just downloaded from the camera, so that loaders can
+ * decode the image without reading it back from disk. Since the
+ * copy can be large, it should be cleared by passing NULL once
+ * the loaders have finished with it. The memory is accounted
+ * by whoever allocated it, since it is often shared with the
+ * #EntangleCameraFile it was downloaded into.
+ */
+void entangle_image_set_data(EntangleImage *image,
+                             GBytes *data)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE(image));
+
+    EntangleImagePrivate *priv = image->priv;
+    GBytes *old;
+
+    if (data)
+        g_bytes_ref(data);
+
+    g_mutex_lock(&entangle_image_data_lock);
+    old = priv->data;
+    priv->data = data;
+    g_mutex_unlock(&entangle_image_data_lock);
+
+    if (old)
+        g_bytes_unref(old);
+}
+
+
+/**
+ * entangle_image_get_data:
+ * @image: (transfer none): the image instance
+ *
+ * Get the in-memory copy of the file contents, if one has
+ * been provided. Since it may be cleared by another thread,
+ * a new reference is returned.
+ *
+ * Returns: (transfer full)(allow-none): the file contents or NULL
+ */
+GBytes *entangle_image_get_data(EntangleImage *image)
+{
+    g_return_val_if_fail(ENTANGLE_IS_IMAGE(image), NULL);
+
+    EntangleImagePrivate *priv = image->priv;
+    GBytes *data;
+
+    g_mutex_lock(&entangle_image_data_lock);
+    data = priv->data;
+    if (data)
+        g_bytes_ref(data);
+    g_mutex_unlock(&entangle_image_data_lock);
+
+    return data;
+}
+
+
+/**
+ * entangle_image_set_raw_histogram:
+ * @image: (transfer none): the image instance
+ * @histogram: (transfer none)(allow-none): the raw sensor histogram
+ *
+ * Set the histogram of the undeveloped sensor data, which
+ * loaders compute from their worker threads while decoding
+ * raw files. Unlike the pixbuf, no notification is emitted,
+ * so it should be set before the pixbuf it goes with.
+ */
+void entangle_image_set_raw_histogram(EntangleImage *image,
+                                      EntangleRawHistogram *histogram)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE(image));
+    g_return_if_fail(!histogram || ENTANGLE_IS_RAW_HISTOGRAM(histogram));
+
+    EntangleImagePrivate *priv = image->priv;
+    EntangleRawHistogram *old;
+
+    if (histogram)
+        g_object_ref(histogram);
+
+    g_mutex_lock(&entangle_image_data_lock);
+    old = priv->rawHistogram;
+    priv->rawHistogram = histogram;
+    g_mutex_unlock(&entangle_image_data_lock);
+
+    if (old)
+        g_object_unref(old);
+}
+
+
+/**
+ * entangle_image_get_raw_histogram:
+ * @image: (transfer none): the image instance
+ *
+ * Get the histogram of the undeveloped sensor data, if the
+ * image is a raw file which has been decoded. Since it may
+ * be replaced by another thread, a new reference is returned.
+ *
+ * Returns: (transfer full)(allow-none): the histogram or NULL
+ */
+EntangleRawHistogram *entangle_image_get_raw_histogram(EntangleImage *image)
+{
+    g_return_val_if_fail(ENTANGLE_IS_IMAGE(image), NULL);
+
+    EntangleImagePrivate *priv = image->priv;
+    EntangleRawHistogram *histogram;
+
+    g_mutex_lock(&entangle_image_data_lock);
+    histogram = priv->rawHistogram;
+    if (histogram)
+        g_object_ref(histogram);
+    g_mutex_unlock(&entangle_image_data_lock);
+
+    return histogram;
+}
+
+
 
 /*
  * Local variables:
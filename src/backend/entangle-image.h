@@ -28,6 +28,7 @@
 #include <sys/stat.h>
 
 #include "entangle-control-group.h"
+#include "entangle-raw-histogram.h"
 
 G_BEGIN_DECLS
 
@@ -76,6 +77,14 @@ GExiv2Metadata *entangle_image_get_metadata(EntangleImage *image);
 void entangle_image_set_metadata(EntangleImage *image,
                                  GExiv2Metadata *metadata);
 
+void entangle_image_set_data(EntangleImage *image,
+                             GBytes *data);
+GBytes *entangle_image_get_data(EntangleImage *image);
+
+void entangle_image_set_raw_histogram(EntangleImage *image,
+                                      EntangleRawHistogram *histogram);
+EntangleRawHistogram *entangle_image_get_raw_histogram(EntangleImage *image);
+
 G_END_DECLS
 
 #endif /* __ENTANGLE_IMAGE_H__ */
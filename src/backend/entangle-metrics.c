@@ -0,0 +1,619 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <string.h>
+
+#include "entangle-debug.h"
+#include "entangle-metrics.h"
+
+/* Downloads averaged over for the transfer rate */
+#define ENTANGLE_METRICS_DOWNLOADS 16
+
+/* Seconds averaged over for the live view allocation rate */
+#define ENTANGLE_METRICS_SECONDS 10
+
+typedef struct _EntangleMetricsCache EntangleMetricsCache;
+
+struct _EntangleMetricsCache {
+    gpointer cache;
+    const char *name;
+    EntangleMetricsCacheFunc func;
+};
+
+/* Upper bounds of the histogram buckets, in microseconds. There
+ * is an extra bucket for anything slower than the last one */
+static const gint64 entangle_metrics_buckets[] = {
+    1000, 2000, 5000,
+    10000, 20000, 50000,
+    100000, 200000, 500000,
+    1000000, 2000000, 5000000,
+    10000000, 30000000,
+};
+#define ENTANGLE_METRICS_BUCKETS G_N_ELEMENTS(entangle_metrics_buckets)
+
+struct _EntangleMetricsMemory {
+    const char *name;
+    gint64 bytes;
+    gint64 peak;
+    gint64 buffers;
+};
+
+typedef struct _EntangleMetricsHistogramData EntangleMetricsHistogramData;
+
+struct _EntangleMetricsHistogramData {
+    guint64 counts[ENTANGLE_METRICS_BUCKETS + 1];
+    gint64 sum;
+    gint64 count;
+};
+
+static const char *const entangle_metrics_counter_names[] = {
+    "download-files",
+    "download-bytes",
+    "liveview-frames",
+    "liveview-dropped",
+    "thumbnail-hits",
+    "thumbnail-misses",
+    "decode-cancelled",
+    "decode-wasted",
+    "liveview-allocated",
+    "liveview-recycled",
+};
+
+static const char *const entangle_metrics_histogram_names[] = {
+    "capture",
+    "preview",
+    "download",
+    "delete",
+    "get-config",
+    "set-config",
+};
+
+static GMutex entangle_metrics_lock;
+static gint64 entangle_metrics_counters[ENTANGLE_METRICS_COUNTER_LAST];
+static EntangleMetricsHistogramData entangle_metrics_histograms[ENTANGLE_METRICS_HISTOGRAM_LAST];
+static gsize entangle_metrics_download_bytes[ENTANGLE_METRICS_DOWNLOADS];
+static gint64 entangle_metrics_download_usecs[ENTANGLE_METRICS_DOWNLOADS];
+static guint entangle_metrics_download_next;
+static gint64 entangle_metrics_alloc_second[ENTANGLE_METRICS_SECONDS];
+static gint64 entangle_metrics_alloc_count[ENTANGLE_METRICS_SECONDS];
+
+/* Separate from the counters, so a slow cache sample never
+ * holds up the camera threads */
+static GMutex entangle_metrics_cache_lock;
+static GList *entangle_metrics_caches;
+
+/* Owners are never freed, so callers can keep hold of them */
+static GMutex entangle_metrics_memory_lock;
+static GPtrArray *entangle_metrics_memory;
+
+
+/**
+ * entangle_metrics_add:
+ * @counter: the counter to update
+ * @delta: the amount to add
+ *
+ * Add @delta to the running total of @counter
+ */
+void entangle_metrics_add(EntangleMetricsCounter counter,
+                          gint64 delta)
+{
+    g_return_if_fail(counter < ENTANGLE_METRICS_COUNTER_LAST);
+
+    g_mutex_lock(&entangle_metrics_lock);
+    entangle_metrics_counters[counter] += delta;
+    g_mutex_unlock(&entangle_metrics_lock);
+}
+
+
+/**
+ * entangle_metrics_observe:
+ * @histogram: the histogram to update
+ * @usecs: the duration of the operation
+ *
+ * Record that an operation took @usecs microseconds
+ */
+void entangle_metrics_observe(EntangleMetricsHistogram histogram,
+                              gint64 usecs)
+{
+    g_return_if_fail(histogram < ENTANGLE_METRICS_HISTOGRAM_LAST);
+
+    EntangleMetricsHistogramData *data = &entangle_metrics_histograms[histogram];
+    gsize bucket = 0;
+
+    while (bucket < ENTANGLE_METRICS_BUCKETS &&
+           usecs > entangle_metrics_buckets[bucket])
+        bucket++;
+
+    g_mutex_lock(&entangle_metrics_lock);
+    data->counts[bucket]++;
+    data->sum += usecs;
+    data->count++;
+    g_mutex_unlock(&entangle_metrics_lock);
+}
+
+
+/**
+ * entangle_metrics_download:
+ * @bytes: the size of the file
+ * @usecs: the time taken to transfer it
+ *
+ * Record a file transfer from the camera, which counts towards
+ * the download totals and the recent transfer rate. The download
+ * latency histogram is fed by the gphoto backend alone, like the
+ * other command histograms
+ */
+void entangle_metrics_download(gsize bytes,
+                               gint64 usecs)
+{
+    g_mutex_lock(&entangle_metrics_lock);
+    entangle_metrics_counters[ENTANGLE_METRICS_COUNTER_DOWNLOAD_FILES]++;
+    entangle_metrics_counters[ENTANGLE_METRICS_COUNTER_DOWNLOAD_BYTES] += bytes;
+    entangle_metrics_download_bytes[entangle_metrics_download_next] = bytes;
+    entangle_metrics_download_usecs[entangle_metrics_download_next] = usecs;
+    entangle_metrics_download_next =
+        (entangle_metrics_download_next + 1) % ENTANGLE_METRICS_DOWNLOADS;
+    g_mutex_unlock(&entangle_metrics_lock);
+}
+
+
+/**
+ * entangle_metrics_liveview_buffer:
+ * @recycled: TRUE if the buffer was taken from a pool
+ *
+ * Record that a buffer was needed for a live view frame,
+ * which counts towards the allocation rate unless it was
+ * @recycled
+ */
+void entangle_metrics_liveview_buffer(gboolean recycled)
+{
+    gint64 second = g_get_monotonic_time() / G_USEC_PER_SEC;
+    gsize slot = second % ENTANGLE_METRICS_SECONDS;
+
+    g_mutex_lock(&entangle_metrics_lock);
+    if (recycled) {
+        entangle_metrics_counters[ENTANGLE_METRICS_COUNTER_LIVEVIEW_RECYCLED]++;
+    } else {
+        entangle_metrics_counters[ENTANGLE_METRICS_COUNTER_LIVEVIEW_ALLOCATED]++;
+        if (entangle_metrics_alloc_second[slot] != second) {
+            entangle_metrics_alloc_second[slot] = second;
+            entangle_metrics_alloc_count[slot] = 0;
+        }
+        entangle_metrics_alloc_count[slot]++;
+    }
+    g_mutex_unlock(&entangle_metrics_lock);
+}
+
+
+/**
+ * entangle_metrics_add_cache:
+ * @cache: the cache object
+ * @name: (transfer none): the name to report the cache under
+ * @func: (scope forever): the function to sample the cache
+ *
+ * Register @cache to be sampled by @func whenever the cache
+ * metrics are requested. Caches sharing the same @name are
+ * reported as one. The @name must remain valid until the
+ * cache is removed.
+ */
+void entangle_metrics_add_cache(gpointer cache,
+                                const char *name,
+                                EntangleMetricsCacheFunc func)
+{
+    EntangleMetricsCache *entry = g_new0(EntangleMetricsCache, 1);
+
+    entry->cache = cache;
+    entry->name = name;
+    entry->func = func;
+
+    g_mutex_lock(&entangle_metrics_cache_lock);
+    entangle_metrics_caches = g_list_prepend(entangle_metrics_caches, entry);
+    g_mutex_unlock(&entangle_metrics_cache_lock);
+}
+
+
+/**
+ * entangle_metrics_remove_cache:
+ * @cache: the cache object
+ *
+ * Stop sampling @cache. Once this returns, its sample
+ * function will not be called again.
+ */
+void entangle_metrics_remove_cache(gpointer cache)
+{
+    GList *tmp;
+
+    g_mutex_lock(&entangle_metrics_cache_lock);
+    for (tmp = entangle_metrics_caches; tmp; tmp = tmp->next) {
+        EntangleMetricsCache *entry = tmp->data;
+        if (entry->cache == cache) {
+            entangle_metrics_caches = g_list_delete_link(entangle_metrics_caches, tmp);
+            g_free(entry);
+            break;
+        }
+    }
+    g_mutex_unlock(&entangle_metrics_cache_lock);
+}
+
+
+/**
+ * entangle_metrics_memory_owner:
+ * @name: the name to account memory under
+ *
+ * Get the memory accounting for owners called @name, creating
+ * it if this is the first use. This is intended to be called
+ * once per owner type, with the result kept for later use.
+ *
+ * Returns: (transfer none): the memory owner
+ */
+EntangleMetricsMemory *entangle_metrics_memory_owner(const char *name)
+{
+    EntangleMetricsMemory *owner = NULL;
+
+    g_mutex_lock(&entangle_metrics_memory_lock);
+    if (!entangle_metrics_memory)
+        entangle_metrics_memory = g_ptr_array_new();
+
+    for (gsize i = 0; i < entangle_metrics_memory->len; i++) {
+        EntangleMetricsMemory *tmp = g_ptr_array_index(entangle_metrics_memory, i);
+        if (g_str_equal(tmp->name, name)) {
+            owner = tmp;
+            break;
+        }
+    }
+    if (!owner) {
+        owner = g_new0(EntangleMetricsMemory, 1);
+        owner->name = g_intern_string(name);
+        g_ptr_array_add(entangle_metrics_memory, owner);
+    }
+    g_mutex_unlock(&entangle_metrics_memory_lock);
+
+    return owner;
+}
+
+
+/**
+ * entangle_metrics_memory_alloc:
+ * @owner: (transfer none): the memory owner
+ * @bytes: the size of the buffer
+ *
+ * Record that @owner has taken hold of a buffer of @bytes
+ */
+void entangle_metrics_memory_alloc(EntangleMetricsMemory *owner,
+                                   gsize bytes)
+{
+    g_return_if_fail(owner != NULL);
+
+    g_mutex_lock(&entangle_metrics_memory_lock);
+    owner->bytes += bytes;
+    owner->buffers++;
+    if (owner->bytes > owner->peak)
+        owner->peak = owner->bytes;
+    g_mutex_unlock(&entangle_metrics_memory_lock);
+}
+
+
+/**
+ * entangle_metrics_memory_free:
+ * @owner: (transfer none): the memory owner
+ * @bytes: the size of the buffer
+ *
+ * Record that @owner has released a buffer of @bytes, which
+ * must match the size it was allocated with
+ */
+void entangle_metrics_memory_free(EntangleMetricsMemory *owner,
+                                  gsize bytes)
+{
+    g_return_if_fail(owner != NULL);
+
+    g_mutex_lock(&entangle_metrics_memory_lock);
+    owner->bytes -= bytes;
+    owner->buffers--;
+    if (owner->bytes < 0 || owner->buffers < 0)
+        g_warning("Unbalanced memory accounting for %s", owner->name);
+    g_mutex_unlock(&entangle_metrics_memory_lock);
+}
+
+
+static gboolean entangle_metrics_memory_log(gpointer opaque G_GNUC_UNUSED)
+{
+    GString *msg = g_string_new("Memory");
+    gint64 total = 0;
+
+    g_mutex_lock(&entangle_metrics_memory_lock);
+    for (gsize i = 0; entangle_metrics_memory && i < entangle_metrics_memory->len; i++) {
+        EntangleMetricsMemory *owner = g_ptr_array_index(entangle_metrics_memory, i);
+        g_string_append_printf(msg, " %s=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+                               "/%" G_GINT64_FORMAT,
+                               owner->name, owner->bytes, owner->peak, owner->buffers);
+        total += owner->bytes;
+    }
+    g_mutex_unlock(&entangle_metrics_memory_lock);
+
+    g_message("%s total=%" G_GINT64_FORMAT, msg->str, total);
+    g_string_free(msg, TRUE);
+    return TRUE;
+}
+
+
+/**
+ * entangle_metrics_memory_setup_log:
+ * @interval: the seconds between log messages
+ *
+ * Log the bytes, peak bytes & buffers held by every memory
+ * owner every @interval seconds, from the main loop
+ */
+void entangle_metrics_memory_setup_log(guint interval)
+{
+    ENTANGLE_DEBUG("Logging memory every %u seconds", interval);
+    g_timeout_add_seconds(interval, entangle_metrics_memory_log, NULL);
+}
+
+
+/**
+ * entangle_metrics_get_counters:
+ *
+ * Get the current value of every counter
+ *
+ * Returns: (transfer full): a floating a{sx} dictionary
+ */
+GVariant *entangle_metrics_get_counters(void)
+{
+    gint64 counters[ENTANGLE_METRICS_COUNTER_LAST];
+    GVariantBuilder builder;
+
+    g_mutex_lock(&entangle_metrics_lock);
+    memcpy(counters, entangle_metrics_counters, sizeof(counters));
+    g_mutex_unlock(&entangle_metrics_lock);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sx}"));
+    for (int i = 0; i < ENTANGLE_METRICS_COUNTER_LAST; i++)
+        g_variant_builder_add(&builder, "{sx}",
+                              entangle_metrics_counter_names[i],
+                              counters[i]);
+
+    return g_variant_builder_end(&builder);
+}
+
+
+/**
+ * entangle_metrics_get_histograms:
+ *
+ * Get every latency histogram, each as a tuple of the bucket
+ * upper bounds in microseconds, the per-bucket counts with a
+ * trailing overflow bucket, the total microseconds and the
+ * number of operations
+ *
+ * Returns: (transfer full): a floating a{s(atatxx)} dictionary
+ */
+GVariant *entangle_metrics_get_histograms(void)
+{
+    EntangleMetricsHistogramData histograms[ENTANGLE_METRICS_HISTOGRAM_LAST];
+    GVariantBuilder builder;
+
+    g_mutex_lock(&entangle_metrics_lock);
+    memcpy(histograms, entangle_metrics_histograms, sizeof(histograms));
+    g_mutex_unlock(&entangle_metrics_lock);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{s(atatxx)}"));
+    for (int i = 0; i < ENTANGLE_METRICS_HISTOGRAM_LAST; i++) {
+        GVariantBuilder bounds;
+        GVariantBuilder counts;
+        gsize j;
+
+        g_variant_builder_init(&bounds, G_VARIANT_TYPE("at"));
+        for (j = 0; j < ENTANGLE_METRICS_BUCKETS; j++)
+            g_variant_builder_add(&bounds, "t", (guint64)entangle_metrics_buckets[j]);
+
+        g_variant_builder_init(&counts, G_VARIANT_TYPE("at"));
+        for (j = 0; j <= ENTANGLE_METRICS_BUCKETS; j++)
+            g_variant_builder_add(&counts, "t", histograms[i].counts[j]);
+
+        g_variant_builder_add(&builder, "{s(atatxx)}",
+                              entangle_metrics_histogram_names[i],
+                              &bounds, &counts,
+                              histograms[i].sum,
+                              histograms[i].count);
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+
+/**
+ * entangle_metrics_get_caches:
+ *
+ * Sample every registered cache, reporting the queue length,
+ * the number of loads in progress, the resident entries and
+ * their size in bytes, and the hits & misses for each cache
+ * name
+ *
+ * Returns: (transfer full): a floating a{sa{sx}} dictionary
+ */
+GVariant *entangle_metrics_get_caches(void)
+{
+    GHashTable *totals = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               NULL, g_free);
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer key, value;
+    GList *tmp;
+
+    g_mutex_lock(&entangle_metrics_cache_lock);
+    for (tmp = entangle_metrics_caches; tmp; tmp = tmp->next) {
+        EntangleMetricsCache *entry = tmp->data;
+        EntangleMetricsCacheStats stats;
+        EntangleMetricsCacheStats *total;
+
+        memset(&stats, 0, sizeof(stats));
+        entry->func(entry->cache, &stats);
+
+        if (!(total = g_hash_table_lookup(totals, entry->name))) {
+            total = g_new0(EntangleMetricsCacheStats, 1);
+            g_hash_table_insert(totals, (gpointer)entry->name, total);
+        }
+        total->queued += stats.queued;
+        total->active += stats.active;
+        total->entries += stats.entries;
+        total->bytes += stats.bytes;
+        total->hits += stats.hits;
+        total->misses += stats.misses;
+    }
+    g_mutex_unlock(&entangle_metrics_cache_lock);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sa{sx}}"));
+    g_hash_table_iter_init(&iter, totals);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        EntangleMetricsCacheStats *total = value;
+
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("{sa{sx}}"));
+        g_variant_builder_add(&builder, "s", key);
+        g_variant_builder_open(&builder, G_VARIANT_TYPE("a{sx}"));
+        g_variant_builder_add(&builder, "{sx}", "queued", total->queued);
+        g_variant_builder_add(&builder, "{sx}", "active", total->active);
+        g_variant_builder_add(&builder, "{sx}", "entries", total->entries);
+        g_variant_builder_add(&builder, "{sx}", "bytes", total->bytes);
+        g_variant_builder_add(&builder, "{sx}", "hits", total->hits);
+        g_variant_builder_add(&builder, "{sx}", "misses", total->misses);
+        g_variant_builder_close(&builder);
+        g_variant_builder_close(&builder);
+    }
+    g_hash_table_unref(totals);
+
+    return g_variant_builder_end(&builder);
+}
+
+
+/**
+ * entangle_metrics_get_cache_bytes:
+ *
+ * Get the memory held by the pixels of all registered caches
+ *
+ * Returns: the total size in bytes
+ */
+gint64 entangle_metrics_get_cache_bytes(void)
+{
+    gint64 bytes = 0;
+    GList *tmp;
+
+    g_mutex_lock(&entangle_metrics_cache_lock);
+    for (tmp = entangle_metrics_caches; tmp; tmp = tmp->next) {
+        EntangleMetricsCache *entry = tmp->data;
+        EntangleMetricsCacheStats stats;
+
+        memset(&stats, 0, sizeof(stats));
+        entry->func(entry->cache, &stats);
+        bytes += stats.bytes;
+    }
+    g_mutex_unlock(&entangle_metrics_cache_lock);
+
+    return bytes;
+}
+
+
+/**
+ * entangle_metrics_get_memory:
+ *
+ * Get the memory held by every owner, as a tuple of the bytes
+ * currently held, the most bytes ever held, and the number of
+ * buffers currently held
+ *
+ * Returns: (transfer full): a floating a{s(xxx)} dictionary
+ */
+GVariant *entangle_metrics_get_memory(void)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{s(xxx)}"));
+
+    g_mutex_lock(&entangle_metrics_memory_lock);
+    for (gsize i = 0; entangle_metrics_memory && i < entangle_metrics_memory->len; i++) {
+        EntangleMetricsMemory *owner = g_ptr_array_index(entangle_metrics_memory, i);
+        g_variant_builder_add(&builder, "{s(xxx)}", owner->name,
+                              owner->bytes, owner->peak, owner->buffers);
+    }
+    g_mutex_unlock(&entangle_metrics_memory_lock);
+
+    return g_variant_builder_end(&builder);
+}
+
+
+/**
+ * entangle_metrics_get_download_rate:
+ *
+ * Get the transfer rate over the most recent downloads from
+ * the camera
+ *
+ * Returns: the rate in MB/s, or 0 if nothing was downloaded
+ */
+gdouble entangle_metrics_get_download_rate(void)
+{
+    gint64 usecs = 0;
+    guint64 bytes = 0;
+
+    g_mutex_lock(&entangle_metrics_lock);
+    for (int i = 0; i < ENTANGLE_METRICS_DOWNLOADS; i++) {
+        bytes += entangle_metrics_download_bytes[i];
+        usecs += entangle_metrics_download_usecs[i];
+    }
+    g_mutex_unlock(&entangle_metrics_lock);
+
+    /* Bytes per microsecond is MB per second */
+    if (!usecs)
+        return 0;
+    return (gdouble)bytes / (gdouble)usecs;
+}
+
+
+/**
+ * entangle_metrics_get_liveview_alloc_rate:
+ *
+ * Get the rate at which buffers for live view frames have
+ * been allocated, rather than recycled, over the last few
+ * seconds
+ *
+ * Returns: the number of allocations per second
+ */
+gdouble entangle_metrics_get_liveview_alloc_rate(void)
+{
+    gint64 second = g_get_monotonic_time() / G_USEC_PER_SEC;
+    gint64 count = 0;
+
+    g_mutex_lock(&entangle_metrics_lock);
+    for (int i = 0; i < ENTANGLE_METRICS_SECONDS; i++) {
+        if (entangle_metrics_alloc_second[i] > second - ENTANGLE_METRICS_SECONDS)
+            count += entangle_metrics_alloc_count[i];
+    }
+    g_mutex_unlock(&entangle_metrics_lock);
+
+    return (gdouble)count / ENTANGLE_METRICS_SECONDS;
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
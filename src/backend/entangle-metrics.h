@@ -0,0 +1,120 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_METRICS_H__
+#define __ENTANGLE_METRICS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide runtime counters, for monitoring unattended
+ * rigs. Updating a counter or histogram is a short critical
+ * section on a private lock, and the caches are only visited
+ * when a snapshot is taken, so collection is always enabled.
+ * Memory is accounted per owner as buffers are taken & released,
+ * so the totals can be watched for leaks over long sessions.
+ */
+
+typedef enum {
+    ENTANGLE_METRICS_COUNTER_DOWNLOAD_FILES,
+    ENTANGLE_METRICS_COUNTER_DOWNLOAD_BYTES,
+    ENTANGLE_METRICS_COUNTER_LIVEVIEW_FRAMES,
+    ENTANGLE_METRICS_COUNTER_LIVEVIEW_DROPPED,
+    ENTANGLE_METRICS_COUNTER_THUMBNAIL_HITS,
+    ENTANGLE_METRICS_COUNTER_THUMBNAIL_MISSES,
+    ENTANGLE_METRICS_COUNTER_DECODE_CANCELLED,
+    ENTANGLE_METRICS_COUNTER_DECODE_WASTED,
+    ENTANGLE_METRICS_COUNTER_LIVEVIEW_ALLOCATED,
+    ENTANGLE_METRICS_COUNTER_LIVEVIEW_RECYCLED,
+
+    ENTANGLE_METRICS_COUNTER_LAST,
+} EntangleMetricsCounter;
+
+typedef enum {
+    ENTANGLE_METRICS_HISTOGRAM_CAMERA_CAPTURE,
+    ENTANGLE_METRICS_HISTOGRAM_CAMERA_PREVIEW,
+    ENTANGLE_METRICS_HISTOGRAM_CAMERA_DOWNLOAD,
+    ENTANGLE_METRICS_HISTOGRAM_CAMERA_DELETE,
+    ENTANGLE_METRICS_HISTOGRAM_CAMERA_GET_CONFIG,
+    ENTANGLE_METRICS_HISTOGRAM_CAMERA_SET_CONFIG,
+
+    ENTANGLE_METRICS_HISTOGRAM_LAST,
+} EntangleMetricsHistogram;
+
+typedef struct _EntangleMetricsCacheStats EntangleMetricsCacheStats;
+
+struct _EntangleMetricsCacheStats {
+    gint64 queued;
+    gint64 active;
+    gint64 entries;
+    gint64 bytes;
+    gint64 hits;
+    gint64 misses;
+};
+
+typedef void (*EntangleMetricsCacheFunc)(gpointer cache,
+                                         EntangleMetricsCacheStats *stats);
+
+/* Bytes held by one kind of owner, eg a widget type */
+typedef struct _EntangleMetricsMemory EntangleMetricsMemory;
+
+void entangle_metrics_add(EntangleMetricsCounter counter,
+                          gint64 delta);
+void entangle_metrics_observe(EntangleMetricsHistogram histogram,
+                              gint64 usecs);
+void entangle_metrics_download(gsize bytes,
+                               gint64 usecs);
+void entangle_metrics_liveview_buffer(gboolean recycled);
+
+void entangle_metrics_add_cache(gpointer cache,
+                                const char *name,
+                                EntangleMetricsCacheFunc func);
+void entangle_metrics_remove_cache(gpointer cache);
+
+EntangleMetricsMemory *entangle_metrics_memory_owner(const char *name);
+void entangle_metrics_memory_alloc(EntangleMetricsMemory *owner,
+                                   gsize bytes);
+void entangle_metrics_memory_free(EntangleMetricsMemory *owner,
+                                  gsize bytes);
+void entangle_metrics_memory_setup_log(guint interval);
+
+GVariant *entangle_metrics_get_counters(void);
+GVariant *entangle_metrics_get_histograms(void);
+GVariant *entangle_metrics_get_caches(void);
+gint64 entangle_metrics_get_cache_bytes(void);
+gdouble entangle_metrics_get_download_rate(void);
+gdouble entangle_metrics_get_liveview_alloc_rate(void);
+GVariant *entangle_metrics_get_memory(void);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_METRICS_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -22,9 +22,12 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <glib/gstdio.h>
 
 #include "entangle-debug.h"
 #include "entangle-pixbuf-loader.h"
+#include "entangle-metrics.h"
+#include "entangle-tracer.h"
 
 #define ENTANGLE_PIXBUF_LOADER_GET_PRIVATE(obj)                         \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_PIXBUF_LOADER, EntanglePixbufLoaderPrivate))
@@ -32,33 +35,90 @@
 #if GLIB_CHECK_VERSION(2, 31, 0)
 #define g_mutex_new() g_new0(GMutex, 1)
 #define g_mutex_free(m) g_free(m)
+#define g_cond_new() g_new0(GCond, 1)
+#define g_cond_free(c) g_free(c)
 #endif
 
+/*
+ * Images pass through three pools: the I/O stage reads the
+ * file into memory, the decode stage produces the pixbuf and
+ * the colour stage applies the transform. Reading a single
+ * device from many threads just makes it seek, so there is a
+ * small I/O pool per storage device, keyed on the st_dev of
+ * the image's directory, while the other two scale with the
+ * processors. Decode is the bulk of the CPU time, so unless
+ * the workers property says otherwise it gets a thread per
+ * processor too, rather than the single thread it had back
+ * when one worker did every stage of an image in turn.
+ * The I/O stage waits before reading another file while those
+ * read ahead of the decode stage add up to
+ * ENTANGLE_PIXBUF_LOADER_PREFETCH_BYTES, so a slow decode holds
+ * back the reads instead of piling up whole files in memory.
+ * Raw files are far bigger than JPEGs, so counting bytes rather
+ * than jobs keeps the memory used the same whatever the mix.
+ * The decode stage waits before handing on a job while the
+ * colour queue holds ENTANGLE_PIXBUF_LOADER_QUEUE_DEPTH jobs
+ * per thread.
+ */
+#define ENTANGLE_PIXBUF_LOADER_IO_WORKERS 2
+#define ENTANGLE_PIXBUF_LOADER_QUEUE_DEPTH 2
+#define ENTANGLE_PIXBUF_LOADER_PREFETCH_BYTES (128 * 1024 * 1024)
+
 typedef struct _EntanglePixbufLoaderEntry {
     int refs;
     EntangleImage *image;
     gboolean pending;
     gboolean processing;
+    gboolean reload;
     gboolean ready;
     GdkPixbuf *pixbuf;
     GExiv2Metadata *metadata;
+    EntangleMetricsMemory *memory;
+    gsize pixbufBytes;
+    /* Triggered when the last ref goes while processing */
+    GCancellable *cancel;
 } EntanglePixbufLoaderEntry;
 
-typedef struct _EntanglePixbufrLoaderResult {
+/* A file read in by the loader, rather than handed over
+ * with the image, so accounted until the last ref goes */
+typedef struct _EntanglePixbufLoaderRead {
+    EntangleMetricsMemory *memory;
+    gchar *buf;
+    gsize len;
+} EntanglePixbufLoaderRead;
+
+typedef struct _EntanglePixbufLoaderJob {
     EntanglePixbufLoader *loader;
     EntangleImage *image;
+    GBytes *data;
+    /* Counted against ENTANGLE_PIXBUF_LOADER_PREFETCH_BYTES */
+    gsize dataBytes;
+    GCancellable *cancel;
+    EntangleColourProfileTransform *transform;
     GdkPixbuf *pixbuf;
     GExiv2Metadata *metadata;
-} EntanglePixbufLoaderResult;
+} EntanglePixbufLoaderJob;
 
 struct _EntanglePixbufLoaderPrivate {
-    GThreadPool *workers;
+    GHashTable *ioWorkers; /* st_dev -> GThreadPool */
+    GHashTable *ioDirs;    /* directory -> GThreadPool in ioWorkers */
+    GThreadPool *decodeWorkers;
+    GThreadPool *colourWorkers;
     EntangleColourProfileTransform *colourTransform;
 
     GMutex *lock;
+    /* Signalled as the decode & colour stages take jobs,
+     * and as the decode stage drops the files read for it */
+    GCond *stageCond;
+    gsize prefetchBytes;
     GHashTable *pixbufs;
 
     gboolean withMetadata;
+    gboolean shutdown;
+
+    gint64 hits;
+    gint64 misses;
+    EntangleMetricsMemory *memory;
 };
 
 G_DEFINE_ABSTRACT_TYPE(EntanglePixbufLoader, entangle_pixbuf_loader, G_TYPE_OBJECT);
@@ -70,6 +130,9 @@ enum {
     PROP_WITH_METADATA,
 };
 
+static void entangle_pixbuf_loader_io_push(EntanglePixbufLoader *loader,
+                                           EntangleImage *image);
+
 
 struct idle_emit_data {
     EntangleImage *image;
@@ -164,20 +227,26 @@ static void entangle_pixbuf_loader_entry_free(gpointer opaque)
     ENTANGLE_DEBUG("free entry %p %p", entry, entry->image);
     if (entry->image)
         g_object_unref(entry->image);
-    if (entry->pixbuf)
+    if (entry->pixbuf) {
+        entangle_metrics_memory_free(entry->memory, entry->pixbufBytes);
         g_object_unref(entry->pixbuf);
+    }
     if (entry->metadata)
         g_object_unref(entry->metadata);
+    if (entry->cancel)
+        g_object_unref(entry->cancel);
     g_free(entry);
 }
 
 
-static EntanglePixbufLoaderEntry *entangle_pixbuf_loader_entry_new(EntangleImage *image)
+static EntanglePixbufLoaderEntry *entangle_pixbuf_loader_entry_new(EntangleImage *image,
+                                                                    EntangleMetricsMemory *memory)
 {
     EntanglePixbufLoaderEntry *entry;
 
     entry = g_new0(EntanglePixbufLoaderEntry, 1);
     entry->image = image;
+    entry->memory = memory;
     g_object_ref(image);
     entry->refs = 1;
     entry->pending = TRUE;
@@ -207,17 +276,84 @@ void entangle_pixbuf_loader_trigger_reload(EntanglePixbufLoader *loader)
     g_hash_table_iter_init(&iter, priv->pixbufs);
     while (g_hash_table_iter_next(&iter, &key, &value)) {
         EntanglePixbufLoaderEntry *entry = value;
-        if (entry->refs &&
-            !entry->processing)
-            g_thread_pool_push(priv->workers, entry->image, NULL);
+        if (!entry->refs || entry->pending)
+            continue;
+        /* An in-flight load may have used stale settings,
+         * so have its result queue another one */
+        if (entry->processing) {
+            entry->reload = TRUE;
+            continue;
+        }
+        entry->pending = TRUE;
+        entangle_pixbuf_loader_io_push(loader, entry->image);
     }
     g_mutex_unlock(priv->lock);
 }
 
 
+/* Drop the copy of the file read by the I/O stage, unless
+ * someone else has since replaced it on the image */
+static void entangle_pixbuf_loader_job_release_data(EntanglePixbufLoaderJob *job)
+{
+    GBytes *data;
+
+    if (!job->data)
+        return;
+
+    data = entangle_image_get_data(job->image);
+    if (data == job->data)
+        entangle_image_set_data(job->image, NULL);
+    if (data)
+        g_bytes_unref(data);
+    g_bytes_unref(job->data);
+    job->data = NULL;
+}
+
+
+static void entangle_pixbuf_loader_job_free(EntanglePixbufLoaderJob *job)
+{
+    entangle_pixbuf_loader_job_release_data(job);
+    if (job->cancel)
+        g_object_unref(job->cancel);
+    if (job->transform)
+        g_object_unref(job->transform);
+    if (job->pixbuf)
+        g_object_unref(job->pixbuf);
+    if (job->metadata)
+        g_object_unref(job->metadata);
+    if (job->loader)
+        g_object_unref(job->loader);
+    g_object_unref(job->image);
+    g_free(job);
+}
+
+
+/*
+ * Drop the output of a job whose image was unloaded while it
+ * was in flight, counting it as wasted if it got as far as
+ * producing a pixbuf. Returns TRUE if the job was cancelled.
+ */
+static gboolean entangle_pixbuf_loader_job_cancelled(EntanglePixbufLoaderJob *job)
+{
+    if (!g_cancellable_is_cancelled(job->cancel))
+        return FALSE;
+
+    if (job->pixbuf) {
+        entangle_metrics_add(ENTANGLE_METRICS_COUNTER_DECODE_WASTED, 1);
+        g_object_unref(job->pixbuf);
+        job->pixbuf = NULL;
+    }
+    if (job->metadata) {
+        g_object_unref(job->metadata);
+        job->metadata = NULL;
+    }
+    return TRUE;
+}
+
+
 static gboolean entangle_pixbuf_loader_result(gpointer data)
 {
-    EntanglePixbufLoaderResult *result = data;
+    EntanglePixbufLoaderJob *result = data;
     EntanglePixbufLoader *loader = result->loader;
     EntanglePixbufLoaderPrivate *priv = loader->priv;
     EntanglePixbufLoaderEntry *entry;
@@ -229,62 +365,202 @@ static gboolean entangle_pixbuf_loader_result(gpointer data)
     if (!entry) {
         g_mutex_unlock(priv->lock);
         if (result->pixbuf)
-            g_object_unref(result->pixbuf);
-        g_object_unref(result->image);
-        if (result->metadata)
-            g_object_unref(result->metadata);
-        g_object_unref(result->loader);
-        g_free(result);
+            entangle_metrics_add(ENTANGLE_METRICS_COUNTER_DECODE_WASTED, 1);
+        entangle_pixbuf_loader_job_free(result);
+        return FALSE;
+    }
+
+    /* Abandoned part way, so keep whatever was loaded before,
+     * and start again if the image was wanted back meanwhile */
+    if (entangle_pixbuf_loader_job_cancelled(result)) {
+        entangle_metrics_add(ENTANGLE_METRICS_COUNTER_DECODE_CANCELLED, 1);
+        entry->processing = FALSE;
+        if (entry->refs && !entry->pending) {
+            entry->reload = FALSE;
+            entry->pending = TRUE;
+            entangle_pixbuf_loader_io_push(loader, entry->image);
+        } else if (!entry->refs && !entry->pending) {
+            g_hash_table_remove(priv->pixbufs, entangle_image_get_filename(result->image));
+        }
+        g_mutex_unlock(priv->lock);
+        entangle_pixbuf_loader_job_free(result);
         return FALSE;
     }
 
-    if (entry->pixbuf)
+    if (entry->pixbuf) {
+        entangle_metrics_memory_free(entry->memory, entry->pixbufBytes);
         g_object_unref(entry->pixbuf);
+    }
+    if (entry->metadata)
+        g_object_unref(entry->metadata);
     entry->pixbuf = result->pixbuf;
     entry->metadata = result->metadata;
+    result->pixbuf = NULL;
+    result->metadata = NULL;
+    if (entry->pixbuf) {
+        entry->pixbufBytes = (gsize)gdk_pixbuf_get_rowstride(entry->pixbuf) *
+            gdk_pixbuf_get_height(entry->pixbuf);
+        entangle_metrics_memory_alloc(entry->memory, entry->pixbufBytes);
+    }
     entry->ready = TRUE;
     entry->processing = FALSE;
 
+    if (entry->refs && entry->reload && !entry->pending) {
+        entry->reload = FALSE;
+        entry->pending = TRUE;
+        entangle_pixbuf_loader_io_push(loader, entry->image);
+    }
+
     if (entry->refs) {
+        gboolean hasMetadata = entry->metadata != NULL;
         g_mutex_unlock(priv->lock);
-        ENTANGLE_DEBUG("Emit loaded %p %p %p", result->image, result->pixbuf, result->metadata);
+        ENTANGLE_DEBUG("Emit loaded %p %d", result->image, hasMetadata);
         do_idle_emit(loader, "pixbuf-loaded", result->image);
-        if (result->metadata)
+        if (hasMetadata)
             do_idle_emit(loader, "metadata-loaded", result->image);
         g_mutex_lock(priv->lock);
     } else if (!entry->pending) {
         g_hash_table_remove(priv->pixbufs, entangle_image_get_filename(result->image));
     }
 
-    g_object_unref(result->loader);
-    g_object_unref(result->image);
-    g_free(result);
     g_mutex_unlock(priv->lock);
+    entangle_pixbuf_loader_job_free(result);
 
     return FALSE;
 }
 
 
 static GdkPixbuf *entangle_pixbuf_load(EntanglePixbufLoader *loader, EntangleImage *image,
-                                       GExiv2Metadata **metadata)
+                                       GExiv2Metadata **metadata, GCancellable *cancel)
+{
+    return ENTANGLE_PIXBUF_LOADER_GET_CLASS(loader)->pixbuf_load(loader, image, metadata, cancel);
+}
+
+
+/*
+ * Wait, with the lock held, for room in the queue of the
+ * @next stage. Returns FALSE if the loader is shutting down
+ * and the job should be dropped instead.
+ */
+static gboolean entangle_pixbuf_loader_stage_wait(EntanglePixbufLoader *loader,
+                                                  GThreadPool *next)
+{
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+    guint limit = ENTANGLE_PIXBUF_LOADER_QUEUE_DEPTH *
+        g_thread_pool_get_max_threads(next);
+
+    while (!priv->shutdown &&
+           g_thread_pool_unprocessed(next) >= limit)
+        g_cond_wait(priv->stageCond, priv->lock);
+
+    return !priv->shutdown;
+}
+
+
+/*
+ * Wait, with the lock held, until the files read ahead of the
+ * decode stage are under ENTANGLE_PIXBUF_LOADER_PREFETCH_BYTES.
+ * Returns FALSE if the loader is shutting down and the job
+ * should be dropped instead.
+ */
+static gboolean entangle_pixbuf_loader_prefetch_wait(EntanglePixbufLoader *loader)
+{
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+
+    while (!priv->shutdown &&
+           priv->prefetchBytes >= ENTANGLE_PIXBUF_LOADER_PREFETCH_BYTES)
+        g_cond_wait(priv->stageCond, priv->lock);
+
+    return !priv->shutdown;
+}
+
+
+/* Called with the lock held, to hand the job back to the main loop */
+static void entangle_pixbuf_loader_complete(EntanglePixbufLoader *loader,
+                                            EntanglePixbufLoaderJob *job)
+{
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+
+    if (priv->shutdown) {
+        entangle_pixbuf_loader_job_free(job);
+        return;
+    }
+
+    job->loader = g_object_ref(loader);
+    g_idle_add(entangle_pixbuf_loader_result, job);
+}
+
+
+static EntangleMetricsMemory *entangle_pixbuf_loader_read_memory(void)
+{
+    static gsize memory = 0;
+
+    if (g_once_init_enter(&memory))
+        g_once_init_leave(&memory, (gsize)entangle_metrics_memory_owner("EntangleImage"));
+
+    return (EntangleMetricsMemory *)memory;
+}
+
+
+static void entangle_pixbuf_loader_read_free(gpointer opaque)
 {
-    return ENTANGLE_PIXBUF_LOADER_GET_CLASS(loader)->pixbuf_load(loader, image, metadata);
+    EntanglePixbufLoaderRead *read = opaque;
+
+    entangle_metrics_memory_free(read->memory, read->len);
+    g_free(read->buf);
+    g_free(read);
 }
 
 
-static void entangle_pixbuf_loader_worker(gpointer data,
-                                          gpointer opaque)
+static GBytes *entangle_pixbuf_loader_read(EntangleImage *image)
+{
+    GBytes *data = entangle_image_get_data(image);
+    EntanglePixbufLoaderRead *read;
+    gchar *buf;
+    gsize len;
+
+    /* Already in memory, eg just downloaded from the camera */
+    if (data) {
+        g_bytes_unref(data);
+        return NULL;
+    }
+
+    ENTANGLE_TRACE_BEGIN("pixbuf-loader-read");
+    if (g_file_get_contents(entangle_image_get_filename(image), &buf, &len, NULL)) {
+        read = g_new0(EntanglePixbufLoaderRead, 1);
+        read->memory = entangle_pixbuf_loader_read_memory();
+        read->buf = buf;
+        read->len = len;
+        entangle_metrics_memory_alloc(read->memory, len);
+        data = g_bytes_new_with_free_func(buf, len,
+                                          entangle_pixbuf_loader_read_free,
+                                          read);
+        entangle_image_set_data(image, data);
+    }
+    ENTANGLE_TRACE_END("pixbuf-loader-read");
+
+    return data;
+}
+
+
+static void entangle_pixbuf_loader_io_worker(gpointer data,
+                                             gpointer opaque)
 {
     EntanglePixbufLoader *loader = opaque;
     EntanglePixbufLoaderPrivate *priv = loader->priv;
+    EntanglePixbufLoaderClass *klass = ENTANGLE_PIXBUF_LOADER_GET_CLASS(loader);
     EntangleImage *image = data;
-    EntanglePixbufLoaderResult *result = g_new0(EntanglePixbufLoaderResult, 1);
-    EntangleColourProfileTransform *transform;
     EntanglePixbufLoaderEntry *entry;
-    GdkPixbuf *pixbuf;
+    EntanglePixbufLoaderJob *job;
+    gboolean prefetch;
 
     ENTANGLE_DEBUG("worker process job %p %p", loader, image);
+    prefetch = klass->pixbuf_prefetch &&
+        klass->pixbuf_prefetch(loader, image);
+
     g_mutex_lock(priv->lock);
+    if (priv->shutdown)
+        goto cleanup;
     entry = g_hash_table_lookup(priv->pixbufs, entangle_image_get_filename(image));
     if (!entry)
         goto cleanup;
@@ -295,53 +571,249 @@ static void entangle_pixbuf_loader_worker(gpointer data,
     }
     entry->pending = FALSE;
     entry->processing = TRUE;
+    entry->reload = FALSE;
+    if (entry->cancel)
+        g_object_unref(entry->cancel);
+    entry->cancel = g_cancellable_new();
+
+    job = g_new0(EntanglePixbufLoaderJob, 1);
+    job->image = image;
+    job->cancel = g_object_ref(entry->cancel);
+    job->transform = priv->colourTransform;
+    if (job->transform)
+        g_object_ref(job->transform);
+    if (prefetch && !entangle_pixbuf_loader_prefetch_wait(loader)) {
+        entangle_pixbuf_loader_job_free(job);
+        g_mutex_unlock(priv->lock);
+        return;
+    }
+    g_mutex_unlock(priv->lock);
+
+    if (prefetch && !g_cancellable_is_cancelled(job->cancel))
+        job->data = entangle_pixbuf_loader_read(image);
+
+    g_mutex_lock(priv->lock);
+    if (priv->shutdown) {
+        entangle_pixbuf_loader_job_free(job);
+    } else {
+        if (job->data) {
+            job->dataBytes = g_bytes_get_size(job->data);
+            priv->prefetchBytes += job->dataBytes;
+        }
+        g_thread_pool_push(priv->decodeWorkers, job, NULL);
+    }
+    g_mutex_unlock(priv->lock);
+    return;
 
-    transform = priv->colourTransform;
-    if (transform)
-        g_object_ref(transform);
+ cleanup:
     g_mutex_unlock(priv->lock);
+    g_object_unref(image);
+}
+
 
-    pixbuf = entangle_pixbuf_load(loader, image,
-                                  priv->withMetadata ?
-                                  &result->metadata : NULL);
-    if (pixbuf) {
-        if (transform) {
-            result->pixbuf = entangle_colour_profile_transform_apply(transform,
-                                                                     pixbuf);
-            g_object_unref(pixbuf);
-        } else {
-            result->pixbuf = pixbuf;
+/*
+ * Queue @image on the I/O pool for the device holding it.
+ * Images come from a handful of directories, so each is
+ * only stat'd the first time it is seen.
+ *
+ * Called with the loader lock held
+ */
+static void entangle_pixbuf_loader_io_push(EntanglePixbufLoader *loader,
+                                           EntangleImage *image)
+{
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+    gchar *dir = g_path_get_dirname(entangle_image_get_filename(image));
+    GThreadPool *pool = g_hash_table_lookup(priv->ioDirs, dir);
+
+    if (!pool) {
+        GStatBuf sb;
+        gint64 dev = 0;
+
+        /* Anything that cannot be stat'd shares one pool */
+        if (g_stat(dir, &sb) == 0)
+            dev = sb.st_dev;
+
+        if (!(pool = g_hash_table_lookup(priv->ioWorkers, &dev))) {
+            gint64 *key = g_new(gint64, 1);
+
+            ENTANGLE_DEBUG("New I/O pool for device %" G_GINT64_FORMAT, dev);
+            pool = g_thread_pool_new(entangle_pixbuf_loader_io_worker,
+                                     loader,
+                                     ENTANGLE_PIXBUF_LOADER_IO_WORKERS,
+                                     FALSE,
+                                     NULL);
+            *key = dev;
+            g_hash_table_insert(priv->ioWorkers, key, pool);
         }
+        g_hash_table_insert(priv->ioDirs, dir, pool);
+    } else {
+        g_free(dir);
     }
 
-    result->loader = loader;
-    result->image = image;
-    g_object_ref(image);
-    g_object_ref(loader);
+    g_thread_pool_push(pool, g_object_ref(image), NULL);
+}
+
 
-    g_idle_add(entangle_pixbuf_loader_result, result);
+static void entangle_pixbuf_loader_decode_worker(gpointer data,
+                                                 gpointer opaque)
+{
+    EntanglePixbufLoader *loader = opaque;
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+    EntanglePixbufLoaderJob *job = data;
+    gboolean shutdown;
 
     g_mutex_lock(priv->lock);
-    if (transform)
-        g_object_unref(transform);
+    g_cond_broadcast(priv->stageCond);
+    shutdown = priv->shutdown;
+    g_mutex_unlock(priv->lock);
 
- cleanup:
+    if (!shutdown && !g_cancellable_is_cancelled(job->cancel)) {
+        ENTANGLE_TRACE_BEGIN("pixbuf-loader-decode");
+        job->pixbuf = entangle_pixbuf_load(loader, job->image,
+                                           priv->withMetadata ?
+                                           &job->metadata : NULL,
+                                           job->cancel);
+        ENTANGLE_TRACE_END("pixbuf-loader-decode");
+    }
+    entangle_pixbuf_loader_job_release_data(job);
+
+    g_mutex_lock(priv->lock);
+    if (job->dataBytes) {
+        priv->prefetchBytes -= job->dataBytes;
+        job->dataBytes = 0;
+        g_cond_broadcast(priv->stageCond);
+    }
+    if (!entangle_pixbuf_loader_job_cancelled(job) &&
+        job->pixbuf && job->transform) {
+        if (entangle_pixbuf_loader_stage_wait(loader, priv->colourWorkers))
+            g_thread_pool_push(priv->colourWorkers, job, NULL);
+        else
+            entangle_pixbuf_loader_job_free(job);
+    } else {
+        entangle_pixbuf_loader_complete(loader, job);
+    }
     g_mutex_unlock(priv->lock);
 }
 
 
+static void entangle_pixbuf_loader_colour_worker(gpointer data,
+                                                 gpointer opaque)
+{
+    EntanglePixbufLoader *loader = opaque;
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+    EntanglePixbufLoaderJob *job = data;
+    gboolean shutdown;
+
+    g_mutex_lock(priv->lock);
+    g_cond_broadcast(priv->stageCond);
+    shutdown = priv->shutdown;
+    g_mutex_unlock(priv->lock);
+
+    if (!shutdown && !entangle_pixbuf_loader_job_cancelled(job)) {
+        GdkPixbuf *pixbuf = entangle_colour_profile_transform_apply(job->transform,
+                                                                    job->pixbuf);
+        g_object_unref(job->pixbuf);
+        job->pixbuf = pixbuf;
+    }
+
+    g_mutex_lock(priv->lock);
+    entangle_pixbuf_loader_complete(loader, job);
+    g_mutex_unlock(priv->lock);
+}
+
+
+static guint entangle_pixbuf_loader_queued(EntanglePixbufLoaderPrivate *priv)
+{
+    GHashTableIter iter;
+    gpointer value;
+    guint queued = g_thread_pool_unprocessed(priv->decodeWorkers) +
+        g_thread_pool_unprocessed(priv->colourWorkers);
+
+    g_hash_table_iter_init(&iter, priv->ioWorkers);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        queued += g_thread_pool_unprocessed(value);
+    return queued;
+}
+
+
+static void entangle_pixbuf_loader_metrics(gpointer opaque,
+                                           EntangleMetricsCacheStats *stats)
+{
+    EntanglePixbufLoader *loader = opaque;
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_mutex_lock(priv->lock);
+    stats->queued = entangle_pixbuf_loader_queued(priv);
+    stats->hits = priv->hits;
+    stats->misses = priv->misses;
+    g_hash_table_iter_init(&iter, priv->pixbufs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        EntanglePixbufLoaderEntry *entry = value;
+        if (entry->processing)
+            stats->active++;
+        if (entry->pixbuf) {
+            stats->entries++;
+            stats->bytes += entry->pixbufBytes;
+        }
+    }
+    g_mutex_unlock(priv->lock);
+}
+
+
+static void entangle_pixbuf_loader_constructed(GObject *object)
+{
+    EntanglePixbufLoader *loader = ENTANGLE_PIXBUF_LOADER(object);
+    EntanglePixbufLoaderPrivate *priv = loader->priv;
+
+    /* Subclasses are distinguished by type name, which is
+     * not known until the instance is fully initialized */
+    priv->memory = entangle_metrics_memory_owner(G_OBJECT_TYPE_NAME(object));
+    entangle_metrics_add_cache(object, G_OBJECT_TYPE_NAME(object),
+                               entangle_pixbuf_loader_metrics);
+
+    if (G_OBJECT_CLASS(entangle_pixbuf_loader_parent_class)->constructed)
+        G_OBJECT_CLASS(entangle_pixbuf_loader_parent_class)->constructed(object);
+}
+
+
 static void entangle_pixbuf_loader_finalize(GObject *object)
 {
     EntanglePixbufLoader *loader = ENTANGLE_PIXBUF_LOADER(object);
     EntanglePixbufLoaderPrivate *priv = loader->priv;
+    GHashTableIter iter;
+    gpointer key, value;
 
     ENTANGLE_DEBUG("Finalize pixbuf loader %p", object);
-    g_thread_pool_free(priv->workers, TRUE, TRUE);
+    entangle_metrics_remove_cache(object);
+    /* Let the workers drain the queues, so the image refs
+     * held by queued jobs are released, without producing
+     * results for a loader which is going away. Each stage
+     * only feeds the next, so they are freed in order */
+    g_mutex_lock(priv->lock);
+    priv->shutdown = TRUE;
+    g_cond_broadcast(priv->stageCond);
+    g_hash_table_iter_init(&iter, priv->pixbufs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        EntanglePixbufLoaderEntry *entry = value;
+        if (entry->cancel)
+            g_cancellable_cancel(entry->cancel);
+    }
+    g_mutex_unlock(priv->lock);
+    g_hash_table_iter_init(&iter, priv->ioWorkers);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_thread_pool_free(value, FALSE, TRUE);
+    g_thread_pool_free(priv->decodeWorkers, FALSE, TRUE);
+    g_thread_pool_free(priv->colourWorkers, FALSE, TRUE);
 
     if (priv->colourTransform)
         g_object_unref(priv->colourTransform);
 
     g_hash_table_unref(priv->pixbufs);
+    g_hash_table_unref(priv->ioDirs);
+    g_hash_table_unref(priv->ioWorkers);
+    g_cond_free(priv->stageCond);
     g_mutex_free(priv->lock);
 
     G_OBJECT_CLASS(entangle_pixbuf_loader_parent_class)->finalize(object);
@@ -352,6 +824,7 @@ static void entangle_pixbuf_loader_class_init(EntanglePixbufLoaderClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
 
+    object_class->constructed = entangle_pixbuf_loader_constructed;
     object_class->finalize = entangle_pixbuf_loader_finalize;
     object_class->get_property = entangle_pixbuf_loader_get_property;
     object_class->set_property = entangle_pixbuf_loader_set_property;
@@ -360,8 +833,8 @@ static void entangle_pixbuf_loader_class_init(EntanglePixbufLoaderClass *klass)
                                     PROP_WORKERS,
                                     g_param_spec_int("workers",
                                                      "Workers",
-                                                     "Number of worker threads to load pixbufs",
-                                                     1, 64, 1,
+                                                     "Number of worker threads to decode pixbufs, or 0 for one per processor",
+                                                     0, 64, 0,
                                                      G_PARAM_READWRITE |
                                                      G_PARAM_CONSTRUCT_ONLY |
                                                      G_PARAM_STATIC_NAME |
@@ -438,15 +911,32 @@ static void entangle_pixbuf_loader_init(EntanglePixbufLoader *loader)
     memset(priv, 0, sizeof(*priv));
 
     priv->lock = g_mutex_new();
+    priv->stageCond = g_cond_new();
     priv->pixbufs = g_hash_table_new_full(g_str_hash,
                                           g_str_equal,
                                           g_free,
                                           entangle_pixbuf_loader_entry_free);
-    priv->workers = g_thread_pool_new(entangle_pixbuf_loader_worker,
-                                      loader,
-                                      1,
-                                      TRUE,
-                                      NULL);
+    /* Threads are shared with other pools and only started
+     * on demand, since most of the time every stage is idle.
+     * I/O pools are created as each device is first seen */
+    priv->ioWorkers = g_hash_table_new_full(g_int64_hash,
+                                            g_int64_equal,
+                                            g_free,
+                                            NULL);
+    priv->ioDirs = g_hash_table_new_full(g_str_hash,
+                                         g_str_equal,
+                                         g_free,
+                                         NULL);
+    priv->decodeWorkers = g_thread_pool_new(entangle_pixbuf_loader_decode_worker,
+                                            loader,
+                                            g_get_num_processors(),
+                                            FALSE,
+                                            NULL);
+    priv->colourWorkers = g_thread_pool_new(entangle_pixbuf_loader_colour_worker,
+                                            loader,
+                                            g_get_num_processors(),
+                                            FALSE,
+                                            NULL);
 }
 
 
@@ -583,6 +1073,7 @@ gboolean entangle_pixbuf_loader_load(EntanglePixbufLoader *loader,
         gboolean hasPixbuf = entry->pixbuf != NULL;
         gboolean hasMetadata = entry->metadata != NULL;
         entry->refs++;
+        priv->hits++;
         g_mutex_unlock(priv->lock);
         if (hasPixbuf && 0)
             do_idle_emit(loader, "pixbuf-loaded", image);
@@ -590,9 +1081,11 @@ gboolean entangle_pixbuf_loader_load(EntanglePixbufLoader *loader,
             do_idle_emit(loader, "metadata-loaded", image);
         return TRUE;
     }
-    entry = entangle_pixbuf_loader_entry_new(image);
+    priv->misses++;
+    entry = entangle_pixbuf_loader_entry_new(image, priv->memory);
     g_hash_table_insert(priv->pixbufs, g_strdup(entangle_image_get_filename(image)), entry);
-    g_thread_pool_push(priv->workers, image, NULL);
+    entangle_pixbuf_loader_io_push(loader, image);
+    ENTANGLE_TRACE_COUNTER("pixbuf-loader-queue", entangle_pixbuf_loader_queued(priv));
 
     g_mutex_unlock(priv->lock);
     return TRUE;
@@ -628,8 +1121,16 @@ gboolean entangle_pixbuf_loader_unload(EntanglePixbufLoader *loader,
     entry = g_hash_table_lookup(priv->pixbufs, entangle_image_get_filename(image));
     if (!entry)
         goto cleanup;
+    if (entry->refs == 0) {
+        g_warning("Unbalanced unload of %s", entangle_image_get_filename(image));
+        goto cleanup;
+    }
     entry->refs--;
     ENTANGLE_DEBUG("Entry %d %d", entry->refs, entry->ready);
+    /* Nobody wants the result any more, so free up its
+     * thread rather than finish a multi-second decode */
+    if (entry->refs == 0 && entry->processing)
+        g_cancellable_cancel(entry->cancel);
     if (entry->refs == 0 &&
         !entry->processing &&
         !entry->pending) {
@@ -698,9 +1199,11 @@ EntangleColourProfileTransform *entangle_pixbuf_loader_get_colour_transform(Enta
 /**
  * entangle_pixbuf_loader_set_workers:
  * @loader: the pixbuf loader
- * @count: the new limit on workers
+ * @count: the new limit on workers, or 0 for one per processor
  *
- * Set the maximum number of worker threads for the pixbuf loader
+ * Set the maximum number of threads decoding images for the
+ * pixbuf loader. The threads reading files and applying colour
+ * transforms are sized separately.
  */
 void entangle_pixbuf_loader_set_workers(EntanglePixbufLoader *loader,
                                         int count)
@@ -709,7 +1212,10 @@ void entangle_pixbuf_loader_set_workers(EntanglePixbufLoader *loader,
 
     EntanglePixbufLoaderPrivate *priv = loader->priv;
 
-    g_thread_pool_set_max_threads(priv->workers, count, NULL);
+    if (count <= 0)
+        count = g_get_num_processors();
+
+    g_thread_pool_set_max_threads(priv->decodeWorkers, count, NULL);
 }
 
 
@@ -717,9 +1223,9 @@ void entangle_pixbuf_loader_set_workers(EntanglePixbufLoader *loader,
  * entangle_pixbuf_loader_get_workers:
  * @loader: the pixbuf loader
  *
- * Get the number of worker threads associated with the loader
+ * Get the number of decode threads associated with the loader
  *
- * Returns: the maximum number of worker threads
+ * Returns: the maximum number of decode threads
  */
 int entangle_pixbuf_loader_get_workers(EntanglePixbufLoader *loader)
 {
@@ -727,7 +1233,7 @@ int entangle_pixbuf_loader_get_workers(EntanglePixbufLoader *loader)
 
     EntanglePixbufLoaderPrivate *priv = loader->priv;
 
-    return g_thread_pool_get_max_threads(priv->workers);
+    return g_thread_pool_get_max_threads(priv->decodeWorkers);
 }
 
 
@@ -59,7 +59,10 @@ struct _EntanglePixbufLoaderClass
     void (*metadata_unloaded)(EntanglePixbufLoader *loader, EntangleImage *image);
 
     GdkPixbuf *(*pixbuf_load)(EntanglePixbufLoader *loader, EntangleImage *image,
-                              GExiv2Metadata **metadata);
+                              GExiv2Metadata **metadata, GCancellable *cancel);
+    /* Whether the whole file should be read into memory
+     * before pixbuf_load, or left for it to read itself */
+    gboolean (*pixbuf_prefetch)(EntanglePixbufLoader *loader, EntangleImage *image);
 };
 
 
@@ -112,7 +112,16 @@ GdkPixbuf *entangle_pixbuf_auto_rotate(GdkPixbuf *src,
     return dest;
 }
 
-static gboolean entangle_pixbuf_is_raw(EntangleImage *image)
+/**
+ * entangle_pixbuf_is_raw:
+ * @image: (transfer none): the camera image to check
+ *
+ * Determine whether @image is a raw file, going by the
+ * extension of its filename
+ *
+ * Returns: TRUE if @image is a raw file
+ */
+gboolean entangle_pixbuf_is_raw(EntangleImage *image)
 {
     const char *extlist[] = {
         ".cr2", ".nef", ".nrw", ".arw", ".orf", ".dng", ".pef",
@@ -139,6 +148,48 @@ static gboolean entangle_pixbuf_is_raw(EntangleImage *image)
 }
 
 
+/*
+ * libraw_init allocates several MB of tables and buffers, so
+ * each thread keeps a handle to reuse. It is taken out of the
+ * slot while in use, so a nested open just gets its own.
+ */
+static void entangle_pixbuf_raw_free(gpointer opaque)
+{
+    libraw_close(opaque);
+}
+
+static GPrivate entangle_pixbuf_raw = G_PRIVATE_INIT(entangle_pixbuf_raw_free);
+
+
+static libraw_data_t *entangle_pixbuf_raw_take(void)
+{
+    libraw_data_t *raw = g_private_get(&entangle_pixbuf_raw);
+
+    if (raw) {
+        g_private_set(&entangle_pixbuf_raw, NULL);
+        return raw;
+    }
+
+    return libraw_init(0);
+}
+
+
+/* Drops the file & per image buffers but keeps the handle */
+static void entangle_pixbuf_raw_release(libraw_data_t *raw)
+{
+    if (!raw)
+        return;
+
+    libraw_recycle(raw);
+    libraw_set_progress_handler(raw, NULL, NULL);
+
+    if (g_private_get(&entangle_pixbuf_raw))
+        libraw_close(raw);
+    else
+        g_private_set(&entangle_pixbuf_raw, raw);
+}
+
+
 static void img_free(guchar *ignore G_GNUC_UNUSED, gpointer opaque)
 {
     libraw_processed_image_t *img = opaque;
@@ -146,10 +197,73 @@ static void img_free(guchar *ignore G_GNUC_UNUSED, gpointer opaque)
 }
 
 
-static GdkPixbuf *entangle_pixbuf_open_image_master_raw(EntangleImage *image)
+/* Called by libraw throughout a decode, a non-zero
+ * return makes it give up with LIBRAW_CANCELLED_BY_CALLBACK */
+static int entangle_pixbuf_raw_progress(void *opaque,
+                                        enum LibRaw_progress stage G_GNUC_UNUSED,
+                                        int iteration G_GNUC_UNUSED,
+                                        int expected G_GNUC_UNUSED)
+{
+    GCancellable *cancel = opaque;
+
+    return g_cancellable_is_cancelled(cancel) ? 1 : 0;
+}
+
+
+/* Prefer the in-memory copy of the file, if there is one */
+static int entangle_pixbuf_open_raw(libraw_data_t *raw,
+                                    EntangleImage *image,
+                                    GBytes *data,
+                                    GCancellable *cancel)
+{
+    if (cancel)
+        libraw_set_progress_handler(raw, entangle_pixbuf_raw_progress, cancel);
+    if (data) {
+        gsize len;
+        gconstpointer buf = g_bytes_get_data(data, &len);
+        return libraw_open_buffer(raw, (void *)buf, len);
+    }
+    return libraw_open_file(raw, entangle_image_get_filename(image));
+}
+
+
+/* Attach a histogram of the unpacked sensor data to @image */
+static gboolean entangle_pixbuf_raw_analyse(EntangleImage *image,
+                                            libraw_data_t *raw)
+{
+    EntangleRawHistogram *histogram;
+    const guint16 *data;
+
+    /* Foveon & linear DNGs have no single channel data */
+    if (!raw->rawdata.raw_image)
+        return FALSE;
+
+    data = raw->rawdata.raw_image +
+        (gsize)raw->sizes.top_margin * raw->sizes.raw_pitch / 2 +
+        raw->sizes.left_margin;
+    histogram = entangle_raw_histogram_new_bayer(data,
+                                                 raw->sizes.width,
+                                                 raw->sizes.height,
+                                                 raw->sizes.raw_pitch,
+                                                 raw->idata.filters,
+                                                 raw->color.black,
+                                                 raw->color.maximum);
+    if (!histogram)
+        return FALSE;
+
+    entangle_image_set_raw_histogram(image, histogram);
+    g_object_unref(histogram);
+    return TRUE;
+}
+
+
+static GdkPixbuf *entangle_pixbuf_open_image_master_raw(EntangleImage *image,
+                                                        GBytes *data,
+                                                        gboolean rawHistogram,
+                                                        GCancellable *cancel)
 {
     GdkPixbuf *result = NULL;
-    libraw_data_t *raw = libraw_init(0);
+    libraw_data_t *raw = entangle_pixbuf_raw_take();
     libraw_processed_image_t *img = NULL;
     int ret;
 
@@ -170,12 +284,15 @@ static GdkPixbuf *entangle_pixbuf_open_image_master_raw(EntangleImage *image)
     raw->params.fbdd_noiserd = 1;
 
     ENTANGLE_DEBUG("Open raw %s", entangle_image_get_filename(image));
-    if ((ret = libraw_open_file(raw, entangle_image_get_filename(image))) != 0) {
+    if ((ret = entangle_pixbuf_open_raw(raw, image, data, cancel)) != 0) {
         ENTANGLE_DEBUG("Failed to open raw file: %s",
                        libraw_strerror(ret));
         goto cleanup;
     }
 
+    if (g_cancellable_is_cancelled(cancel))
+        goto cleanup;
+
     ENTANGLE_DEBUG("Unpack raw %s", entangle_image_get_filename(image));
     if ((ret = libraw_unpack(raw)) != 0) {
         ENTANGLE_DEBUG("Failed to unpack raw file: %s",
@@ -183,6 +300,13 @@ static GdkPixbuf *entangle_pixbuf_open_image_master_raw(EntangleImage *image)
         goto cleanup;
     }
 
+    /* Almost free while the unpacked data is at hand */
+    if (rawHistogram)
+        entangle_pixbuf_raw_analyse(image, raw);
+
+    if (g_cancellable_is_cancelled(cancel))
+        goto cleanup;
+
     ENTANGLE_DEBUG("Process raw %s", entangle_image_get_filename(image));
     if ((ret = libraw_dcraw_process(raw)) != 0) {
         ENTANGLE_DEBUG("Failed to process raw file: %s",
@@ -206,12 +330,34 @@ static GdkPixbuf *entangle_pixbuf_open_image_master_raw(EntangleImage *image)
                                       img_free, img);
 
  cleanup:
-    libraw_close(raw);
+    entangle_pixbuf_raw_release(raw);
+    return result;
+}
+
+
+static GdkPixbuf *entangle_pixbuf_open_data_gdk(GBytes *data)
+{
+    GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
+    GdkPixbuf *result = NULL;
+    gsize len;
+    const guchar *buf = g_bytes_get_data(data, &len);
+
+    if (gdk_pixbuf_loader_write(loader, buf, len, NULL) &&
+        gdk_pixbuf_loader_close(loader, NULL)) {
+        result = gdk_pixbuf_loader_get_pixbuf(loader);
+        if (result)
+            g_object_ref(result);
+    } else {
+        gdk_pixbuf_loader_close(loader, NULL);
+    }
+
+    g_object_unref(loader);
     return result;
 }
 
 
 static GdkPixbuf *entangle_pixbuf_open_image_master_gdk(EntangleImage *image,
+                                                        GBytes *data,
                                                         GExiv2Metadata *metadata,
                                                         gboolean applyOrientation)
 {
@@ -219,7 +365,10 @@ static GdkPixbuf *entangle_pixbuf_open_image_master_gdk(EntangleImage *image,
     GdkPixbuf *result;
 
     ENTANGLE_DEBUG("Loading %s using GDK Pixbuf", entangle_image_get_filename(image));
-    master = gdk_pixbuf_new_from_file(entangle_image_get_filename(image), NULL);
+    if (data)
+        master = entangle_pixbuf_open_data_gdk(data);
+    else
+        master = gdk_pixbuf_new_from_file(entangle_image_get_filename(image), NULL);
 
     if (!master)
         return NULL;
@@ -243,13 +392,16 @@ static GdkPixbuf *entangle_pixbuf_open_image_master_gdk(EntangleImage *image,
 
 
 static GdkPixbuf *entangle_pixbuf_open_image_master(EntangleImage *image,
+                                                    GBytes *data,
                                                     GExiv2Metadata *metadata,
-                                                    gboolean applyOrientation)
+                                                    gboolean applyOrientation,
+                                                    gboolean rawHistogram,
+                                                    GCancellable *cancel)
 {
     if (entangle_pixbuf_is_raw(image))
-        return entangle_pixbuf_open_image_master_raw(image);
+        return entangle_pixbuf_open_image_master_raw(image, data, rawHistogram, cancel);
     else
-        return entangle_pixbuf_open_image_master_gdk(image, metadata, applyOrientation);
+        return entangle_pixbuf_open_image_master_gdk(image, data, metadata, applyOrientation);
 }
 
 
@@ -304,12 +456,14 @@ entangle_pixbuf_get_closest_preview(GExiv2PreviewProperties **proplist,
 
 
 static GdkPixbuf *entangle_pixbuf_open_image_preview_raw(EntangleImage *image,
+                                                         GBytes *data,
                                                          GExiv2Metadata *metadata,
-                                                         gboolean applyOrientation)
+                                                         gboolean applyOrientation,
+                                                         GCancellable *cancel)
 {
     GdkPixbuf *result = NULL;
     GdkPixbufLoader *loader = gdk_pixbuf_loader_new();
-    libraw_data_t *raw = libraw_init(0);
+    libraw_data_t *raw = entangle_pixbuf_raw_take();
     libraw_processed_image_t *img = NULL;
     int ret;
 
@@ -319,7 +473,7 @@ static GdkPixbuf *entangle_pixbuf_open_image_preview_raw(EntangleImage *image,
     }
 
     ENTANGLE_DEBUG("Open preview raw %s", entangle_image_get_filename(image));
-    if ((ret = libraw_open_file(raw, entangle_image_get_filename(image))) != 0) {
+    if ((ret = entangle_pixbuf_open_raw(raw, image, data, cancel)) != 0) {
         ENTANGLE_DEBUG("Failed to open preview raw file: %s",
                        libraw_strerror(ret));
         goto cleanup;
@@ -370,7 +524,7 @@ static GdkPixbuf *entangle_pixbuf_open_image_preview_raw(EntangleImage *image,
     if (img)
         libraw_dcraw_clear_mem(img);
 
-    libraw_close(raw);
+    entangle_pixbuf_raw_release(raw);
 
     gdk_pixbuf_loader_close(loader, NULL);
 
@@ -442,44 +596,109 @@ static GdkPixbuf *entangle_pixbuf_open_image_preview_exiv(EntangleImage *image,
 
 
 static GdkPixbuf *entangle_pixbuf_open_image_preview(EntangleImage *image,
+                                                     GBytes *data,
                                                      GExiv2Metadata *metadata,
-                                                     gboolean applyOrientation)
+                                                     gboolean applyOrientation,
+                                                     gboolean rawHistogram,
+                                                     GCancellable *cancel)
 {
     GdkPixbuf *result = NULL;
     if (entangle_pixbuf_is_raw(image)) {
-        result = entangle_pixbuf_open_image_preview_raw(image, metadata, applyOrientation);
-        if (!result && metadata)
+        result = entangle_pixbuf_open_image_preview_raw(image, data, metadata, applyOrientation, cancel);
+        if (!result && metadata && !g_cancellable_is_cancelled(cancel))
             result = entangle_pixbuf_open_image_preview_exiv(image, 256, metadata);
-        if (!result)
-            result = entangle_pixbuf_open_image_master_raw(image);
+        if (!result && !g_cancellable_is_cancelled(cancel))
+            result = entangle_pixbuf_open_image_master_raw(image, data, rawHistogram, cancel);
     } else {
-        result = entangle_pixbuf_open_image_master_gdk(image, metadata, applyOrientation);
+        result = entangle_pixbuf_open_image_master_gdk(image, data, metadata, applyOrientation);
     }
     return result;
 }
 
 
 static GdkPixbuf *entangle_pixbuf_open_image_thumbnail(EntangleImage *image,
+                                                       GBytes *data,
                                                        GExiv2Metadata *metadata,
-                                                       gboolean applyOrientation)
+                                                       gboolean applyOrientation,
+                                                       gboolean rawHistogram,
+                                                       GCancellable *cancel)
 {
     GdkPixbuf *result = NULL;
     if (entangle_pixbuf_is_raw(image))
-        result = entangle_pixbuf_open_image_preview_raw(image, metadata, applyOrientation);
-    if (!result && metadata)
+        result = entangle_pixbuf_open_image_preview_raw(image, data, metadata, applyOrientation, cancel);
+    if (!result && metadata && !g_cancellable_is_cancelled(cancel))
         result = entangle_pixbuf_open_image_preview_exiv(image, 128, metadata);
-    if (!result)
-        result = entangle_pixbuf_open_image_master(image, metadata, applyOrientation);
+    if (!result && !g_cancellable_is_cancelled(cancel))
+        result = entangle_pixbuf_open_image_master(image, data, metadata, applyOrientation, rawHistogram, cancel);
     return result;
 }
 
 
+/**
+ * entangle_pixbuf_open_raw_histogram:
+ * @image: the camera image to analyse
+ * @cancel: (allow-none): a cancellable to abandon the analysis
+ *
+ * If @image is a raw file, unpack its sensor data without
+ * demosaicing or developing it, and attach a histogram of
+ * the data to @image. This is much quicker than loading the
+ * master image, so suits callers only showing the preview.
+ * Loading the master image attaches the histogram anyway.
+ *
+ * Returns: TRUE if a histogram was attached to @image
+ */
+gboolean entangle_pixbuf_open_raw_histogram(EntangleImage *image,
+                                            GCancellable *cancel)
+{
+    libraw_data_t *raw;
+    GBytes *data;
+    gboolean ret = FALSE;
+    int err;
+
+    if (!entangle_pixbuf_is_raw(image))
+        return FALSE;
+
+    if (!(raw = entangle_pixbuf_raw_take())) {
+        ENTANGLE_DEBUG("Failed to initialize libraw");
+        return FALSE;
+    }
+
+    data = entangle_image_get_data(image);
+
+    ENTANGLE_DEBUG("Analyse raw %s", entangle_image_get_filename(image));
+    if ((err = entangle_pixbuf_open_raw(raw, image, data, cancel)) != 0) {
+        ENTANGLE_DEBUG("Failed to open raw file: %s",
+                       libraw_strerror(err));
+        goto cleanup;
+    }
+
+    if (g_cancellable_is_cancelled(cancel))
+        goto cleanup;
+
+    if ((err = libraw_unpack(raw)) != 0) {
+        ENTANGLE_DEBUG("Failed to unpack raw file: %s",
+                       libraw_strerror(err));
+        goto cleanup;
+    }
+
+    ret = entangle_pixbuf_raw_analyse(image, raw);
+
+ cleanup:
+    if (data)
+        g_bytes_unref(data);
+    entangle_pixbuf_raw_release(raw);
+    return ret;
+}
+
+
 /**
  * entangle_pixbuf_open_image:
  * @image: the camera image to open
  * @slot: the type of image data to open
  * @applyOrientation: whether to rotate to natural orientation
+ * @rawHistogram: whether to attach a raw histogram to the image
  * @metadata: (allow-none)(transfer full): filled with metadata object instance
+ * @cancel: (allow-none): a cancellable to abandon the decode
  *
  * If @slot is ENTANGLE_PIXBUF_IMAGE_SLOT_MASTER then the primary
  * image data is loaded.
@@ -493,42 +712,70 @@ static GdkPixbuf *entangle_pixbuf_open_image_thumbnail(EntangleImage *image,
  * files any thumbnail in the exiv2 metadata is loaded. If no thumbnail
  * is available, the primary image data is loaded.
  *
+ * If the image has an in-memory copy of its file contents, that
+ * is decoded instead of the file on disk.
+ *
+ * If @rawHistogram is TRUE and the sensor data of a raw file gets
+ * unpacked by the decode, its histogram is attached to @image.
+ *
+ * If @cancel is triggered, the decode is abandoned at the next
+ * stage, or from within libraw for raw files, and NULL is
+ * returned.
+ *
  * Returns: (transfer full): the pixbuf for the image slot
  */
 GdkPixbuf *entangle_pixbuf_open_image(EntangleImage *image,
                                       EntanglePixbufImageSlot slot,
                                       gboolean applyOrientation,
-                                      GExiv2Metadata **metadata)
+                                      gboolean rawHistogram,
+                                      GExiv2Metadata **metadata,
+                                      GCancellable *cancel)
 {
     ENTANGLE_DEBUG("Open image %s %d", entangle_image_get_filename(image), slot);
     GExiv2Metadata *themetadata = gexiv2_metadata_new();
     GdkPixbuf *ret = NULL;
+    GBytes *data = entangle_image_get_data(image);
+    gboolean opened;
 
-    if (!gexiv2_metadata_open_path(themetadata, entangle_image_get_filename(image), NULL)) {
+    if (data) {
+        gsize len;
+        const guint8 *buf = g_bytes_get_data(data, &len);
+        opened = gexiv2_metadata_open_buf(themetadata, buf, len, NULL);
+    } else {
+        opened = gexiv2_metadata_open_path(themetadata, entangle_image_get_filename(image), NULL);
+    }
+    if (!opened) {
         g_object_unref(themetadata);
         themetadata = NULL;
     }
 
+    if (g_cancellable_is_cancelled(cancel))
+        goto cleanup;
+
     switch (slot) {
     case ENTANGLE_PIXBUF_IMAGE_SLOT_MASTER:
-        ret = entangle_pixbuf_open_image_master(image, themetadata, applyOrientation);
+        ret = entangle_pixbuf_open_image_master(image, data, themetadata, applyOrientation, rawHistogram, cancel);
         break;
 
     case ENTANGLE_PIXBUF_IMAGE_SLOT_PREVIEW:
-        ret = entangle_pixbuf_open_image_preview(image, themetadata, applyOrientation);
+        ret = entangle_pixbuf_open_image_preview(image, data, themetadata, applyOrientation, rawHistogram, cancel);
         break;
 
     case ENTANGLE_PIXBUF_IMAGE_SLOT_THUMBNAIL:
-        ret = entangle_pixbuf_open_image_thumbnail(image, themetadata, applyOrientation);
+        ret = entangle_pixbuf_open_image_thumbnail(image, data, themetadata, applyOrientation, rawHistogram, cancel);
         break;
 
     default:
         g_warn_if_reached();
         break;
     }
+
+ cleanup:
+    if (data)
+        g_bytes_unref(data);
     if (metadata)
         *metadata = themetadata;
-    else
+    else if (themetadata)
         g_object_unref(themetadata);
     return ret;
 }
@@ -30,6 +30,8 @@ G_BEGIN_DECLS
 GdkPixbuf *entangle_pixbuf_auto_rotate(GdkPixbuf *src,
                                        GExiv2Metadata *metadata);
 
+gboolean entangle_pixbuf_is_raw(EntangleImage *image);
+
 typedef enum {
   ENTANGLE_PIXBUF_IMAGE_SLOT_MASTER,
   ENTANGLE_PIXBUF_IMAGE_SLOT_PREVIEW,
@@ -39,7 +41,11 @@ typedef enum {
 GdkPixbuf *entangle_pixbuf_open_image(EntangleImage *image,
                                       EntanglePixbufImageSlot slot,
                                       gboolean applyOrientation,
-                                      GExiv2Metadata **metadata);
+                                      gboolean rawHistogram,
+                                      GExiv2Metadata **metadata,
+                                      GCancellable *cancel);
+gboolean entangle_pixbuf_open_raw_histogram(EntangleImage *image,
+                                            GCancellable *cancel);
 
 #endif /* __ENTANGLE_PIXBUF_H__ */
 
@@ -0,0 +1,270 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "entangle-debug.h"
+#include "entangle-raw-histogram.h"
+#include "entangle-tracer.h"
+
+/*
+ * Counts the levels of the undeveloped sensor data, separately
+ * for each photosite of the 2x2 colour filter pattern, so that
+ * clipping shows up as the camera recorded it, rather than as
+ * hidden or exaggerated by white balance and tone curves.
+ */
+
+#define ENTANGLE_RAW_HISTOGRAM_GET_PRIVATE(obj)                         \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_RAW_HISTOGRAM, EntangleRawHistogramPrivate))
+
+/* The colour of a photosite, using dcraw's filter pattern encoding */
+#define ENTANGLE_RAW_HISTOGRAM_FC(filters, row, col)                    \
+    ((filters) >> ((((row) << 1 & 14) + ((col) & 1)) << 1) & 3)
+
+struct _EntangleRawHistogramPrivate {
+    int colour[ENTANGLE_RAW_HISTOGRAM_SITES];
+    /* The extra bin counts photosites at or above saturation */
+    guint64 counts[ENTANGLE_RAW_HISTOGRAM_SITES][ENTANGLE_RAW_HISTOGRAM_BINS + 1];
+    guint64 total[ENTANGLE_RAW_HISTOGRAM_SITES];
+};
+
+G_DEFINE_TYPE(EntangleRawHistogram, entangle_raw_histogram, G_TYPE_OBJECT);
+
+
+static void entangle_raw_histogram_class_init(EntangleRawHistogramClass *klass)
+{
+    g_type_class_add_private(klass, sizeof(EntangleRawHistogramPrivate));
+}
+
+
+static void entangle_raw_histogram_init(EntangleRawHistogram *histogram)
+{
+    histogram->priv = ENTANGLE_RAW_HISTOGRAM_GET_PRIVATE(histogram);
+    memset(histogram->priv, 0, sizeof(*histogram->priv));
+}
+
+
+/*
+ * Sites alternate along a row, so each pair of photosites is
+ * a lookup and increment for each of the two sites, with no
+ * branches or arithmetic in the loop. Scattered increments
+ * do not map onto SIMD, so this is as tight as it gets.
+ */
+static void entangle_raw_histogram_add_row(const guint16 *row,
+                                           guint width,
+                                           const guint16 *lut,
+                                           guint64 *even,
+                                           guint64 *odd)
+{
+    guint col;
+
+    for (col = 0; col + 1 < width; col += 2) {
+        even[lut[row[col]]]++;
+        odd[lut[row[col + 1]]]++;
+    }
+    if (col < width)
+        even[lut[row[col]]]++;
+}
+
+
+/**
+ * entangle_raw_histogram_new_bayer:
+ * @data: the first visible photosite of the raw data
+ * @width: the number of visible photosites per row
+ * @height: the number of visible rows
+ * @pitch: the bytes between the start of each row
+ * @filters: the colour filter pattern, as encoded by libraw
+ * @black: the level of an unexposed photosite
+ * @maximum: the level at which photosites saturate
+ *
+ * Build a histogram from the undeveloped data of a sensor
+ * with a Bayer colour filter. Other kinds of filter are not
+ * supported.
+ *
+ * Returns: (transfer full)(allow-none): the histogram, or NULL
+ */
+EntangleRawHistogram *entangle_raw_histogram_new_bayer(const guint16 *data,
+                                                       guint width,
+                                                       guint height,
+                                                       gsize pitch,
+                                                       guint filters,
+                                                       guint black,
+                                                       guint maximum)
+{
+    EntangleRawHistogram *histogram;
+    EntangleRawHistogramPrivate *priv;
+    guint16 *lut;
+    guint row, site;
+
+    /* Only plain Bayer patterns repeat every two rows */
+    if (filters < 1000 || maximum <= black)
+        return NULL;
+    for (row = 2; row < 8; row++) {
+        if (ENTANGLE_RAW_HISTOGRAM_FC(filters, row, 0) !=
+            ENTANGLE_RAW_HISTOGRAM_FC(filters, row - 2, 0) ||
+            ENTANGLE_RAW_HISTOGRAM_FC(filters, row, 1) !=
+            ENTANGLE_RAW_HISTOGRAM_FC(filters, row - 2, 1))
+            return NULL;
+    }
+
+    histogram = ENTANGLE_RAW_HISTOGRAM(g_object_new(ENTANGLE_TYPE_RAW_HISTOGRAM, NULL));
+    priv = histogram->priv;
+
+    for (site = 0; site < ENTANGLE_RAW_HISTOGRAM_SITES; site++) {
+        int colour = ENTANGLE_RAW_HISTOGRAM_FC(filters, site >> 1, site & 1);
+        /* The second green is numbered separately */
+        priv->colour[site] = colour == 3 ? 1 : colour;
+    }
+
+    ENTANGLE_TRACE_BEGIN("raw-histogram");
+    lut = g_new(guint16, G_MAXUINT16 + 1);
+    for (guint level = 0; level <= G_MAXUINT16; level++) {
+        if (level <= black)
+            lut[level] = 0;
+        else if (level >= maximum)
+            lut[level] = ENTANGLE_RAW_HISTOGRAM_BINS;
+        else
+            lut[level] = (guint16)((guint64)(level - black) * ENTANGLE_RAW_HISTOGRAM_BINS /
+                                   (maximum - black));
+    }
+
+    for (row = 0; row < height; row++) {
+        const guint16 *line = (const guint16 *)((const guint8 *)data + row * pitch);
+        entangle_raw_histogram_add_row(line, width, lut,
+                                       priv->counts[(row & 1) << 1],
+                                       priv->counts[((row & 1) << 1) + 1]);
+    }
+    g_free(lut);
+
+    for (site = 0; site < ENTANGLE_RAW_HISTOGRAM_SITES; site++) {
+        for (guint bin = 0; bin <= ENTANGLE_RAW_HISTOGRAM_BINS; bin++)
+            priv->total[site] += priv->counts[site][bin];
+    }
+    ENTANGLE_TRACE_END("raw-histogram");
+
+    ENTANGLE_DEBUG("Raw histogram %ux%u black %u max %u clipped %" G_GUINT64_FORMAT
+                   "/%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT,
+                   width, height, black, maximum,
+                   priv->counts[0][ENTANGLE_RAW_HISTOGRAM_BINS],
+                   priv->counts[1][ENTANGLE_RAW_HISTOGRAM_BINS],
+                   priv->counts[2][ENTANGLE_RAW_HISTOGRAM_BINS],
+                   priv->counts[3][ENTANGLE_RAW_HISTOGRAM_BINS]);
+
+    return histogram;
+}
+
+
+/**
+ * entangle_raw_histogram_get_colour:
+ * @histogram: (transfer none): the raw histogram
+ * @site: the photosite in the 2x2 filter pattern, row major
+ *
+ * Get the colour of the filter over @site
+ *
+ * Returns: 0 for red, 1 for green or 2 for blue
+ */
+int entangle_raw_histogram_get_colour(EntangleRawHistogram *histogram,
+                                      guint site)
+{
+    g_return_val_if_fail(ENTANGLE_IS_RAW_HISTOGRAM(histogram), 0);
+    g_return_val_if_fail(site < ENTANGLE_RAW_HISTOGRAM_SITES, 0);
+
+    EntangleRawHistogramPrivate *priv = histogram->priv;
+
+    return priv->colour[site];
+}
+
+
+/**
+ * entangle_raw_histogram_get_counts:
+ * @histogram: (transfer none): the raw histogram
+ * @site: the photosite in the 2x2 filter pattern, row major
+ *
+ * Get the number of photosites at each level for @site,
+ * from black in the first bin to just below saturation
+ * in the last
+ *
+ * Returns: (transfer none): ENTANGLE_RAW_HISTOGRAM_BINS counts
+ */
+const guint64 *entangle_raw_histogram_get_counts(EntangleRawHistogram *histogram,
+                                                 guint site)
+{
+    g_return_val_if_fail(ENTANGLE_IS_RAW_HISTOGRAM(histogram), NULL);
+    g_return_val_if_fail(site < ENTANGLE_RAW_HISTOGRAM_SITES, NULL);
+
+    EntangleRawHistogramPrivate *priv = histogram->priv;
+
+    return priv->counts[site];
+}
+
+
+/**
+ * entangle_raw_histogram_get_clipped:
+ * @histogram: (transfer none): the raw histogram
+ * @site: the photosite in the 2x2 filter pattern, row major
+ *
+ * Get the number of photosites for @site which reached
+ * the saturation level of the sensor
+ *
+ * Returns: the number of clipped photosites
+ */
+guint64 entangle_raw_histogram_get_clipped(EntangleRawHistogram *histogram,
+                                           guint site)
+{
+    g_return_val_if_fail(ENTANGLE_IS_RAW_HISTOGRAM(histogram), 0);
+    g_return_val_if_fail(site < ENTANGLE_RAW_HISTOGRAM_SITES, 0);
+
+    EntangleRawHistogramPrivate *priv = histogram->priv;
+
+    return priv->counts[site][ENTANGLE_RAW_HISTOGRAM_BINS];
+}
+
+
+/**
+ * entangle_raw_histogram_get_total:
+ * @histogram: (transfer none): the raw histogram
+ * @site: the photosite in the 2x2 filter pattern, row major
+ *
+ * Get the number of photosites counted for @site
+ *
+ * Returns: the number of photosites
+ */
+guint64 entangle_raw_histogram_get_total(EntangleRawHistogram *histogram,
+                                         guint site)
+{
+    g_return_val_if_fail(ENTANGLE_IS_RAW_HISTOGRAM(histogram), 0);
+    g_return_val_if_fail(site < ENTANGLE_RAW_HISTOGRAM_SITES, 0);
+
+    EntangleRawHistogramPrivate *priv = histogram->priv;
+
+    return priv->total[site];
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
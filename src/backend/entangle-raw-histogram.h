@@ -0,0 +1,88 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_RAW_HISTOGRAM_H__
+#define __ENTANGLE_RAW_HISTOGRAM_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define ENTANGLE_TYPE_RAW_HISTOGRAM            (entangle_raw_histogram_get_type ())
+#define ENTANGLE_RAW_HISTOGRAM(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), ENTANGLE_TYPE_RAW_HISTOGRAM, EntangleRawHistogram))
+#define ENTANGLE_RAW_HISTOGRAM_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), ENTANGLE_TYPE_RAW_HISTOGRAM, EntangleRawHistogramClass))
+#define ENTANGLE_IS_RAW_HISTOGRAM(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ENTANGLE_TYPE_RAW_HISTOGRAM))
+#define ENTANGLE_IS_RAW_HISTOGRAM_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ENTANGLE_TYPE_RAW_HISTOGRAM))
+#define ENTANGLE_RAW_HISTOGRAM_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), ENTANGLE_TYPE_RAW_HISTOGRAM, EntangleRawHistogramClass))
+
+/* Levels between the black & saturation points */
+#define ENTANGLE_RAW_HISTOGRAM_BINS 256
+/* Photosites in the repeating 2x2 colour filter pattern */
+#define ENTANGLE_RAW_HISTOGRAM_SITES 4
+
+typedef struct _EntangleRawHistogram EntangleRawHistogram;
+typedef struct _EntangleRawHistogramPrivate EntangleRawHistogramPrivate;
+typedef struct _EntangleRawHistogramClass EntangleRawHistogramClass;
+
+struct _EntangleRawHistogram
+{
+    GObject parent;
+
+    EntangleRawHistogramPrivate *priv;
+};
+
+struct _EntangleRawHistogramClass
+{
+    GObjectClass parent_class;
+};
+
+
+GType entangle_raw_histogram_get_type(void) G_GNUC_CONST;
+
+EntangleRawHistogram *entangle_raw_histogram_new_bayer(const guint16 *data,
+                                                       guint width,
+                                                       guint height,
+                                                       gsize pitch,
+                                                       guint filters,
+                                                       guint black,
+                                                       guint maximum);
+
+int entangle_raw_histogram_get_colour(EntangleRawHistogram *histogram,
+                                      guint site);
+const guint64 *entangle_raw_histogram_get_counts(EntangleRawHistogram *histogram,
+                                                 guint site);
+guint64 entangle_raw_histogram_get_clipped(EntangleRawHistogram *histogram,
+                                           guint site);
+guint64 entangle_raw_histogram_get_total(EntangleRawHistogram *histogram,
+                                         guint site);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_RAW_HISTOGRAM_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
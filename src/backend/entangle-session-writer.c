@@ -0,0 +1,745 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gi18n.h>
+
+#include "entangle-debug.h"
+#include "entangle-session-writer.h"
+#include "entangle-tracer.h"
+
+/*
+ * Captured files are written to the session by a single worker
+ * thread, so a slow disk never stalls the main loop. Files are
+ * written in the order they were queued, with the space for
+ * each preallocated up front and the data written in large
+ * chunks at aligned offsets. Completion is reported back in
+ * the main loop only once the requested durability has been
+ * reached. The queue is not bounded by blocking the caller,
+ * since the data is already in memory, but once the backlog
+ * grows too large the writer reports itself as congested so
+ * that no more files are fetched from the camera until it has
+ * caught up.
+ */
+
+#define ENTANGLE_SESSION_WRITER_GET_PRIVATE(obj)                        \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_SESSION_WRITER, EntangleSessionWriterPrivate))
+
+/* Size of each write, and the alignment of their offsets */
+#define ENTANGLE_SESSION_WRITER_CHUNK (4 * 1024 * 1024)
+
+/* Largest group of files sharing a single commit */
+#define ENTANGLE_SESSION_WRITER_GROUP_FILES 16
+#define ENTANGLE_SESSION_WRITER_GROUP_BYTES (256 * 1024 * 1024)
+
+#define ENTANGLE_SESSION_WRITER_MAX_BACKLOG (512 * 1024 * 1024)
+
+#ifndef HAVE_FDATASYNC
+# define fdatasync fsync
+#endif
+
+typedef struct _EntangleSessionWriterJob EntangleSessionWriterJob;
+
+struct _EntangleSessionWriterJob {
+    EntangleSessionWriter *writer;
+    char *filename;
+    GBytes *data;
+    GCancellable *cancel;
+    GSimpleAsyncResult *result;
+    GError *error;
+
+    /* Still open, awaiting a group commit */
+    int fd;
+};
+
+struct _EntangleSessionWriterPrivate {
+    GMutex lock;
+    GCond cond;
+    GThread *thread;
+    gboolean shutdown;
+
+    /* Protected by lock */
+    GQueue *jobs;
+    guint busy;
+    guint64 pendingBytes;
+    guint64 maxBacklog;
+    EntangleSessionWriterDurability durability;
+
+    /* Only touched from the main loop */
+    gboolean congested;
+};
+
+G_DEFINE_TYPE(EntangleSessionWriter, entangle_session_writer, G_TYPE_OBJECT);
+
+enum {
+    PROP_0,
+    PROP_DURABILITY,
+    PROP_MAX_BACKLOG,
+    PROP_CONGESTED,
+};
+
+#define ENTANGLE_SESSION_WRITER_ERROR entangle_session_writer_error_quark()
+
+static GQuark entangle_session_writer_error_quark(void)
+{
+    return g_quark_from_static_string("entangle-session-writer");
+}
+
+
+static void entangle_session_writer_get_property(GObject *object,
+                                                 guint prop_id,
+                                                 GValue *value,
+                                                 GParamSpec *pspec)
+{
+    EntangleSessionWriter *writer = ENTANGLE_SESSION_WRITER(object);
+
+    switch (prop_id)
+        {
+        case PROP_DURABILITY:
+            g_value_set_enum(value, entangle_session_writer_get_durability(writer));
+            break;
+
+        case PROP_MAX_BACKLOG:
+            g_value_set_uint64(value, entangle_session_writer_get_max_backlog(writer));
+            break;
+
+        case PROP_CONGESTED:
+            g_value_set_boolean(value, entangle_session_writer_get_congested(writer));
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+}
+
+static void entangle_session_writer_set_property(GObject *object,
+                                                 guint prop_id,
+                                                 const GValue *value,
+                                                 GParamSpec *pspec)
+{
+    EntangleSessionWriter *writer = ENTANGLE_SESSION_WRITER(object);
+
+    switch (prop_id)
+        {
+        case PROP_DURABILITY:
+            entangle_session_writer_set_durability(writer, g_value_get_enum(value));
+            break;
+
+        case PROP_MAX_BACKLOG:
+            entangle_session_writer_set_max_backlog(writer, g_value_get_uint64(value));
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+}
+
+
+static void entangle_session_writer_finalize(GObject *object)
+{
+    EntangleSessionWriter *writer = ENTANGLE_SESSION_WRITER(object);
+    EntangleSessionWriterPrivate *priv = writer->priv;
+
+    /* Queued jobs hold a reference, so the queue is empty */
+    if (priv->thread) {
+        g_mutex_lock(&priv->lock);
+        priv->shutdown = TRUE;
+        g_cond_broadcast(&priv->cond);
+        g_mutex_unlock(&priv->lock);
+        g_thread_join(priv->thread);
+    }
+
+    g_queue_free(priv->jobs);
+    g_cond_clear(&priv->cond);
+    g_mutex_clear(&priv->lock);
+
+    G_OBJECT_CLASS(entangle_session_writer_parent_class)->finalize(object);
+}
+
+
+static void entangle_session_writer_class_init(EntangleSessionWriterClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = entangle_session_writer_finalize;
+    object_class->get_property = entangle_session_writer_get_property;
+    object_class->set_property = entangle_session_writer_set_property;
+
+    g_object_class_install_property(object_class,
+                                    PROP_DURABILITY,
+                                    g_param_spec_enum("durability",
+                                                      "Durability",
+                                                      "When written files are flushed to disk",
+                                                      ENTANGLE_TYPE_SESSION_WRITER_DURABILITY,
+                                                      ENTANGLE_SESSION_WRITER_DURABILITY_NONE,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_NAME |
+                                                      G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+    g_object_class_install_property(object_class,
+                                    PROP_MAX_BACKLOG,
+                                    g_param_spec_uint64("max-backlog",
+                                                        "Max backlog",
+                                                        "Bytes queued before the writer is congested",
+                                                        1, G_MAXUINT64,
+                                                        ENTANGLE_SESSION_WRITER_MAX_BACKLOG,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_NAME |
+                                                        G_PARAM_STATIC_NICK |
+                                                        G_PARAM_STATIC_BLURB));
+    g_object_class_install_property(object_class,
+                                    PROP_CONGESTED,
+                                    g_param_spec_boolean("congested",
+                                                         "Congested",
+                                                         "Whether the backlog of writes is too large",
+                                                         FALSE,
+                                                         G_PARAM_READABLE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
+    g_type_class_add_private(klass, sizeof(EntangleSessionWriterPrivate));
+}
+
+
+static void entangle_session_writer_init(EntangleSessionWriter *writer)
+{
+    EntangleSessionWriterPrivate *priv;
+
+    priv = writer->priv = ENTANGLE_SESSION_WRITER_GET_PRIVATE(writer);
+
+    g_mutex_init(&priv->lock);
+    g_cond_init(&priv->cond);
+    priv->jobs = g_queue_new();
+    priv->maxBacklog = ENTANGLE_SESSION_WRITER_MAX_BACKLOG;
+}
+
+
+/**
+ * entangle_session_writer_get_default:
+ *
+ * Get the process wide writer for session files. All files
+ * share one writer so that they reach the disk in order.
+ *
+ * Returns: (transfer none): the session writer
+ */
+EntangleSessionWriter *entangle_session_writer_get_default(void)
+{
+    static gsize writer = 0;
+
+    if (g_once_init_enter(&writer)) {
+        EntangleSessionWriter *tmp = g_object_new(ENTANGLE_TYPE_SESSION_WRITER, NULL);
+        g_once_init_leave(&writer, (gsize)tmp);
+    }
+
+    return ENTANGLE_SESSION_WRITER((gpointer)writer);
+}
+
+
+static void entangle_session_writer_job_free(EntangleSessionWriterJob *job)
+{
+    g_object_unref(job->writer);
+    g_free(job->filename);
+    g_bytes_unref(job->data);
+    if (job->cancel)
+        g_object_unref(job->cancel);
+    g_object_unref(job->result);
+    if (job->error)
+        g_error_free(job->error);
+    g_free(job);
+}
+
+
+/* Re-evaluated in the main loop as the backlog changes, with
+ * some hysteresis so downloads don't flip on & off per file */
+static void entangle_session_writer_update_congested(EntangleSessionWriter *writer)
+{
+    EntangleSessionWriterPrivate *priv = writer->priv;
+    gboolean congested;
+
+    g_mutex_lock(&priv->lock);
+    if (priv->congested)
+        congested = priv->pendingBytes > priv->maxBacklog / 2;
+    else
+        congested = priv->pendingBytes > priv->maxBacklog;
+    ENTANGLE_TRACE_COUNTER("session-writer-backlog", priv->pendingBytes);
+    g_mutex_unlock(&priv->lock);
+
+    if (congested == priv->congested)
+        return;
+
+    ENTANGLE_DEBUG("Session writer %s", congested ? "congested" : "caught up");
+    priv->congested = congested;
+    g_object_notify(G_OBJECT(writer), "congested");
+}
+
+
+static gboolean entangle_session_writer_complete(gpointer opaque)
+{
+    EntangleSessionWriterJob *job = opaque;
+
+    if (job->error)
+        g_simple_async_result_set_from_error(job->result, job->error);
+    else
+        g_simple_async_result_set_op_res_gboolean(job->result, TRUE);
+
+    entangle_session_writer_update_congested(job->writer);
+    g_simple_async_result_complete(job->result);
+    entangle_session_writer_job_free(job);
+
+    return FALSE;
+}
+
+
+static void entangle_session_writer_done(EntangleSessionWriterJob *job)
+{
+    EntangleSessionWriterPrivate *priv = job->writer->priv;
+
+    g_mutex_lock(&priv->lock);
+    priv->pendingBytes -= g_bytes_get_size(job->data);
+    priv->busy--;
+    g_cond_broadcast(&priv->cond);
+    g_mutex_unlock(&priv->lock);
+
+    g_idle_add(entangle_session_writer_complete, job);
+}
+
+
+/* @fmt is given the filename, then the description of errno */
+static void entangle_session_writer_set_errno(EntangleSessionWriterJob *job,
+                                              const char *fmt)
+{
+    int err = errno;
+
+    if (job->error)
+        return;
+
+    g_set_error(&job->error, ENTANGLE_SESSION_WRITER_ERROR, 0,
+                fmt, job->filename, g_strerror(err));
+}
+
+
+/* Makes the new directory entries durable, not just the data */
+static void entangle_session_writer_sync_dir(const char *filename)
+{
+    gchar *dir = g_path_get_dirname(filename);
+    int fd;
+
+    if ((fd = open(dir, O_RDONLY)) >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    g_free(dir);
+}
+
+
+static void entangle_session_writer_write(EntangleSessionWriterJob *job,
+                                          EntangleSessionWriterDurability durability)
+{
+    gsize len;
+    const guint8 *buf = g_bytes_get_data(job->data, &len);
+    gsize offset = 0;
+    int fd;
+
+    if (g_cancellable_set_error_if_cancelled(job->cancel, &job->error))
+        return;
+
+    ENTANGLE_DEBUG("Writing %s", job->filename);
+    ENTANGLE_TRACE_BEGIN("session-writer-write");
+
+    if ((fd = open(job->filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666)) < 0) {
+        entangle_session_writer_set_errno(job, _("Unable to create %s: %s"));
+        goto cleanup;
+    }
+
+#ifdef HAVE_POSIX_FALLOCATE
+    /* Keeps the file contiguous, failure only costs that */
+    if (len)
+        posix_fallocate(fd, 0, len);
+#endif
+
+    while (offset < len) {
+        gsize want = MIN(len - offset, ENTANGLE_SESSION_WRITER_CHUNK);
+        ssize_t got = pwrite(fd, buf + offset, want, offset);
+
+        if (got < 0) {
+            if (errno == EINTR)
+                continue;
+            entangle_session_writer_set_errno(job, _("Unable to write %s: %s"));
+            goto cleanup;
+        }
+        offset += got;
+    }
+
+    switch (durability) {
+    case ENTANGLE_SESSION_WRITER_DURABILITY_FILE:
+        if (fdatasync(fd) < 0) {
+            entangle_session_writer_set_errno(job, _("Unable to sync %s: %s"));
+            goto cleanup;
+        }
+        entangle_session_writer_sync_dir(job->filename);
+        break;
+
+    case ENTANGLE_SESSION_WRITER_DURABILITY_GROUP:
+        job->fd = fd;
+        fd = -1;
+        break;
+
+    case ENTANGLE_SESSION_WRITER_DURABILITY_NONE:
+    default:
+        break;
+    }
+
+ cleanup:
+    if (fd >= 0 && close(fd) < 0)
+        entangle_session_writer_set_errno(job, _("Unable to close %s: %s"));
+    /* Never leave a truncated file behind in the session */
+    if (job->error && fd >= 0)
+        unlink(job->filename);
+    ENTANGLE_TRACE_END("session-writer-write");
+}
+
+
+/* Syncs a batch of files together, so a burst of shots pays
+ * for one flush of the disk cache rather than one per file */
+static void entangle_session_writer_commit(GQueue *group)
+{
+    GHashTable *dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GHashTableIter iter;
+    gpointer dir;
+    GList *tmp;
+
+    ENTANGLE_DEBUG("Committing %u files", g_queue_get_length(group));
+    ENTANGLE_TRACE_BEGIN("session-writer-commit");
+
+    for (tmp = group->head; tmp; tmp = tmp->next) {
+        EntangleSessionWriterJob *job = tmp->data;
+
+        if (fdatasync(job->fd) < 0)
+            entangle_session_writer_set_errno(job, _("Unable to sync %s: %s"));
+        g_hash_table_add(dirs, g_path_get_dirname(job->filename));
+    }
+
+    g_hash_table_iter_init(&iter, dirs);
+    while (g_hash_table_iter_next(&iter, &dir, NULL)) {
+        int fd;
+        if ((fd = open(dir, O_RDONLY)) >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+    g_hash_table_unref(dirs);
+
+    while (!g_queue_is_empty(group)) {
+        EntangleSessionWriterJob *job = g_queue_pop_head(group);
+
+        if (close(job->fd) < 0)
+            entangle_session_writer_set_errno(job, _("Unable to close %s: %s"));
+        if (job->error)
+            unlink(job->filename);
+        job->fd = -1;
+        entangle_session_writer_done(job);
+    }
+
+    ENTANGLE_TRACE_END("session-writer-commit");
+}
+
+
+static gpointer entangle_session_writer_worker(gpointer opaque)
+{
+    EntangleSessionWriter *writer = opaque;
+    EntangleSessionWriterPrivate *priv = writer->priv;
+    GQueue group = G_QUEUE_INIT;
+    gsize groupBytes = 0;
+
+    for (;;) {
+        EntangleSessionWriterJob *job;
+        EntangleSessionWriterDurability durability;
+        gboolean idle;
+
+        g_mutex_lock(&priv->lock);
+        while (!priv->shutdown && g_queue_is_empty(priv->jobs))
+            g_cond_wait(&priv->cond, &priv->lock);
+        job = g_queue_pop_head(priv->jobs);
+        idle = g_queue_is_empty(priv->jobs);
+        durability = priv->durability;
+        g_mutex_unlock(&priv->lock);
+
+        if (!job)
+            break;
+
+        entangle_session_writer_write(job, durability);
+        if (job->fd >= 0) {
+            g_queue_push_tail(&group, job);
+            groupBytes += g_bytes_get_size(job->data);
+        } else {
+            entangle_session_writer_done(job);
+        }
+
+        /* Commit as soon as there is nothing else to batch up */
+        if (!g_queue_is_empty(&group) &&
+            (idle ||
+             g_queue_get_length(&group) >= ENTANGLE_SESSION_WRITER_GROUP_FILES ||
+             groupBytes >= ENTANGLE_SESSION_WRITER_GROUP_BYTES)) {
+            entangle_session_writer_commit(&group);
+            groupBytes = 0;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * entangle_session_writer_write_async:
+ * @writer: (transfer none): the session writer
+ * @filename: (transfer none): the file to create
+ * @data: (transfer none): the contents of the file
+ * @cancel: (allow-none): a cancellable to abort the write before it starts
+ * @callback: (scope async): the function to call when complete
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Queue the creation of @filename holding @data. The file must
+ * not already exist. @callback is invoked in the main loop once
+ * the file is written and, depending on the durability mode,
+ * flushed to disk. Queuing never blocks, but a large backlog
+ * makes the writer congested.
+ */
+void entangle_session_writer_write_async(EntangleSessionWriter *writer,
+                                         const char *filename,
+                                         GBytes *data,
+                                         GCancellable *cancel,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data)
+{
+    g_return_if_fail(ENTANGLE_IS_SESSION_WRITER(writer));
+    g_return_if_fail(filename != NULL);
+    g_return_if_fail(data != NULL);
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+    EntangleSessionWriterJob *job = g_new0(EntangleSessionWriterJob, 1);
+
+    job->writer = g_object_ref(writer);
+    job->filename = g_strdup(filename);
+    job->data = g_bytes_ref(data);
+    if (cancel)
+        job->cancel = g_object_ref(cancel);
+    job->result = g_simple_async_result_new(G_OBJECT(writer),
+                                            callback,
+                                            user_data,
+                                            entangle_session_writer_write_async);
+    job->fd = -1;
+
+    g_mutex_lock(&priv->lock);
+    if (!priv->thread)
+        priv->thread = g_thread_new("session-writer",
+                                    entangle_session_writer_worker,
+                                    writer);
+    g_queue_push_tail(priv->jobs, job);
+    priv->busy++;
+    priv->pendingBytes += g_bytes_get_size(data);
+    g_cond_broadcast(&priv->cond);
+    g_mutex_unlock(&priv->lock);
+
+    entangle_session_writer_update_congested(writer);
+}
+
+
+/**
+ * entangle_session_writer_write_finish:
+ * @writer: (transfer none): the session writer
+ * @result: (transfer none): the asynchronous result
+ * @error: (allow-none): filled with the error on failure
+ *
+ * Check whether the file was written. A file which could not
+ * be written in full is deleted.
+ *
+ * Returns: TRUE if the file was written, FALSE on error
+ */
+gboolean entangle_session_writer_write_finish(EntangleSessionWriter *writer,
+                                              GAsyncResult *result,
+                                              GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_SESSION_WRITER(writer), FALSE);
+
+    if (g_simple_async_result_propagate_error(G_SIMPLE_ASYNC_RESULT(result),
+                                              error))
+        return FALSE;
+
+    return TRUE;
+}
+
+
+/**
+ * entangle_session_writer_flush:
+ * @writer: (transfer none): the session writer
+ *
+ * Block until every queued file has been written, which must
+ * be done before exiting so that no captures are lost. The
+ * completion callbacks will still run from the main loop, if
+ * it is iterated again.
+ */
+void entangle_session_writer_flush(EntangleSessionWriter *writer)
+{
+    g_return_if_fail(ENTANGLE_IS_SESSION_WRITER(writer));
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+
+    g_mutex_lock(&priv->lock);
+    while (priv->busy)
+        g_cond_wait(&priv->cond, &priv->lock);
+    g_mutex_unlock(&priv->lock);
+}
+
+
+/**
+ * entangle_session_writer_set_durability:
+ * @writer: (transfer none): the session writer
+ * @durability: when to flush files to disk
+ *
+ * Set whether a file must reach the disk before its write is
+ * reported complete. With ENTANGLE_SESSION_WRITER_DURABILITY_FILE
+ * every file is synced on its own, while with
+ * ENTANGLE_SESSION_WRITER_DURABILITY_GROUP files queued together
+ * are synced together once the queue drains.
+ */
+void entangle_session_writer_set_durability(EntangleSessionWriter *writer,
+                                            EntangleSessionWriterDurability durability)
+{
+    g_return_if_fail(ENTANGLE_IS_SESSION_WRITER(writer));
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+
+    g_mutex_lock(&priv->lock);
+    priv->durability = durability;
+    g_mutex_unlock(&priv->lock);
+    g_object_notify(G_OBJECT(writer), "durability");
+}
+
+
+/**
+ * entangle_session_writer_get_durability:
+ * @writer: (transfer none): the session writer
+ *
+ * Get when files are flushed to disk
+ *
+ * Returns: the durability mode
+ */
+EntangleSessionWriterDurability entangle_session_writer_get_durability(EntangleSessionWriter *writer)
+{
+    g_return_val_if_fail(ENTANGLE_IS_SESSION_WRITER(writer),
+                         ENTANGLE_SESSION_WRITER_DURABILITY_NONE);
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+    EntangleSessionWriterDurability durability;
+
+    g_mutex_lock(&priv->lock);
+    durability = priv->durability;
+    g_mutex_unlock(&priv->lock);
+
+    return durability;
+}
+
+
+/**
+ * entangle_session_writer_set_max_backlog:
+ * @writer: (transfer none): the session writer
+ * @bytes: the size of the backlog
+ *
+ * Set how many bytes may be waiting to be written before
+ * the writer reports itself congested. It is no longer
+ * congested once the backlog falls to half of @bytes.
+ */
+void entangle_session_writer_set_max_backlog(EntangleSessionWriter *writer,
+                                             guint64 bytes)
+{
+    g_return_if_fail(ENTANGLE_IS_SESSION_WRITER(writer));
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+
+    g_mutex_lock(&priv->lock);
+    priv->maxBacklog = bytes;
+    g_mutex_unlock(&priv->lock);
+    g_object_notify(G_OBJECT(writer), "max-backlog");
+
+    entangle_session_writer_update_congested(writer);
+}
+
+
+/**
+ * entangle_session_writer_get_max_backlog:
+ * @writer: (transfer none): the session writer
+ *
+ * Get how many bytes may be waiting to be written before
+ * the writer reports itself congested
+ *
+ * Returns: the size of the backlog
+ */
+guint64 entangle_session_writer_get_max_backlog(EntangleSessionWriter *writer)
+{
+    g_return_val_if_fail(ENTANGLE_IS_SESSION_WRITER(writer), 0);
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+    guint64 bytes;
+
+    g_mutex_lock(&priv->lock);
+    bytes = priv->maxBacklog;
+    g_mutex_unlock(&priv->lock);
+
+    return bytes;
+}
+
+
+/**
+ * entangle_session_writer_get_congested:
+ * @writer: (transfer none): the session writer
+ *
+ * Determine if the backlog of writes has grown too large,
+ * in which case no more data should be queued if it can
+ * be avoided. A notification is emitted from the main loop
+ * when this changes.
+ *
+ * Returns: TRUE if the writer is congested
+ */
+gboolean entangle_session_writer_get_congested(EntangleSessionWriter *writer)
+{
+    g_return_val_if_fail(ENTANGLE_IS_SESSION_WRITER(writer), FALSE);
+
+    EntangleSessionWriterPrivate *priv = writer->priv;
+
+    return priv->congested;
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,98 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_SESSION_WRITER_H__
+#define __ENTANGLE_SESSION_WRITER_H__
+
+#include <gio/gio.h>
+
+#include "entangle-session-writer-enums.h"
+
+G_BEGIN_DECLS
+
+#define ENTANGLE_TYPE_SESSION_WRITER            (entangle_session_writer_get_type ())
+#define ENTANGLE_SESSION_WRITER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), ENTANGLE_TYPE_SESSION_WRITER, EntangleSessionWriter))
+#define ENTANGLE_SESSION_WRITER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), ENTANGLE_TYPE_SESSION_WRITER, EntangleSessionWriterClass))
+#define ENTANGLE_IS_SESSION_WRITER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ENTANGLE_TYPE_SESSION_WRITER))
+#define ENTANGLE_IS_SESSION_WRITER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ENTANGLE_TYPE_SESSION_WRITER))
+#define ENTANGLE_SESSION_WRITER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), ENTANGLE_TYPE_SESSION_WRITER, EntangleSessionWriterClass))
+
+
+typedef struct _EntangleSessionWriter EntangleSessionWriter;
+typedef struct _EntangleSessionWriterPrivate EntangleSessionWriterPrivate;
+typedef struct _EntangleSessionWriterClass EntangleSessionWriterClass;
+
+typedef enum {
+    ENTANGLE_SESSION_WRITER_DURABILITY_NONE,
+    ENTANGLE_SESSION_WRITER_DURABILITY_FILE,
+    ENTANGLE_SESSION_WRITER_DURABILITY_GROUP,
+} EntangleSessionWriterDurability;
+
+struct _EntangleSessionWriter
+{
+    GObject parent;
+
+    EntangleSessionWriterPrivate *priv;
+};
+
+struct _EntangleSessionWriterClass
+{
+    GObjectClass parent_class;
+};
+
+
+GType entangle_session_writer_get_type(void) G_GNUC_CONST;
+
+EntangleSessionWriter *entangle_session_writer_get_default(void);
+
+void entangle_session_writer_write_async(EntangleSessionWriter *writer,
+                                         const char *filename,
+                                         GBytes *data,
+                                         GCancellable *cancel,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data);
+gboolean entangle_session_writer_write_finish(EntangleSessionWriter *writer,
+                                              GAsyncResult *result,
+                                              GError **error);
+
+void entangle_session_writer_flush(EntangleSessionWriter *writer);
+
+void entangle_session_writer_set_durability(EntangleSessionWriter *writer,
+                                            EntangleSessionWriterDurability durability);
+EntangleSessionWriterDurability entangle_session_writer_get_durability(EntangleSessionWriter *writer);
+
+void entangle_session_writer_set_max_backlog(EntangleSessionWriter *writer,
+                                             guint64 bytes);
+guint64 entangle_session_writer_get_max_backlog(EntangleSessionWriter *writer);
+
+gboolean entangle_session_writer_get_congested(EntangleSessionWriter *writer);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_SESSION_WRITER_H__ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
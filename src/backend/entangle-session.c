@@ -21,6 +21,7 @@
 #include <config.h>
 
 #include <glib.h>
+#include <glib/gi18n.h>
 #include <gio/gio.h>
 #include <stdio.h>
 #include <string.h>
@@ -32,6 +33,12 @@
 #include "entangle-session.h"
 #include "entangle-image.h"
 
+/* Files enumerated, and then stat'd, between each emission */
+#define ENTANGLE_SESSION_LOAD_BATCH 256
+
+/* Enough to keep a slow or network disk busy */
+#define ENTANGLE_SESSION_STAT_THREADS 8
+
 #define ENTANGLE_SESSION_GET_PRIVATE(obj)                                   \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_SESSION, EntangleSessionPrivate))
 
@@ -44,7 +51,11 @@ struct _EntangleSessionPrivate {
     char *lastFilePrefixSrc;
     char *lastFilePrefixDst;
 
-    GList *images;
+    /* Sorted by filename, which puts the oldest capture
+     * first, the reverse of the public index */
+    GPtrArray *images;
+
+    gboolean loading;
 };
 
 G_DEFINE_TYPE(EntangleSession, entangle_session, G_TYPE_OBJECT);
@@ -53,6 +64,7 @@ enum {
     PROP_0,
     PROP_DIRECTORY,
     PROP_FILENAME_PATTERN,
+    PROP_LOADING,
 };
 
 static void entangle_session_get_property(GObject *object,
@@ -72,6 +84,10 @@ static void entangle_session_get_property(GObject *object,
         g_value_set_string(value, priv->filenamePattern);
         break;
 
+    case PROP_LOADING:
+        g_value_set_boolean(value, priv->loading);
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -104,14 +120,6 @@ static void entangle_session_set_property(GObject *object,
 }
 
 
-static void do_image_unref(gpointer object,
-                           gpointer opaque G_GNUC_UNUSED)
-{
-    EntangleImage *image = object;
-
-    g_object_unref(image);
-}
-
 static void entangle_session_finalize(GObject *object)
 {
     EntangleSession *session = ENTANGLE_SESSION(object);
@@ -119,10 +127,7 @@ static void entangle_session_finalize(GObject *object)
 
     ENTANGLE_DEBUG("Finalize session %p", object);
 
-    if (priv->images) {
-        g_list_foreach(priv->images, do_image_unref, NULL);
-        g_list_free(priv->images);
-    }
+    g_ptr_array_unref(priv->images);
 
     g_free(priv->lastFilePrefixSrc);
     g_free(priv->lastFilePrefixDst);
@@ -151,6 +156,16 @@ static void entangle_session_class_init(EntangleSessionClass *klass)
                  1,
                  ENTANGLE_TYPE_IMAGE);
 
+    g_signal_new("session-images-added",
+                 G_TYPE_FROM_CLASS(klass),
+                 G_SIGNAL_RUN_FIRST,
+                 G_STRUCT_OFFSET(EntangleSessionClass, session_images_added),
+                 NULL, NULL,
+                 g_cclosure_marshal_VOID__BOXED,
+                 G_TYPE_NONE,
+                 1,
+                 G_TYPE_PTR_ARRAY);
+
     g_signal_new("session-image-removed",
                  G_TYPE_FROM_CLASS(klass),
                  G_SIGNAL_RUN_FIRST,
@@ -185,6 +200,17 @@ static void entangle_session_class_init(EntangleSessionClass *klass)
                                                         G_PARAM_STATIC_NICK |
                                                         G_PARAM_STATIC_BLURB));
 
+    g_object_class_install_property(object_class,
+                                    PROP_LOADING,
+                                    g_param_spec_boolean("loading",
+                                                         "Loading",
+                                                         "Whether files are still being loaded",
+                                                         FALSE,
+                                                         G_PARAM_READABLE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
     g_type_class_add_private(klass, sizeof(EntangleSessionPrivate));
 }
 
@@ -217,6 +243,7 @@ static void entangle_session_init(EntangleSession *session)
     priv = session->priv = ENTANGLE_SESSION_GET_PRIVATE(session);
 
     priv->recalculateDigit = TRUE;
+    priv->images = g_ptr_array_new_with_free_func(g_object_unref);
 }
 
 
@@ -238,6 +265,38 @@ const char *entangle_session_directory(EntangleSession *session)
 }
 
 
+/**
+ * entangle_session_is_loading:
+ * @session: (transfer none): the session instance
+ *
+ * Determine whether the files in the session directory are
+ * still being loaded, so more batches of images are to come
+ *
+ * Returns: TRUE if a load is in progress
+ */
+gboolean entangle_session_is_loading(EntangleSession *session)
+{
+    g_return_val_if_fail(ENTANGLE_IS_SESSION(session), FALSE);
+
+    EntangleSessionPrivate *priv = session->priv;
+
+    return priv->loading;
+}
+
+
+static void entangle_session_set_loading(EntangleSession *session,
+                                         gboolean loading)
+{
+    EntangleSessionPrivate *priv = session->priv;
+
+    if (priv->loading == loading)
+        return;
+
+    priv->loading = loading;
+    g_object_notify(G_OBJECT(session), "loading");
+}
+
+
 /**
  * entangle_session_filename_pattern:
  * @session: (transfer none): the session instance
@@ -260,7 +319,6 @@ static gint entangle_session_next_digit(EntangleSession *session)
 {
     EntangleSessionPrivate *priv = session->priv;
     gint maxDigit = -1;
-    GList *images = priv->images;
     const gchar *template = strchr(priv->filenamePattern, 'X');
     gchar *prefix = g_strndup(priv->filenamePattern, (template - priv->filenamePattern));
     gint prefixlen = strlen(prefix);
@@ -279,8 +337,8 @@ static gint entangle_session_next_digit(EntangleSession *session)
     ENTANGLE_DEBUG("Template '%s' with prefixlen %d, %zu digits and postfix %zu",
                    priv->filenamePattern, prefixlen, templatelen, postfixlen);
 
-    while (images) {
-        EntangleImage *image = images->data;
+    for (guint i = 0; i < priv->images->len; i++) {
+        EntangleImage *image = g_ptr_array_index(priv->images, i);
         const gchar *name = entangle_image_get_filename(image);
         gsize used = 0;
         gint digit = 0;
@@ -288,7 +346,7 @@ static gint entangle_session_next_digit(EntangleSession *session)
         if (!g_str_has_prefix(name, priv->directory)) {
             ENTANGLE_DEBUG("File %s does not match directory",
                            entangle_image_get_filename(image));
-            goto next;
+            continue;
         }
         name += strlen(priv->directory);
         while (*name == '/')
@@ -298,7 +356,7 @@ static gint entangle_session_next_digit(EntangleSession *session)
         if (!g_str_has_prefix(name, prefix)) {
             ENTANGLE_DEBUG("File %s does not match prefix",
                            entangle_image_get_filename(image));
-            goto next;
+            continue;
         }
 
         name += prefixlen;
@@ -315,13 +373,13 @@ static gint entangle_session_next_digit(EntangleSession *session)
         if (used < templatelen) {
             ENTANGLE_DEBUG("File %s has too few digits",
                            entangle_image_get_filename(image));
-            goto next;
+            continue;
         }
 
         if (!g_str_has_prefix(name, postfix)) {
             ENTANGLE_DEBUG("File %s does not match postfix",
                            entangle_image_get_filename(image));
-            goto next;
+            continue;
         }
 
         name += postfixlen;
@@ -330,16 +388,13 @@ static gint entangle_session_next_digit(EntangleSession *session)
         if (*name != '.') {
             ENTANGLE_DEBUG("File %s has trailing data",
                            entangle_image_get_filename(image));
-            goto next;
+            continue;
         }
 
         if (digit > maxDigit)
             maxDigit = digit;
         ENTANGLE_DEBUG("File %s matches maxDigit is %d",
                        entangle_image_get_filename(image), maxDigit);
-
-    next:
-        images = images->next;
     }
 
     g_free(prefix);
@@ -463,12 +518,57 @@ char *entangle_session_next_filename(EntangleSession *session,
 }
 
 
+/*
+ * Find where @filename is, or would be, in the sorted
+ * image list, returning whether it is already there
+ */
+static gboolean entangle_session_find(EntangleSessionPrivate *priv,
+                                      const char *filename,
+                                      guint *pos)
+{
+    guint lo = 0, hi = priv->images->len;
+
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        EntangleImage *image = g_ptr_array_index(priv->images, mid);
+        int cmp = g_strcmp0(entangle_image_get_filename(image), filename);
+
+        if (cmp == 0) {
+            *pos = mid;
+            return TRUE;
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *pos = lo;
+    return FALSE;
+}
+
+
+static void entangle_session_insert(EntangleSessionPrivate *priv,
+                                    guint pos,
+                                    EntangleImage *image)
+{
+    GPtrArray *images = priv->images;
+
+    g_ptr_array_add(images, NULL);
+    memmove(images->pdata + pos + 1, images->pdata + pos,
+            (images->len - 1 - pos) * sizeof(gpointer));
+    images->pdata[pos] = g_object_ref(image);
+}
+
+
 /**
  * entangle_session_add:
  * @session: (transfer none): the session instance
  * @image: (transfer none): the image to add to the session
  *
- * Add @image to the @session
+ * Add @image to the @session. If a load in progress has
+ * already found the same file, that copy is replaced, since
+ * @image is the one the caller will go on to use.
  */
 void entangle_session_add(EntangleSession *session, EntangleImage *image)
 {
@@ -476,9 +576,21 @@ void entangle_session_add(EntangleSession *session, EntangleImage *image)
     g_return_if_fail(ENTANGLE_IS_IMAGE(image));
 
     EntangleSessionPrivate *priv = session->priv;
+    guint pos;
 
-    g_object_ref(image);
-    priv->images = g_list_prepend(priv->images, image);
+    if (entangle_session_find(priv, entangle_image_get_filename(image), &pos)) {
+        EntangleImage *old = g_ptr_array_index(priv->images, pos);
+
+        if (old == image)
+            return;
+
+        g_object_ref(old);
+        g_ptr_array_remove_index(priv->images, pos);
+        g_signal_emit_by_name(session, "session-image-removed", old);
+        g_object_unref(old);
+    }
+
+    entangle_session_insert(priv, pos, image);
 
     g_signal_emit_by_name(session, "session-image-added", image);
 }
@@ -497,12 +609,12 @@ void entangle_session_remove(EntangleSession *session, EntangleImage *image)
     g_return_if_fail(ENTANGLE_IS_IMAGE(image));
 
     EntangleSessionPrivate *priv = session->priv;
-    GList *tmp = g_list_find(priv->images, image);
 
-    if (!tmp)
+    g_object_ref(image);
+    if (!g_ptr_array_remove(priv->images, image)) {
+        g_object_unref(image);
         return;
-
-    priv->images = g_list_delete_link(priv->images, tmp);
+    }
 
     g_signal_emit_by_name(session, "session-image-removed", image);
     g_object_unref(image);
@@ -538,12 +650,182 @@ static gboolean entangle_session_image_supported(const gchar *name)
 }
 
 
+/*
+ * Files already in the session, such as captures added
+ * while the load was running, are dropped from the batch
+ */
+static void entangle_session_add_images(EntangleSession *session,
+                                        GPtrArray *images)
+{
+    EntangleSessionPrivate *priv = session->priv;
+    GPtrArray *added = g_ptr_array_new_with_free_func(g_object_unref);
+
+    for (guint i = 0; i < images->len; i++) {
+        EntangleImage *image = g_ptr_array_index(images, i);
+        guint pos;
+
+        if (entangle_session_find(priv, entangle_image_get_filename(image), &pos)) {
+            ENTANGLE_DEBUG("Skipping '%s' already in session",
+                           entangle_image_get_filename(image));
+            continue;
+        }
+
+        entangle_session_insert(priv, pos, image);
+        g_ptr_array_add(added, g_object_ref(image));
+    }
+    priv->recalculateDigit = TRUE;
+
+    if (added->len)
+        g_signal_emit_by_name(session, "session-images-added", added);
+    g_ptr_array_unref(added);
+}
+
+
+typedef void (*EntangleSessionScanFunc)(GPtrArray *images,
+                                        gpointer opaque);
+
+typedef struct {
+    GMutex lock;
+    GCond cond;
+    guint pending;
+} EntangleSessionStatBatch;
+
+
+static void entangle_session_stat_image(gpointer opaque,
+                                        gpointer userdata)
+{
+    EntangleImage *image = opaque;
+    EntangleSessionStatBatch *batch = userdata;
+
+    /* Caches the result, so the browser doesn't stat
+     * every file again from the main loop */
+    entangle_image_get_last_modified(image);
+
+    g_mutex_lock(&batch->lock);
+    if (--batch->pending == 0)
+        g_cond_signal(&batch->cond);
+    g_mutex_unlock(&batch->lock);
+}
+
+
+/*
+ * Only the name & type are asked of the enumerator, which it
+ * can answer from readdir alone. The files it returns are then
+ * stat'd by a pool of threads, so a slow disk has many requests
+ * in flight, and passed to @func in batches.
+ */
+static gboolean entangle_session_scan(const char *directory,
+                                      GCancellable *cancel,
+                                      EntangleSessionScanFunc func,
+                                      gpointer opaque,
+                                      GError **error)
+{
+    GFile *dir = g_file_new_for_path(directory);
+    GFileEnumerator *children;
+    EntangleSessionStatBatch batch;
+    GThreadPool *pool = NULL;
+    GList *infos;
+    GError *err = NULL;
+    gboolean ret = FALSE;
+
+    g_mutex_init(&batch.lock);
+    g_cond_init(&batch.cond);
+    batch.pending = 0;
+
+    if (!(children = g_file_enumerate_children(dir,
+                                               G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                               G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                               G_FILE_QUERY_INFO_NONE,
+                                               cancel,
+                                               error)))
+        goto cleanup;
+
+    if (!(pool = g_thread_pool_new(entangle_session_stat_image,
+                                   &batch,
+                                   ENTANGLE_SESSION_STAT_THREADS,
+                                   FALSE,
+                                   error)))
+        goto cleanup;
+
+    while ((infos = g_file_enumerator_next_files(children,
+                                                 ENTANGLE_SESSION_LOAD_BATCH,
+                                                 cancel,
+                                                 &err)) != NULL) {
+        GPtrArray *images = g_ptr_array_new_with_free_func(g_object_unref);
+        GList *tmp;
+
+        for (tmp = infos; tmp; tmp = tmp->next) {
+            GFileInfo *info = tmp->data;
+            const gchar *name = g_file_info_get_name(info);
+            GFileType type = g_file_info_get_file_type(info);
+
+            if ((type == G_FILE_TYPE_REGULAR ||
+                 type == G_FILE_TYPE_SYMBOLIC_LINK) &&
+                entangle_session_image_supported(name)) {
+                gchar *path = g_build_filename(directory, name, NULL);
+
+                ENTANGLE_DEBUG("Adding '%s'", path);
+                g_ptr_array_add(images, entangle_image_new_file(path));
+                g_free(path);
+            }
+        }
+        g_list_free_full(infos, g_object_unref);
+
+        g_mutex_lock(&batch.lock);
+        batch.pending = images->len;
+        g_mutex_unlock(&batch.lock);
+        for (guint i = 0; i < images->len; i++)
+            g_thread_pool_push(pool, g_ptr_array_index(images, i), NULL);
+
+        g_mutex_lock(&batch.lock);
+        while (batch.pending)
+            g_cond_wait(&batch.cond, &batch.lock);
+        g_mutex_unlock(&batch.lock);
+
+        if (images->len)
+            func(images, opaque);
+        g_ptr_array_unref(images);
+
+        if (g_cancellable_set_error_if_cancelled(cancel, error))
+            goto cleanup;
+    }
+
+    if (err) {
+        g_propagate_error(error, err);
+        goto cleanup;
+    }
+
+    ret = TRUE;
+
+ cleanup:
+    if (pool)
+        g_thread_pool_free(pool, FALSE, TRUE);
+    if (children)
+        g_object_unref(children);
+    g_object_unref(dir);
+    g_cond_clear(&batch.cond);
+    g_mutex_clear(&batch.lock);
+    return ret;
+}
+
+
+static void entangle_session_load_batch(GPtrArray *images,
+                                        gpointer opaque)
+{
+    EntangleSession *session = opaque;
+
+    entangle_session_add_images(session, images);
+}
+
+
 /**
  * entangle_session_load:
  * @session: (transfer none): the session instance
  *
  * Load all the files present in the directory associated
- * with the session
+ * with the session, blocking until they are all found. This
+ * emits #EntangleSession::session-images-added for each batch
+ * of files.
  *
  * Returns: TRUE if the session was loaded
  */
@@ -552,35 +834,194 @@ gboolean entangle_session_load(EntangleSession *session)
     g_return_val_if_fail(ENTANGLE_IS_SESSION(session), FALSE);
 
     EntangleSessionPrivate *priv = session->priv;
-    GFile *dir = g_file_new_for_path(priv->directory);
-    GFileEnumerator *children = g_file_enumerate_children(dir,
-                                                          "standard::name,standard::type",
-                                                          G_FILE_QUERY_INFO_NONE,
-                                                          NULL,
-                                                          NULL);
-    GFileInfo *childinfo;
-    while ((childinfo = g_file_enumerator_next_file(children, NULL, NULL)) != NULL) {
-        const gchar *thisname = g_file_info_get_name(childinfo);
-        GFile *child = g_file_get_child(dir, thisname);
-        if (g_file_info_get_file_type(childinfo) == G_FILE_TYPE_REGULAR ||
-            g_file_info_get_file_type(childinfo) == G_FILE_TYPE_SYMBOLIC_LINK) {
-
-            if (entangle_session_image_supported(thisname)) {
-                EntangleImage *image = entangle_image_new_file(g_file_get_path(child));
-
-                ENTANGLE_DEBUG("Adding '%s'", g_file_get_path(child));
-                entangle_session_add(session, image);
-
-                g_object_unref(image);
-            }
-        }
-        g_object_unref(child);
-        g_object_unref(childinfo);
+    GError *error = NULL;
+    gboolean ret = TRUE;
+
+    entangle_session_set_loading(session, TRUE);
+    if (!entangle_session_scan(priv->directory, NULL,
+                               entangle_session_load_batch, session,
+                               &error)) {
+        ENTANGLE_DEBUG("Unable to load session %s: %s",
+                       priv->directory, error->message);
+        g_error_free(error);
+        ret = FALSE;
     }
+    entangle_session_set_loading(session, FALSE);
 
-    g_object_unref(children);
+    return ret;
+}
 
-    priv->recalculateDigit = TRUE;
+
+/*
+ * The state of an asynchronous load, which is also copied
+ * for each batch of images handed back to the main loop
+ */
+typedef struct {
+    EntangleSession *session;
+    EntangleProgress *progress;
+    GCancellable *cancel;
+    guint loaded;
+
+    /* Only set on a batch, NULL once the directory has been read */
+    GPtrArray *images;
+} EntangleSessionLoadData;
+
+
+static void entangle_session_load_data_free(EntangleSessionLoadData *data)
+{
+    g_object_unref(data->session);
+    if (data->progress)
+        g_object_unref(data->progress);
+    if (data->cancel)
+        g_object_unref(data->cancel);
+    if (data->images)
+        g_ptr_array_unref(data->images);
+    g_free(data);
+}
+
+
+static gboolean entangle_session_load_emit(gpointer opaque)
+{
+    EntangleSessionLoadData *batch = opaque;
+    gboolean cancelled = g_cancellable_is_cancelled(batch->cancel);
+
+    /* Don't add files once the caller has moved on */
+    if (batch->images && !cancelled) {
+        entangle_session_add_images(batch->session, batch->images);
+        if (batch->progress)
+            entangle_progress_update(batch->progress, batch->loaded);
+    }
+
+    /* Nor stop the progress, which may be reporting on
+     * whatever the caller moved on to by now */
+    if (!batch->images) {
+        if (batch->progress && !cancelled)
+            entangle_progress_stop(batch->progress);
+        entangle_session_set_loading(batch->session, FALSE);
+    }
+
+    entangle_session_load_data_free(batch);
+
+    return FALSE;
+}
+
+
+/* Batches are queued at the same priority as the completion
+ * of the load, so they are all emitted before it */
+static void entangle_session_load_queue(GPtrArray *images,
+                                        gpointer opaque)
+{
+    EntangleSessionLoadData *data = opaque;
+    EntangleSessionLoadData *batch = g_new0(EntangleSessionLoadData, 1);
+
+    if (images)
+        data->loaded += images->len;
+
+    batch->session = g_object_ref(data->session);
+    if (data->progress)
+        batch->progress = g_object_ref(data->progress);
+    if (data->cancel)
+        batch->cancel = g_object_ref(data->cancel);
+    batch->loaded = data->loaded;
+    if (images)
+        batch->images = g_ptr_array_ref(images);
+
+    g_idle_add_full(G_PRIORITY_DEFAULT, entangle_session_load_emit, batch, NULL);
+}
+
+
+static void entangle_session_load_helper(GSimpleAsyncResult *result,
+                                         GObject *object,
+                                         GCancellable *cancel G_GNUC_UNUSED)
+{
+    EntangleSession *session = ENTANGLE_SESSION(object);
+    EntangleSessionPrivate *priv = session->priv;
+    EntangleSessionLoadData *data = g_simple_async_result_get_op_res_gpointer(result);
+    GError *error = NULL;
+
+    if (!entangle_session_scan(priv->directory, data->cancel,
+                               entangle_session_load_queue, data,
+                               &error)) {
+        g_simple_async_result_set_from_error(result, error);
+        g_error_free(error);
+    }
+
+    entangle_session_load_queue(NULL, data);
+}
+
+
+/**
+ * entangle_session_load_async:
+ * @session: (transfer none): the session instance
+ * @progress: (allow-none)(transfer none): reporter for the number of files found
+ * @cancel: (allow-none): a cancellable to stop the load
+ * @callback: (scope async): the function to call when complete
+ * @user_data: (closure): data to pass to @callback
+ *
+ * Load all the files present in the directory associated
+ * with the session, from a background thread. The files
+ * are added to the session in batches, emitting
+ * #EntangleSession::session-images-added for each, rather
+ * than #EntangleSession::session-image-added per file. Once
+ * @cancel is triggered no further files are added. Only one
+ * load may be in progress for a session, and the
+ * #EntangleSession:loading property is TRUE until the last
+ * batch has been added.
+ */
+void entangle_session_load_async(EntangleSession *session,
+                                 EntangleProgress *progress,
+                                 GCancellable *cancel,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+    g_return_if_fail(ENTANGLE_IS_SESSION(session));
+    g_return_if_fail(!progress || ENTANGLE_IS_PROGRESS(progress));
+
+    GSimpleAsyncResult *result = g_simple_async_result_new(G_OBJECT(session),
+                                                           callback,
+                                                           user_data,
+                                                           entangle_session_load_async);
+    EntangleSessionLoadData *data = g_new0(EntangleSessionLoadData, 1);
+
+    data->session = g_object_ref(session);
+    if (cancel)
+        data->cancel = g_object_ref(cancel);
+    if (progress) {
+        data->progress = g_object_ref(progress);
+        entangle_progress_start(progress, 0, _("Loading session"));
+    }
+    entangle_session_set_loading(session, TRUE);
+    g_simple_async_result_set_op_res_gpointer(result, data,
+                                              (GDestroyNotify)entangle_session_load_data_free);
+
+    g_simple_async_result_run_in_thread(result,
+                                        entangle_session_load_helper,
+                                        G_PRIORITY_DEFAULT,
+                                        cancel);
+
+    g_object_unref(result);
+}
+
+
+/**
+ * entangle_session_load_finish:
+ * @session: (transfer none): the session instance
+ * @result: (transfer none): the asynchronous result
+ * @error: (allow-none): filled with the error on failure
+ *
+ * Check whether the session directory was read in full
+ *
+ * Returns: TRUE if the session was loaded, FALSE on error or if cancelled
+ */
+gboolean entangle_session_load_finish(EntangleSession *session,
+                                      GAsyncResult *result,
+                                      GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_SESSION(session), FALSE);
+
+    if (g_simple_async_result_propagate_error(G_SIMPLE_ASYNC_RESULT(result),
+                                              error))
+        return FALSE;
 
     return TRUE;
 }
@@ -600,7 +1041,7 @@ int entangle_session_image_count(EntangleSession *session)
 
     EntangleSessionPrivate *priv = session->priv;
 
-    return g_list_length(priv->images);
+    return priv->images->len;
 }
 
 
@@ -619,7 +1060,11 @@ EntangleImage *entangle_session_image_get(EntangleSession *session, int idx)
 
     EntangleSessionPrivate *priv = session->priv;
 
-    return g_list_nth_data(priv->images, idx);
+    /* Newest image first */
+    if (idx < 0 || idx >= (int)priv->images->len)
+        return NULL;
+
+    return g_ptr_array_index(priv->images, priv->images->len - 1 - idx);
 }
 
 /*
@@ -22,9 +22,11 @@
 #define __ENTANGLE_SESSION_H__
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "entangle-image.h"
 #include "entangle-camera-file.h"
+#include "entangle-progress.h"
 
 G_BEGIN_DECLS
 
@@ -52,6 +54,7 @@ struct _EntangleSessionClass
     GObjectClass parent_class;
 
     void (*session_image_added)(EntangleSession *session, EntangleImage *image);
+    void (*session_images_added)(EntangleSession *session, GPtrArray *images);
     void (*session_image_removed)(EntangleSession *session, EntangleImage *image);
 };
 
@@ -68,6 +71,15 @@ char *entangle_session_next_filename(EntangleSession *session,
                                      EntangleCameraFile *file);
 
 gboolean entangle_session_load(EntangleSession *session);
+gboolean entangle_session_is_loading(EntangleSession *session);
+void entangle_session_load_async(EntangleSession *session,
+                                 EntangleProgress *progress,
+                                 GCancellable *cancel,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data);
+gboolean entangle_session_load_finish(EntangleSession *session,
+                                      GAsyncResult *result,
+                                      GError **error);
 
 void entangle_session_add(EntangleSession *session, EntangleImage *image);
 void entangle_session_remove(EntangleSession *session, EntangleImage *image);
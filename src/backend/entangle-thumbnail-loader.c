@@ -31,15 +31,55 @@
 #include "entangle-debug.h"
 #include "entangle-pixbuf.h"
 #include "entangle-thumbnail-loader.h"
+#include "entangle-thumbnail-store.h"
 #include "entangle-colour-profile.h"
+#include "entangle-metrics.h"
+#include "entangle-tracer.h"
 
 #define ENTANGLE_THUMBNAIL_LOADER_GET_PRIVATE(obj)                      \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_THUMBNAIL_LOADER, EntangleThumbnailLoaderPrivate))
 
+/* Bytes of finished thumbnails kept in memory */
+#define ENTANGLE_THUMBNAIL_LOADER_COMPOSITE_MAX (32 * 1024 * 1024)
+
+typedef struct _EntangleThumbnailLoaderTier EntangleThumbnailLoaderTier;
+typedef struct _EntangleThumbnailLoaderComposite EntangleThumbnailLoaderComposite;
+
+/* The freedesktop.org thumbnail sizes, smallest first */
+struct _EntangleThumbnailLoaderTier {
+    const char *name;
+    int size;
+};
+
+static const EntangleThumbnailLoaderTier entangle_thumbnail_loader_tiers[] = {
+    { "normal", 128 },
+    { "large", 256 },
+};
+
+/* A thumbnail letterboxed to the display size, ready to draw */
+struct _EntangleThumbnailLoaderComposite {
+    char *filename;
+    time_t mtime;
+    off_t size;
+    int width;
+    int height;
+    GdkPixbuf *pixbuf;
+    gsize bytes;
+};
 
 struct _EntangleThumbnailLoaderPrivate {
     guint width;
     guint height;
+    int scale;
+
+    GMutex lock;
+    EntangleThumbnailStore *store;
+
+    /* Protected by lock, most recently used at the head */
+    GHashTable *composites;
+    GQueue *compositeQueue;
+    gsize compositeBytes;
+    EntangleMetricsMemory *compositeMemory;
 };
 
 G_DEFINE_TYPE(EntangleThumbnailLoader, entangle_thumbnail_loader, ENTANGLE_TYPE_PIXBUF_LOADER);
@@ -48,6 +88,8 @@ enum {
     PROP_0,
     PROP_WIDTH,
     PROP_HEIGHT,
+    PROP_STORE,
+    PROP_SCALE,
 };
 
 
@@ -69,6 +111,14 @@ static void entangle_thumbnail_loader_get_property(GObject *object,
             g_value_set_int(value, priv->height);
             break;
 
+        case PROP_STORE:
+            g_value_take_object(value, entangle_thumbnail_loader_get_store(loader));
+            break;
+
+        case PROP_SCALE:
+            g_value_set_int(value, entangle_thumbnail_loader_get_scale(loader));
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         }
@@ -92,12 +142,45 @@ static void entangle_thumbnail_loader_set_property(GObject *object,
             priv->height = g_value_get_int(value);
             break;
 
+        case PROP_STORE:
+            entangle_thumbnail_loader_set_store(loader, g_value_get_object(value));
+            break;
+
+        case PROP_SCALE:
+            entangle_thumbnail_loader_set_scale(loader, g_value_get_int(value));
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         }
 }
 
 
+static void entangle_thumbnail_loader_composite_free(EntangleThumbnailLoaderComposite *composite)
+{
+    g_object_unref(composite->pixbuf);
+    g_free(composite->filename);
+    g_free(composite);
+}
+
+
+static void entangle_thumbnail_loader_finalize(GObject *object)
+{
+    EntangleThumbnailLoader *loader = ENTANGLE_THUMBNAIL_LOADER(object);
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+
+    if (priv->store)
+        g_object_unref(priv->store);
+    g_queue_free_full(priv->compositeQueue,
+                      (GDestroyNotify)entangle_thumbnail_loader_composite_free);
+    g_hash_table_unref(priv->composites);
+    entangle_metrics_memory_free(priv->compositeMemory, priv->compositeBytes);
+    g_mutex_clear(&priv->lock);
+
+    G_OBJECT_CLASS(entangle_thumbnail_loader_parent_class)->finalize(object);
+}
+
+
 static char *entangle_thumbnail_loader_path_to_uri(const char *filename)
 {
     char *path = g_uri_escape_string(filename,
@@ -115,38 +198,116 @@ static char *entangle_thumbnail_loader_uri_to_md5(const char *uri)
                                        strlen(uri));
 }
 
-static char *entangle_thumbnail_loader_uri_to_thumb(const char *uri)
+static char *entangle_thumbnail_loader_uri_to_thumb(const char *uri,
+                                                    const EntangleThumbnailLoaderTier *tier)
 {
     char *md5 = entangle_thumbnail_loader_uri_to_md5(uri);
     char *thumb;
 
-    thumb = g_strdup_printf("%s/thumbnails/normal/%s.png",
-                            g_get_user_cache_dir(), md5);
+    thumb = g_strdup_printf("%s/thumbnails/%s/%s.png",
+                            g_get_user_cache_dir(), tier->name, md5);
     g_free(md5);
 
     return thumb;
 }
 
 
-static void entangle_thumbnail_ensure_thumbnail_dir(void)
+static void entangle_thumbnail_ensure_thumbnail_dir(const EntangleThumbnailLoaderTier *tier)
 {
     char *dir;
 
-    dir = g_strdup_printf("%s/thumbnails/normal/",
-                          g_get_user_cache_dir());
+    dir = g_strdup_printf("%s/thumbnails/%s/",
+                          g_get_user_cache_dir(), tier->name);
 
     g_mkdir_with_parents(dir, 0700);
 
     g_free(dir);
 }
 
+static guint32 entangle_thumbnail_loader_read_uint32(const guchar *buf)
+{
+    return ((guint32)buf[0] << 24) | ((guint32)buf[1] << 16) |
+        ((guint32)buf[2] << 8) | (guint32)buf[3];
+}
+
+
+/*
+ * Checks the Thumb::URI and Thumb::MTime text chunks, which
+ * precede the image data, so that a stale thumbnail can be
+ * rejected without decoding it
+ */
+static gboolean entangle_thumbnail_loader_check_png(const char *thumbname,
+                                                    const char *uri,
+                                                    time_t mtime)
+{
+    static const guchar signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    guchar buf[8];
+    gboolean gotURI = FALSE, gotMTime = FALSE;
+    gboolean valid = TRUE;
+    FILE *fp;
+
+    if (!(fp = fopen(thumbname, "rb")))
+        return FALSE;
+
+    if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf) ||
+        memcmp(buf, signature, sizeof(signature)) != 0) {
+        fclose(fp);
+        return FALSE;
+    }
+
+    while (valid && !(gotURI && gotMTime) &&
+           fread(buf, 1, sizeof(buf), fp) == sizeof(buf)) {
+        guint32 len = entangle_thumbnail_loader_read_uint32(buf);
+        char *data;
+        gsize keylen;
+
+        if (memcmp(buf + 4, "IDAT", 4) == 0 ||
+            memcmp(buf + 4, "IEND", 4) == 0)
+            break;
+
+        /* Skip the data & CRC of anything else */
+        if (memcmp(buf + 4, "tEXt", 4) != 0 || len > 65536) {
+            if (fseek(fp, (long)len + 4, SEEK_CUR) < 0)
+                break;
+            continue;
+        }
+
+        data = g_malloc(len + 1);
+        if (fread(data, 1, len, fp) != len ||
+            fseek(fp, 4, SEEK_CUR) < 0) {
+            g_free(data);
+            break;
+        }
+        data[len] = '\0';
+        keylen = strlen(data);
+
+        if (keylen < len) {
+            const char *text = data + keylen + 1;
+            if (g_str_equal(data, "Thumb::URI")) {
+                gotURI = TRUE;
+                valid = g_str_equal(text, uri);
+            } else if (g_str_equal(data, "Thumb::MTime")) {
+                gotMTime = TRUE;
+                valid = atol(text) == mtime;
+            }
+        }
+        g_free(data);
+    }
+
+    fclose(fp);
+    return valid && gotURI && gotMTime;
+}
+
+
 /* Loads the master image and downsizes it to produce a thumbnail */
 static GdkPixbuf *entangle_thumbnail_loader_generate(EntanglePixbufLoader *loader G_GNUC_UNUSED,
                                                      EntangleImage *image,
                                                      const char *uri,
                                                      const char *thumbname,
+                                                     const EntangleThumbnailLoaderTier *tier,
                                                      time_t mtime,
-                                                     GExiv2Metadata **metadata)
+                                                     GExiv2Metadata **metadata,
+                                                     GCancellable *cancel)
 {
     GdkPixbuf *master;
     GdkPixbuf *thumb = NULL;
@@ -164,12 +325,14 @@ static GdkPixbuf *entangle_thumbnail_loader_generate(EntanglePixbufLoader *loade
     master = entangle_pixbuf_open_image(image,
                                         ENTANGLE_PIXBUF_IMAGE_SLOT_THUMBNAIL,
                                         FALSE,
-                                        metadata);
+                                        FALSE,
+                                        metadata,
+                                        cancel);
 
     if (!master)
         return NULL;
 
-    sw = sh = 128;
+    sw = sh = tier->size;
     iw = gdk_pixbuf_get_width(master);
     ih = gdk_pixbuf_get_height(master);
 
@@ -196,7 +359,7 @@ static GdkPixbuf *entangle_thumbnail_loader_generate(EntanglePixbufLoader *loade
 
     orientationstr = gdk_pixbuf_get_option(master, "orientation");
 
-    entangle_thumbnail_ensure_thumbnail_dir();
+    entangle_thumbnail_ensure_thumbnail_dir(tier);
 
     if (gdk_pixbuf_save(thumb, thumbnametmp,
                         "png", NULL,
@@ -226,47 +389,174 @@ static GdkPixbuf *entangle_thumbnail_loader_generate(EntanglePixbufLoader *loade
 }
 
 
+static EntangleThumbnailLoaderComposite *entangle_thumbnail_loader_composite_lookup(EntangleThumbnailLoader *loader,
+                                                                                   const char *filename)
+{
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+    GList *link = g_hash_table_lookup(priv->composites, filename);
+
+    return link ? link->data : NULL;
+}
+
+
+static void entangle_thumbnail_loader_composite_remove(EntangleThumbnailLoader *loader,
+                                                       EntangleThumbnailLoaderComposite *composite)
+{
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+    GList *link = g_hash_table_lookup(priv->composites, composite->filename);
+
+    g_queue_delete_link(priv->compositeQueue, link);
+    g_hash_table_remove(priv->composites, composite->filename);
+    priv->compositeBytes -= composite->bytes;
+    entangle_metrics_memory_free(priv->compositeMemory, composite->bytes);
+    entangle_thumbnail_loader_composite_free(composite);
+}
+
+
+/* Returns a new reference to the cached thumbnail, if still valid */
+static GdkPixbuf *entangle_thumbnail_loader_composite_get(EntangleThumbnailLoader *loader,
+                                                          const char *filename,
+                                                          const struct stat *sb,
+                                                          int width,
+                                                          int height)
+{
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+    EntangleThumbnailLoaderComposite *composite;
+    GdkPixbuf *pixbuf = NULL;
+    GList *link;
+
+    g_mutex_lock(&priv->lock);
+    if (!(link = g_hash_table_lookup(priv->composites, filename)))
+        goto cleanup;
+    composite = link->data;
+
+    if (composite->mtime != sb->st_mtime ||
+        composite->size != sb->st_size ||
+        composite->width != width ||
+        composite->height != height) {
+        entangle_thumbnail_loader_composite_remove(loader, composite);
+        goto cleanup;
+    }
+
+    /* Most recently used at the head */
+    g_queue_unlink(priv->compositeQueue, link);
+    g_queue_push_head_link(priv->compositeQueue, link);
+    pixbuf = g_object_ref(composite->pixbuf);
+
+ cleanup:
+    g_mutex_unlock(&priv->lock);
+    return pixbuf;
+}
+
+
+static void entangle_thumbnail_loader_composite_put(EntangleThumbnailLoader *loader,
+                                                    const char *filename,
+                                                    const struct stat *sb,
+                                                    GdkPixbuf *pixbuf)
+{
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+    EntangleThumbnailLoaderComposite *composite, *old;
+
+    composite = g_new0(EntangleThumbnailLoaderComposite, 1);
+    composite->filename = g_strdup(filename);
+    composite->mtime = sb->st_mtime;
+    composite->size = sb->st_size;
+    composite->width = gdk_pixbuf_get_width(pixbuf);
+    composite->height = gdk_pixbuf_get_height(pixbuf);
+    composite->pixbuf = g_object_ref(pixbuf);
+    composite->bytes = (gsize)gdk_pixbuf_get_rowstride(pixbuf) * composite->height;
+
+    g_mutex_lock(&priv->lock);
+    if ((old = entangle_thumbnail_loader_composite_lookup(loader, filename)))
+        entangle_thumbnail_loader_composite_remove(loader, old);
+
+    g_queue_push_head(priv->compositeQueue, composite);
+    g_hash_table_insert(priv->composites, composite->filename,
+                        g_queue_peek_head_link(priv->compositeQueue));
+    priv->compositeBytes += composite->bytes;
+    entangle_metrics_memory_alloc(priv->compositeMemory, composite->bytes);
+
+    while (priv->compositeBytes > ENTANGLE_THUMBNAIL_LOADER_COMPOSITE_MAX &&
+           g_queue_get_length(priv->compositeQueue) > 1)
+        entangle_thumbnail_loader_composite_remove(loader,
+                                                   g_queue_peek_tail(priv->compositeQueue));
+    g_mutex_unlock(&priv->lock);
+}
+
+
+static const EntangleThumbnailLoaderTier *entangle_thumbnail_loader_pick_tier(int width,
+                                                                             int height)
+{
+    int want = MAX(width, height);
+
+    /* The smallest tier which avoids upscaling */
+    for (gsize i = 0; i < G_N_ELEMENTS(entangle_thumbnail_loader_tiers); i++) {
+        if (entangle_thumbnail_loader_tiers[i].size >= want)
+            return &entangle_thumbnail_loader_tiers[i];
+    }
+    return &entangle_thumbnail_loader_tiers[G_N_ELEMENTS(entangle_thumbnail_loader_tiers) - 1];
+}
+
+
 static GdkPixbuf *entangle_thumbnail_loader_pixbuf_load(EntanglePixbufLoader *loader,
                                                         EntangleImage *image,
-                                                        GExiv2Metadata **metadata G_GNUC_UNUSED)
+                                                        GExiv2Metadata **metadata G_GNUC_UNUSED,
+                                                        GCancellable *cancel)
 {
     EntangleThumbnailLoader *tloader = ENTANGLE_THUMBNAIL_LOADER(loader);
     EntangleThumbnailLoaderPrivate *priv = tloader->priv;
-    char *uri = entangle_thumbnail_loader_path_to_uri(entangle_image_get_filename(image));
-    char *thumbname = entangle_thumbnail_loader_uri_to_thumb(uri);
+    const char *filename = entangle_image_get_filename(image);
+    char *uri = entangle_thumbnail_loader_path_to_uri(filename);
+    char *thumbname = NULL;
     GdkPixbuf *result = NULL;
     GdkPixbuf *thumb = NULL;
     struct stat sb;
     GExiv2Metadata *themetadata = NULL;
+    EntangleThumbnailStore *store = entangle_thumbnail_loader_get_store(tloader);
+    const EntangleThumbnailLoaderTier *tier;
+    int scale = g_atomic_int_get(&priv->scale);
+    int width = priv->width * scale;
+    int height = priv->height * scale;
 
     /* Sanity check that the base image still exists */
-    if (stat(entangle_image_get_filename(image), &sb) < 0) {
-        ENTANGLE_DEBUG("File %s does not exist", entangle_image_get_filename(image));
+    if (stat(filename, &sb) < 0) {
+        ENTANGLE_DEBUG("File %s does not exist", filename);
         goto cleanup;
     }
 
-    ENTANGLE_DEBUG("Want thumbnail %s for %s %ld", thumbname, uri, sb.st_mtime);
+    if ((result = entangle_thumbnail_loader_composite_get(tloader, filename, &sb,
+                                                          width, height))) {
+        entangle_metrics_add(ENTANGLE_METRICS_COUNTER_THUMBNAIL_HITS, 1);
+        goto cleanup;
+    }
 
-    /* Have a go at loading a thumbnail, but it might not exist */
-    thumb = gdk_pixbuf_new_from_file(thumbname, NULL);
-    if (thumb) {
-        const char *thisuri = gdk_pixbuf_get_option(thumb, "tEXt::Thumb::URI");
-        const char *thismtimeStr = gdk_pixbuf_get_option(thumb, "tEXt::Thumb::MTime");
-        time_t thismtime;
+    /* The store holds thumbnails ready to display, so
+     * none of the work below is needed on a hit */
+    if (store) {
+        ENTANGLE_TRACE_BEGIN("thumbnail-store-read");
+        result = entangle_thumbnail_store_lookup(store, filename,
+                                                 sb.st_mtime, sb.st_size,
+                                                 width, height);
+        ENTANGLE_TRACE_END("thumbnail-store-read");
+        if (result) {
+            entangle_metrics_add(ENTANGLE_METRICS_COUNTER_THUMBNAIL_HITS, 1);
+            goto composite;
+        }
+    }
 
-        thismtime = thismtimeStr ? atol(thismtimeStr) : 0;
+    tier = entangle_thumbnail_loader_pick_tier(width, height);
+    thumbname = entangle_thumbnail_loader_uri_to_thumb(uri, tier);
 
-        ENTANGLE_DEBUG("Check thumbnail %s for %s %s",
-                       thumbname, thisuri, thismtimeStr);
+    ENTANGLE_DEBUG("Want thumbnail %s for %s %ld", thumbname, uri, sb.st_mtime);
 
-        /* Check that the thumbnail is still valid */
-        if (!thisuri || !thismtimeStr ||
-            strcmp(uri, thisuri) != 0 ||
-            thismtime != sb.st_mtime) {
-            g_object_unref(thumb);
-            thumb = NULL;
-        }
-    }
+    /* Have a go at loading a thumbnail, but it might not exist */
+    ENTANGLE_TRACE_BEGIN("thumbnail-read");
+    if (entangle_thumbnail_loader_check_png(thumbname, uri, sb.st_mtime))
+        thumb = gdk_pixbuf_new_from_file(thumbname, NULL);
+    ENTANGLE_TRACE_END("thumbnail-read");
+    entangle_metrics_add(thumb ?
+                         ENTANGLE_METRICS_COUNTER_THUMBNAIL_HITS :
+                         ENTANGLE_METRICS_COUNTER_THUMBNAIL_MISSES, 1);
 
 
     /* No thumbnail, so lets generate one */
@@ -274,11 +564,15 @@ static GdkPixbuf *entangle_thumbnail_loader_pixbuf_load(EntanglePixbufLoader *lo
         unlink(thumbname);
         ENTANGLE_DEBUG("Generate thumbnail %s for %s %ld",
                        thumbname, uri, sb.st_mtime);
+        ENTANGLE_TRACE_BEGIN("thumbnail-generate");
         thumb = entangle_thumbnail_loader_generate(loader,
                                                    image,
                                                    uri, thumbname,
+                                                   tier,
                                                    sb.st_mtime,
-                                                   &themetadata);
+                                                   &themetadata,
+                                                   cancel);
+        ENTANGLE_TRACE_END("thumbnail-generate");
     }
 
     /* Apply any rotation hints so it is "normal" for the viewer */
@@ -291,7 +585,9 @@ static GdkPixbuf *entangle_thumbnail_loader_pixbuf_load(EntanglePixbufLoader *lo
     /* Chances are that the thumbnail size is not actually the
      * exact size that we want, or the aspect ratio is different.
      * So scale it to fit our desired size, and fill any borders
-     * left over with black
+     * left over with black. A thumbnail which is smaller than
+     * wanted, because the image itself is, is centred as is
+     * rather than being blurred by upscaling.
      */
     if (thumb) {
         int tw, th;
@@ -299,35 +595,39 @@ static GdkPixbuf *entangle_thumbnail_loader_pixbuf_load(EntanglePixbufLoader *lo
         tw = gdk_pixbuf_get_width(thumb);
         th = gdk_pixbuf_get_height(thumb);
 
-        if (tw != priv->width ||
-            th != priv->height) {
+        if (tw != width ||
+            th != height) {
             double ta, ra;
             int rw, rh;
             double sw, sh;
 
             ta = (double)tw / (double)th;
-            ra = (double)priv->width / (double)priv->height;
+            ra = (double)width / (double)height;
 
             if (ta > ra) {
-                rw = priv->width;
-                rh = (int)((double)priv->width / ta);
+                rw = width;
+                rh = (int)((double)width / ta);
             } else {
-                rw = (int)((double)priv->height * ta);
-                rh = priv->height;
+                rw = (int)((double)height * ta);
+                rh = height;
+            }
+            if (rw > tw || rh > th) {
+                rw = tw;
+                rh = th;
             }
 
             sw = (double)rw / (double)tw;
             sh = (double)rh / (double)th;
             result = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8,
-                                    priv->width, priv->height);
+                                    width, height);
             gdk_pixbuf_fill(result, 0x00000000);
 
             gdk_pixbuf_scale(thumb, result,
-                             (priv->width - rw) / 2,
-                             (priv->height - rh) / 2,
+                             (width - rw) / 2,
+                             (height - rh) / 2,
                              rw, rh,
-                             (priv->width - rw) / 2,
-                             (priv->height - rh) / 2,
+                             (width - rw) / 2,
+                             (height - rh) / 2,
                              sw, sh,
                              GDK_INTERP_BILINEAR);
             g_object_unref(thumb);
@@ -336,7 +636,25 @@ static GdkPixbuf *entangle_thumbnail_loader_pixbuf_load(EntanglePixbufLoader *lo
         }
     }
 
+    if (result && store) {
+        GError *error = NULL;
+        ENTANGLE_TRACE_BEGIN("thumbnail-store-write");
+        if (!entangle_thumbnail_store_save(store, filename,
+                                           sb.st_mtime, sb.st_size,
+                                           result, &error)) {
+            ENTANGLE_DEBUG("Unable to store thumbnail: %s", error->message);
+            g_error_free(error);
+        }
+        ENTANGLE_TRACE_END("thumbnail-store-write");
+    }
+
+ composite:
+    if (result)
+        entangle_thumbnail_loader_composite_put(tloader, filename, &sb, result);
+
  cleanup:
+    if (store)
+        g_object_unref(store);
     if (themetadata)
         g_object_unref(themetadata);
     g_free(uri);
@@ -351,6 +669,7 @@ static void entangle_thumbnail_loader_class_init(EntangleThumbnailLoaderClass *k
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
     EntanglePixbufLoaderClass *loader_class = ENTANGLE_PIXBUF_LOADER_CLASS(klass);
 
+    object_class->finalize = entangle_thumbnail_loader_finalize;
     object_class->get_property = entangle_thumbnail_loader_get_property;
     object_class->set_property = entangle_thumbnail_loader_set_property;
 
@@ -378,6 +697,26 @@ static void entangle_thumbnail_loader_class_init(EntangleThumbnailLoaderClass *k
                                                      G_PARAM_STATIC_NAME |
                                                      G_PARAM_STATIC_NICK |
                                                      G_PARAM_STATIC_BLURB));
+    g_object_class_install_property(object_class,
+                                    PROP_STORE,
+                                    g_param_spec_object("store",
+                                                        "Store",
+                                                        "Packed thumbnail store",
+                                                        ENTANGLE_TYPE_THUMBNAIL_STORE,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_NAME |
+                                                        G_PARAM_STATIC_NICK |
+                                                        G_PARAM_STATIC_BLURB));
+    g_object_class_install_property(object_class,
+                                    PROP_SCALE,
+                                    g_param_spec_int("scale",
+                                                     "Scale",
+                                                     "Device pixels per logical pixel",
+                                                     1, 4, 1,
+                                                     G_PARAM_READWRITE |
+                                                     G_PARAM_STATIC_NAME |
+                                                     G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
 
     g_type_class_add_private(klass, sizeof(EntangleThumbnailLoaderPrivate));
 }
@@ -401,6 +740,114 @@ static void entangle_thumbnail_loader_init(EntangleThumbnailLoader *loader)
     memset(priv, 0, sizeof(*priv));
 
     priv->width = priv->height = 128;
+    priv->scale = 1;
+    g_mutex_init(&priv->lock);
+    priv->composites = g_hash_table_new(g_str_hash, g_str_equal);
+    priv->compositeQueue = g_queue_new();
+    priv->compositeMemory = entangle_metrics_memory_owner("EntangleThumbnailCache");
+}
+
+
+/**
+ * entangle_thumbnail_loader_set_store:
+ * @loader: the thumbnail loader
+ * @store: (transfer none)(allow-none): the opened thumbnail store
+ *
+ * Set the packed store to look for thumbnails in before the
+ * freedesktop thumbnail cache, and to save newly generated
+ * thumbnails to. Thumbnails which are already loaded are not
+ * affected.
+ */
+void entangle_thumbnail_loader_set_store(EntangleThumbnailLoader *loader,
+                                         EntangleThumbnailStore *store)
+{
+    g_return_if_fail(ENTANGLE_IS_THUMBNAIL_LOADER(loader));
+    g_return_if_fail(!store || ENTANGLE_IS_THUMBNAIL_STORE(store));
+
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+
+    g_mutex_lock(&priv->lock);
+    if (priv->store)
+        g_object_unref(priv->store);
+    priv->store = store;
+    if (priv->store)
+        g_object_ref(priv->store);
+    g_mutex_unlock(&priv->lock);
+}
+
+
+/**
+ * entangle_thumbnail_loader_get_store:
+ * @loader: the thumbnail loader
+ *
+ * Get the packed store used for thumbnails, if any. Since
+ * the store may be replaced at any time by another thread,
+ * a new reference is returned.
+ *
+ * Returns: (transfer full)(allow-none): the thumbnail store
+ */
+EntangleThumbnailStore *entangle_thumbnail_loader_get_store(EntangleThumbnailLoader *loader)
+{
+    g_return_val_if_fail(ENTANGLE_IS_THUMBNAIL_LOADER(loader), NULL);
+
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+    EntangleThumbnailStore *store;
+
+    g_mutex_lock(&priv->lock);
+    store = priv->store;
+    if (store)
+        g_object_ref(store);
+    g_mutex_unlock(&priv->lock);
+
+    return store;
+}
+
+
+/**
+ * entangle_thumbnail_loader_set_scale:
+ * @loader: the thumbnail loader
+ * @scale: device pixels per logical pixel
+ *
+ * Set the scale factor of the display the thumbnails are
+ * shown on. Thumbnails are rendered at the loader's width
+ * and height multiplied by @scale, picking the larger of the
+ * freedesktop.org thumbnail sizes when needed so they stay
+ * sharp on HiDPI displays. Any loaded thumbnails are reloaded
+ * at the new size.
+ */
+void entangle_thumbnail_loader_set_scale(EntangleThumbnailLoader *loader,
+                                         int scale)
+{
+    g_return_if_fail(ENTANGLE_IS_THUMBNAIL_LOADER(loader));
+    g_return_if_fail(scale >= 1);
+
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+
+    if (g_atomic_int_get(&priv->scale) == scale)
+        return;
+
+    ENTANGLE_DEBUG("Thumbnail scale %d", scale);
+    g_atomic_int_set(&priv->scale, scale);
+    entangle_pixbuf_loader_trigger_reload(ENTANGLE_PIXBUF_LOADER(loader));
+    g_object_notify(G_OBJECT(loader), "scale");
+}
+
+
+/**
+ * entangle_thumbnail_loader_get_scale:
+ * @loader: the thumbnail loader
+ *
+ * Get the scale factor thumbnails are rendered at
+ *
+ * Returns: device pixels per logical pixel
+ */
+int entangle_thumbnail_loader_get_scale(EntangleThumbnailLoader *loader)
+{
+    g_return_val_if_fail(ENTANGLE_IS_THUMBNAIL_LOADER(loader), 1);
+
+    EntangleThumbnailLoaderPrivate *priv = loader->priv;
+
+    return g_atomic_int_get(&priv->scale);
 }
 
 
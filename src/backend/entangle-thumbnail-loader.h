@@ -23,6 +23,7 @@
 
 #include <glib-object.h>
 #include "entangle-pixbuf-loader.h"
+#include "entangle-thumbnail-store.h"
 
 G_BEGIN_DECLS
 
@@ -56,6 +57,14 @@ GType entangle_thumbnail_loader_get_type(void) G_GNUC_CONST;
 EntangleThumbnailLoader *entangle_thumbnail_loader_new(int width,
                                                int height);
 
+void entangle_thumbnail_loader_set_store(EntangleThumbnailLoader *loader,
+                                         EntangleThumbnailStore *store);
+EntangleThumbnailStore *entangle_thumbnail_loader_get_store(EntangleThumbnailLoader *loader);
+
+void entangle_thumbnail_loader_set_scale(EntangleThumbnailLoader *loader,
+                                         int scale);
+int entangle_thumbnail_loader_get_scale(EntangleThumbnailLoader *loader);
+
 G_END_DECLS
 
 #endif /* __ENTANGLE_THUMBNAIL_LOADER_H__ */
@@ -0,0 +1,907 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "entangle-debug.h"
+#include "entangle-thumbnail-store.h"
+
+/*
+ * A store is a single file of thumbnail records, appended to
+ * as thumbnails are generated and mapped into memory for
+ * reading. Each record has a fixed header identifying the
+ * source file, followed by the path and the raw pixel data,
+ * so a thumbnail can be validated without touching its
+ * pixels, and used without decoding or copying them.
+ *
+ * A superseded record is left in place until the store is
+ * next opened, when it is compacted if enough is wasted.
+ * A record torn by a crash is discarded along with anything
+ * after it.
+ */
+
+#define ENTANGLE_THUMBNAIL_STORE_GET_PRIVATE(obj)                       \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_THUMBNAIL_STORE, EntangleThumbnailStorePrivate))
+
+#define ENTANGLE_THUMBNAIL_STORE_MAGIC "ENTTHMB1"
+#define ENTANGLE_THUMBNAIL_STORE_MARKER 0x424d4854
+#define ENTANGLE_THUMBNAIL_STORE_ALIGN(n) (((n) + 7) & ~(guint64)7)
+#define ENTANGLE_THUMBNAIL_STORE_PATH_MAX 4096
+/* Below this, wasted space is not worth rewriting the file for */
+#define ENTANGLE_THUMBNAIL_STORE_COMPACT_MIN (4 * 1024 * 1024)
+
+typedef struct _EntangleThumbnailStoreHeader EntangleThumbnailStoreHeader;
+typedef struct _EntangleThumbnailStoreRecord EntangleThumbnailStoreRecord;
+typedef struct _EntangleThumbnailStoreEntry EntangleThumbnailStoreEntry;
+
+/* Stores are never shared between hosts, so native byte order */
+struct _EntangleThumbnailStoreHeader {
+    char magic[8];
+    guint32 byteorder;
+    guint32 reserved;
+};
+
+struct _EntangleThumbnailStoreRecord {
+    guint32 marker;
+    guint32 pathlen;
+    gint64 mtime;
+    gint64 size;
+    guint32 width;
+    guint32 height;
+    guint32 rowstride;
+    guint32 alpha;
+};
+
+struct _EntangleThumbnailStoreEntry {
+    guint64 offset;
+    guint64 length;
+};
+
+struct _EntangleThumbnailStorePrivate {
+    char *filename;
+
+    GMutex lock;
+    int fd;
+    GMappedFile *map;
+    guint64 length;
+    guint64 wasted;
+    GHashTable *entries;
+};
+
+G_DEFINE_TYPE(EntangleThumbnailStore, entangle_thumbnail_store, G_TYPE_OBJECT);
+
+enum {
+    PROP_0,
+    PROP_FILENAME,
+};
+
+/* Open stores, which the garbage collector must leave alone */
+static GMutex entangle_thumbnail_store_open_lock;
+static GHashTable *entangle_thumbnail_store_open_files;
+
+#define ENTANGLE_THUMBNAIL_STORE_ERROR entangle_thumbnail_store_error_quark()
+
+static GQuark entangle_thumbnail_store_error_quark(void)
+{
+    return g_quark_from_static_string("entangle-thumbnail-store");
+}
+
+
+static void entangle_thumbnail_store_get_property(GObject *object,
+                                                  guint prop_id,
+                                                  GValue *value,
+                                                  GParamSpec *pspec)
+{
+    EntangleThumbnailStore *store = ENTANGLE_THUMBNAIL_STORE(object);
+    EntangleThumbnailStorePrivate *priv = store->priv;
+
+    switch (prop_id)
+        {
+        case PROP_FILENAME:
+            g_value_set_string(value, priv->filename);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+}
+
+
+static void entangle_thumbnail_store_set_property(GObject *object,
+                                                  guint prop_id,
+                                                  const GValue *value,
+                                                  GParamSpec *pspec)
+{
+    EntangleThumbnailStore *store = ENTANGLE_THUMBNAIL_STORE(object);
+    EntangleThumbnailStorePrivate *priv = store->priv;
+
+    switch (prop_id)
+        {
+        case PROP_FILENAME:
+            g_free(priv->filename);
+            priv->filename = g_value_dup_string(value);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        }
+}
+
+
+static void entangle_thumbnail_store_register(const char *filename,
+                                              gboolean open)
+{
+    guint count;
+
+    g_mutex_lock(&entangle_thumbnail_store_open_lock);
+    if (!entangle_thumbnail_store_open_files)
+        entangle_thumbnail_store_open_files = g_hash_table_new_full(g_str_hash,
+                                                                    g_str_equal,
+                                                                    g_free,
+                                                                    NULL);
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(entangle_thumbnail_store_open_files,
+                                                 filename));
+    if (open)
+        count++;
+    else if (count)
+        count--;
+    if (count)
+        g_hash_table_insert(entangle_thumbnail_store_open_files,
+                            g_strdup(filename), GUINT_TO_POINTER(count));
+    else
+        g_hash_table_remove(entangle_thumbnail_store_open_files, filename);
+    g_mutex_unlock(&entangle_thumbnail_store_open_lock);
+}
+
+
+static void entangle_thumbnail_store_close(EntangleThumbnailStore *store)
+{
+    EntangleThumbnailStorePrivate *priv = store->priv;
+
+    if (priv->map) {
+        g_mapped_file_unref(priv->map);
+        priv->map = NULL;
+    }
+    if (priv->fd != -1) {
+        close(priv->fd);
+        priv->fd = -1;
+    }
+    g_hash_table_remove_all(priv->entries);
+    priv->length = priv->wasted = 0;
+}
+
+
+static void entangle_thumbnail_store_finalize(GObject *object)
+{
+    EntangleThumbnailStore *store = ENTANGLE_THUMBNAIL_STORE(object);
+    EntangleThumbnailStorePrivate *priv = store->priv;
+
+    ENTANGLE_DEBUG("Finalize thumbnail store %s", priv->filename);
+
+    if (priv->fd != -1)
+        entangle_thumbnail_store_register(priv->filename, FALSE);
+    entangle_thumbnail_store_close(store);
+    g_hash_table_unref(priv->entries);
+    g_mutex_clear(&priv->lock);
+    g_free(priv->filename);
+
+    G_OBJECT_CLASS(entangle_thumbnail_store_parent_class)->finalize(object);
+}
+
+
+static void entangle_thumbnail_store_class_init(EntangleThumbnailStoreClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = entangle_thumbnail_store_finalize;
+    object_class->get_property = entangle_thumbnail_store_get_property;
+    object_class->set_property = entangle_thumbnail_store_set_property;
+
+    g_object_class_install_property(object_class,
+                                    PROP_FILENAME,
+                                    g_param_spec_string("filename",
+                                                        "Filename",
+                                                        "Full path to the store",
+                                                        NULL,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_CONSTRUCT_ONLY |
+                                                        G_PARAM_STATIC_NAME |
+                                                        G_PARAM_STATIC_NICK |
+                                                        G_PARAM_STATIC_BLURB));
+
+    g_type_class_add_private(klass, sizeof(EntangleThumbnailStorePrivate));
+}
+
+
+/**
+ * entangle_thumbnail_store_new:
+ * @filename: the full path to the store
+ *
+ * Create a new thumbnail store, which must be opened before
+ * it can be used
+ *
+ * Returns: (transfer full): the new thumbnail store
+ */
+EntangleThumbnailStore *entangle_thumbnail_store_new(const char *filename)
+{
+    return ENTANGLE_THUMBNAIL_STORE(g_object_new(ENTANGLE_TYPE_THUMBNAIL_STORE,
+                                                 "filename", filename,
+                                                 NULL));
+}
+
+
+static char *entangle_thumbnail_store_session_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "entangle", "sessions", NULL);
+}
+
+
+/**
+ * entangle_thumbnail_store_new_for_session:
+ * @directory: the session directory
+ *
+ * Create a new thumbnail store for the images in the session
+ * @directory, kept in the user's cache directory
+ *
+ * Returns: (transfer full): the new thumbnail store
+ */
+EntangleThumbnailStore *entangle_thumbnail_store_new_for_session(const char *directory)
+{
+    char *md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, directory, -1);
+    char *dir = entangle_thumbnail_store_session_dir();
+    char *name = g_strdup_printf("%s.thumbs", md5);
+    char *filename = g_build_filename(dir, name, NULL);
+    EntangleThumbnailStore *store = entangle_thumbnail_store_new(filename);
+
+    g_free(filename);
+    g_free(name);
+    g_free(dir);
+    g_free(md5);
+    return store;
+}
+
+
+static void entangle_thumbnail_store_init(EntangleThumbnailStore *store)
+{
+    EntangleThumbnailStorePrivate *priv;
+
+    priv = store->priv = ENTANGLE_THUMBNAIL_STORE_GET_PRIVATE(store);
+
+    g_mutex_init(&priv->lock);
+    priv->fd = -1;
+    priv->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                          g_free, g_free);
+}
+
+
+/**
+ * entangle_thumbnail_store_get_filename:
+ * @store: the thumbnail store
+ *
+ * Get the full path to the file backing the store
+ *
+ * Returns: (transfer none): the filename
+ */
+const char *entangle_thumbnail_store_get_filename(EntangleThumbnailStore *store)
+{
+    g_return_val_if_fail(ENTANGLE_IS_THUMBNAIL_STORE(store), NULL);
+
+    EntangleThumbnailStorePrivate *priv = store->priv;
+
+    return priv->filename;
+}
+
+
+static gboolean entangle_thumbnail_store_write(int fd,
+                                               const void *data,
+                                               gsize len,
+                                               guint64 offset)
+{
+    const char *buf = data;
+
+    while (len) {
+        ssize_t ret = pwrite(fd, buf, len, offset);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        buf += ret;
+        len -= ret;
+        offset += ret;
+    }
+    return TRUE;
+}
+
+
+static gboolean entangle_thumbnail_store_reset(EntangleThumbnailStore *store,
+                                               GError **error)
+{
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    EntangleThumbnailStoreHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENTANGLE_THUMBNAIL_STORE_MAGIC, sizeof(header.magic));
+    header.byteorder = G_BYTE_ORDER;
+
+    if (ftruncate(priv->fd, 0) < 0 ||
+        !entangle_thumbnail_store_write(priv->fd, &header, sizeof(header), 0)) {
+        g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                    _("Unable to initialize thumbnail store %s: %s"),
+                    priv->filename, g_strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+static gboolean entangle_thumbnail_store_remap(EntangleThumbnailStore *store,
+                                               GError **error)
+{
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    GMappedFile *map;
+
+    /* Writable so pixbufs handed out may be modified, but
+     * the mapping is private so the file never is */
+    if (!(map = g_mapped_file_new_from_fd(priv->fd, TRUE, error)))
+        return FALSE;
+
+    /* Pixbufs from the old mapping keep it alive */
+    if (priv->map)
+        g_mapped_file_unref(priv->map);
+    priv->map = map;
+    return TRUE;
+}
+
+
+static guint64 entangle_thumbnail_store_record_length(const EntangleThumbnailStoreRecord *record)
+{
+    return sizeof(*record) +
+        ENTANGLE_THUMBNAIL_STORE_ALIGN((guint64)record->pathlen) +
+        ENTANGLE_THUMBNAIL_STORE_ALIGN((guint64)record->rowstride * record->height);
+}
+
+
+static gboolean entangle_thumbnail_store_scan(EntangleThumbnailStore *store)
+{
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    const char *data = g_mapped_file_get_contents(priv->map);
+    guint64 maplen = g_mapped_file_get_length(priv->map);
+    const EntangleThumbnailStoreHeader *header = (const EntangleThumbnailStoreHeader *)data;
+    guint64 offset = sizeof(*header);
+
+    if (maplen < sizeof(*header) ||
+        memcmp(header->magic, ENTANGLE_THUMBNAIL_STORE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byteorder != G_BYTE_ORDER)
+        return FALSE;
+
+    while (offset + sizeof(EntangleThumbnailStoreRecord) <= maplen) {
+        const EntangleThumbnailStoreRecord *record =
+            (const EntangleThumbnailStoreRecord *)(data + offset);
+        EntangleThumbnailStoreEntry *entry, *old;
+        guint64 length;
+        char *path;
+
+        if (record->marker != ENTANGLE_THUMBNAIL_STORE_MARKER ||
+            record->pathlen == 0 ||
+            record->pathlen > ENTANGLE_THUMBNAIL_STORE_PATH_MAX ||
+            record->width == 0 || record->height == 0 ||
+            record->rowstride < record->width * (record->alpha ? 4 : 3))
+            break;
+
+        length = entangle_thumbnail_store_record_length(record);
+        if (length > maplen - offset)
+            break;
+
+        path = g_strndup(data + offset + sizeof(*record), record->pathlen);
+        if ((old = g_hash_table_lookup(priv->entries, path)))
+            priv->wasted += old->length;
+
+        entry = g_new0(EntangleThumbnailStoreEntry, 1);
+        entry->offset = offset;
+        entry->length = length;
+        g_hash_table_insert(priv->entries, path, entry);
+
+        offset += length;
+    }
+
+    priv->length = offset;
+    return TRUE;
+}
+
+
+static gboolean entangle_thumbnail_store_compact(EntangleThumbnailStore *store,
+                                                 GError **error)
+{
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    const char *data = g_mapped_file_get_contents(priv->map);
+    char *tmpname = g_strdup_printf("%s.entangle-tmp", priv->filename);
+    EntangleThumbnailStoreHeader header;
+    GHashTableIter iter;
+    gpointer key, value;
+    guint64 offset;
+    gboolean ret = FALSE;
+    int fd;
+
+    ENTANGLE_DEBUG("Compacting thumbnail store %s, %" G_GUINT64_FORMAT
+                   " of %" G_GUINT64_FORMAT " bytes wasted",
+                   priv->filename, priv->wasted, priv->length);
+
+    if ((fd = open(tmpname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0)
+        goto error;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENTANGLE_THUMBNAIL_STORE_MAGIC, sizeof(header.magic));
+    header.byteorder = G_BYTE_ORDER;
+    if (!entangle_thumbnail_store_write(fd, &header, sizeof(header), 0))
+        goto error;
+
+    offset = sizeof(header);
+    g_hash_table_iter_init(&iter, priv->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        EntangleThumbnailStoreEntry *entry = value;
+        if (!entangle_thumbnail_store_write(fd, data + entry->offset,
+                                            entry->length, offset))
+            goto error;
+        entry->offset = offset;
+        offset += entry->length;
+    }
+
+    if (rename(tmpname, priv->filename) < 0)
+        goto error;
+
+    close(priv->fd);
+    priv->fd = fd;
+    fd = -1;
+    priv->length = offset;
+    priv->wasted = 0;
+
+    if (!entangle_thumbnail_store_remap(store, error))
+        goto cleanup;
+
+    ret = TRUE;
+    goto cleanup;
+
+ error:
+    g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                _("Unable to compact thumbnail store %s: %s"),
+                priv->filename, g_strerror(errno));
+    unlink(tmpname);
+ cleanup:
+    if (fd != -1)
+        close(fd);
+    g_free(tmpname);
+    return ret;
+}
+
+
+/**
+ * entangle_thumbnail_store_open:
+ * @store: the thumbnail store
+ * @error: the error details
+ *
+ * Open the file backing the store, creating it if it does not
+ * exist. The index is rebuilt from the record headers, which
+ * does not require reading any pixel data.
+ *
+ * Returns: TRUE if the store was opened, FALSE on error
+ */
+gboolean entangle_thumbnail_store_open(EntangleThumbnailStore *store,
+                                       GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_THUMBNAIL_STORE(store), FALSE);
+
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    char *dir = NULL;
+    struct stat sb;
+    gboolean ret = FALSE;
+
+    g_mutex_lock(&priv->lock);
+    if (priv->fd != -1) {
+        ret = TRUE;
+        goto cleanup;
+    }
+
+    dir = g_path_get_dirname(priv->filename);
+    g_mkdir_with_parents(dir, 0700);
+
+    /* Registered before the file is opened, so the garbage
+     * collector cannot delete it out from under us */
+    entangle_thumbnail_store_register(priv->filename, TRUE);
+
+    if ((priv->fd = open(priv->filename, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0 ||
+        fstat(priv->fd, &sb) < 0) {
+        g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                    _("Unable to open thumbnail store %s: %s"),
+                    priv->filename, g_strerror(errno));
+        goto error;
+    }
+
+    if (sb.st_size < (off_t)sizeof(EntangleThumbnailStoreHeader) &&
+        !entangle_thumbnail_store_reset(store, error))
+        goto error;
+
+    if (!entangle_thumbnail_store_remap(store, error))
+        goto error;
+
+    if (!entangle_thumbnail_store_scan(store)) {
+        ENTANGLE_DEBUG("Discarding incompatible thumbnail store %s", priv->filename);
+        if (!entangle_thumbnail_store_reset(store, error) ||
+            !entangle_thumbnail_store_remap(store, error))
+            goto error;
+        entangle_thumbnail_store_scan(store);
+    }
+
+    /* Drop a torn record, so appends line up with the index */
+    if (priv->length < g_mapped_file_get_length(priv->map)) {
+        ENTANGLE_DEBUG("Truncating thumbnail store %s to %" G_GUINT64_FORMAT,
+                       priv->filename, priv->length);
+        if (ftruncate(priv->fd, priv->length) < 0) {
+            g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                        _("Unable to truncate thumbnail store %s: %s"),
+                        priv->filename, g_strerror(errno));
+            goto error;
+        }
+        if (!entangle_thumbnail_store_remap(store, error))
+            goto error;
+    }
+
+    if (priv->wasted > ENTANGLE_THUMBNAIL_STORE_COMPACT_MIN &&
+        priv->wasted > priv->length / 2 &&
+        !entangle_thumbnail_store_compact(store, error))
+        goto error;
+
+    ENTANGLE_DEBUG("Opened thumbnail store %s with %u entries",
+                   priv->filename, g_hash_table_size(priv->entries));
+    ret = TRUE;
+    goto cleanup;
+
+ error:
+    entangle_thumbnail_store_close(store);
+    entangle_thumbnail_store_register(priv->filename, FALSE);
+ cleanup:
+    g_mutex_unlock(&priv->lock);
+    g_free(dir);
+    return ret;
+}
+
+
+static void entangle_thumbnail_store_unmap(guchar *pixels G_GNUC_UNUSED,
+                                           gpointer opaque)
+{
+    g_mapped_file_unref(opaque);
+}
+
+
+/**
+ * entangle_thumbnail_store_lookup:
+ * @store: the thumbnail store
+ * @filename: the image the thumbnail is for
+ * @mtime: the modification time of the image
+ * @size: the size of the image in bytes
+ * @width: the width of the thumbnail
+ * @height: the height of the thumbnail
+ *
+ * Find the thumbnail for @filename, provided it was generated
+ * from the same version of the image at the same size. The
+ * pixbuf refers directly to the mapped store, so no decoding
+ * or copying takes place.
+ *
+ * Returns: (transfer full)(allow-none): the thumbnail or NULL
+ */
+GdkPixbuf *entangle_thumbnail_store_lookup(EntangleThumbnailStore *store,
+                                           const char *filename,
+                                           gint64 mtime,
+                                           gint64 size,
+                                           int width,
+                                           int height)
+{
+    g_return_val_if_fail(ENTANGLE_IS_THUMBNAIL_STORE(store), NULL);
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    EntangleThumbnailStoreEntry *entry;
+    const EntangleThumbnailStoreRecord *record;
+    char *data;
+    GdkPixbuf *pixbuf = NULL;
+
+    g_mutex_lock(&priv->lock);
+    if (priv->fd == -1)
+        goto cleanup;
+
+    if (!(entry = g_hash_table_lookup(priv->entries, filename)))
+        goto cleanup;
+
+    /* Records are written whole while holding the lock, so
+     * the mapping holds all of a record or none of it */
+    if (entry->offset >= g_mapped_file_get_length(priv->map) &&
+        !entangle_thumbnail_store_remap(store, NULL))
+        goto cleanup;
+
+    data = g_mapped_file_get_contents(priv->map) + entry->offset;
+    record = (const EntangleThumbnailStoreRecord *)data;
+
+    if (record->mtime != mtime ||
+        record->size != size ||
+        record->width != (guint32)width ||
+        record->height != (guint32)height) {
+        ENTANGLE_DEBUG("Stale thumbnail for %s in %s", filename, priv->filename);
+        goto cleanup;
+    }
+
+    data += sizeof(*record) + ENTANGLE_THUMBNAIL_STORE_ALIGN((guint64)record->pathlen);
+    pixbuf = gdk_pixbuf_new_from_data((guchar *)data,
+                                      GDK_COLORSPACE_RGB,
+                                      record->alpha ? TRUE : FALSE,
+                                      8,
+                                      record->width,
+                                      record->height,
+                                      record->rowstride,
+                                      entangle_thumbnail_store_unmap,
+                                      g_mapped_file_ref(priv->map));
+
+ cleanup:
+    g_mutex_unlock(&priv->lock);
+    return pixbuf;
+}
+
+
+/**
+ * entangle_thumbnail_store_save:
+ * @store: the thumbnail store
+ * @filename: the image the thumbnail is for
+ * @mtime: the modification time of the image
+ * @size: the size of the image in bytes
+ * @pixbuf: the thumbnail
+ * @error: the error details
+ *
+ * Append @pixbuf to the store as the thumbnail for @filename,
+ * replacing any earlier thumbnail for it
+ *
+ * Returns: TRUE if the thumbnail was saved, FALSE on error
+ */
+gboolean entangle_thumbnail_store_save(EntangleThumbnailStore *store,
+                                       const char *filename,
+                                       gint64 mtime,
+                                       gint64 size,
+                                       GdkPixbuf *pixbuf,
+                                       GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_THUMBNAIL_STORE(store), FALSE);
+    g_return_val_if_fail(filename != NULL, FALSE);
+    g_return_val_if_fail(GDK_IS_PIXBUF(pixbuf), FALSE);
+
+    EntangleThumbnailStorePrivate *priv = store->priv;
+    EntangleThumbnailStoreRecord *record;
+    EntangleThumbnailStoreEntry *entry, *old;
+    gboolean alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+    int width = gdk_pixbuf_get_width(pixbuf);
+    int height = gdk_pixbuf_get_height(pixbuf);
+    int stride = gdk_pixbuf_get_rowstride(pixbuf);
+    const guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
+    gsize pathlen = strlen(filename);
+    guint32 rowbytes = width * (alpha ? 4 : 3);
+    guint64 length;
+    char *buf, *dst;
+    gboolean ret = FALSE;
+
+    if (gdk_pixbuf_get_bits_per_sample(pixbuf) != 8 ||
+        gdk_pixbuf_get_n_channels(pixbuf) != (alpha ? 4 : 3) ||
+        pathlen == 0 || pathlen > ENTANGLE_THUMBNAIL_STORE_PATH_MAX) {
+        g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                    _("Unsupported thumbnail for %s"), filename);
+        return FALSE;
+    }
+
+    length = sizeof(*record) +
+        ENTANGLE_THUMBNAIL_STORE_ALIGN((guint64)pathlen) +
+        ENTANGLE_THUMBNAIL_STORE_ALIGN((guint64)rowbytes * height);
+    buf = g_malloc0(length);
+
+    record = (EntangleThumbnailStoreRecord *)buf;
+    record->marker = ENTANGLE_THUMBNAIL_STORE_MARKER;
+    record->pathlen = pathlen;
+    record->mtime = mtime;
+    record->size = size;
+    record->width = width;
+    record->height = height;
+    record->rowstride = rowbytes;
+    record->alpha = alpha;
+
+    dst = buf + sizeof(*record);
+    memcpy(dst, filename, pathlen);
+    dst += ENTANGLE_THUMBNAIL_STORE_ALIGN((guint64)pathlen);
+    /* The last row of a pixbuf may be shorter than its rowstride */
+    for (int y = 0; y < height; y++)
+        memcpy(dst + (gsize)y * rowbytes, pixels + (gsize)y * stride, rowbytes);
+
+    g_mutex_lock(&priv->lock);
+    if (priv->fd == -1) {
+        g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                    _("Thumbnail store %s is not open"), priv->filename);
+        goto cleanup;
+    }
+
+    if (!entangle_thumbnail_store_write(priv->fd, buf, length, priv->length)) {
+        g_set_error(error, ENTANGLE_THUMBNAIL_STORE_ERROR, 0,
+                    _("Unable to write thumbnail store %s: %s"),
+                    priv->filename, g_strerror(errno));
+        if (ftruncate(priv->fd, priv->length) < 0)
+            ENTANGLE_DEBUG("Unable to discard partial record in %s", priv->filename);
+        goto cleanup;
+    }
+
+    if ((old = g_hash_table_lookup(priv->entries, filename)))
+        priv->wasted += old->length;
+
+    entry = g_new0(EntangleThumbnailStoreEntry, 1);
+    entry->offset = priv->length;
+    entry->length = length;
+    g_hash_table_insert(priv->entries, g_strdup(filename), entry);
+    priv->length += length;
+    ret = TRUE;
+
+ cleanup:
+    g_mutex_unlock(&priv->lock);
+    g_free(buf);
+    return ret;
+}
+
+
+typedef struct _EntangleThumbnailStoreFile EntangleThumbnailStoreFile;
+
+struct _EntangleThumbnailStoreFile {
+    char *filename;
+    gint64 used;
+    guint64 size;
+};
+
+
+static gint entangle_thumbnail_store_file_compare(gconstpointer a,
+                                                  gconstpointer b)
+{
+    const EntangleThumbnailStoreFile *filea = *(EntangleThumbnailStoreFile *const *)a;
+    const EntangleThumbnailStoreFile *fileb = *(EntangleThumbnailStoreFile *const *)b;
+
+    if (filea->used < fileb->used)
+        return -1;
+    if (filea->used > fileb->used)
+        return 1;
+    return 0;
+}
+
+
+static void entangle_thumbnail_store_file_free(gpointer opaque)
+{
+    EntangleThumbnailStoreFile *file = opaque;
+
+    g_free(file->filename);
+    g_free(file);
+}
+
+
+static guint64 entangle_thumbnail_store_list_files(const char *dirname,
+                                                   const char *suffix,
+                                                   GPtrArray *files)
+{
+    GDir *dir;
+    const char *name;
+    guint64 total = 0;
+
+    if (!(dir = g_dir_open(dirname, 0, NULL)))
+        return 0;
+
+    while ((name = g_dir_read_name(dir))) {
+        EntangleThumbnailStoreFile *file;
+        GStatBuf sb;
+        char *filename;
+
+        if (!g_str_has_suffix(name, suffix))
+            continue;
+
+        filename = g_build_filename(dirname, name, NULL);
+        if (g_stat(filename, &sb) < 0 || !S_ISREG(sb.st_mode)) {
+            g_free(filename);
+            continue;
+        }
+
+        file = g_new0(EntangleThumbnailStoreFile, 1);
+        file->filename = filename;
+        file->size = sb.st_size;
+        /* Many filesystems are mounted noatime */
+        file->used = MAX(sb.st_atime, sb.st_mtime);
+        g_ptr_array_add(files, file);
+        total += file->size;
+    }
+
+    g_dir_close(dir);
+    return total;
+}
+
+
+/**
+ * entangle_thumbnail_store_collect_garbage:
+ * @limit: the most bytes to leave cached
+ *
+ * Delete the least recently used thumbnails until the total
+ * size of the freedesktop normal & large thumbnail caches and the
+ * session stores is within @limit. Stores which are currently
+ * open are never deleted. This does blocking I/O so is best
+ * run from a worker thread.
+ */
+void entangle_thumbnail_store_collect_garbage(guint64 limit)
+{
+    GPtrArray *files = g_ptr_array_new_with_free_func(entangle_thumbnail_store_file_free);
+    char *normal = g_build_filename(g_get_user_cache_dir(), "thumbnails", "normal", NULL);
+    char *large = g_build_filename(g_get_user_cache_dir(), "thumbnails", "large", NULL);
+    char *sessions = entangle_thumbnail_store_session_dir();
+    guint64 total = 0;
+    guint deleted = 0;
+
+    total += entangle_thumbnail_store_list_files(normal, ".png", files);
+    total += entangle_thumbnail_store_list_files(large, ".png", files);
+    total += entangle_thumbnail_store_list_files(sessions, ".thumbs", files);
+
+    ENTANGLE_DEBUG("Thumbnail cache holds %" G_GUINT64_FORMAT " bytes, limit %" G_GUINT64_FORMAT,
+                   total, limit);
+
+    g_ptr_array_sort(files, entangle_thumbnail_store_file_compare);
+
+    for (guint i = 0; i < files->len && total > limit; i++) {
+        EntangleThumbnailStoreFile *file = g_ptr_array_index(files, i);
+        gboolean open;
+
+        g_mutex_lock(&entangle_thumbnail_store_open_lock);
+        open = entangle_thumbnail_store_open_files &&
+            g_hash_table_lookup(entangle_thumbnail_store_open_files, file->filename);
+        if (!open && unlink(file->filename) == 0) {
+            total -= file->size;
+            deleted++;
+        }
+        g_mutex_unlock(&entangle_thumbnail_store_open_lock);
+    }
+
+    ENTANGLE_DEBUG("Deleted %u thumbnail files, %" G_GUINT64_FORMAT " bytes remain",
+                   deleted, total);
+
+    g_ptr_array_unref(files);
+    g_free(sessions);
+    g_free(large);
+    g_free(normal);
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,90 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_THUMBNAIL_STORE_H__
+#define __ENTANGLE_THUMBNAIL_STORE_H__
+
+#include <glib-object.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+#define ENTANGLE_TYPE_THUMBNAIL_STORE            (entangle_thumbnail_store_get_type ())
+#define ENTANGLE_THUMBNAIL_STORE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), ENTANGLE_TYPE_THUMBNAIL_STORE, EntangleThumbnailStore))
+#define ENTANGLE_THUMBNAIL_STORE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), ENTANGLE_TYPE_THUMBNAIL_STORE, EntangleThumbnailStoreClass))
+#define ENTANGLE_IS_THUMBNAIL_STORE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ENTANGLE_TYPE_THUMBNAIL_STORE))
+#define ENTANGLE_IS_THUMBNAIL_STORE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ENTANGLE_TYPE_THUMBNAIL_STORE))
+#define ENTANGLE_THUMBNAIL_STORE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), ENTANGLE_TYPE_THUMBNAIL_STORE, EntangleThumbnailStoreClass))
+
+
+typedef struct _EntangleThumbnailStore EntangleThumbnailStore;
+typedef struct _EntangleThumbnailStorePrivate EntangleThumbnailStorePrivate;
+typedef struct _EntangleThumbnailStoreClass EntangleThumbnailStoreClass;
+
+struct _EntangleThumbnailStore
+{
+    GObject parent;
+
+    EntangleThumbnailStorePrivate *priv;
+};
+
+struct _EntangleThumbnailStoreClass
+{
+    GObjectClass parent_class;
+};
+
+
+GType entangle_thumbnail_store_get_type(void) G_GNUC_CONST;
+
+EntangleThumbnailStore *entangle_thumbnail_store_new(const char *filename);
+EntangleThumbnailStore *entangle_thumbnail_store_new_for_session(const char *directory);
+
+const char *entangle_thumbnail_store_get_filename(EntangleThumbnailStore *store);
+
+gboolean entangle_thumbnail_store_open(EntangleThumbnailStore *store,
+                                       GError **error);
+
+GdkPixbuf *entangle_thumbnail_store_lookup(EntangleThumbnailStore *store,
+                                           const char *filename,
+                                           gint64 mtime,
+                                           gint64 size,
+                                           int width,
+                                           int height);
+gboolean entangle_thumbnail_store_save(EntangleThumbnailStore *store,
+                                       const char *filename,
+                                       gint64 mtime,
+                                       gint64 size,
+                                       GdkPixbuf *pixbuf,
+                                       GError **error);
+
+void entangle_thumbnail_store_collect_garbage(guint64 limit);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_THUMBNAIL_STORE_H__ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,282 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "entangle-debug.h"
+#include "entangle-tracer.h"
+
+/* Events per thread, must be a power of 2 */
+#define ENTANGLE_TRACER_RING_SIZE (1 << 15)
+
+typedef struct _EntangleTracerRecord EntangleTracerRecord;
+typedef struct _EntangleTracerRing EntangleTracerRing;
+
+struct _EntangleTracerRecord {
+    const char *name;
+    gint64 when;
+    gint64 value;
+    EntangleTracerEvent type;
+};
+
+struct _EntangleTracerRing {
+    guint tid;
+    gboolean main;
+    /* Set once its thread has exited, so another can take it */
+    gboolean idle;
+    guint head;
+    EntangleTracerRecord records[ENTANGLE_TRACER_RING_SIZE];
+};
+
+gboolean entangle_tracer_enabled = FALSE;
+
+static char *entangle_tracer_filename;
+static gint64 entangle_tracer_start;
+static GThread *entangle_tracer_main;
+
+static void entangle_tracer_ring_retire(gpointer data);
+static GPrivate entangle_tracer_ring = G_PRIVATE_INIT(entangle_tracer_ring_retire);
+
+/* Only taken when a thread records its first event or exits */
+static GMutex entangle_tracer_lock;
+static GPtrArray *entangle_tracer_rings;
+
+#define ENTANGLE_TRACER_ERROR entangle_tracer_error_quark()
+
+static GQuark entangle_tracer_error_quark(void)
+{
+    return g_quark_from_static_string("entangle-tracer");
+}
+
+
+/**
+ * entangle_tracer_setup:
+ * @filename: the file to write the trace to
+ *
+ * Enable recording of trace events, to be written to
+ * @filename when entangle_tracer_save is called
+ */
+void entangle_tracer_setup(const char *filename)
+{
+    g_free(entangle_tracer_filename);
+    entangle_tracer_filename = g_strdup(filename);
+    entangle_tracer_start = g_get_monotonic_time();
+    entangle_tracer_main = g_thread_self();
+    entangle_tracer_rings = g_ptr_array_new();
+    entangle_tracer_enabled = TRUE;
+    ENTANGLE_DEBUG("Tracing to %s", filename);
+}
+
+
+/*
+ * Rings outlive their threads, since their events are only
+ * written out when the trace is saved. Thread pools replace
+ * idle threads all the time though, so a new thread carries
+ * on with the ring of one which has exited, rather than
+ * allocating yet another.
+ */
+static void entangle_tracer_ring_retire(gpointer data)
+{
+    EntangleTracerRing *ring = data;
+
+    g_mutex_lock(&entangle_tracer_lock);
+    ring->idle = TRUE;
+    g_mutex_unlock(&entangle_tracer_lock);
+}
+
+
+static EntangleTracerRing *entangle_tracer_get_ring(void)
+{
+    EntangleTracerRing *ring = g_private_get(&entangle_tracer_ring);
+    gboolean main;
+    gsize i;
+
+    if (G_LIKELY(ring))
+        return ring;
+
+    main = g_thread_self() == entangle_tracer_main;
+
+    g_mutex_lock(&entangle_tracer_lock);
+    for (i = 0; i < entangle_tracer_rings->len; i++) {
+        EntangleTracerRing *tmp = g_ptr_array_index(entangle_tracer_rings, i);
+        if (tmp->idle && tmp->main == main) {
+            ring = tmp;
+            ring->idle = FALSE;
+            break;
+        }
+    }
+    if (!ring) {
+        ring = g_new0(EntangleTracerRing, 1);
+        ring->tid = entangle_tracer_rings->len + 1;
+        ring->main = main;
+        g_ptr_array_add(entangle_tracer_rings, ring);
+    }
+    g_mutex_unlock(&entangle_tracer_lock);
+
+    g_private_set(&entangle_tracer_ring, ring);
+    return ring;
+}
+
+
+/**
+ * entangle_tracer_record:
+ * @type: the kind of event
+ * @name: the span or counter name, which must be static
+ * @value: the counter value
+ *
+ * Record an event on the calling thread's ring. Callers
+ * should use the ENTANGLE_TRACE_* macros instead, which skip
+ * the call entirely when tracing is disabled.
+ */
+void entangle_tracer_record(EntangleTracerEvent type,
+                            const char *name,
+                            gint64 value)
+{
+    EntangleTracerRing *ring = entangle_tracer_get_ring();
+    guint head = ring->head;
+    EntangleTracerRecord *record = &ring->records[head & (ENTANGLE_TRACER_RING_SIZE - 1)];
+
+    record->name = name;
+    record->when = g_get_monotonic_time();
+    record->value = value;
+    record->type = type;
+
+    /* Publishes the record to the reader */
+    g_atomic_int_set(&ring->head, head + 1);
+}
+
+
+static void entangle_tracer_write_ring(FILE *fp,
+                                       EntangleTracerRing *ring,
+                                       gboolean *first)
+{
+    guint head = g_atomic_int_get(&ring->head);
+    guint count = MIN(head, ENTANGLE_TRACER_RING_SIZE);
+    guint depth = 0;
+    guint i;
+
+    for (i = head - count; i != head; i++) {
+        EntangleTracerRecord *record = &ring->records[i & (ENTANGLE_TRACER_RING_SIZE - 1)];
+        gint64 when = record->when - entangle_tracer_start;
+
+        /* Spans nest within a thread, so an END with no open
+         * span is one whose BEGIN the ring has overwritten */
+        if (record->type == ENTANGLE_TRACER_EVENT_BEGIN) {
+            depth++;
+        } else if (record->type == ENTANGLE_TRACER_EVENT_END) {
+            if (!depth)
+                continue;
+            depth--;
+        }
+
+        fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"entangle\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%" G_GINT64_FORMAT,
+                *first ? "" : ",", record->name, ring->tid, when);
+        *first = FALSE;
+
+        switch (record->type) {
+        case ENTANGLE_TRACER_EVENT_BEGIN:
+            fprintf(fp, ",\"ph\":\"B\"}");
+            break;
+        case ENTANGLE_TRACER_EVENT_END:
+            fprintf(fp, ",\"ph\":\"E\"}");
+            break;
+        case ENTANGLE_TRACER_EVENT_COUNTER:
+        default:
+            fprintf(fp, ",\"ph\":\"C\",\"args\":{\"value\":%" G_GINT64_FORMAT "}}",
+                    record->value);
+            break;
+        }
+    }
+}
+
+
+/**
+ * entangle_tracer_save:
+ * @error: the error details
+ *
+ * Write all events recorded so far to the trace file given
+ * to entangle_tracer_setup. Threads may continue to record
+ * while this runs, so events at the very start of a full
+ * ring may be garbled; saving once all work has stopped
+ * avoids this.
+ *
+ * Returns: TRUE if the trace was written, FALSE on error
+ */
+gboolean entangle_tracer_save(GError **error)
+{
+    FILE *fp;
+    gboolean first = TRUE;
+    gboolean failed;
+    gsize i;
+
+    if (!entangle_tracer_enabled)
+        return TRUE;
+
+    if (!(fp = fopen(entangle_tracer_filename, "w"))) {
+        g_set_error(error, ENTANGLE_TRACER_ERROR, 0,
+                    _("Unable to create trace %s: %s"),
+                    entangle_tracer_filename, g_strerror(errno));
+        return FALSE;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    g_mutex_lock(&entangle_tracer_lock);
+    for (i = 0; i < entangle_tracer_rings->len; i++) {
+        EntangleTracerRing *ring = g_ptr_array_index(entangle_tracer_rings, i);
+
+        fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"%s %u\"}}",
+                first ? "" : ",", ring->tid,
+                ring->main ? "main" : "worker", ring->tid);
+        first = FALSE;
+        entangle_tracer_write_ring(fp, ring, &first);
+    }
+    g_mutex_unlock(&entangle_tracer_lock);
+
+    fprintf(fp, "\n]}\n");
+
+    failed = ferror(fp) != 0;
+    if (fclose(fp) != 0 || failed) {
+        g_set_error(error, ENTANGLE_TRACER_ERROR, 0,
+                    _("Unable to write trace %s: %s"),
+                    entangle_tracer_filename, g_strerror(errno));
+        return FALSE;
+    }
+
+    ENTANGLE_DEBUG("Saved trace to %s", entangle_tracer_filename);
+    return TRUE;
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,83 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_TRACER_H__
+#define __ENTANGLE_TRACER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A span & counter tracer for finding where time goes. Each
+ * thread records into its own fixed size ring, so the hot
+ * path is a flag test, a clock read and a few stores, with no
+ * locks or formatting. When the ring fills, the oldest events
+ * are overwritten. Names must be string literals, since only
+ * the pointer is recorded. The rings are written out as
+ * Chrome trace JSON, which Perfetto & chrome://tracing load.
+ */
+
+typedef enum {
+    ENTANGLE_TRACER_EVENT_BEGIN,
+    ENTANGLE_TRACER_EVENT_END,
+    ENTANGLE_TRACER_EVENT_COUNTER,
+} EntangleTracerEvent;
+
+extern gboolean entangle_tracer_enabled;
+
+void entangle_tracer_setup(const char *filename);
+gboolean entangle_tracer_save(GError **error);
+
+void entangle_tracer_record(EntangleTracerEvent type,
+                            const char *name,
+                            gint64 value);
+
+#define ENTANGLE_TRACE_BEGIN(name)                                      \
+    do {                                                                \
+        if (G_UNLIKELY(entangle_tracer_enabled))                        \
+            entangle_tracer_record(ENTANGLE_TRACER_EVENT_BEGIN, name, 0); \
+    } while (0)
+
+#define ENTANGLE_TRACE_END(name)                                        \
+    do {                                                                \
+        if (G_UNLIKELY(entangle_tracer_enabled))                        \
+            entangle_tracer_record(ENTANGLE_TRACER_EVENT_END, name, 0); \
+    } while (0)
+
+#define ENTANGLE_TRACE_COUNTER(name, value)                             \
+    do {                                                                \
+        if (G_UNLIKELY(entangle_tracer_enabled))                        \
+            entangle_tracer_record(ENTANGLE_TRACER_EVENT_COUNTER, name, value); \
+    } while (0)
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_TRACER_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,9 @@
+#!/bin/sh
+#
+# Run by 'make check'. A short stress of the pixbuf loader,
+# which fails on the leaks & lost signals it can see itself,
+# and aborts rather than hang on a deadlock. Worth running
+# in a tree configured with --enable-sanitizers=thread, and
+# again with --enable-sanitizers (address,undefined)
+
+exec ./entangle-bench --stress --stress-ops=2000 --stress-timeout=300 "$@"
@@ -0,0 +1,1239 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "entangle-debug.h"
+#include "entangle-camera-file.h"
+#include "entangle-colour-profile.h"
+#include "entangle-image.h"
+#include "entangle-pixbuf.h"
+#include "entangle-session.h"
+#include "entangle-thumbnail-loader.h"
+
+/*
+ * Times the backend image pipeline against generated fixtures,
+ * reporting latency percentiles & throughput as JSON, so runs
+ * against different commits can be compared mechanically.
+ */
+
+typedef enum {
+    ENTANGLE_BENCH_FORMAT_JPEG,
+    ENTANGLE_BENCH_FORMAT_PNG,
+    ENTANGLE_BENCH_FORMAT_TIFF,
+    ENTANGLE_BENCH_FORMAT_DNG,
+
+    ENTANGLE_BENCH_FORMAT_LAST
+} EntangleBenchFormat;
+
+static const char *const entangle_bench_formats[] = {
+    "jpeg", "png", "tiff", "dng",
+};
+
+static const char *const entangle_bench_slots[] = {
+    "master", "preview", "thumbnail",
+};
+
+typedef struct _EntangleBenchFixture EntangleBenchFixture;
+typedef struct _EntangleBenchResult EntangleBenchResult;
+
+struct _EntangleBenchFixture {
+    EntangleBenchFormat format;
+    int width;
+    int height;
+    char *filename;
+};
+
+struct _EntangleBenchResult {
+    char *name;
+    char *format;
+    char *slot;
+    int width;
+    int height;
+    GArray *samples; /* double, milliseconds */
+    guint errors;
+    double units;    /* work per sample, in throughput units */
+    const char *unit;
+};
+
+static int entangle_bench_iterations = 5;
+static char *entangle_bench_sizes = NULL;
+static char *entangle_bench_profile = NULL;
+static char *entangle_bench_output = NULL;
+static int entangle_bench_session_images = 200;
+static gboolean entangle_bench_keep = FALSE;
+static gboolean entangle_bench_stress_loader = FALSE;
+static int entangle_bench_stress_ops = 20000;
+static int entangle_bench_stress_threads = 8;
+static int entangle_bench_stress_workers = 8;
+static int entangle_bench_stress_image_count = 64;
+static int entangle_bench_stress_timeout = 0;
+
+
+static EntangleBenchResult *entangle_bench_result_new(const char *name,
+                                                      const char *format,
+                                                      const char *slot,
+                                                      int width,
+                                                      int height,
+                                                      double units,
+                                                      const char *unit)
+{
+    EntangleBenchResult *result = g_new0(EntangleBenchResult, 1);
+
+    result->name = g_strdup(name);
+    result->format = g_strdup(format);
+    result->slot = g_strdup(slot);
+    result->width = width;
+    result->height = height;
+    result->samples = g_array_new(FALSE, FALSE, sizeof(double));
+    result->units = units;
+    result->unit = unit;
+    return result;
+}
+
+
+static void entangle_bench_result_free(gpointer opaque)
+{
+    EntangleBenchResult *result = opaque;
+
+    g_array_unref(result->samples);
+    g_free(result->name);
+    g_free(result->format);
+    g_free(result->slot);
+    g_free(result);
+}
+
+
+static void entangle_bench_result_add(EntangleBenchResult *result,
+                                      gint64 startus,
+                                      gboolean ok)
+{
+    double ms = (g_get_monotonic_time() - startus) / 1000.0;
+
+    if (ok)
+        g_array_append_val(result->samples, ms);
+    else
+        result->errors++;
+}
+
+
+static int entangle_bench_compare_double(gconstpointer a, gconstpointer b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+
+/* Nearest rank, on already sorted samples */
+static double entangle_bench_percentile(GArray *samples, double pct)
+{
+    gsize idx;
+
+    if (!samples->len)
+        return 0;
+
+    idx = (gsize)ceil((pct / 100.0) * samples->len);
+    if (idx > 0)
+        idx--;
+    if (idx >= samples->len)
+        idx = samples->len - 1;
+    return g_array_index(samples, double, idx);
+}
+
+
+static void entangle_bench_json_string(GString *str, const char *key, const char *val)
+{
+    gchar *tmp = g_strescape(val ? val : "", NULL);
+
+    g_string_append_printf(str, "\"%s\": \"%s\"", key, tmp);
+    g_free(tmp);
+}
+
+
+static void entangle_bench_json_double(GString *str, const char *key, double val)
+{
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf(str, "\"%s\": %s", key,
+                           g_ascii_formatd(buf, sizeof(buf), "%.4f", val));
+}
+
+
+static void entangle_bench_report_result(GString *str,
+                                         EntangleBenchResult *result)
+{
+    double total = 0;
+
+    g_array_sort(result->samples, entangle_bench_compare_double);
+    for (gsize i = 0; i < result->samples->len; i++)
+        total += g_array_index(result->samples, double, i);
+
+    g_string_append(str, "    {");
+    entangle_bench_json_string(str, "name", result->name);
+    if (result->format) {
+        g_string_append(str, ", ");
+        entangle_bench_json_string(str, "format", result->format);
+    }
+    if (result->slot) {
+        g_string_append(str, ", ");
+        entangle_bench_json_string(str, "slot", result->slot);
+    }
+    if (result->width) {
+        g_string_append_printf(str, ", \"width\": %d, \"height\": %d",
+                               result->width, result->height);
+    }
+    g_string_append_printf(str, ", \"samples\": %u, \"errors\": %u, ",
+                           result->samples->len, result->errors);
+    entangle_bench_json_double(str, "min_ms",
+                               entangle_bench_percentile(result->samples, 0));
+    g_string_append(str, ", ");
+    entangle_bench_json_double(str, "mean_ms",
+                               result->samples->len ? total / result->samples->len : 0);
+    g_string_append(str, ", ");
+    entangle_bench_json_double(str, "p50_ms",
+                               entangle_bench_percentile(result->samples, 50));
+    g_string_append(str, ", ");
+    entangle_bench_json_double(str, "p90_ms",
+                               entangle_bench_percentile(result->samples, 90));
+    g_string_append(str, ", ");
+    entangle_bench_json_double(str, "p99_ms",
+                               entangle_bench_percentile(result->samples, 99));
+    g_string_append(str, ", ");
+    entangle_bench_json_double(str, "max_ms",
+                               entangle_bench_percentile(result->samples, 100));
+    g_string_append(str, ", ");
+    entangle_bench_json_double(str, "throughput",
+                               total > 0 ? (result->units * result->samples->len) / (total / 1000.0) : 0);
+    g_string_append(str, ", ");
+    entangle_bench_json_string(str, "throughput_unit", result->unit);
+    g_string_append(str, "}");
+}
+
+
+static char *entangle_bench_report(GPtrArray *results)
+{
+    GString *str = g_string_new("{\n");
+    GDateTime *now = g_date_time_new_now_utc();
+    gchar *stamp = g_date_time_format(now, "%Y-%m-%dT%H:%M:%SZ");
+
+    g_string_append(str, "  ");
+    entangle_bench_json_string(str, "version", VERSION);
+    g_string_append(str, ",\n  ");
+    entangle_bench_json_string(str, "timestamp", stamp);
+    g_string_append_printf(str, ",\n  \"iterations\": %d,\n  \"results\": [\n",
+                           entangle_bench_iterations);
+
+    for (gsize i = 0; i < results->len; i++) {
+        entangle_bench_report_result(str, g_ptr_array_index(results, i));
+        g_string_append(str, i == (results->len - 1) ? "\n" : ",\n");
+    }
+    g_string_append(str, "  ]\n}\n");
+
+    g_free(stamp);
+    g_date_time_unref(now);
+    return g_string_free(str, FALSE);
+}
+
+
+static gboolean entangle_bench_write_report(GPtrArray *results)
+{
+    char *report = entangle_bench_report(results);
+    GError *error = NULL;
+    gboolean ret = TRUE;
+
+    if (entangle_bench_output) {
+        if (!g_file_set_contents(entangle_bench_output, report, -1, &error)) {
+            g_printerr("Unable to write %s: %s\n",
+                       entangle_bench_output, error->message);
+            g_error_free(error);
+            ret = FALSE;
+        }
+    } else {
+        fputs(report, stdout);
+    }
+
+    g_free(report);
+    return ret;
+}
+
+
+/*
+ * Fixtures
+ */
+
+static GdkPixbuf *entangle_bench_pattern(int width, int height)
+{
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
+    int stride = gdk_pixbuf_get_rowstride(pixbuf);
+
+    /* Gradients plus some high frequency detail, so the
+     * encoders have realistic work to do */
+    for (int y = 0; y < height; y++) {
+        guchar *row = pixels + (y * stride);
+        for (int x = 0; x < width; x++) {
+            row[(x * 3) + 0] = (x * 255) / width;
+            row[(x * 3) + 1] = (y * 255) / height;
+            row[(x * 3) + 2] = ((x ^ y) & 0x10) ? 200 : 40;
+        }
+    }
+
+    return pixbuf;
+}
+
+
+static void entangle_bench_put16(GByteArray *buf, guint16 val)
+{
+    guint8 b[2] = { val & 0xff, val >> 8 };
+    g_byte_array_append(buf, b, sizeof(b));
+}
+
+
+static void entangle_bench_put32(GByteArray *buf, guint32 val)
+{
+    guint8 b[4] = { val & 0xff, (val >> 8) & 0xff, (val >> 16) & 0xff, val >> 24 };
+    g_byte_array_append(buf, b, sizeof(b));
+}
+
+
+static void entangle_bench_dng_tag(GByteArray *ifd,
+                                   GByteArray *extra,
+                                   guint32 extraBase,
+                                   guint16 tag,
+                                   guint16 type,
+                                   guint32 count,
+                                   const guint8 *value,
+                                   gsize len)
+{
+    entangle_bench_put16(ifd, tag);
+    entangle_bench_put16(ifd, type);
+    entangle_bench_put32(ifd, count);
+    if (len <= 4) {
+        guint8 inline_value[4] = { 0 };
+        memcpy(inline_value, value, len);
+        g_byte_array_append(ifd, inline_value, sizeof(inline_value));
+    } else {
+        entangle_bench_put32(ifd, extraBase + extra->len);
+        g_byte_array_append(extra, value, len);
+        if (extra->len & 1)
+            g_byte_array_append(extra, (const guint8 *)"", 1);
+    }
+}
+
+
+static void entangle_bench_dng_short(GByteArray *ifd, GByteArray *extra,
+                                     guint32 extraBase, guint16 tag, guint16 val)
+{
+    guint8 b[2] = { val & 0xff, val >> 8 };
+    entangle_bench_dng_tag(ifd, extra, extraBase, tag, 3, 1, b, sizeof(b));
+}
+
+
+static void entangle_bench_dng_long(GByteArray *ifd, GByteArray *extra,
+                                    guint32 extraBase, guint16 tag, guint32 val)
+{
+    guint8 b[4] = { val & 0xff, (val >> 8) & 0xff, (val >> 16) & 0xff, val >> 24 };
+    entangle_bench_dng_tag(ifd, extra, extraBase, tag, 4, 1, b, sizeof(b));
+}
+
+
+static void entangle_bench_dng_ascii(GByteArray *ifd, GByteArray *extra,
+                                     guint32 extraBase, guint16 tag, const char *val)
+{
+    entangle_bench_dng_tag(ifd, extra, extraBase, tag, 2, strlen(val) + 1,
+                           (const guint8 *)val, strlen(val) + 1);
+}
+
+
+/*
+ * There is nothing in the dependency stack which can write
+ * raw files, so build a minimal uncompressed LinearRaw DNG
+ * by hand, which libraw can then develop like a camera raw.
+ */
+#define ENTANGLE_BENCH_DNG_TAGS 19
+
+static gboolean entangle_bench_write_dng(GdkPixbuf *pixbuf,
+                                         const char *filename,
+                                         GError **error)
+{
+    int width = gdk_pixbuf_get_width(pixbuf);
+    int height = gdk_pixbuf_get_height(pixbuf);
+    int stride = gdk_pixbuf_get_rowstride(pixbuf);
+    const guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
+    guint32 extraBase = 8 + 2 + (ENTANGLE_BENCH_DNG_TAGS * 12) + 4;
+    GByteArray *file = g_byte_array_new();
+    GByteArray *ifd = g_byte_array_new();
+    GByteArray *extra = g_byte_array_new();
+    const guint8 bits[] = { 16, 0, 16, 0, 16, 0 };
+    const guint8 version[] = { 1, 4, 0, 0 };
+    guint8 matrix[9 * 8];
+    guint8 neutral[3 * 8];
+    gsize stripOffsetPos;
+    guint32 dataOffset;
+    gboolean ret;
+
+    for (int i = 0; i < 9; i++) {
+        gint32 num = (i % 4) == 0 ? 1 : 0;
+        guint32 den = 1;
+        for (int j = 0; j < 4; j++) {
+            matrix[(i * 8) + j] = ((guint32)num >> (j * 8)) & 0xff;
+            matrix[(i * 8) + 4 + j] = (den >> (j * 8)) & 0xff;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            neutral[(i * 8) + j] = j == 0 ? 1 : 0;
+            neutral[(i * 8) + 4 + j] = j == 0 ? 1 : 0;
+        }
+    }
+
+    /* Tags must be in ascending order */
+    entangle_bench_put16(ifd, ENTANGLE_BENCH_DNG_TAGS);
+    entangle_bench_dng_long(ifd, extra, extraBase, 254, 0);
+    entangle_bench_dng_long(ifd, extra, extraBase, 256, width);
+    entangle_bench_dng_long(ifd, extra, extraBase, 257, height);
+    entangle_bench_dng_tag(ifd, extra, extraBase, 258, 3, 3, bits, sizeof(bits));
+    entangle_bench_dng_short(ifd, extra, extraBase, 259, 1);
+    entangle_bench_dng_short(ifd, extra, extraBase, 262, 34892);
+    entangle_bench_dng_ascii(ifd, extra, extraBase, 271, "Entangle");
+    entangle_bench_dng_ascii(ifd, extra, extraBase, 272, "Bench");
+    stripOffsetPos = ifd->len + 8;
+    entangle_bench_dng_long(ifd, extra, extraBase, 273, 0);
+    entangle_bench_dng_short(ifd, extra, extraBase, 274, 1);
+    entangle_bench_dng_short(ifd, extra, extraBase, 277, 3);
+    entangle_bench_dng_long(ifd, extra, extraBase, 278, height);
+    entangle_bench_dng_long(ifd, extra, extraBase, 279, width * height * 6);
+    entangle_bench_dng_short(ifd, extra, extraBase, 284, 1);
+    entangle_bench_dng_tag(ifd, extra, extraBase, 50706, 1, 4, version, sizeof(version));
+    entangle_bench_dng_ascii(ifd, extra, extraBase, 50708, "Entangle Bench");
+    entangle_bench_dng_tag(ifd, extra, extraBase, 50721, 10, 9, matrix, sizeof(matrix));
+    entangle_bench_dng_tag(ifd, extra, extraBase, 50728, 5, 3, neutral, sizeof(neutral));
+    entangle_bench_dng_short(ifd, extra, extraBase, 50778, 21);
+    entangle_bench_put32(ifd, 0);
+    g_assert(ifd->len == extraBase - 8);
+
+    dataOffset = extraBase + extra->len;
+    ifd->data[stripOffsetPos + 0] = dataOffset & 0xff;
+    ifd->data[stripOffsetPos + 1] = (dataOffset >> 8) & 0xff;
+    ifd->data[stripOffsetPos + 2] = (dataOffset >> 16) & 0xff;
+    ifd->data[stripOffsetPos + 3] = dataOffset >> 24;
+
+    g_byte_array_append(file, (const guint8 *)"II", 2);
+    entangle_bench_put16(file, 42);
+    entangle_bench_put32(file, 8);
+    g_byte_array_append(file, ifd->data, ifd->len);
+    g_byte_array_append(file, extra->data, extra->len);
+
+    for (int y = 0; y < height; y++) {
+        const guchar *row = pixels + (y * stride);
+        for (int x = 0; x < width * 3; x++)
+            entangle_bench_put16(file, row[x] << 8);
+    }
+
+    ret = g_file_set_contents(filename, (const char *)file->data, file->len, error);
+
+    g_byte_array_unref(extra);
+    g_byte_array_unref(ifd);
+    g_byte_array_unref(file);
+    return ret;
+}
+
+
+static EntangleBenchFixture *entangle_bench_fixture_new(const char *dir,
+                                                        EntangleBenchFormat format,
+                                                        int width,
+                                                        int height)
+{
+    EntangleBenchFixture *fixture = g_new0(EntangleBenchFixture, 1);
+    GdkPixbuf *pixbuf = entangle_bench_pattern(width, height);
+    gchar *name = g_strdup_printf("fixture-%dx%d.%s", width, height,
+                                  entangle_bench_formats[format]);
+    GError *error = NULL;
+    gboolean ok;
+
+    fixture->format = format;
+    fixture->width = width;
+    fixture->height = height;
+    fixture->filename = g_build_filename(dir, name, NULL);
+
+    switch (format) {
+    case ENTANGLE_BENCH_FORMAT_JPEG:
+        ok = gdk_pixbuf_save(pixbuf, fixture->filename, "jpeg", &error,
+                             "quality", "90", NULL);
+        break;
+    case ENTANGLE_BENCH_FORMAT_PNG:
+        ok = gdk_pixbuf_save(pixbuf, fixture->filename, "png", &error, NULL);
+        break;
+    case ENTANGLE_BENCH_FORMAT_TIFF:
+        ok = gdk_pixbuf_save(pixbuf, fixture->filename, "tiff", &error, NULL);
+        break;
+    case ENTANGLE_BENCH_FORMAT_DNG:
+        ok = entangle_bench_write_dng(pixbuf, fixture->filename, &error);
+        break;
+    case ENTANGLE_BENCH_FORMAT_LAST:
+    default:
+        g_assert_not_reached();
+    }
+
+    if (!ok) {
+        g_printerr("Unable to create fixture %s: %s\n",
+                   fixture->filename, error->message);
+        g_error_free(error);
+        g_free(fixture->filename);
+        g_free(fixture);
+        fixture = NULL;
+    }
+
+    g_object_unref(pixbuf);
+    g_free(name);
+    return fixture;
+}
+
+
+static void entangle_bench_fixture_free(gpointer opaque)
+{
+    EntangleBenchFixture *fixture = opaque;
+
+    g_free(fixture->filename);
+    g_free(fixture);
+}
+
+
+static void entangle_bench_remove_tree(const char *path)
+{
+    GDir *dir;
+    const char *name;
+
+    if ((dir = g_dir_open(path, 0, NULL))) {
+        while ((name = g_dir_read_name(dir))) {
+            gchar *child = g_build_filename(path, name, NULL);
+            entangle_bench_remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+        g_rmdir(path);
+    } else {
+        g_unlink(path);
+    }
+}
+
+
+/*
+ * Benchmarks
+ */
+
+static void entangle_bench_open_image(GPtrArray *results,
+                                      EntangleBenchFixture *fixture)
+{
+    for (int slot = ENTANGLE_PIXBUF_IMAGE_SLOT_MASTER;
+         slot <= ENTANGLE_PIXBUF_IMAGE_SLOT_THUMBNAIL; slot++) {
+        EntangleBenchResult *result =
+            entangle_bench_result_new("open_image",
+                                      entangle_bench_formats[fixture->format],
+                                      entangle_bench_slots[slot],
+                                      fixture->width, fixture->height,
+                                      (fixture->width * fixture->height) / 1000000.0,
+                                      "Mpixel/s");
+
+        for (int i = 0; i < entangle_bench_iterations; i++) {
+            EntangleImage *image = entangle_image_new_file(fixture->filename);
+            GExiv2Metadata *metadata = NULL;
+            gint64 start = g_get_monotonic_time();
+            GdkPixbuf *pixbuf = entangle_pixbuf_open_image(image, slot, TRUE, FALSE, &metadata, NULL);
+
+            entangle_bench_result_add(result, start, pixbuf != NULL);
+
+            if (pixbuf)
+                g_object_unref(pixbuf);
+            if (metadata)
+                g_object_unref(metadata);
+            g_object_unref(image);
+        }
+
+        g_ptr_array_add(results, result);
+    }
+}
+
+
+static void entangle_bench_thumbnail_loaded(EntanglePixbufLoader *loader G_GNUC_UNUSED,
+                                            EntangleImage *image G_GNUC_UNUSED,
+                                            gpointer opaque)
+{
+    g_main_loop_quit(opaque);
+}
+
+
+static gboolean entangle_bench_thumbnail_timeout(gpointer opaque)
+{
+    g_main_loop_quit(opaque);
+    return FALSE;
+}
+
+
+/*
+ * Measured through the public loader API, so includes the
+ * worker thread hand-off & idle dispatch the UI sees
+ */
+static void entangle_bench_thumbnail(GPtrArray *results,
+                                     EntangleBenchFixture *fixture,
+                                     const char *thumbdir,
+                                     gboolean cached)
+{
+    EntangleBenchResult *result =
+        entangle_bench_result_new(cached ? "thumbnail_cached" : "thumbnail_generate",
+                                  entangle_bench_formats[fixture->format],
+                                  NULL,
+                                  fixture->width, fixture->height,
+                                  1, "thumbnail/s");
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+    for (int i = 0; i < entangle_bench_iterations; i++) {
+        EntangleThumbnailLoader *loader = entangle_thumbnail_loader_new(256, 256);
+        EntangleImage *image = entangle_image_new_file(fixture->filename);
+        gulong sigid;
+        guint timeout;
+        gint64 start;
+
+        if (!cached)
+            entangle_bench_remove_tree(thumbdir);
+
+        sigid = g_signal_connect(loader, "pixbuf-loaded",
+                                 G_CALLBACK(entangle_bench_thumbnail_loaded), loop);
+        timeout = g_timeout_add_seconds(60, entangle_bench_thumbnail_timeout, loop);
+
+        start = g_get_monotonic_time();
+        entangle_pixbuf_loader_load(ENTANGLE_PIXBUF_LOADER(loader), image);
+        g_main_loop_run(loop);
+        entangle_bench_result_add(result, start,
+                                  entangle_pixbuf_loader_get_pixbuf(ENTANGLE_PIXBUF_LOADER(loader),
+                                                                    image) != NULL);
+
+        g_source_remove(timeout);
+        g_signal_handler_disconnect(loader, sigid);
+        entangle_pixbuf_loader_unload(ENTANGLE_PIXBUF_LOADER(loader), image);
+        g_object_unref(image);
+        g_object_unref(loader);
+    }
+
+    g_main_loop_unref(loop);
+    g_ptr_array_add(results, result);
+}
+
+
+static void entangle_bench_colour_transform(GPtrArray *results,
+                                            EntangleBenchFixture *fixture)
+{
+    EntangleColourProfile *profile;
+    EntangleColourProfileTransform *transform;
+    GdkPixbuf *pixbuf;
+    EntangleBenchResult *result;
+
+    if (!entangle_bench_profile)
+        return;
+
+    profile = entangle_colour_profile_new_file(entangle_bench_profile);
+    transform = entangle_colour_profile_transform_new(profile, profile,
+                                                      ENTANGLE_COLOUR_PROFILE_INTENT_PERCEPTUAL);
+    pixbuf = entangle_bench_pattern(fixture->width, fixture->height);
+    result = entangle_bench_result_new("colour_transform", NULL, NULL,
+                                       fixture->width, fixture->height,
+                                       (fixture->width * fixture->height) / 1000000.0,
+                                       "Mpixel/s");
+
+    for (int i = 0; i < entangle_bench_iterations; i++) {
+        gint64 start = g_get_monotonic_time();
+        GdkPixbuf *out = entangle_colour_profile_transform_apply(transform, pixbuf);
+
+        entangle_bench_result_add(result, start, out != NULL);
+        if (out)
+            g_object_unref(out);
+    }
+
+    g_ptr_array_add(results, result);
+    g_object_unref(pixbuf);
+    g_object_unref(transform);
+    g_object_unref(profile);
+}
+
+
+static void entangle_bench_auto_rotate(GPtrArray *results,
+                                       EntangleBenchFixture *fixture)
+{
+    GdkPixbuf *pixbuf = entangle_bench_pattern(fixture->width, fixture->height);
+    EntangleBenchResult *result =
+        entangle_bench_result_new("auto_rotate", NULL, NULL,
+                                  fixture->width, fixture->height,
+                                  (fixture->width * fixture->height) / 1000000.0,
+                                  "Mpixel/s");
+
+    /* A 90 degree rotation, the common portrait case */
+    g_object_set_data(G_OBJECT(pixbuf), "tEXt::Entangle::Orientation", (gpointer)"6");
+
+    for (int i = 0; i < entangle_bench_iterations; i++) {
+        gint64 start = g_get_monotonic_time();
+        GdkPixbuf *out = entangle_pixbuf_auto_rotate(pixbuf, NULL);
+
+        entangle_bench_result_add(result, start, out != NULL);
+        if (out)
+            g_object_unref(out);
+    }
+
+    g_ptr_array_add(results, result);
+    g_object_unref(pixbuf);
+}
+
+
+static void entangle_bench_session(GPtrArray *results,
+                                   EntangleBenchFixture *fixture,
+                                   const char *tmpdir)
+{
+    gchar *dir = g_build_filename(tmpdir, "session", NULL);
+    EntangleBenchResult *load =
+        entangle_bench_result_new("session_load", NULL, NULL, 0, 0,
+                                  entangle_bench_session_images, "image/s");
+    EntangleBenchResult *alloc =
+        entangle_bench_result_new("filename_allocate", NULL, NULL, 0, 0,
+                                  1, "filename/s");
+
+    g_mkdir_with_parents(dir, 0777);
+    for (int i = 0; i < entangle_bench_session_images; i++) {
+        gchar *name = g_strdup_printf("%s/bench%06d.jpg", dir, i);
+        if (symlink(fixture->filename, name) < 0)
+            g_printerr("Unable to link %s: %s\n", name, g_strerror(errno));
+        g_free(name);
+    }
+
+    for (int i = 0; i < entangle_bench_iterations; i++) {
+        gint64 start = g_get_monotonic_time();
+        EntangleSession *session = entangle_session_new(dir, "benchXXXXXX");
+        gboolean ok = entangle_session_load(session);
+
+        entangle_bench_result_add(load, start,
+                                  ok && entangle_session_image_count(session) ==
+                                  entangle_bench_session_images);
+        g_object_unref(session);
+    }
+
+    /* Each allocated name is created on disk, as a capture
+     * would, so later allocations see a growing directory */
+    for (int i = 0; i < entangle_bench_iterations; i++) {
+        EntangleSession *session = entangle_session_new(dir, "benchXXXXXX");
+
+        entangle_session_load(session);
+        for (int j = 0; j < 100; j++) {
+            gchar *srcname = g_strdup_printf("IMG_%04d.JPG", (i * 100) + j);
+            EntangleCameraFile *file = entangle_camera_file_new("/", srcname);
+            gint64 start = g_get_monotonic_time();
+            gchar *dstname = entangle_session_next_filename(session, file);
+
+            entangle_bench_result_add(alloc, start, dstname != NULL);
+            if (dstname)
+                g_file_set_contents(dstname, "", 0, NULL);
+
+            g_free(dstname);
+            g_object_unref(file);
+            g_free(srcname);
+        }
+        g_object_unref(session);
+    }
+
+    g_ptr_array_add(results, load);
+    g_ptr_array_add(results, alloc);
+    g_free(dir);
+}
+
+
+/*
+ * Loader stress
+ *
+ * Hammers load, unload & trigger_reload from many threads
+ * against a loader whose decode is a tiny synthetic pixbuf,
+ * then checks that held images were signalled & ready, and
+ * that every image & pixbuf is released afterwards.
+ */
+
+typedef struct _EntangleBenchLoader EntangleBenchLoader;
+typedef struct _EntangleBenchLoaderClass EntangleBenchLoaderClass;
+
+struct _EntangleBenchLoader {
+    EntanglePixbufLoader parent;
+};
+
+struct _EntangleBenchLoaderClass {
+    EntanglePixbufLoaderClass parent_class;
+};
+
+GType entangle_bench_loader_get_type(void) G_GNUC_CONST;
+
+G_DEFINE_TYPE(EntangleBenchLoader, entangle_bench_loader, ENTANGLE_TYPE_PIXBUF_LOADER);
+
+static gint entangle_bench_stress_inflight;
+static gint entangle_bench_stress_pixbufs;
+static gint entangle_bench_stress_images;
+static gint entangle_bench_stress_running;
+
+static GMutex entangle_bench_stress_lock;
+static GCond entangle_bench_stress_cond;
+static gboolean entangle_bench_stress_finished;
+
+
+static void entangle_bench_stress_pixbuf_gone(gpointer data G_GNUC_UNUSED,
+                                              GObject *object G_GNUC_UNUSED)
+{
+    g_atomic_int_add(&entangle_bench_stress_pixbufs, -1);
+}
+
+
+static void entangle_bench_stress_image_gone(gpointer data G_GNUC_UNUSED,
+                                             GObject *object G_GNUC_UNUSED)
+{
+    g_atomic_int_add(&entangle_bench_stress_images, -1);
+}
+
+
+static GdkPixbuf *entangle_bench_loader_pixbuf_load(EntanglePixbufLoader *loader G_GNUC_UNUSED,
+                                                    EntangleImage *image G_GNUC_UNUSED,
+                                                    GExiv2Metadata **metadata,
+                                                    GCancellable *cancel G_GNUC_UNUSED)
+{
+    GdkPixbuf *pixbuf;
+
+    g_atomic_int_inc(&entangle_bench_stress_inflight);
+    g_usleep(g_random_int_range(0, 500));
+
+    pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 16, 16);
+    g_atomic_int_inc(&entangle_bench_stress_pixbufs);
+    g_object_weak_ref(G_OBJECT(pixbuf), entangle_bench_stress_pixbuf_gone, NULL);
+    if (metadata)
+        *metadata = NULL;
+
+    g_atomic_int_add(&entangle_bench_stress_inflight, -1);
+    return pixbuf;
+}
+
+
+static void entangle_bench_loader_class_init(EntangleBenchLoaderClass *klass)
+{
+    EntanglePixbufLoaderClass *loader_class = ENTANGLE_PIXBUF_LOADER_CLASS(klass);
+
+    loader_class->pixbuf_load = entangle_bench_loader_pixbuf_load;
+}
+
+
+static void entangle_bench_loader_init(EntangleBenchLoader *loader G_GNUC_UNUSED)
+{
+}
+
+
+typedef struct _EntangleBenchStressThread EntangleBenchStressThread;
+
+struct _EntangleBenchStressThread {
+    EntanglePixbufLoader *loader;
+    GPtrArray *images;
+    guint32 seed;
+    int *held;
+    gint64 elapsed;
+};
+
+static gpointer entangle_bench_stress_thread(gpointer opaque)
+{
+    EntangleBenchStressThread *thread = opaque;
+    GRand *rand = g_rand_new_with_seed(thread->seed);
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < entangle_bench_stress_ops; i++) {
+        int idx = g_rand_int_range(rand, 0, thread->images->len);
+        EntangleImage *image = g_ptr_array_index(thread->images, idx);
+        int op = g_rand_int_range(rand, 0, 100);
+
+        if (op < 48) {
+            entangle_pixbuf_loader_load(thread->loader, image);
+            thread->held[idx]++;
+        } else if (op < 96) {
+            if (thread->held[idx]) {
+                entangle_pixbuf_loader_unload(thread->loader, image);
+                thread->held[idx]--;
+            }
+        } else if (op < 98) {
+            entangle_pixbuf_loader_trigger_reload(thread->loader);
+        } else {
+            g_thread_yield();
+        }
+    }
+
+    thread->elapsed = g_get_monotonic_time() - start;
+    g_rand_free(rand);
+    g_atomic_int_add(&entangle_bench_stress_running, -1);
+    return NULL;
+}
+
+
+static void entangle_bench_stress_loaded(EntanglePixbufLoader *loader G_GNUC_UNUSED,
+                                         EntangleImage *image,
+                                         gpointer opaque)
+{
+    GHashTable *signals = opaque;
+
+    g_hash_table_replace(signals, image,
+                         GINT_TO_POINTER(GPOINTER_TO_INT(g_hash_table_lookup(signals, image)) + 1));
+}
+
+
+/*
+ * A deadlock or lost wakeup would otherwise leave the run
+ * spinning forever, so give up after --stress-timeout seconds
+ */
+static gpointer entangle_bench_stress_watchdog(gpointer opaque G_GNUC_UNUSED)
+{
+    gint64 deadline = g_get_monotonic_time() +
+        (gint64)entangle_bench_stress_timeout * G_USEC_PER_SEC;
+
+    g_mutex_lock(&entangle_bench_stress_lock);
+    while (!entangle_bench_stress_finished) {
+        if (!g_cond_wait_until(&entangle_bench_stress_cond,
+                               &entangle_bench_stress_lock,
+                               deadline) &&
+            !entangle_bench_stress_finished) {
+            g_printerr("Stress did not finish within %d seconds\n",
+                       entangle_bench_stress_timeout);
+            abort();
+        }
+    }
+    g_mutex_unlock(&entangle_bench_stress_lock);
+
+    return NULL;
+}
+
+
+/* Run the main loop until workers & idle callbacks go quiet */
+static void entangle_bench_stress_drain(void)
+{
+    int quiet = 0;
+
+    while (quiet < 20) {
+        if (g_main_context_iteration(NULL, FALSE) ||
+            g_atomic_int_get(&entangle_bench_stress_inflight)) {
+            quiet = 0;
+        } else {
+            quiet++;
+            g_usleep(5 * 1000);
+        }
+    }
+}
+
+
+static guint entangle_bench_stress_check(EntanglePixbufLoader *loader,
+                                         GPtrArray *images,
+                                         int *held,
+                                         GHashTable *signals)
+{
+    guint errors = 0;
+
+    for (gsize i = 0; i < images->len; i++) {
+        EntangleImage *image = g_ptr_array_index(images, i);
+        gboolean ready = entangle_pixbuf_loader_is_ready(loader, image);
+
+        if (held[i] && !ready) {
+            g_printerr("%s held %d times but not ready\n",
+                       entangle_image_get_filename(image), held[i]);
+            errors++;
+        } else if (held[i] && !g_hash_table_lookup(signals, image)) {
+            g_printerr("%s ready but never signalled\n",
+                       entangle_image_get_filename(image));
+            errors++;
+        } else if (!held[i] && ready) {
+            g_printerr("%s not held but still loaded\n",
+                       entangle_image_get_filename(image));
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+
+static guint entangle_bench_stress(GPtrArray *results)
+{
+    EntanglePixbufLoader *loader;
+    GPtrArray *images = g_ptr_array_new_with_free_func(g_object_unref);
+    EntangleBenchStressThread *threads;
+    GHashTable *signals = g_hash_table_new(g_direct_hash, g_direct_equal);
+    int *held = g_new0(int, entangle_bench_stress_image_count);
+    EntangleBenchResult *result =
+        entangle_bench_result_new("loader_stress", NULL, NULL, 0, 0,
+                                  entangle_bench_stress_ops, "op/s");
+    GThread *watchdog = NULL;
+    guint errors = 0;
+
+    if (entangle_bench_stress_timeout)
+        watchdog = g_thread_new("stress-watchdog",
+                                entangle_bench_stress_watchdog, NULL);
+
+    loader = g_object_new(entangle_bench_loader_get_type(),
+                          "workers", entangle_bench_stress_workers,
+                          NULL);
+    g_signal_connect(loader, "pixbuf-loaded",
+                     G_CALLBACK(entangle_bench_stress_loaded), signals);
+
+    for (int i = 0; i < entangle_bench_stress_image_count; i++) {
+        gchar *filename = g_strdup_printf("/stress/image%04d.jpg", i);
+        EntangleImage *image = entangle_image_new_file(filename);
+
+        g_atomic_int_inc(&entangle_bench_stress_images);
+        g_object_weak_ref(G_OBJECT(image), entangle_bench_stress_image_gone, NULL);
+        g_ptr_array_add(images, image);
+        g_free(filename);
+    }
+
+    threads = g_new0(EntangleBenchStressThread, entangle_bench_stress_threads);
+    g_atomic_int_set(&entangle_bench_stress_running, entangle_bench_stress_threads);
+    for (int i = 0; i < entangle_bench_stress_threads; i++) {
+        GThread *th;
+
+        threads[i].loader = loader;
+        threads[i].images = images;
+        threads[i].seed = g_random_int();
+        threads[i].held = g_new0(int, entangle_bench_stress_image_count);
+        g_printerr("Stress thread %d seed %u\n", i, threads[i].seed);
+
+        th = g_thread_new("stress", entangle_bench_stress_thread, &threads[i]);
+        g_thread_unref(th);
+    }
+
+    /* Signals are emitted from idle callbacks, so keep the
+     * main loop turning while the threads run */
+    while (g_atomic_int_get(&entangle_bench_stress_running))
+        g_main_context_iteration(NULL, FALSE);
+    entangle_bench_stress_drain();
+
+    for (int i = 0; i < entangle_bench_stress_threads; i++) {
+        double ms = threads[i].elapsed / 1000.0;
+
+        for (int j = 0; j < entangle_bench_stress_image_count; j++)
+            held[j] += threads[i].held[j];
+        g_array_append_val(result->samples, ms);
+    }
+    errors += entangle_bench_stress_check(loader, images, held, signals);
+
+    /* Release everything still held, after which nothing
+     * should be left loaded */
+    for (int j = 0; j < entangle_bench_stress_image_count; j++) {
+        for (; held[j]; held[j]--)
+            entangle_pixbuf_loader_unload(loader, g_ptr_array_index(images, j));
+    }
+    entangle_bench_stress_drain();
+    errors += entangle_bench_stress_check(loader, images, held, signals);
+
+    g_object_unref(loader);
+    g_ptr_array_unref(images);
+    entangle_bench_stress_drain();
+
+    if (g_atomic_int_get(&entangle_bench_stress_images)) {
+        g_printerr("%d images leaked\n", g_atomic_int_get(&entangle_bench_stress_images));
+        errors++;
+    }
+    if (g_atomic_int_get(&entangle_bench_stress_pixbufs)) {
+        g_printerr("%d pixbufs leaked\n", g_atomic_int_get(&entangle_bench_stress_pixbufs));
+        errors++;
+    }
+
+    if (watchdog) {
+        g_mutex_lock(&entangle_bench_stress_lock);
+        entangle_bench_stress_finished = TRUE;
+        g_cond_signal(&entangle_bench_stress_cond);
+        g_mutex_unlock(&entangle_bench_stress_lock);
+        g_thread_join(watchdog);
+    }
+
+    result->errors = errors;
+    g_ptr_array_add(results, result);
+
+    for (int i = 0; i < entangle_bench_stress_threads; i++)
+        g_free(threads[i].held);
+    g_free(threads);
+    g_free(held);
+    g_hash_table_unref(signals);
+    return errors;
+}
+
+
+static gboolean entangle_bench_parse_size(const char *str, int *width, int *height)
+{
+    char *end;
+
+    *width = strtol(str, &end, 10);
+    if (*end != 'x' || *width <= 0)
+        return FALSE;
+    *height = strtol(end + 1, &end, 10);
+    return *end == '\0' && *height > 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    GOptionContext *optContext;
+    GError *error = NULL;
+    gboolean debug_app = FALSE;
+    const GOptionEntry entries[] = {
+        { "debug-entangle", 'd', 0, G_OPTION_ARG_NONE, &debug_app, "Enable debugging of application code", NULL },
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &entangle_bench_iterations, "Samples per benchmark", "N" },
+        { "sizes", 's', 0, G_OPTION_ARG_STRING, &entangle_bench_sizes, "Comma separated fixture sizes", "WxH,..." },
+        { "profile", 'p', 0, G_OPTION_ARG_FILENAME, &entangle_bench_profile, "ICC profile for the colour transform benchmark", "FILE" },
+        { "session-images", 0, 0, G_OPTION_ARG_INT, &entangle_bench_session_images, "Images in the session load benchmark", "N" },
+        { "output", 'o', 0, G_OPTION_ARG_FILENAME, &entangle_bench_output, "Write the JSON report to FILE", "FILE" },
+        { "keep", 'k', 0, G_OPTION_ARG_NONE, &entangle_bench_keep, "Keep the generated fixtures", NULL },
+        { "stress", 0, 0, G_OPTION_ARG_NONE, &entangle_bench_stress_loader, "Stress the pixbuf loader instead of benchmarking", NULL },
+        { "stress-threads", 0, 0, G_OPTION_ARG_INT, &entangle_bench_stress_threads, "Threads calling the pixbuf loader", "N" },
+        { "stress-workers", 0, 0, G_OPTION_ARG_INT, &entangle_bench_stress_workers, "Pixbuf loader worker threads", "N" },
+        { "stress-ops", 0, 0, G_OPTION_ARG_INT, &entangle_bench_stress_ops, "Operations per stress thread", "N" },
+        { "stress-images", 0, 0, G_OPTION_ARG_INT, &entangle_bench_stress_image_count, "Distinct images to stress with", "N" },
+        { "stress-timeout", 0, 0, G_OPTION_ARG_INT, &entangle_bench_stress_timeout, "Abort the stress run after SECS seconds", "SECS" },
+        { NULL, 0, 0, 0, NULL, NULL, NULL },
+    };
+    gchar *tmpdir, *cachedir, *thumbdir;
+    gchar **sizes;
+    GPtrArray *fixtures;
+    GPtrArray *results;
+    int ret = 0;
+
+    optContext = g_option_context_new("- benchmark the Entangle image pipeline");
+    g_option_context_add_main_entries(optContext, entries, NULL);
+    if (!g_option_context_parse(optContext, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    g_option_context_free(optContext);
+
+    if (entangle_bench_iterations <= 0 || entangle_bench_session_images <= 0 ||
+        entangle_bench_stress_threads <= 0 || entangle_bench_stress_ops <= 0 ||
+        entangle_bench_stress_image_count <= 0 ||
+        entangle_bench_stress_workers <= 0 || entangle_bench_stress_workers > 64 ||
+        entangle_bench_stress_timeout < 0) {
+        g_printerr("Iteration, thread and image counts must be positive\n");
+        return 1;
+    }
+
+    if (entangle_bench_stress_loader) {
+        entangle_debug_setup(debug_app, FALSE);
+        results = g_ptr_array_new_with_free_func(entangle_bench_result_free);
+        if (entangle_bench_stress(results))
+            ret = 1;
+        if (!entangle_bench_write_report(results))
+            ret = 1;
+        g_ptr_array_unref(results);
+        return ret;
+    }
+
+    if (!(tmpdir = g_dir_make_tmp("entangle-bench-XXXXXX", &error))) {
+        g_printerr("Unable to create fixture directory: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    /* Keep thumbnails out of the user's cache. This must be
+     * set before glib first looks up the cache directory */
+    cachedir = g_build_filename(tmpdir, "cache", NULL);
+    thumbdir = g_build_filename(cachedir, "thumbnails", NULL);
+    g_setenv("XDG_CACHE_HOME", cachedir, TRUE);
+
+    entangle_debug_setup(debug_app, FALSE);
+
+    sizes = g_strsplit(entangle_bench_sizes ? entangle_bench_sizes :
+                       "640x480,1920x1280,6000x4000", ",", 0);
+    fixtures = g_ptr_array_new_with_free_func(entangle_bench_fixture_free);
+    results = g_ptr_array_new_with_free_func(entangle_bench_result_free);
+
+    for (gsize i = 0; sizes[i]; i++) {
+        int width, height;
+
+        if (!entangle_bench_parse_size(sizes[i], &width, &height)) {
+            g_printerr("Malformed size '%s', expected WxH\n", sizes[i]);
+            ret = 1;
+            goto cleanup;
+        }
+
+        for (int format = 0; format < ENTANGLE_BENCH_FORMAT_LAST; format++) {
+            EntangleBenchFixture *fixture =
+                entangle_bench_fixture_new(tmpdir, format, width, height);
+            if (!fixture) {
+                ret = 1;
+                goto cleanup;
+            }
+            g_ptr_array_add(fixtures, fixture);
+        }
+    }
+
+    for (gsize i = 0; i < fixtures->len; i++) {
+        EntangleBenchFixture *fixture = g_ptr_array_index(fixtures, i);
+
+        g_printerr("Benchmarking %s\n", fixture->filename);
+        entangle_bench_open_image(results, fixture);
+        entangle_bench_thumbnail(results, fixture, thumbdir, FALSE);
+        entangle_bench_thumbnail(results, fixture, thumbdir, TRUE);
+
+        /* Pixel operations don't depend on the source format */
+        if (fixture->format == ENTANGLE_BENCH_FORMAT_JPEG) {
+            entangle_bench_colour_transform(results, fixture);
+            entangle_bench_auto_rotate(results, fixture);
+        }
+    }
+
+    /* Session costs are per file, not per pixel */
+    entangle_bench_session(results, g_ptr_array_index(fixtures, 0), tmpdir);
+
+    if (!entangle_bench_write_report(results))
+        ret = 1;
+
+ cleanup:
+    if (entangle_bench_keep)
+        g_printerr("Fixtures kept in %s\n", tmpdir);
+    else
+        entangle_bench_remove_tree(tmpdir);
+    g_ptr_array_unref(results);
+    g_ptr_array_unref(fixtures);
+    g_strfreev(sizes);
+    g_free(thumbdir);
+    g_free(cachedir);
+    g_free(tmpdir);
+    return ret;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
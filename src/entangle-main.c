@@ -29,7 +29,12 @@
 
 #include "entangle-debug.h"
 #include "entangle-application.h"
+#include "entangle-camera-simulator.h"
+#include "entangle-camera-trace.h"
+#include "entangle-tracer.h"
+#include "entangle-metrics.h"
 #include "entangle-camera-manager.h"
+#include "entangle-session-writer.h"
 
 
 int main(int argc, char **argv)
@@ -41,10 +46,22 @@ int main(int argc, char **argv)
     gboolean debug_app = FALSE;
     gboolean debug_gphoto = FALSE;
     gchar *ins = NULL;
+    gchar *simulator = NULL;
+    gchar *record = NULL;
+    gboolean record_payloads = FALSE;
+    gchar *replay = NULL;
+    gchar *spans = NULL;
+    gint memory_log = 0;
     const GOptionEntry entries[] = {
         { "debug-entangle", 'd', 0, G_OPTION_ARG_NONE, &debug_app, "Enable debugging of application code", NULL },
         { "debug-gphoto", 'g', 0, G_OPTION_ARG_NONE, &debug_gphoto, "Enable debugging of gphoto library", NULL },
         { "introspect-dump", 'i', 0, G_OPTION_ARG_STRING, &ins, "Dump introspection data", NULL },
+        { "simulator", 0, 0, G_OPTION_ARG_FILENAME, &simulator, "Add a simulated camera configured from FILE, or defaults if empty", "FILE" },
+        { "record-trace", 0, 0, G_OPTION_ARG_FILENAME, &record, "Record traces of camera sessions into DIR", "DIR" },
+        { "record-payloads", 0, 0, G_OPTION_ARG_NONE, &record_payloads, "Include file data in recorded traces, not just sizes", NULL },
+        { "replay-trace", 0, 0, G_OPTION_ARG_FILENAME, &replay, "Add a camera replaying the trace FILE", "FILE" },
+        { "trace-spans", 0, 0, G_OPTION_ARG_FILENAME, &spans, "Write timing spans as Chrome trace JSON to FILE on exit", "FILE" },
+        { "memory-log", 0, 0, G_OPTION_ARG_INT, &memory_log, "Log memory held by each subsystem every SECS seconds", "SECS" },
         { NULL, 0, 0, 0, NULL, NULL, NULL },
     };
     static const char *help_msg = "Run 'entangle --help' to see full list of options";
@@ -85,6 +102,26 @@ int main(int argc, char **argv)
 
     entangle_debug_setup(debug_app, debug_gphoto);
 
+    if (spans) {
+        entangle_tracer_setup(spans);
+        g_free(spans);
+    }
+    if (memory_log > 0)
+        entangle_metrics_memory_setup_log(memory_log);
+
+    if (simulator) {
+        entangle_camera_simulator_setup(simulator);
+        g_free(simulator);
+    }
+    if (record) {
+        entangle_camera_trace_setup_record(record, record_payloads);
+        g_free(record);
+    }
+    if (replay) {
+        entangle_camera_trace_setup_replay(replay);
+        g_free(replay);
+    }
+
     theme = gtk_icon_theme_get_default();
     gtk_icon_theme_prepend_search_path(theme, DATADIR "/icons");
 
@@ -92,7 +129,15 @@ int main(int argc, char **argv)
 
     g_application_run(G_APPLICATION(app), argc, argv);
 
+    /* Captures may still be queued for writing to the session */
+    entangle_session_writer_flush(entangle_session_writer_get_default());
+
     g_object_unref(app);
+
+    if (!entangle_tracer_save(&error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+    }
     return 0;
 }
 
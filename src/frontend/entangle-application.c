@@ -28,7 +28,9 @@
 #include "entangle-debug.h"
 #include "entangle-application.h"
 #include "entangle-preferences.h"
+#include "entangle-thumbnail-store.h"
 #include "entangle-camera-manager.h"
+#include "entangle-metrics.h"
 
 /**
  * SECTION:entangle-application
@@ -45,8 +47,34 @@
  * This class will normally be sub-classed when creating a Entangle based
  * application, typically in order to add in UI state.
  * </para>
+ *
+ * <para>
+ * The application also exports a read-only metrics interface on
+ * its D-Bus object path, so that unattended rigs can be monitored
+ * by scraping its properties, eg with
+ * <literal>gdbus call --session --dest org.entangle_photo.Manager
+ * --object-path /org/entangle_photo/Manager --method
+ * org.freedesktop.DBus.Properties.GetAll
+ * org.entangle_photo.Manager.Metrics</literal>
+ * </para>
  */
 
+#define ENTANGLE_APPLICATION_METRICS_INTERFACE "org.entangle_photo.Manager.Metrics"
+
+static const char entangle_application_metrics_xml[] =
+    "<node>"
+    "  <interface name='" ENTANGLE_APPLICATION_METRICS_INTERFACE "'>"
+    "    <property name='Uptime' type='x' access='read'/>"
+    "    <property name='Counters' type='a{sx}' access='read'/>"
+    "    <property name='DownloadRate' type='d' access='read'/>"
+    "    <property name='LiveviewAllocRate' type='d' access='read'/>"
+    "    <property name='CameraLatency' type='a{s(atatxx)}' access='read'/>"
+    "    <property name='Caches' type='a{sa{sx}}' access='read'/>"
+    "    <property name='CacheBytes' type='x' access='read'/>"
+    "    <property name='Memory' type='a{s(xxx)}' access='read'/>"
+    "  </interface>"
+    "</node>";
+
 
 #define ENTANGLE_APPLICATION_GET_PRIVATE(obj)                           \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_APPLICATION, EntangleApplicationPrivate))
@@ -59,6 +87,10 @@ struct _EntangleApplicationPrivate {
 
     PeasEngine *pluginEngine;
     PeasExtensionSet *pluginExt;
+
+    gint64 started;
+    GDBusNodeInfo *metricsInfo;
+    guint metricsID;
 };
 
 G_DEFINE_TYPE(EntangleApplication, entangle_application, GTK_TYPE_APPLICATION);
@@ -150,6 +182,8 @@ static void entangle_application_finalize(GObject *object)
         g_object_unref(priv->pluginEngine);
     if (priv->pluginExt)
         g_object_unref(priv->pluginExt);
+    if (priv->metricsInfo)
+        g_dbus_node_info_unref(priv->metricsInfo);
 
     G_OBJECT_CLASS(entangle_application_parent_class)->finalize(object);
 }
@@ -166,6 +200,15 @@ static void entangle_application_activate(GApplication *gapp)
     }
 }
 
+static gpointer entangle_application_collect_thumbnails(gpointer opaque)
+{
+    guint64 limit = (guint64)GPOINTER_TO_UINT(opaque) * 1024 * 1024;
+
+    entangle_thumbnail_store_collect_garbage(limit);
+    return NULL;
+}
+
+
 static void entangle_application_startup(GApplication *gapp)
 {
     g_return_if_fail(ENTANGLE_IS_APPLICATION(gapp));
@@ -174,11 +217,20 @@ static void entangle_application_startup(GApplication *gapp)
     EntangleApplicationPrivate *priv = app->priv;
     GList *cameras = NULL, *tmp = NULL;
     gboolean gotcamera = FALSE;
+    gint thumbLimit;
 
     (*G_APPLICATION_CLASS(entangle_application_parent_class)->startup)(gapp);
 
     gtk_window_set_default_icon_name("entangle");
 
+    /* Enforced once per run, in the background since the
+     * cache may hold many thousands of files */
+    thumbLimit = entangle_preferences_interface_get_thumbnail_cache_size(priv->preferences);
+    if (thumbLimit > 0)
+        g_thread_unref(g_thread_new("thumbnail-gc",
+                                    entangle_application_collect_thumbnails,
+                                    GUINT_TO_POINTER(thumbLimit)));
+
     if (entangle_preferences_interface_get_auto_connect(priv->preferences))
         cameras = tmp = entangle_camera_list_get_cameras(priv->activeCameras);
 
@@ -208,6 +260,93 @@ static void entangle_application_startup(GApplication *gapp)
 }
 
 
+static GVariant *entangle_application_metrics_get(GDBusConnection *connection G_GNUC_UNUSED,
+                                                   const gchar *sender G_GNUC_UNUSED,
+                                                   const gchar *path G_GNUC_UNUSED,
+                                                   const gchar *iface G_GNUC_UNUSED,
+                                                   const gchar *name,
+                                                   GError **error,
+                                                   gpointer data)
+{
+    EntangleApplication *app = data;
+    EntangleApplicationPrivate *priv = app->priv;
+
+    if (g_str_equal(name, "Uptime"))
+        return g_variant_new_int64(g_get_monotonic_time() - priv->started);
+    if (g_str_equal(name, "Counters"))
+        return entangle_metrics_get_counters();
+    if (g_str_equal(name, "DownloadRate"))
+        return g_variant_new_double(entangle_metrics_get_download_rate());
+    if (g_str_equal(name, "LiveviewAllocRate"))
+        return g_variant_new_double(entangle_metrics_get_liveview_alloc_rate());
+    if (g_str_equal(name, "CameraLatency"))
+        return entangle_metrics_get_histograms();
+    if (g_str_equal(name, "Caches"))
+        return entangle_metrics_get_caches();
+    if (g_str_equal(name, "CacheBytes"))
+        return g_variant_new_int64(entangle_metrics_get_cache_bytes());
+    if (g_str_equal(name, "Memory"))
+        return entangle_metrics_get_memory();
+
+    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                _("Unknown metric %s"), name);
+    return NULL;
+}
+
+
+static const GDBusInterfaceVTable entangle_application_metrics_vtable = {
+    .get_property = entangle_application_metrics_get,
+};
+
+
+static gboolean entangle_application_dbus_register(GApplication *gapp,
+                                                   GDBusConnection *connection,
+                                                   const gchar *path,
+                                                   GError **error)
+{
+    g_return_val_if_fail(ENTANGLE_IS_APPLICATION(gapp), FALSE);
+
+    EntangleApplication *app = ENTANGLE_APPLICATION(gapp);
+    EntangleApplicationPrivate *priv = app->priv;
+
+    if (!G_APPLICATION_CLASS(entangle_application_parent_class)->dbus_register(gapp, connection,
+                                                                               path, error))
+        return FALSE;
+
+    if (!priv->metricsInfo &&
+        !(priv->metricsInfo = g_dbus_node_info_new_for_xml(entangle_application_metrics_xml,
+                                                           error)))
+        return FALSE;
+
+    ENTANGLE_DEBUG("Exporting metrics on %s", path);
+    if (!(priv->metricsID = g_dbus_connection_register_object(connection, path,
+                                                              priv->metricsInfo->interfaces[0],
+                                                              &entangle_application_metrics_vtable,
+                                                              app, NULL, error)))
+        return FALSE;
+
+    return TRUE;
+}
+
+
+static void entangle_application_dbus_unregister(GApplication *gapp,
+                                                 GDBusConnection *connection,
+                                                 const gchar *path)
+{
+    g_return_if_fail(ENTANGLE_IS_APPLICATION(gapp));
+
+    EntangleApplication *app = ENTANGLE_APPLICATION(gapp);
+    EntangleApplicationPrivate *priv = app->priv;
+
+    if (priv->metricsID) {
+        g_dbus_connection_unregister_object(connection, priv->metricsID);
+        priv->metricsID = 0;
+    }
+
+    G_APPLICATION_CLASS(entangle_application_parent_class)->dbus_unregister(gapp, connection, path);
+}
+
+
 static void entangle_application_class_init(EntangleApplicationClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
@@ -219,6 +358,8 @@ static void entangle_application_class_init(EntangleApplicationClass *klass)
 
     app_class->activate = entangle_application_activate;
     app_class->startup = entangle_application_startup;
+    app_class->dbus_register = entangle_application_dbus_register;
+    app_class->dbus_unregister = entangle_application_dbus_unregister;
 
     g_object_class_install_property(object_class,
                                     PROP_ACTIVE_CAMERAS,
@@ -328,6 +469,7 @@ static void entangle_application_init(EntangleApplication *app)
 
     priv = app->priv = ENTANGLE_APPLICATION_GET_PRIVATE(app);
 
+    priv->started = g_get_monotonic_time();
     priv->preferences = entangle_preferences_new();
     priv->activeCameras = entangle_camera_list_new_active();
     priv->supportedCameras = entangle_camera_list_new_supported();
@@ -36,6 +36,7 @@
 #include "entangle-camera-manager.h"
 #include "entangle-camera-list.h"
 #include "entangle-camera-support.h"
+#include "entangle-memory-panel.h"
 #include "entangle-camera-picker.h"
 #include "entangle-session.h"
 #include "entangle-image-display.h"
@@ -50,10 +51,23 @@
 #include "entangle-control-panel.h"
 #include "entangle-colour-profile.h"
 #include "entangle-preferences-display.h"
+#include "entangle-preview-decoder.h"
 #include "entangle-progress.h"
 #include "entangle-dpms.h"
 #include "entangle-window.h"
 #include "entangle-auto-drawer.h"
+#include "entangle-capture-latency.h"
+#include "entangle-metrics.h"
+#include "entangle-session-writer.h"
+
+/* Bound on captures holding their downloaded data, in case
+ * a loader never gets to them, eg if another image is selected */
+#define ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_MAX 2
+
+enum {
+    ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_PREVIEW = (1 << 0),
+    ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_THUMBNAIL = (1 << 1),
+};
 
 #define ENTANGLE_CAMERA_MANAGER_GET_PRIVATE(obj)                        \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_CAMERA_MANAGER, EntangleCameraManagerPrivate))
@@ -62,18 +76,24 @@ struct _EntangleCameraManagerPrivate {
     EntangleCameraAutomata *automata;
     EntangleCamera *camera;
     EntangleCameraPreferences *cameraPrefs;
+    EntangleControlGroup *cameraControls;
     gboolean cameraReady;
     gboolean cameraChanged;
     EntangleSession *session;
+    GCancellable *sessionCancel;
     EntangleScriptConfig *scriptConfig;
 
     EntangleCameraPicker *picker;
     EntangleHelpAbout *about;
 
     EntangleCameraSupport *supported;
+    EntangleMemoryPanel *memoryPanel;
 
     EntangleImageLoader *imageLoader;
     EntangleThumbnailLoader *thumbLoader;
+    EntanglePreviewDecoder *previewDecoder;
+    /* New captures whose downloaded data is still held for the loaders */
+    GQueue *imageData;
     EntangleColourProfileTransform *colourTransform;
     GtkScrolledWindow *imageScroll;
     EntangleImageDisplay *imageDisplay;
@@ -110,6 +130,8 @@ struct _EntangleCameraManagerPrivate {
     GCancellable *taskConfirm;
     gboolean taskCapture;
     gboolean taskPreview;
+    /* A preview frame has been shown but not yet painted */
+    gboolean previewUndrawn;
     gboolean taskActive;
     gboolean taskProcessEvents;
     char *deleteImageDup;
@@ -137,6 +159,8 @@ enum {
 
 void do_menu_help_supported(GtkMenuItem *src,
                             EntangleCameraManager *manager);
+void do_menu_help_memory(GtkMenuItem *src,
+                         EntangleCameraManager *manager);
 void do_menu_new_window(GtkImageMenuItem *src,
                         EntangleCameraManager *manager);
 void do_menu_select_session(GtkImageMenuItem *src,
@@ -368,6 +392,44 @@ static void entangle_camera_manager_update_histogram_linear(EntangleCameraManage
 }
 
 
+static void entangle_camera_manager_update_histogram_raw(EntangleCameraManager *manager)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    EntanglePreferences *prefs = entangle_camera_manager_get_preferences(manager);
+    gboolean histogram_raw = entangle_preferences_interface_get_histogram_raw(prefs);
+
+    if (priv->imageLoader)
+        entangle_image_loader_set_raw_histogram(priv->imageLoader, histogram_raw);
+    entangle_image_histogram_set_histogram_raw(priv->imageHistogram, histogram_raw);
+}
+
+
+static void entangle_camera_manager_update_capture_latency(EntangleCameraManager *manager)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    EntanglePreferences *prefs = entangle_camera_manager_get_preferences(manager);
+    gboolean latency = entangle_preferences_capture_get_latency(prefs);
+
+    entangle_capture_latency_set_log_enabled(entangle_capture_latency_get_default(), latency);
+    entangle_image_statusbar_set_show_latency(priv->imageStatusbar, latency);
+}
+
+
+static void entangle_camera_manager_update_capture_durability(EntangleCameraManager *manager)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntanglePreferences *prefs = entangle_camera_manager_get_preferences(manager);
+
+    entangle_session_writer_set_durability(entangle_session_writer_get_default(),
+                                           entangle_preferences_capture_get_durability(prefs));
+}
+
+
 static void entangle_camera_manager_update_background_highlight(EntangleCameraManager *manager)
 {
     g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
@@ -485,6 +547,57 @@ static void entangle_camera_manager_update_image_loader(EntangleCameraManager *m
 }
 
 
+static void entangle_camera_manager_update_thumbnail_store(EntangleCameraManager *manager)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    EntanglePreferences *prefs = entangle_camera_manager_get_preferences(manager);
+    EntangleThumbnailStore *store = NULL;
+
+    if (priv->session &&
+        entangle_preferences_interface_get_thumbnail_store(prefs)) {
+        GError *error = NULL;
+        store = entangle_thumbnail_store_new_for_session(entangle_session_directory(priv->session));
+        /* Thumbnails still work from the freedesktop cache alone */
+        if (!entangle_thumbnail_store_open(store, &error)) {
+            g_warning("%s", error->message);
+            g_error_free(error);
+            g_object_unref(store);
+            store = NULL;
+        }
+    }
+
+    entangle_thumbnail_loader_set_store(priv->thumbLoader, store);
+    if (store)
+        g_object_unref(store);
+}
+
+
+#if GTK_CHECK_VERSION(3,10,0)
+/* Render thumbnails at the monitor's scale so they stay sharp */
+static void entangle_camera_manager_update_thumbnail_scale(EntangleCameraManager *manager)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+
+    entangle_thumbnail_loader_set_scale(priv->thumbLoader,
+                                        gtk_widget_get_scale_factor(GTK_WIDGET(manager)));
+}
+
+
+static void do_camera_manager_scale_factor(GObject *object,
+                                           GParamSpec *pspec G_GNUC_UNUSED,
+                                           gpointer data G_GNUC_UNUSED)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(object));
+
+    entangle_camera_manager_update_thumbnail_scale(ENTANGLE_CAMERA_MANAGER(object));
+}
+#endif
+
+
 static void entangle_camera_manager_update_automata(EntangleCameraManager *manager)
 {
     g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
@@ -508,6 +621,8 @@ static void entangle_camera_manager_prefs_changed(GObject *object G_GNUC_UNUSED,
 
     if (g_str_equal(spec->name, "interface-histogram-linear")) {
         entangle_camera_manager_update_histogram_linear(manager);
+    } else if (g_str_equal(spec->name, "interface-histogram-raw")) {
+        entangle_camera_manager_update_histogram_raw(manager);
     } else if (g_str_equal(spec->name, "cms-enabled") ||
         g_str_equal(spec->name, "cms-rgb-profile") ||
         g_str_equal(spec->name, "cms-monitor-profile") ||
@@ -527,6 +642,12 @@ static void entangle_camera_manager_prefs_changed(GObject *object G_GNUC_UNUSED,
         entangle_camera_manager_update_image_loader(manager);
     } else if (g_str_equal(spec->name, "capture-delete-file")) {
         entangle_camera_manager_update_automata(manager);
+    } else if (g_str_equal(spec->name, "capture-latency")) {
+        entangle_camera_manager_update_capture_latency(manager);
+    } else if (g_str_equal(spec->name, "capture-durability")) {
+        entangle_camera_manager_update_capture_durability(manager);
+    } else if (g_str_equal(spec->name, "interface-thumbnail-store")) {
+        entangle_camera_manager_update_thumbnail_store(manager);
     } else if (g_str_equal(spec->name, "img-onion-skin") ||
                g_str_equal(spec->name, "img-onion-layers")) {
         EntangleCameraManagerPrivate *priv = manager->priv;
@@ -654,6 +775,19 @@ static void do_restore_scroll(GtkWidget *widget,
 }
 
 
+static gboolean do_image_display_draw(GtkWidget *widget G_GNUC_UNUSED,
+                                      cairo_t *cr G_GNUC_UNUSED,
+                                      EntangleCameraManager *manager)
+{
+    g_return_val_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager), FALSE);
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+
+    priv->previewUndrawn = FALSE;
+    return FALSE;
+}
+
+
 static void do_select_image(EntangleCameraManager *manager,
                             EntangleImage *image)
 {
@@ -739,6 +873,97 @@ static void do_select_image(EntangleCameraManager *manager,
 }
 
 
+/*
+ * Preview frames are shown without an EntangleImage, so
+ * whatever was selected before is dropped in favour of
+ * the frame itself
+ */
+static void do_select_frame(EntangleCameraManager *manager,
+                            cairo_surface_t *frame,
+                            gint width,
+                            gint height)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    GList *oldimages;
+    GList *tmp;
+
+    tmp = oldimages = entangle_image_display_get_image_list(priv->imageDisplay);
+    while (tmp) {
+        EntangleImage *thisimage = tmp->data;
+
+        if (entangle_image_get_filename(thisimage))
+            entangle_pixbuf_loader_unload(ENTANGLE_PIXBUF_LOADER(priv->imageLoader),
+                                          thisimage);
+
+        tmp = tmp->next;
+    }
+
+    entangle_image_display_set_frame(priv->imageDisplay, frame, width, height);
+
+    if (priv->currentImage) {
+        g_object_unref(priv->currentImage);
+        priv->currentImage = NULL;
+    }
+
+    entangle_image_statusbar_set_image(priv->imageStatusbar, NULL);
+    entangle_image_histogram_set_frame(priv->imageHistogram, frame);
+    if (priv->imagePresentation)
+        entangle_image_popup_set_frame(priv->imagePresentation, frame, width, height);
+
+    g_list_foreach(oldimages, (GFunc)g_object_unref, NULL);
+    g_list_free(oldimages);
+}
+
+
+/*
+ * The size in device pixels a widget draws preview frames in
+ */
+static void entangle_camera_manager_widget_size(GtkWidget *widget,
+                                                gint *width,
+                                                gint *height)
+{
+    gint scale = 1;
+
+#if GTK_CHECK_VERSION(3,10,0)
+    scale = gtk_widget_get_scale_factor(widget);
+#endif
+
+    *width = gtk_widget_get_allocated_width(widget) * scale;
+    *height = gtk_widget_get_allocated_height(widget) * scale;
+}
+
+
+/*
+ * The size preview frames are worth decoding at, which is
+ * the largest area they will be drawn in, or 0 if they are
+ * drawn at their natural size
+ */
+static void entangle_camera_manager_frame_size(EntangleCameraManager *manager,
+                                               gint *width,
+                                               gint *height)
+{
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    gint popupWidth, popupHeight;
+
+    *width = *height = 0;
+    if (!entangle_image_display_get_autoscale(priv->imageDisplay))
+        return;
+
+    entangle_camera_manager_widget_size(GTK_WIDGET(priv->imageDisplay),
+                                        width, height);
+
+    if (priv->imagePresentation &&
+        gtk_widget_get_visible(GTK_WIDGET(priv->imagePresentation))) {
+        entangle_camera_manager_widget_size(GTK_WIDGET(priv->imagePresentation),
+                                            &popupWidth, &popupHeight);
+        *width = MAX(*width, popupWidth);
+        *height = MAX(*height, popupHeight);
+    }
+}
+
+
 static void do_camera_task_error(EntangleCameraManager *manager,
                                  const char *label, GError *error)
 {
@@ -777,7 +1002,7 @@ static void do_camera_load_controls_refresh_finish(GObject *source,
     EntangleCamera *camera = ENTANGLE_CAMERA(source);
     GError *error = NULL;
 
-    if (!entangle_camera_load_controls_finish(camera, result, &error)) {
+    if (!entangle_camera_refresh_controls_finish(camera, result, &error)) {
         GtkWidget *msg = gtk_message_dialog_new(GTK_WINDOW(manager),
                                                 0,
                                                 GTK_MESSAGE_ERROR,
@@ -839,10 +1064,10 @@ static void do_camera_process_events_finish(GObject *src,
 
     if (priv->cameraChanged) {
         priv->cameraChanged = FALSE;
-        entangle_camera_load_controls_async(priv->camera,
-                                            NULL,
-                                            do_camera_load_controls_refresh_finish,
-                                            manager);
+        entangle_camera_refresh_controls_async(priv->camera,
+                                               NULL,
+                                               do_camera_load_controls_refresh_finish,
+                                               manager);
     } else {
         do_camera_process_events(manager);
     }
@@ -909,6 +1134,7 @@ static void do_camera_file_preview(EntangleCamera *cam G_GNUC_UNUSED, EntangleCa
 
     EntangleCameraManager *manager = data;
     EntangleCameraManagerPrivate *priv = manager->priv;
+    EntanglePreferences *prefs = entangle_camera_manager_get_preferences(manager);
     GdkPixbuf *pixbuf;
     GByteArray *bytes;
     GInputStream *is;
@@ -919,7 +1145,37 @@ static void do_camera_file_preview(EntangleCamera *cam G_GNUC_UNUSED, EntangleCa
         !g_cancellable_is_cancelled(priv->taskCancel)) {
         ENTANGLE_DEBUG("File preview %p %p %p", cam, file, data);
 
+        /* The previous frame is replaced before it was ever
+         * painted, so it never reached the user either */
+        if (priv->previewUndrawn &&
+            gtk_widget_is_drawable(GTK_WIDGET(priv->imageDisplay)))
+            entangle_metrics_add(ENTANGLE_METRICS_COUNTER_LIVEVIEW_DROPPED, 1);
+        priv->previewUndrawn = FALSE;
+
         bytes = entangle_camera_file_get_data(file);
+
+        /* Frames which are only to be looked at are decoded
+         * straight into a surface for the display, unless
+         * earlier images have to be layered over them */
+        if (!priv->taskCapture &&
+            !entangle_preferences_img_get_onion_skin(prefs)) {
+            gint targetWidth, targetHeight;
+            gint width, height;
+            cairo_surface_t *frame;
+
+            entangle_camera_manager_frame_size(manager, &targetWidth, &targetHeight);
+            frame = entangle_preview_decoder_decode(priv->previewDecoder,
+                                                    bytes->data, bytes->len,
+                                                    targetWidth, targetHeight,
+                                                    &width, &height);
+            if (frame) {
+                do_select_frame(manager, frame, width, height);
+                cairo_surface_destroy(frame);
+                priv->previewUndrawn = TRUE;
+                return;
+            }
+        }
+
         is = g_memory_input_stream_new_from_data(bytes->data, bytes->len, NULL);
 
         pixbuf = gdk_pixbuf_new_from_stream(is, NULL, NULL);
@@ -938,14 +1194,23 @@ static void do_camera_file_preview(EntangleCamera *cam G_GNUC_UNUSED, EntangleCa
             g_free(localpath);
             priv->taskCapture = FALSE;
         }
-        if (!image)
+        if (!image && pixbuf)
             image = entangle_image_new_pixbuf(pixbuf);
 
-        do_select_image(manager, image);
+        if (image) {
+            do_select_image(manager, image);
+            g_object_unref(image);
+            priv->previewUndrawn = TRUE;
+        } else {
+            entangle_metrics_add(ENTANGLE_METRICS_COUNTER_LIVEVIEW_DROPPED, 1);
+        }
 
-        g_object_unref(pixbuf);
+        if (pixbuf)
+            g_object_unref(pixbuf);
         g_object_unref(is);
-        g_object_unref(image);
+    } else {
+        /* Arrived after the preview was stopped or cancelled */
+        entangle_metrics_add(ENTANGLE_METRICS_COUNTER_LIVEVIEW_DROPPED, 1);
     }
 }
 
@@ -1026,6 +1291,10 @@ static void do_remove_camera(EntangleCameraManager *manager)
     gtk_window_set_title(GTK_WINDOW(manager), _("Camera Manager - Entangle"));
 
     entangle_camera_preferences_set_camera(priv->cameraPrefs, NULL);
+    if (priv->cameraControls) {
+        g_object_unref(priv->cameraControls);
+        priv->cameraControls = NULL;
+    }
     entangle_camera_set_progress(priv->camera, NULL);
 
     g_signal_handler_disconnect(priv->camera, priv->sigFilePreview);
@@ -1040,6 +1309,28 @@ static void do_remove_camera(EntangleCameraManager *manager)
 }
 
 
+/*
+ * Show the camera's controls, unless those already shown,
+ * which may have been restored from the cached schema on
+ * connect, are still current
+ */
+static void do_camera_show_controls(EntangleCameraManager *manager)
+{
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    EntangleControlGroup *controls = entangle_camera_get_controls(priv->camera, NULL);
+
+    if (controls && controls == priv->cameraControls) {
+        g_object_unref(controls);
+        return;
+    }
+
+    if (priv->cameraControls)
+        g_object_unref(priv->cameraControls);
+    priv->cameraControls = controls;
+    entangle_camera_preferences_set_camera(priv->cameraPrefs, priv->camera);
+}
+
+
 static void do_camera_load_controls_finish(GObject *source,
                                            GAsyncResult *result,
                                            gpointer data)
@@ -1055,7 +1346,7 @@ static void do_camera_load_controls_finish(GObject *source,
 
     if (entangle_camera_load_controls_finish(cam, result, &error)) {
         do_capture_widget_sensitivity(manager);
-        entangle_camera_preferences_set_camera(priv->cameraPrefs, priv->camera);
+        do_camera_show_controls(manager);
     } else {
         GtkWidget *msg = gtk_message_dialog_new(GTK_WINDOW(manager),
                                                 0,
@@ -1102,6 +1393,13 @@ static void do_camera_connect_finish(GObject *source,
     GError *error = NULL;
 
     if (entangle_camera_connect_finish(cam, result, &error)) {
+        EntangleControlGroup *controls = entangle_camera_get_controls(cam, NULL);
+        /* Controls restored from the cached schema can be
+         * shown while their values are loaded */
+        if (controls) {
+            do_camera_show_controls(manager);
+            g_object_unref(controls);
+        }
         entangle_camera_load_controls_async(priv->camera,
                                             NULL,
                                             do_camera_load_controls_finish,
@@ -1296,23 +1594,112 @@ static void do_camera_removed(EntangleCameraList *cameras G_GNUC_UNUSED,
 }
 
 
+static void entangle_camera_manager_image_data_drop(EntangleCameraManager *manager,
+                                                    GList *link)
+{
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    EntangleImage *image = link->data;
+
+    ENTANGLE_DEBUG("Drop data for %s", entangle_image_get_filename(image));
+    entangle_image_set_data(image, NULL);
+    g_queue_delete_link(priv->imageData, link);
+    g_object_unref(image);
+}
+
+
+static gint entangle_camera_manager_image_data_compare(gconstpointer a,
+                                                       gconstpointer b)
+{
+    return g_strcmp0(entangle_image_get_filename(ENTANGLE_IMAGE(a)),
+                     entangle_image_get_filename(ENTANGLE_IMAGE(b)));
+}
+
+
+/* Releases the downloaded data once both loaders have decoded it */
+static void entangle_camera_manager_image_data_loaded(EntangleCameraManager *manager,
+                                                      EntangleImage *image,
+                                                      gint loaded)
+{
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    GList *link = g_queue_find_custom(priv->imageData, image,
+                                      entangle_camera_manager_image_data_compare);
+
+    if (!link)
+        return;
+
+    loaded |= GPOINTER_TO_INT(g_object_get_data(G_OBJECT(link->data),
+                                                "entangle-data-loaded"));
+    g_object_set_data(G_OBJECT(link->data), "entangle-data-loaded",
+                      GINT_TO_POINTER(loaded));
+
+    if (loaded == (ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_PREVIEW |
+                   ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_THUMBNAIL))
+        entangle_camera_manager_image_data_drop(manager, link);
+}
+
+
+static void do_thumb_loaded(EntanglePixbufLoader *loader G_GNUC_UNUSED,
+                            EntangleImage *image,
+                            gpointer data)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(data));
+
+    entangle_camera_manager_image_data_loaded(ENTANGLE_CAMERA_MANAGER(data), image,
+                                              ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_THUMBNAIL);
+}
+
+
 static void do_session_image_added(EntangleSession *session G_GNUC_UNUSED,
                                    EntangleImage *img,
                                    gpointer data)
 {
     EntangleCameraManager *manager = data;
+    EntangleCameraManagerPrivate *priv = manager->priv;
+    GBytes *bytes = entangle_image_get_data(img);
+
+    if (bytes) {
+        g_queue_push_head(priv->imageData, g_object_ref(img));
+        while (g_queue_get_length(priv->imageData) > ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_MAX)
+            entangle_camera_manager_image_data_drop(manager,
+                                                    g_queue_peek_tail_link(priv->imageData));
+        g_bytes_unref(bytes);
+    }
 
     do_select_image(manager, img);
 }
 
+static void do_camera_manager_session_load_finish(GObject *src,
+                                                  GAsyncResult *res,
+                                                  gpointer data)
+{
+    EntangleCameraManager *manager = data;
+    GError *error = NULL;
+
+    if (!entangle_session_load_finish(ENTANGLE_SESSION(src), res, &error)) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            do_camera_task_error(manager, _("Load session"), error);
+        g_error_free(error);
+    }
+
+    g_object_unref(manager);
+}
+
+
 static void do_camera_manager_set_session(EntangleCameraManager *manager,
                                           EntangleSession *session)
 {
     EntangleCameraManagerPrivate *priv = manager->priv;
 
+    /* Stop adding files from a session no longer shown */
+    if (priv->sessionCancel) {
+        g_cancellable_cancel(priv->sessionCancel);
+        g_object_unref(priv->sessionCancel);
+        priv->sessionCancel = NULL;
+    }
+
     if (priv->session) {
         entangle_camera_automata_set_session(priv->automata, priv->session);
-        g_signal_handler_disconnect(priv->camera, priv->sigImageAdd);
+        g_signal_handler_disconnect(priv->session, priv->sigImageAdd);
         priv->sigImageAdd = 0;
         g_object_unref(priv->session);
         priv->session = NULL;
@@ -1320,7 +1707,12 @@ static void do_camera_manager_set_session(EntangleCameraManager *manager,
     if (session) {
         EntanglePreferences *prefs = entangle_camera_manager_get_preferences(manager);
         priv->session = g_object_ref(session);
-        entangle_session_load(priv->session);
+        priv->sessionCancel = g_cancellable_new();
+        entangle_session_load_async(priv->session,
+                                    ENTANGLE_PROGRESS(manager),
+                                    priv->sessionCancel,
+                                    do_camera_manager_session_load_finish,
+                                    g_object_ref(manager));
         priv->sigImageAdd = g_signal_connect(priv->session,
                                              "session-image-added",
                                              G_CALLBACK(do_session_image_added), manager);
@@ -1329,6 +1721,8 @@ static void do_camera_manager_set_session(EntangleCameraManager *manager,
                                                       entangle_session_directory(priv->session));
         entangle_camera_automata_set_session(priv->automata, priv->session);
     }
+    /* Before the browser asks for any thumbnails */
+    entangle_camera_manager_update_thumbnail_store(manager);
     entangle_session_browser_set_session(priv->sessionBrowser, priv->session);
 }
 
@@ -1361,6 +1755,7 @@ static void do_entangle_camera_manager_set_app(GObject *object,
     pattern = entangle_preferences_capture_get_filename_pattern(prefs);
 
     entangle_camera_manager_update_histogram_linear(manager);
+    entangle_camera_manager_update_histogram_raw(manager);
     entangle_camera_manager_update_colour_transform(manager);
     entangle_camera_manager_update_aspect_ratio(manager);
     entangle_camera_manager_update_mask_opacity(manager);
@@ -1368,6 +1763,8 @@ static void do_entangle_camera_manager_set_app(GObject *object,
     entangle_camera_manager_update_image_loader(manager);
     entangle_camera_manager_update_background_highlight(manager);
     entangle_camera_manager_update_automata(manager);
+    entangle_camera_manager_update_capture_latency(manager);
+    entangle_camera_manager_update_capture_durability(manager);
 
     session = entangle_session_new(directory, pattern);
     do_camera_manager_set_session(manager, session);
@@ -1416,19 +1813,36 @@ static void entangle_camera_manager_finalize(GObject *object)
     g_object_unref(priv->monitorCancel);
     g_object_unref(priv->taskCancel);
     g_object_unref(priv->taskConfirm);
+    if (priv->sessionCancel)
+        g_object_unref(priv->sessionCancel);
 
-    if (priv->imageLoader)
+    while (!g_queue_is_empty(priv->imageData))
+        entangle_camera_manager_image_data_drop(manager,
+                                                g_queue_peek_head_link(priv->imageData));
+    g_queue_free(priv->imageData);
+
+    if (priv->imageLoader) {
+        g_signal_handlers_disconnect_by_data(priv->imageLoader, manager);
         g_object_unref(priv->imageLoader);
-    if (priv->thumbLoader)
+    }
+    if (priv->thumbLoader) {
+        g_signal_handlers_disconnect_by_data(priv->thumbLoader, manager);
         g_object_unref(priv->thumbLoader);
+    }
+    if (priv->previewDecoder)
+        g_object_unref(priv->previewDecoder);
     if (priv->colourTransform)
         g_object_unref(priv->colourTransform);
     if (priv->camera)
         g_object_unref(priv->camera);
+    if (priv->cameraControls)
+        g_object_unref(priv->cameraControls);
     if (priv->prefsDisplay)
         g_object_unref(priv->prefsDisplay);
     if (priv->picker)
         g_object_unref(priv->picker);
+    if (priv->memoryPanel)
+        gtk_widget_destroy(GTK_WIDGET(priv->memoryPanel));
 
     if (priv->imagePresentation)
         g_object_unref(priv->imagePresentation);
@@ -1497,6 +1911,23 @@ void do_menu_help_supported(GtkMenuItem *src G_GNUC_UNUSED,
 }
 
 
+void do_menu_help_memory(GtkMenuItem *src G_GNUC_UNUSED,
+                         EntangleCameraManager *manager)
+{
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(manager));
+
+    EntangleCameraManagerPrivate *priv = manager->priv;
+
+    if (!priv->memoryPanel) {
+        priv->memoryPanel = entangle_memory_panel_new();
+        gtk_window_set_transient_for(GTK_WINDOW(priv->memoryPanel),
+                                     GTK_WINDOW(manager));
+    }
+
+    gtk_widget_show(GTK_WIDGET(priv->memoryPanel));
+}
+
+
 void do_menu_new_window(GtkImageMenuItem *src G_GNUC_UNUSED,
                         EntangleCameraManager *manager)
 {
@@ -2879,13 +3310,20 @@ static void do_session_browser_drag_failed(GtkWidget *widget G_GNUC_UNUSED,
 
 
 static void do_pixbuf_loaded(EntanglePixbufLoader *loader,
-                             EntangleImage *image)
+                             EntangleImage *image,
+                             gpointer data)
 {
     g_return_if_fail(ENTANGLE_IS_IMAGE(image));
+    g_return_if_fail(ENTANGLE_IS_CAMERA_MANAGER(data));
 
     GdkPixbuf *pixbuf = entangle_pixbuf_loader_get_pixbuf(loader, image);
 
+    entangle_capture_latency_mark_file(entangle_capture_latency_get_default(),
+                                       entangle_image_get_filename(image),
+                                       ENTANGLE_CAPTURE_STAGE_DECODED);
     entangle_image_set_pixbuf(image, pixbuf);
+    entangle_camera_manager_image_data_loaded(ENTANGLE_CAMERA_MANAGER(data), image,
+                                              ENTANGLE_CAMERA_MANAGER_IMAGE_DATA_PREVIEW);
 }
 
 
@@ -2993,8 +3431,10 @@ static void do_entangle_camera_manager_set_builder(EntangleWindow *window,
 
     priv->imageLoader = entangle_image_loader_new();
     priv->thumbLoader = entangle_thumbnail_loader_new(140, 140);
+    priv->previewDecoder = entangle_preview_decoder_new();
 
-    g_signal_connect(priv->imageLoader, "pixbuf-loaded", G_CALLBACK(do_pixbuf_loaded), NULL);
+    g_signal_connect(priv->imageLoader, "pixbuf-loaded", G_CALLBACK(do_pixbuf_loaded), manager);
+    g_signal_connect(priv->thumbLoader, "pixbuf-loaded", G_CALLBACK(do_thumb_loaded), manager);
     g_signal_connect(priv->imageLoader, "metadata-loaded", G_CALLBACK(do_metadata_loaded), NULL);
     g_signal_connect(priv->imageLoader, "pixbuf-unloaded", G_CALLBACK(do_pixbuf_unloaded), NULL);
     g_signal_connect(priv->imageLoader, "metadata-unloaded", G_CALLBACK(do_metadata_unloaded), NULL);
@@ -3014,6 +3454,8 @@ static void do_entangle_camera_manager_set_builder(EntangleWindow *window,
 
     g_signal_connect(priv->imageDisplay, "size-allocate",
                      G_CALLBACK(do_restore_scroll), manager);
+    g_signal_connect_after(priv->imageDisplay, "draw",
+                           G_CALLBACK(do_image_display_draw), manager);
 
     g_signal_connect(priv->sessionBrowser, "selection-changed",
                      G_CALLBACK(do_session_image_selected), manager);
@@ -3062,6 +3504,11 @@ static void do_entangle_camera_manager_set_builder(EntangleWindow *window,
                           gdk_window_get_events(imgWin) | GDK_POINTER_MOTION_MASK);
     g_signal_connect(manager, "motion-notify-event",
                      G_CALLBACK(do_image_status_show), manager);
+#if GTK_CHECK_VERSION(3,10,0)
+    entangle_camera_manager_update_thumbnail_scale(manager);
+    g_signal_connect(manager, "notify::scale-factor",
+                     G_CALLBACK(do_camera_manager_scale_factor), NULL);
+#endif
 
     ENTANGLE_DEBUG("Adding %p to %p", priv->imageDisplay, imageViewport);
     gtk_paned_pack1(GTK_PANED(display), GTK_WIDGET(priv->imageDrawer), TRUE, TRUE);
@@ -3148,6 +3595,7 @@ static void entangle_camera_manager_init(EntangleCameraManager *manager)
 
     priv->imageScrollHOffset = 0;
     priv->imageScrollVOffset = 0;
+    priv->imageData = g_queue_new();
 
     priv->automata = entangle_camera_automata_new();
     priv->cameraPrefs = entangle_camera_preferences_new();
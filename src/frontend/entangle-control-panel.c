@@ -34,6 +34,11 @@
 #include "entangle-control-text.h"
 #include "entangle-control-toggle.h"
 
+#if GLIB_CHECK_VERSION(2, 31, 0)
+#define g_mutex_new() g_new0(GMutex, 1)
+#define g_mutex_free(m) g_free(m)
+#endif
+
 #define ENTANGLE_CONTROL_PANEL_GET_PRIVATE(obj)                         \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_CONTROL_PANEL, EntangleControlPanelPrivate))
 
@@ -45,12 +50,34 @@ struct _EntangleControlPanelPrivate {
     gboolean hasControls;
     gboolean inUpdate;
 
+    GMutex *refreshLock;
+    GHashTable *refreshWidgets;
+    guint refreshId;
+
+    GHashTable *saveEdits;
+    GHashTable *saveInFlight;
+    guint saveId;
+
     GtkWidget *grid;
     gsize rows;
 };
 
 G_DEFINE_TYPE(EntangleControlPanel, entangle_control_panel, GTK_TYPE_EXPANDER);
 
+#define ENTANGLE_CONTROL_REFRESH_VALUE    (1 << 0)
+#define ENTANGLE_CONTROL_REFRESH_READONLY (1 << 1)
+
+/* Window for coalescing edits into one camera save */
+#define ENTANGLE_CONTROL_SAVE_DELAY_MS 150
+
+typedef struct _EntangleControlEdit EntangleControlEdit;
+struct _EntangleControlEdit {
+    EntangleControl *control;
+    GtkWidget *widget;
+    GValue value;
+    GValue previous;
+};
+
 enum {
     PROP_O,
     PROP_CAMERA,
@@ -70,15 +97,92 @@ static void do_control_remove(GtkWidget *widget,
 }
 
 
+static void do_queue_control_refresh(GtkWidget *widget,
+                                     guint flags);
+
+
+static void do_control_edit_free(gpointer opaque)
+{
+    EntangleControlEdit *edit = opaque;
+
+    g_object_unref(edit->control);
+    g_object_unref(edit->widget);
+    g_value_unset(&edit->value);
+    if (G_IS_VALUE(&edit->previous))
+        g_value_unset(&edit->previous);
+    g_free(edit);
+}
+
+
+static void do_control_edit_set_busy(EntangleControlEdit *edit,
+                                     gboolean busy)
+{
+    GtkWidget *label = g_object_get_data(G_OBJECT(edit->widget), "label");
+    GtkWidget *widgets[] = { edit->widget, label };
+
+    for (gsize i = 0; i < G_N_ELEMENTS(widgets); i++) {
+        GtkStyleContext *ctx;
+        if (!widgets[i])
+            continue;
+        ctx = gtk_widget_get_style_context(widgets[i]);
+        if (busy)
+            gtk_style_context_add_class(ctx, "dim-label");
+        else
+            gtk_style_context_remove_class(ctx, "dim-label");
+    }
+    gtk_widget_set_tooltip_text(edit->widget,
+                                busy ? _("Updating camera...") : NULL);
+}
+
+
+static gboolean do_control_edit_pending(EntangleControlPanel *panel,
+                                        EntangleControl *control)
+{
+    EntangleControlPanelPrivate *priv = panel->priv;
+
+    return g_hash_table_contains(priv->saveEdits, control) ||
+        (priv->saveInFlight &&
+         g_hash_table_contains(priv->saveInFlight, control));
+}
+
+
+static void do_submit_control_save(EntangleControlPanel *panel);
+
+
 static void do_update_control_finish(GObject *src,
                                      GAsyncResult *res,
                                      gpointer data)
 {
     g_return_if_fail(ENTANGLE_IS_CONTROL_PANEL(data));
 
+    EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
+    EntangleControlPanelPrivate *priv = panel->priv;
+    GHashTable *edits = priv->saveInFlight;
+    GHashTableIter iter;
+    gpointer value;
     GError *error = NULL;
+    gboolean failed;
+
+    priv->saveInFlight = NULL;
+    failed = !entangle_camera_save_controls_finish(ENTANGLE_CAMERA(src), res, &error);
+
+    g_hash_table_iter_init(&iter, edits);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        EntangleControlEdit *edit = value;
 
-    if (!entangle_camera_save_controls_finish(ENTANGLE_CAMERA(src), res, &error)) {
+        if (failed) {
+            ENTANGLE_DEBUG("Rolling back control '%s'",
+                           entangle_control_get_path(edit->control));
+            g_object_set_property(G_OBJECT(edit->control), "value", &edit->previous);
+            entangle_control_set_dirty(edit->control, FALSE);
+        }
+        do_control_edit_set_busy(edit, FALSE);
+        if (!do_control_edit_pending(panel, edit->control))
+            do_queue_control_refresh(edit->widget, ENTANGLE_CONTROL_REFRESH_VALUE);
+    }
+    g_hash_table_unref(edits);
+
+    if (failed) {
         GtkWidget *msg = gtk_message_dialog_new(NULL,
                                                 0,
                                                 GTK_MESSAGE_ERROR,
@@ -96,12 +200,101 @@ static void do_update_control_finish(GObject *src,
         gtk_widget_show_all(msg);
         g_error_free(error);
     }
+
+    /* Edits made while the save was running are sent straight away */
+    if (g_hash_table_size(priv->saveEdits) && !priv->saveId)
+        do_submit_control_save(panel);
+
+    g_object_unref(panel);
+}
+
+
+static void do_submit_control_save(EntangleControlPanel *panel)
+{
+    EntangleControlPanelPrivate *priv = panel->priv;
+    GHashTableIter iter;
+    gpointer value;
+
+    if (!priv->camera) {
+        g_hash_table_remove_all(priv->saveEdits);
+        return;
+    }
+
+    priv->saveInFlight = priv->saveEdits;
+    priv->saveEdits = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            NULL, do_control_edit_free);
+
+    ENTANGLE_DEBUG("Saving %u control edits",
+                   g_hash_table_size(priv->saveInFlight));
+
+    g_hash_table_iter_init(&iter, priv->saveInFlight);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        EntangleControlEdit *edit = value;
+        GParamSpec *pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(edit->control),
+                                                         "value");
+
+        g_value_init(&edit->previous, G_PARAM_SPEC_VALUE_TYPE(pspec));
+        g_object_get_property(G_OBJECT(edit->control), "value", &edit->previous);
+        g_object_set_property(G_OBJECT(edit->control), "value", &edit->value);
+        do_control_edit_set_busy(edit, TRUE);
+    }
+
+    entangle_camera_save_controls_async(priv->camera,
+                                        NULL,
+                                        do_update_control_finish,
+                                        g_object_ref(panel));
 }
 
 
-static gboolean do_refresh_control_entry_idle(gpointer data)
+static gboolean do_submit_control_save_timeout(gpointer data)
+{
+    EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
+    EntangleControlPanelPrivate *priv = panel->priv;
+
+    priv->saveId = 0;
+
+    /* Otherwise picked up when the running save completes */
+    if (!priv->saveInFlight)
+        do_submit_control_save(panel);
+
+    return FALSE;
+}
+
+
+/*
+ * Edits are held back for a short window, with the last value
+ * for each control winning, and then written to the camera as
+ * a single batch, so dragging a slider doesn't queue up a save
+ * for every intermediate position
+ */
+static void do_queue_control_save(EntangleControlPanel *panel,
+                                  GtkWidget *widget,
+                                  const GValue *value)
+{
+    EntangleControlPanelPrivate *priv = panel->priv;
+    EntangleControl *control = g_object_get_data(G_OBJECT(widget), "control");
+    EntangleControlEdit *edit;
+
+    if (!(edit = g_hash_table_lookup(priv->saveEdits, control))) {
+        edit = g_new0(EntangleControlEdit, 1);
+        edit->control = g_object_ref(control);
+        edit->widget = g_object_ref(widget);
+        g_value_init(&edit->value, G_VALUE_TYPE(value));
+        g_hash_table_insert(priv->saveEdits, control, edit);
+    }
+    g_value_copy(value, &edit->value);
+
+    if (!priv->saveId)
+        priv->saveId = g_timeout_add_full(G_PRIORITY_DEFAULT,
+                                          ENTANGLE_CONTROL_SAVE_DELAY_MS,
+                                          do_submit_control_save_timeout,
+                                          g_object_ref(panel),
+                                          g_object_unref);
+}
+
+
+static void do_refresh_control_entry_widget(GtkWidget *widget)
 {
-    GtkWidget *widget = GTK_WIDGET(data);
     EntangleControlPanel *panel = g_object_get_data(G_OBJECT(widget), "panel");
     GObject *control = g_object_get_data(G_OBJECT(widget), "control");
     gchar *text;
@@ -119,14 +312,13 @@ static gboolean do_refresh_control_entry_idle(gpointer data)
         gtk_entry_set_text(GTK_ENTRY(widget), text);
     g_free(text);
     panel->priv->inUpdate = FALSE;
-    return FALSE;
 }
 
 static void do_refresh_control_entry(GObject *object G_GNUC_UNUSED,
                                      GParamSpec *pspec G_GNUC_UNUSED,
                                      gpointer data)
 {
-    g_idle_add(do_refresh_control_entry_idle, data);
+    do_queue_control_refresh(GTK_WIDGET(data), ENTANGLE_CONTROL_REFRESH_VALUE);
 }
 
 static void do_update_control_entry(GtkWidget *widget,
@@ -137,7 +329,7 @@ static void do_update_control_entry(GtkWidget *widget,
 
     EntangleControlText *control = g_object_get_data(G_OBJECT(widget), "control");
     EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
-    EntangleControlPanelPrivate *priv = panel->priv;
+    GValue val = G_VALUE_INIT;
     const char *text;
 
     if (panel->priv->inUpdate)
@@ -149,18 +341,15 @@ static void do_update_control_entry(GtkWidget *widget,
                    entangle_control_get_path(ENTANGLE_CONTROL(control)),
                    entangle_control_get_label(ENTANGLE_CONTROL(control)),
                    text);
-    g_object_set(control, "value", text, NULL);
-
-    entangle_camera_save_controls_async(priv->camera,
-                                        NULL,
-                                        do_update_control_finish,
-                                        panel);
+    g_value_init(&val, G_TYPE_STRING);
+    g_value_set_string(&val, text);
+    do_queue_control_save(panel, widget, &val);
+    g_value_unset(&val);
 }
 
 
-static gboolean do_refresh_control_range_idle(gpointer data)
+static void do_refresh_control_range_widget(GtkWidget *widget)
 {
-    GtkWidget *widget = GTK_WIDGET(data);
     EntangleControlPanel *panel = g_object_get_data(G_OBJECT(widget), "panel");
     GObject *control = g_object_get_data(G_OBJECT(widget), "control");
     gfloat val;
@@ -180,7 +369,6 @@ static gboolean do_refresh_control_range_idle(gpointer data)
         gtk_range_set_value(GTK_RANGE(widget), val);
     }
     panel->priv->inUpdate = FALSE;
-    return FALSE;
 }
 
 
@@ -188,11 +376,11 @@ static void do_refresh_control_range(GObject *object G_GNUC_UNUSED,
                                      GParamSpec *pspec G_GNUC_UNUSED,
                                      gpointer data)
 {
-    g_idle_add(do_refresh_control_range_idle, data);
+    do_queue_control_refresh(GTK_WIDGET(data), ENTANGLE_CONTROL_REFRESH_VALUE);
 }
 
 
-static void do_update_control_range(GtkRange *widget G_GNUC_UNUSED,
+static void do_update_control_range(GtkRange *widget,
                                     GtkScrollType scroll G_GNUC_UNUSED,
                                     gdouble value,
                                     gpointer data)
@@ -201,7 +389,7 @@ static void do_update_control_range(GtkRange *widget G_GNUC_UNUSED,
 
     EntangleControlRange *control = g_object_get_data(G_OBJECT(widget), "control");
     EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
-    EntangleControlPanelPrivate *priv = panel->priv;
+    GValue val = G_VALUE_INIT;
 
     if (panel->priv->inUpdate)
         return;
@@ -210,18 +398,15 @@ static void do_update_control_range(GtkRange *widget G_GNUC_UNUSED,
                    entangle_control_get_path(ENTANGLE_CONTROL(control)),
                    entangle_control_get_label(ENTANGLE_CONTROL(control)),
                    value);
-    g_object_set(control, "value", (double)value, NULL);
-
-    entangle_camera_save_controls_async(priv->camera,
-                                        NULL,
-                                        do_update_control_finish,
-                                        panel);
+    g_value_init(&val, G_TYPE_DOUBLE);
+    g_value_set_double(&val, value);
+    do_queue_control_save(panel, GTK_WIDGET(widget), &val);
+    g_value_unset(&val);
 }
 
 
-static gboolean do_refresh_control_combo_idle(gpointer data)
+static void do_refresh_control_combo_widget(GtkWidget *widget)
 {
-    GtkWidget *widget = GTK_WIDGET(data);
     EntangleControlPanel *panel = g_object_get_data(G_OBJECT(widget), "panel");
     GObject *control = g_object_get_data(G_OBJECT(widget), "control");
     gchar *text;
@@ -252,8 +437,6 @@ static gboolean do_refresh_control_combo_idle(gpointer data)
     }
     g_free(text);
     panel->priv->inUpdate = FALSE;
-
-    return FALSE;
 }
 
 
@@ -261,7 +444,7 @@ static void do_refresh_control_combo(GObject *object G_GNUC_UNUSED,
                                      GParamSpec *pspec G_GNUC_UNUSED,
                                      gpointer data)
 {
-    g_idle_add(do_refresh_control_combo_idle, data);
+    do_queue_control_refresh(GTK_WIDGET(data), ENTANGLE_CONTROL_REFRESH_VALUE);
 }
 
 
@@ -272,7 +455,7 @@ static void do_update_control_combo(GtkComboBox *widget,
 
     EntangleControlChoice *control = g_object_get_data(G_OBJECT(widget), "control");
     EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
-    EntangleControlPanelPrivate *priv = panel->priv;
+    GValue val = G_VALUE_INIT;
     GtkTreeIter iter;
     char *text = NULL;
     GtkTreeModel *model = gtk_combo_box_get_model(widget);
@@ -287,20 +470,15 @@ static void do_update_control_combo(GtkComboBox *widget,
                    entangle_control_get_path(ENTANGLE_CONTROL(control)),
                    entangle_control_get_label(ENTANGLE_CONTROL(control)),
                    text);
-    g_object_set(control, "value", text, NULL);
-
-    g_free(text);
-
-    entangle_camera_save_controls_async(priv->camera,
-                                        NULL,
-                                        do_update_control_finish,
-                                        panel);
+    g_value_init(&val, G_TYPE_STRING);
+    g_value_take_string(&val, text);
+    do_queue_control_save(panel, GTK_WIDGET(widget), &val);
+    g_value_unset(&val);
 }
 
 
-static gboolean do_refresh_control_toggle_idle(gpointer data)
+static void do_refresh_control_toggle_widget(GtkWidget *widget)
 {
-    GtkWidget *widget = GTK_WIDGET(data);
     EntangleControlPanel *panel = g_object_get_data(G_OBJECT(widget), "panel");
     GObject *control = g_object_get_data(G_OBJECT(widget), "control");
     gboolean state;
@@ -318,7 +496,6 @@ static gboolean do_refresh_control_toggle_idle(gpointer data)
         gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(widget),
                                      state);
     panel->priv->inUpdate = FALSE;
-    return FALSE;
 }
 
 
@@ -326,7 +503,7 @@ static void do_refresh_control_toggle(GObject *object G_GNUC_UNUSED,
                                       GParamSpec *pspec G_GNUC_UNUSED,
                                       gpointer data)
 {
-    g_idle_add(do_refresh_control_toggle_idle, data);
+    do_queue_control_refresh(GTK_WIDGET(data), ENTANGLE_CONTROL_REFRESH_VALUE);
 }
 
 
@@ -337,7 +514,7 @@ static void do_update_control_toggle(GtkToggleButton *widget,
 
     EntangleControlChoice *control = g_object_get_data(G_OBJECT(widget), "control");
     EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
-    EntangleControlPanelPrivate *priv = panel->priv;
+    GValue val = G_VALUE_INIT;
     gboolean active;
 
     if (panel->priv->inUpdate)
@@ -348,24 +525,19 @@ static void do_update_control_toggle(GtkToggleButton *widget,
                    entangle_control_get_path(ENTANGLE_CONTROL(control)),
                    entangle_control_get_label(ENTANGLE_CONTROL(control)),
                    active);
-    g_object_set(control, "value", active, NULL);
-
-    entangle_camera_save_controls_async(priv->camera,
-                                        NULL,
-                                        do_update_control_finish,
-                                        panel);
+    g_value_init(&val, G_TYPE_BOOLEAN);
+    g_value_set_boolean(&val, active);
+    do_queue_control_save(panel, GTK_WIDGET(widget), &val);
+    g_value_unset(&val);
 }
 
-static gboolean do_update_control_readonly_idle(gpointer data)
+static void do_update_control_readonly_widget(GtkWidget *widget)
 {
-    GtkWidget *widget = GTK_WIDGET(data);
     GObject *control = g_object_get_data(G_OBJECT(widget), "control");
     gboolean state;
 
     g_object_get(control, "readonly", &state, NULL);
     gtk_widget_set_sensitive(widget, !state);
-
-    return FALSE;
 }
 
 
@@ -373,7 +545,80 @@ static void do_update_control_readonly(GObject *object G_GNUC_UNUSED,
                                        GParamSpec *pspec G_GNUC_UNUSED,
                                        gpointer data)
 {
-    g_idle_add(do_update_control_readonly_idle, data);
+    do_queue_control_refresh(GTK_WIDGET(data), ENTANGLE_CONTROL_REFRESH_READONLY);
+}
+
+
+/*
+ * A burst of control changes from the camera is applied to the
+ * widgets in a single pass, run once before the next redraw,
+ * rather than queueing an idle callback per control change
+ */
+static gboolean do_refresh_controls_idle(gpointer data)
+{
+    EntangleControlPanel *panel = ENTANGLE_CONTROL_PANEL(data);
+    EntangleControlPanelPrivate *priv = panel->priv;
+    GHashTable *widgets;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_mutex_lock(priv->refreshLock);
+    widgets = priv->refreshWidgets;
+    priv->refreshWidgets = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                 g_object_unref, NULL);
+    priv->refreshId = 0;
+    g_mutex_unlock(priv->refreshLock);
+
+    ENTANGLE_DEBUG("Refreshing %u control widgets",
+                   g_hash_table_size(widgets));
+
+    g_hash_table_iter_init(&iter, widgets);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GtkWidget *widget = GTK_WIDGET(key);
+        GObject *control = g_object_get_data(G_OBJECT(widget), "control");
+        guint flags = GPOINTER_TO_UINT(value);
+
+        /* Don't fight the user over a value they're still editing */
+        if ((flags & ENTANGLE_CONTROL_REFRESH_VALUE) &&
+            !do_control_edit_pending(panel, ENTANGLE_CONTROL(control))) {
+            if (ENTANGLE_IS_CONTROL_CHOICE(control))
+                do_refresh_control_combo_widget(widget);
+            else if (ENTANGLE_IS_CONTROL_RANGE(control))
+                do_refresh_control_range_widget(widget);
+            else if (ENTANGLE_IS_CONTROL_TEXT(control))
+                do_refresh_control_entry_widget(widget);
+            else if (ENTANGLE_IS_CONTROL_TOGGLE(control))
+                do_refresh_control_toggle_widget(widget);
+        }
+        if (flags & ENTANGLE_CONTROL_REFRESH_READONLY)
+            do_update_control_readonly_widget(widget);
+    }
+
+    g_hash_table_unref(widgets);
+    return FALSE;
+}
+
+
+/*
+ * May be called from non-main threads, since controls emit
+ * notifications from wherever they are loaded
+ */
+static void do_queue_control_refresh(GtkWidget *widget,
+                                     guint flags)
+{
+    EntangleControlPanel *panel = g_object_get_data(G_OBJECT(widget), "panel");
+    EntangleControlPanelPrivate *priv = panel->priv;
+
+    g_mutex_lock(priv->refreshLock);
+    flags |= GPOINTER_TO_UINT(g_hash_table_lookup(priv->refreshWidgets, widget));
+    g_hash_table_insert(priv->refreshWidgets, g_object_ref(widget),
+                        GUINT_TO_POINTER(flags));
+    if (!priv->refreshId)
+        priv->refreshId = g_idle_add_full(G_PRIORITY_HIGH_IDLE + 10,
+                                          do_refresh_controls_idle,
+                                          g_object_ref(panel),
+                                          g_object_unref);
+    g_mutex_unlock(priv->refreshLock);
 }
 
 
@@ -395,8 +640,8 @@ static void do_setup_control(EntangleControlPanel *panel,
         value = gtk_button_new_with_label(entangle_control_get_label(control));
         if (entangle_control_get_readonly(control))
             gtk_widget_set_sensitive(value, FALSE);
-        g_signal_connect(control, "notify::readonly",
-                         G_CALLBACK(do_update_control_readonly), value);
+        g_signal_connect_object(control, "notify::readonly",
+                                G_CALLBACK(do_update_control_readonly), value, 0);
     } else if (ENTANGLE_IS_CONTROL_CHOICE(control)) {
         GtkCellRenderer *cell;
         GtkListStore *store;
@@ -443,10 +688,10 @@ static void do_setup_control(EntangleControlPanel *panel,
 
         g_signal_connect(value, "changed",
                          G_CALLBACK(do_update_control_combo), panel);
-        g_signal_connect(control, "notify::value",
-                         G_CALLBACK(do_refresh_control_combo), value);
-        g_signal_connect(control, "notify::readonly",
-                         G_CALLBACK(do_update_control_readonly), value);
+        g_signal_connect_object(control, "notify::value",
+                                G_CALLBACK(do_refresh_control_combo), value, 0);
+        g_signal_connect_object(control, "notify::readonly",
+                                G_CALLBACK(do_update_control_readonly), value, 0);
     } else if (ENTANGLE_IS_CONTROL_DATE(control)) {
         int date;
 
@@ -475,10 +720,10 @@ static void do_setup_control(EntangleControlPanel *panel,
             gtk_widget_set_sensitive(value, FALSE);
         g_signal_connect(value, "change-value",
                          G_CALLBACK(do_update_control_range), panel);
-        g_signal_connect(control, "notify::value",
-                         G_CALLBACK(do_refresh_control_range), value);
-        g_signal_connect(control, "notify::readonly",
-                         G_CALLBACK(do_update_control_readonly), value);
+        g_signal_connect_object(control, "notify::value",
+                                G_CALLBACK(do_refresh_control_range), value, 0);
+        g_signal_connect_object(control, "notify::readonly",
+                                G_CALLBACK(do_update_control_readonly), value, 0);
     } else if (ENTANGLE_IS_CONTROL_TEXT(control)) {
         const char *text;
 
@@ -489,10 +734,10 @@ static void do_setup_control(EntangleControlPanel *panel,
             gtk_widget_set_sensitive(value, FALSE);
         g_signal_connect(value, "focus-out-event",
                          G_CALLBACK(do_update_control_entry), panel);
-        g_signal_connect(control, "notify::value",
-                         G_CALLBACK(do_refresh_control_entry), value);
-        g_signal_connect(control, "notify::readonly",
-                         G_CALLBACK(do_update_control_readonly), value);
+        g_signal_connect_object(control, "notify::value",
+                                G_CALLBACK(do_refresh_control_entry), value, 0);
+        g_signal_connect_object(control, "notify::readonly",
+                                G_CALLBACK(do_update_control_readonly), value, 0);
     } else if (ENTANGLE_IS_CONTROL_TOGGLE(control)) {
         gboolean active;
         needLabel = FALSE;
@@ -503,10 +748,10 @@ static void do_setup_control(EntangleControlPanel *panel,
             gtk_widget_set_sensitive(value, FALSE);
         g_signal_connect(value, "toggled",
                          G_CALLBACK(do_update_control_toggle), panel);
-        g_signal_connect(control, "notify::value",
-                         G_CALLBACK(do_refresh_control_toggle), value);
-        g_signal_connect(control, "notify::readonly",
-                         G_CALLBACK(do_update_control_readonly), value);
+        g_signal_connect_object(control, "notify::value",
+                                G_CALLBACK(do_refresh_control_toggle), value, 0);
+        g_signal_connect_object(control, "notify::readonly",
+                                G_CALLBACK(do_update_control_readonly), value, 0);
     }
 
     if (needLabel) {
@@ -525,6 +770,7 @@ static void do_setup_control(EntangleControlPanel *panel,
 
         g_object_set_data(G_OBJECT(value), "panel", panel);
         g_object_set_data(G_OBJECT(value), "control", control);
+        g_object_set_data(G_OBJECT(value), "label", label);
         gtk_widget_show(value);
     } else {
         gtk_widget_set_hexpand(value, TRUE);
@@ -839,6 +1085,12 @@ static void do_setup_camera(EntangleControlPanel *panel)
     gtk_container_foreach(GTK_CONTAINER(priv->grid), do_control_remove, panel);
     priv->rows = 0;
 
+    if (priv->saveId) {
+        g_source_remove(priv->saveId);
+        priv->saveId = 0;
+    }
+    g_hash_table_remove_all(priv->saveEdits);
+
     if (!priv->camera) {
         GtkWidget *label = gtk_label_new(_("No camera connected"));
 
@@ -944,6 +1196,10 @@ static void entangle_control_panel_finalize(GObject *object)
         g_object_unref(priv->cameraPrefs);
     }
 
+    g_hash_table_unref(priv->refreshWidgets);
+    g_mutex_free(priv->refreshLock);
+    g_hash_table_unref(priv->saveEdits);
+
     G_OBJECT_CLASS(entangle_control_panel_parent_class)->finalize(object);
 }
 
@@ -1012,6 +1268,12 @@ static void entangle_control_panel_init(EntangleControlPanel *panel)
 
     gtk_container_set_border_width(GTK_CONTAINER(panel), 0);
 
+    priv->refreshLock = g_mutex_new();
+    priv->refreshWidgets = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                 g_object_unref, NULL);
+    priv->saveEdits = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            NULL, do_control_edit_free);
+
     priv->grid = gtk_grid_new();
     gtk_grid_set_row_spacing(GTK_GRID(priv->grid), 6);
     gtk_grid_set_column_spacing(GTK_GRID(priv->grid), 6);
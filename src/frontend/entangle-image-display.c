@@ -26,6 +26,10 @@
 #include "entangle-debug.h"
 #include "entangle-image-display.h"
 #include "entangle-image.h"
+#include "entangle-capture-latency.h"
+#include "entangle-image-popup.h"
+#include "entangle-metrics.h"
+#include "entangle-tracer.h"
 
 #define ENTANGLE_IMAGE_DISPLAY_GET_PRIVATE(obj)                         \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_IMAGE_DISPLAY, EntangleImageDisplayPrivate))
@@ -34,6 +38,14 @@ struct _EntangleImageDisplayPrivate {
     GList *images;
 
     cairo_surface_t *pixmap;
+    EntangleMetricsMemory *pixmapMemory;
+    gsize pixmapBytes;
+
+    /* A preview frame shown in place of the images, with
+     * the dimensions it had before it was scaled down */
+    cairo_surface_t *frame;
+    gint frameWidth;
+    gint frameHeight;
     GdkRGBA bkg;
 
     gboolean autoscale;
@@ -67,6 +79,51 @@ static void entangle_image_display_image_pixbuf_notify(GObject *image,
                                                        gpointer data);
 
 
+static void entangle_image_display_free_pixmap(EntangleImageDisplay *display)
+{
+    EntangleImageDisplayPrivate *priv = display->priv;
+
+    if (!priv->pixmap)
+        return;
+
+    entangle_metrics_memory_free(priv->pixmapMemory, priv->pixmapBytes);
+    cairo_surface_destroy(priv->pixmap);
+    priv->pixmap = NULL;
+}
+
+
+static void entangle_image_display_free_frame(EntangleImageDisplay *display)
+{
+    EntangleImageDisplayPrivate *priv = display->priv;
+
+    if (!priv->frame)
+        return;
+
+    cairo_surface_destroy(priv->frame);
+    priv->frame = NULL;
+    priv->frameWidth = priv->frameHeight = 0;
+}
+
+
+static void entangle_image_display_clear_images(EntangleImageDisplay *display)
+{
+    EntangleImageDisplayPrivate *priv = display->priv;
+    GList *tmp = priv->images;
+
+    while (tmp) {
+        EntangleImage *image = ENTANGLE_IMAGE(tmp->data);
+
+        g_signal_handlers_disconnect_by_data(image, display);
+        g_object_unref(image);
+
+        tmp = tmp->next;
+    }
+    g_list_free(priv->images);
+
+    priv->images = NULL;
+}
+
+
 static void do_entangle_image_display_render_pixmap(EntangleImageDisplay *display)
 {
     EntangleImageDisplayPrivate *priv = display->priv;
@@ -85,6 +142,13 @@ static void do_entangle_image_display_render_pixmap(EntangleImageDisplay *displa
     height = gdk_pixbuf_get_height(pixbuf);
     priv->pixmap = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
 
+    /* Popups embed a display, but are accounted separately */
+    priv->pixmapMemory = entangle_metrics_memory_owner(
+        ENTANGLE_IS_IMAGE_POPUP(gtk_widget_get_toplevel(GTK_WIDGET(display))) ?
+        "EntangleImagePopup" : "EntangleImageDisplay");
+    priv->pixmapBytes = (gsize)cairo_image_surface_get_stride(priv->pixmap) * height;
+    entangle_metrics_memory_alloc(priv->pixmapMemory, priv->pixmapBytes);
+
     /* Paint the stack of images - the first one
      * is completely opaque and determine the base
      * dimensions. Others are scaled layers on top. */
@@ -133,10 +197,7 @@ static void entangle_image_display_try_render_pixmap(EntangleImageDisplay *displ
         return;
     }
 
-    if (priv->pixmap) {
-        cairo_surface_destroy(priv->pixmap);
-        priv->pixmap = NULL;
-    }
+    entangle_image_display_free_pixmap(display);
 
     if (!priv->images)
         return;
@@ -277,21 +338,10 @@ static void entangle_image_display_set_property(GObject *object,
 static void entangle_image_display_finalize(GObject *object)
 {
     EntangleImageDisplay *display = ENTANGLE_IMAGE_DISPLAY(object);
-    EntangleImageDisplayPrivate *priv = display->priv;
-    GList *tmp = priv->images;
 
-    while (tmp) {
-        EntangleImage *image = tmp->data;
-
-        g_signal_handlers_disconnect_by_data(image, display);
-        g_object_unref(image);
-
-        tmp = tmp->next;
-    }
-    g_list_free(priv->images);
-
-    if (priv->pixmap)
-        cairo_surface_destroy(priv->pixmap);
+    entangle_image_display_clear_images(display);
+    entangle_image_display_free_pixmap(display);
+    entangle_image_display_free_frame(display);
 
     G_OBJECT_CLASS(entangle_image_display_parent_class)->finalize(object);
 }
@@ -477,16 +527,23 @@ static gboolean entangle_image_display_draw(GtkWidget *widget, cairo_t *cr)
     EntangleImageDisplayPrivate *priv = display->priv;
     int ww, wh; /* Available drawing area extents */
     int pw = 0, ph = 0; /* Original image size */
+    cairo_surface_t *base; /* Surface holding the image */
     double iw, ih; /* Desired image size */
     double mx = 0, my = 0;  /* Offset of image within available area */
     double sx = 1, sy = 1;  /* Amount to scale by */
     double aspectWin, aspectImage = 0.0;
 
+    ENTANGLE_TRACE_BEGIN("image-display-draw");
     ww = gdk_window_get_width(gtk_widget_get_window(widget));
     wh = gdk_window_get_height(gtk_widget_get_window(widget));
     aspectWin = (double)ww / (double)wh;
 
-    if (priv->pixmap) {
+    if (priv->frame) {
+        base = priv->frame;
+        pw = priv->frameWidth;
+        ph = priv->frameHeight;
+        aspectImage = (double)pw / (double)ph;
+    } else if ((base = priv->pixmap)) {
         pw = cairo_image_surface_get_width(priv->pixmap);
         ph = cairo_image_surface_get_height(priv->pixmap);
         aspectImage = (double)pw / (double)ph;
@@ -542,7 +599,7 @@ static gboolean entangle_image_display_draw(GtkWidget *widget, cairo_t *cr)
        not double-buffering. Note we're using the undocumented
        behaviour of drawing the rectangle from right to left
        to cut out the whole */
-    if (priv->pixmap)
+    if (base)
         cairo_rectangle(cr,
                         mx + iw,
                         my,
@@ -551,15 +608,20 @@ static gboolean entangle_image_display_draw(GtkWidget *widget, cairo_t *cr)
     cairo_fill(cr);
     cairo_restore(cr);
 
-    /* Draw the actual image(s) */
-    if (priv->pixmap) {
+    /* Draw the actual image(s). A frame may have been
+     * decoded smaller than its original size, so the
+     * scale is relative to the surface, not the image */
+    if (base) {
         cairo_matrix_t m;
+        double bx = sx * pw / cairo_image_surface_get_width(base);
+        double by = sy * ph / cairo_image_surface_get_height(base);
+
         cairo_get_matrix(cr, &m);
-        cairo_scale(cr, sx, sy);
+        cairo_scale(cr, bx, by);
 
         cairo_set_source_surface(cr,
-                                 priv->pixmap,
-                                 mx/sx, my/sy);
+                                 base,
+                                 mx/bx, my/by);
         cairo_paint(cr);
         cairo_set_matrix(cr, &m);
     }
@@ -572,7 +634,7 @@ static gboolean entangle_image_display_draw(GtkWidget *widget, cairo_t *cr)
     entangle_image_display_draw_grid_display(widget, cr, mx, my);
 
     /* Finally a possible aspect ratio mask */
-    if (priv->pixmap && priv->maskEnabled &&
+    if (base && priv->maskEnabled &&
         (fabs(priv->aspectRatio - aspectImage)  > 0.005)) {
         cairo_set_source_rgba(cr, 0, 0, 0, priv->maskOpacity);
 
@@ -603,6 +665,12 @@ static gboolean entangle_image_display_draw(GtkWidget *widget, cairo_t *cr)
         }
     }
 
+    if (priv->pixmap && priv->images)
+        entangle_capture_latency_mark_file(entangle_capture_latency_get_default(),
+                                           entangle_image_get_filename(priv->images->data),
+                                           ENTANGLE_CAPTURE_STAGE_PAINTED);
+
+    ENTANGLE_TRACE_END("image-display-draw");
     return TRUE;
 }
 
@@ -621,7 +689,7 @@ static void entangle_image_display_get_preferred_width(GtkWidget *widget,
     if (image)
         pixbuf = entangle_image_get_pixbuf(image);
 
-    if (!pixbuf) {
+    if (!pixbuf && !priv->frame) {
         *minwidth = *natwidth = 100;
         ENTANGLE_DEBUG("No image, size request 100,100");
         return;
@@ -634,7 +702,8 @@ static void entangle_image_display_get_preferred_width(GtkWidget *widget,
         *minwidth = *natwidth = 100;
     } else {
         /* Start a 1-to-1 mode */
-        *minwidth = *natwidth = gdk_pixbuf_get_width(pixbuf);
+        *minwidth = *natwidth = pixbuf ?
+            gdk_pixbuf_get_width(pixbuf) : priv->frameWidth;
         if (priv->scale > 0) {
             /* Scaling mode */
             *minwidth = *natwidth = (int)((double)*minwidth * priv->scale);
@@ -657,7 +726,7 @@ static void entangle_image_display_get_preferred_height(GtkWidget *widget,
     if (image)
         pixbuf = entangle_image_get_pixbuf(image);
 
-    if (!pixbuf) {
+    if (!pixbuf && !priv->frame) {
         *minheight = *natheight = 100;
         ENTANGLE_DEBUG("No image, size request 100,100");
         return;
@@ -670,7 +739,8 @@ static void entangle_image_display_get_preferred_height(GtkWidget *widget,
         *minheight = *natheight = 100;
     } else {
         /* Start a 1-to-1 mode */
-        *minheight = *natheight = gdk_pixbuf_get_height(pixbuf);
+        *minheight = *natheight = pixbuf ?
+            gdk_pixbuf_get_height(pixbuf) : priv->frameHeight;
         if (priv->scale > 0) {
             /* Scaling mode */
             *minheight = *natheight = (int)((double)*minheight * priv->scale);
@@ -867,18 +937,8 @@ void entangle_image_display_set_image_list(EntangleImageDisplay *display,
     EntangleImageDisplayPrivate *priv = display->priv;
     GList *tmp;
 
-    tmp = priv->images;
-    while (tmp) {
-        EntangleImage *image = ENTANGLE_IMAGE(tmp->data);
-
-        g_signal_handlers_disconnect_by_data(image, display);
-        g_object_unref(image);
-
-        tmp = tmp->next;
-    }
-    g_list_free(priv->images);
-
-    priv->images = NULL;
+    entangle_image_display_clear_images(display);
+    entangle_image_display_free_frame(display);
 
     tmp = images;
     while (tmp) {
@@ -898,6 +958,44 @@ void entangle_image_display_set_image_list(EntangleImageDisplay *display,
 }
 
 
+/**
+ * entangle_image_display_set_frame:
+ * @display: the display widget
+ * @frame: (transfer none): the preview frame to display
+ * @width: the original width of the frame
+ * @height: the original height of the frame
+ *
+ * Display a camera preview frame in place of any images.
+ * The surface may have been decoded at a reduced size,
+ * in which case @width and @height give the size it
+ * is to be treated as for scaling and layout.
+ */
+void entangle_image_display_set_frame(EntangleImageDisplay *display,
+                                      cairo_surface_t *frame,
+                                      gint width,
+                                      gint height)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_DISPLAY(display));
+    g_return_if_fail(frame != NULL);
+
+    EntangleImageDisplayPrivate *priv = display->priv;
+    gboolean resize = priv->frameWidth != width || priv->frameHeight != height;
+
+    entangle_image_display_clear_images(display);
+    entangle_image_display_free_pixmap(display);
+    entangle_image_display_free_frame(display);
+
+    priv->frame = cairo_surface_reference(frame);
+    priv->frameWidth = width;
+    priv->frameHeight = height;
+
+    /* Consecutive frames nearly always match in size */
+    if (resize)
+        gtk_widget_queue_resize(GTK_WIDGET(display));
+    gtk_widget_queue_draw(GTK_WIDGET(display));
+}
+
+
 /**
  * entangle_image_display_get_image_list:
  * @display: the display widget
@@ -1083,6 +1181,9 @@ gboolean entangle_image_display_get_loaded(EntangleImageDisplay *display)
     EntangleImage *image = entangle_image_display_get_image(display);
     GdkPixbuf *pixbuf = NULL;
 
+    if (display->priv->frame)
+        return TRUE;
+
     if (image)
         pixbuf = entangle_image_get_pixbuf(image);
 
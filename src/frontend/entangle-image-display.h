@@ -70,6 +70,11 @@ void entangle_image_display_set_image_list(EntangleImageDisplay *display,
                                            GList *images);
 GList *entangle_image_display_get_image_list(EntangleImageDisplay *display);
 
+void entangle_image_display_set_frame(EntangleImageDisplay *display,
+                                      cairo_surface_t *frame,
+                                      gint width,
+                                      gint height);
+
 void entangle_image_display_set_autoscale(EntangleImageDisplay *displsy,
                                           gboolean autoscale);
 gboolean entangle_image_display_get_autoscale(EntangleImageDisplay *display);
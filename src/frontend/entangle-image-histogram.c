@@ -22,10 +22,12 @@
 
 #include <string.h>
 #include <math.h>
+#include <glib/gi18n.h>
 
 #include "entangle-debug.h"
 #include "entangle-image-histogram.h"
 #include "entangle-image.h"
+#include "entangle-tracer.h"
 
 #define ENTANGLE_IMAGE_HISTOGRAM_GET_PRIVATE(obj)                       \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_IMAGE_HISTOGRAM, EntangleImageHistogramPrivate))
@@ -34,10 +36,14 @@ struct _EntangleImageHistogramPrivate {
     double freq_red[256];
     double freq_green[256];
     double freq_blue[256];
+    double clipped[3];
     gboolean hasFreq;
+    gboolean hasRaw;
     gboolean linear;
+    gboolean raw;
     gulong imageNotifyID;
     EntangleImage *image;
+    cairo_surface_t *frame;
 };
 
 G_DEFINE_TYPE(EntangleImageHistogram, entangle_image_histogram, GTK_TYPE_DRAWING_AREA);
@@ -50,11 +56,71 @@ enum {
 #define DOUBLE_EQUAL(a, b)                      \
     (fabs((a) - (b)) < 0.005)
 
+/*
+ * Fold the photosites of the filter pattern into the three
+ * colour channels. Bayer sensors have two green sites, so
+ * the green curve is taller, but the clipped fractions
+ * are relative to the number of sites of each colour.
+ */
+static void do_entangle_pixmap_setup_raw(EntangleImageHistogram *histogram,
+                                         EntangleRawHistogram *raw)
+{
+    EntangleImageHistogramPrivate *priv = histogram->priv;
+    double *freq[3] = { priv->freq_red, priv->freq_green, priv->freq_blue };
+    guint64 clipped[3] = { 0, 0, 0 };
+    guint64 total[3] = { 0, 0, 0 };
+    guint site;
+    int idx;
+
+    for (site = 0; site < ENTANGLE_RAW_HISTOGRAM_SITES; site++) {
+        int colour = entangle_raw_histogram_get_colour(raw, site);
+        const guint64 *counts = entangle_raw_histogram_get_counts(raw, site);
+
+        for (idx = 0; idx < ENTANGLE_RAW_HISTOGRAM_BINS; idx++)
+            freq[colour][idx] += counts[idx];
+        clipped[colour] += entangle_raw_histogram_get_clipped(raw, site);
+        total[colour] += entangle_raw_histogram_get_total(raw, site);
+    }
+
+    for (idx = 0; idx < 3; idx++)
+        priv->clipped[idx] = total[idx] ?
+            (double)clipped[idx] * 100.0 / (double)total[idx] : 0.0;
+
+    priv->hasFreq = TRUE;
+    priv->hasRaw = TRUE;
+}
+
+
+static void do_entangle_pixmap_setup_frame(EntangleImageHistogram *histogram)
+{
+    EntangleImageHistogramPrivate *priv = histogram->priv;
+    guchar *pixels = cairo_image_surface_get_data(priv->frame);
+    guint w = cairo_image_surface_get_width(priv->frame);
+    guint h = cairo_image_surface_get_height(priv->frame);
+    guint stride = cairo_image_surface_get_stride(priv->frame);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        guint32 *pixel = (guint32 *)pixels;
+        for (x = 0; x < w; x++) {
+            priv->freq_red[(pixel[x] >> 16) & 0xff]++;
+            priv->freq_green[(pixel[x] >> 8) & 0xff]++;
+            priv->freq_blue[pixel[x] & 0xff]++;
+        }
+
+        pixels += stride;
+    }
+
+    priv->hasFreq = TRUE;
+}
+
+
 static void do_entangle_pixmap_setup(EntangleImageHistogram *histogram)
 {
     g_return_if_fail(ENTANGLE_IS_IMAGE_HISTOGRAM(histogram));
 
     EntangleImageHistogramPrivate *priv = histogram->priv;
+    EntangleRawHistogram *raw = NULL;
     GdkPixbuf *pixbuf = NULL;
 
     if (priv->image)
@@ -63,6 +129,20 @@ static void do_entangle_pixmap_setup(EntangleImageHistogram *histogram)
     memset(priv->freq_red, 0, sizeof(priv->freq_red));
     memset(priv->freq_green, 0, sizeof(priv->freq_green));
     memset(priv->freq_blue, 0, sizeof(priv->freq_blue));
+    priv->hasRaw = FALSE;
+
+    if (priv->frame) {
+        do_entangle_pixmap_setup_frame(histogram);
+        return;
+    }
+
+    if (priv->image && priv->raw)
+        raw = entangle_image_get_raw_histogram(priv->image);
+    if (raw) {
+        do_entangle_pixmap_setup_raw(histogram, raw);
+        g_object_unref(raw);
+        return;
+    }
 
     if (!pixbuf) {
         priv->hasFreq = FALSE;
@@ -146,6 +226,8 @@ static void entangle_image_histogram_finalize(GObject *object)
         g_signal_handler_disconnect(priv->image, priv->imageNotifyID);
         g_object_unref(priv->image);
     }
+    if (priv->frame)
+        cairo_surface_destroy(priv->frame);
 
     G_OBJECT_CLASS(entangle_image_histogram_parent_class)->finalize(object);
 }
@@ -189,6 +271,7 @@ static gboolean entangle_image_histogram_draw(GtkWidget *widget, cairo_t *cr)
     double peak = 0.0;
     int idx;
 
+    ENTANGLE_TRACE_BEGIN("image-histogram-draw");
     ww = gdk_window_get_width(gtk_widget_get_window(widget));
     wh = gdk_window_get_height(gtk_widget_get_window(widget));
 
@@ -276,8 +359,24 @@ static gboolean entangle_image_histogram_draw(GtkWidget *widget, cairo_t *cr)
         cairo_restore(cr);
     }
 
+    if (priv->hasRaw) {
+        gchar *clipped = g_strdup_printf(_("Clipped R %.2f%% G %.2f%% B %.2f%%"),
+                                         priv->clipped[0],
+                                         priv->clipped[1],
+                                         priv->clipped[2]);
+        cairo_save(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+        cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.8);
+        cairo_set_font_size(cr, 10);
+        cairo_move_to(cr, 4, 12);
+        cairo_show_text(cr, clipped);
+        cairo_restore(cr);
+        g_free(clipped);
+    }
+
     cairo_restore(cr);
 
+    ENTANGLE_TRACE_END("image-histogram-draw");
     return TRUE;
 }
 
@@ -379,6 +478,10 @@ void entangle_image_histogram_set_image(EntangleImageHistogram *histogram,
         g_signal_handler_disconnect(priv->image, priv->imageNotifyID);
         g_object_unref(priv->image);
     }
+    if (priv->frame) {
+        cairo_surface_destroy(priv->frame);
+        priv->frame = NULL;
+    }
     priv->image = image;
     if (priv->image) {
         g_object_ref(priv->image);
@@ -395,6 +498,32 @@ void entangle_image_histogram_set_image(EntangleImageHistogram *histogram,
 }
 
 
+/**
+ * entangle_image_histogram_set_frame:
+ * @histogram: (transfer none): the histogram widget
+ * @frame: (transfer none): the preview frame to display histogram for
+ *
+ * Set a camera preview frame to display the histogram for,
+ * in place of any image
+ */
+void entangle_image_histogram_set_frame(EntangleImageHistogram *histogram,
+                                        cairo_surface_t *frame)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_HISTOGRAM(histogram));
+    g_return_if_fail(frame != NULL);
+
+    EntangleImageHistogramPrivate *priv = histogram->priv;
+
+    entangle_image_histogram_set_image(histogram, NULL);
+    priv->frame = cairo_surface_reference(frame);
+
+    do_entangle_pixmap_setup(histogram);
+
+    if (gtk_widget_get_visible((GtkWidget*)histogram))
+        gtk_widget_queue_draw(GTK_WIDGET(histogram));
+}
+
+
 /**
  * entangle_image_histogram_get_image:
  * @histogram: (transfer none): the histogram widget
@@ -434,6 +563,48 @@ gboolean entangle_image_histogram_get_histogram_linear(EntangleImageHistogram *h
     return priv->linear;
 }
 
+
+/**
+ * entangle_image_histogram_set_histogram_raw:
+ * @histogram: (transfer none): the histogram widget
+ * @raw: TRUE to show the raw sensor data
+ *
+ * If @raw is TRUE, then images which carry a histogram of
+ * their raw sensor data will display that, along with the
+ * fraction of clipped photosites of each colour, instead
+ * of the histogram of the developed pixbuf
+ */
+void entangle_image_histogram_set_histogram_raw(EntangleImageHistogram *histogram, gboolean raw)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_HISTOGRAM(histogram));
+
+    EntangleImageHistogramPrivate *priv = histogram->priv;
+
+    priv->raw = raw;
+
+    do_entangle_pixmap_setup(histogram);
+    gtk_widget_queue_draw(GTK_WIDGET(histogram));
+}
+
+
+/**
+ * entangle_image_histogram_get_histogram_raw:
+ * @histogram: (transfer none): the histogram widget
+ *
+ * Determine whether the raw sensor data is displayed when
+ * available
+ *
+ * Returns: TRUE if raw sensor data is displayed
+ */
+gboolean entangle_image_histogram_get_histogram_raw(EntangleImageHistogram *histogram)
+{
+    g_return_val_if_fail(ENTANGLE_IS_IMAGE_HISTOGRAM(histogram), FALSE);
+
+    EntangleImageHistogramPrivate *priv = histogram->priv;
+
+    return priv->raw;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
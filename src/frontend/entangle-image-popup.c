@@ -352,6 +352,35 @@ void entangle_image_popup_set_image(EntangleImagePopup *popup, EntangleImage *im
 }
 
 
+/**
+ * entangle_image_popup_set_frame:
+ * @popup: (transfer none): the popup widget
+ * @frame: (transfer none): the preview frame to display
+ * @width: the original width of the frame
+ * @height: the original height of the frame
+ *
+ * Set a camera preview frame to be displayed by the popup,
+ * in place of any image
+ */
+void entangle_image_popup_set_frame(EntangleImagePopup *popup,
+                                    cairo_surface_t *frame,
+                                    gint width,
+                                    gint height)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_POPUP(popup));
+
+    EntangleImagePopupPrivate *priv = popup->priv;
+
+    if (priv->image) {
+        g_object_unref(priv->image);
+        priv->image = NULL;
+        g_object_notify(G_OBJECT(popup), "image");
+    }
+
+    entangle_image_display_set_frame(priv->display, frame, width, height);
+}
+
+
 /**
  * entangle_image_popup_get_image:
  * @popup: (transfer none): the popup widget
@@ -65,6 +65,10 @@ void entangle_image_popup_move_to_monitor(EntangleImagePopup *popup, gint monito
 void entangle_image_popup_show_on_monitor(EntangleImagePopup *popup, gint monitor);
 
 void entangle_image_popup_set_image(EntangleImagePopup *popup, EntangleImage *image);
+void entangle_image_popup_set_frame(EntangleImagePopup *popup,
+                                    cairo_surface_t *frame,
+                                    gint width,
+                                    gint height);
 EntangleImage *entangle_image_popup_get_image(EntangleImagePopup *popup);
 
 void entangle_image_popup_set_background(EntangleImagePopup *popup,
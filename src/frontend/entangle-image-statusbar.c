@@ -25,6 +25,7 @@
 #include "entangle-debug.h"
 #include "entangle-image-statusbar.h"
 #include "entangle-image.h"
+#include "entangle-capture-latency.h"
 
 #define ENTANGLE_IMAGE_STATUSBAR_GET_PRIVATE(obj)                       \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_IMAGE_STATUSBAR, EntangleImageStatusbarPrivate))
@@ -40,6 +41,10 @@ struct _EntangleImageStatusbarPrivate {
     GtkWidget *metaIso;
     GtkWidget *metaFocal;
     GtkWidget *metaDimensions;
+    GtkWidget *latency;
+
+    gboolean showLatency;
+    gulong latencyID;
 };
 
 G_DEFINE_TYPE(EntangleImageStatusbar, entangle_image_statusbar, GTK_TYPE_EVENT_BOX);
@@ -47,6 +52,7 @@ G_DEFINE_TYPE(EntangleImageStatusbar, entangle_image_statusbar, GTK_TYPE_EVENT_B
 enum {
     PROP_O,
     PROP_IMAGE,
+    PROP_SHOW_LATENCY,
 };
 
 
@@ -64,6 +70,10 @@ static void entangle_image_statusbar_get_property(GObject *object,
             g_value_set_object(value, priv->image);
             break;
 
+        case PROP_SHOW_LATENCY:
+            g_value_set_boolean(value, priv->showLatency);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         }
@@ -85,6 +95,10 @@ static void entangle_image_statusbar_set_property(GObject *object,
             entangle_image_statusbar_set_image(statusbar, g_value_get_object(value));
             break;
 
+        case PROP_SHOW_LATENCY:
+            entangle_image_statusbar_set_show_latency(statusbar, g_value_get_boolean(value));
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         }
@@ -100,6 +114,9 @@ static void entangle_image_statusbar_finalize(GObject *object)
         g_signal_handler_disconnect(priv->image, priv->imageNotifyID);
         g_object_unref(priv->image);
     }
+    if (priv->latencyID)
+        g_signal_handler_disconnect(entangle_capture_latency_get_default(),
+                                    priv->latencyID);
 
     G_OBJECT_CLASS(entangle_image_statusbar_parent_class)->finalize(object);
 }
@@ -124,6 +141,17 @@ static void entangle_image_statusbar_class_init(EntangleImageStatusbarClass *kla
                                                         G_PARAM_STATIC_NICK |
                                                         G_PARAM_STATIC_BLURB));
 
+    g_object_class_install_property(object_class,
+                                    PROP_SHOW_LATENCY,
+                                    g_param_spec_boolean("show-latency",
+                                                         "Show latency",
+                                                         "Show the capture latency of the image",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
     g_type_class_add_private(klass, sizeof(EntangleImageStatusbarPrivate));
 }
 
@@ -154,12 +182,14 @@ static void entangle_image_statusbar_init(EntangleImageStatusbar *statusbar)
     priv->metaFocal = gtk_label_new("");
     priv->metaIso = gtk_label_new("");
     priv->metaDimensions = gtk_label_new("");
+    priv->latency = gtk_label_new("");
 
     gtk_box_pack_start(GTK_BOX(priv->metaBox), priv->metaAperture, TRUE, TRUE, 6);
     gtk_box_pack_start(GTK_BOX(priv->metaBox), priv->metaShutter, TRUE, TRUE, 6);
     gtk_box_pack_start(GTK_BOX(priv->metaBox), priv->metaFocal, TRUE, TRUE, 6);
     gtk_box_pack_start(GTK_BOX(priv->metaBox), priv->metaIso, TRUE, TRUE, 6);
     gtk_box_pack_start(GTK_BOX(priv->metaBox), priv->metaDimensions, TRUE, TRUE, 6);
+    gtk_box_pack_start(GTK_BOX(priv->metaBox), priv->latency, TRUE, TRUE, 6);
 
     gtk_container_add(GTK_CONTAINER(statusbar), priv->metaBox);
 
@@ -170,8 +200,11 @@ static void entangle_image_statusbar_init(EntangleImageStatusbar *statusbar)
     gtk_widget_override_color(GTK_WIDGET(priv->metaFocal), GTK_STATE_FLAG_NORMAL, &white);
     gtk_widget_override_color(GTK_WIDGET(priv->metaIso), GTK_STATE_FLAG_NORMAL, &white);
     gtk_widget_override_color(GTK_WIDGET(priv->metaDimensions), GTK_STATE_FLAG_NORMAL, &white);
+    gtk_widget_override_color(GTK_WIDGET(priv->latency), GTK_STATE_FLAG_NORMAL, &white);
 
     gtk_widget_show_all(GTK_WIDGET(statusbar));
+    gtk_widget_set_no_show_all(priv->latency, TRUE);
+    gtk_widget_hide(priv->latency);
 }
 
 
@@ -247,6 +280,50 @@ static void entangle_image_statusbar_update_labels(EntangleImageStatusbar *statu
 }
 
 
+static void entangle_image_statusbar_update_latency(EntangleImageStatusbar *statusbar)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_STATUSBAR(statusbar));
+
+    EntangleImageStatusbarPrivate *priv = statusbar->priv;
+    EntangleCaptureLatency *latency = entangle_capture_latency_get_default();
+    gint64 elapsed = -1;
+    gint64 p50, p90;
+    gchar *text = NULL;
+
+    if (!priv->showLatency)
+        return;
+
+    if (priv->image)
+        elapsed = entangle_capture_latency_get_elapsed(latency,
+                                                       entangle_image_get_filename(priv->image),
+                                                       ENTANGLE_CAPTURE_STAGE_PAINTED);
+    p50 = entangle_capture_latency_get_percentile(latency, ENTANGLE_CAPTURE_STAGE_PAINTED, 50);
+    p90 = entangle_capture_latency_get_percentile(latency, ENTANGLE_CAPTURE_STAGE_PAINTED, 90);
+
+    if (elapsed >= 0)
+        text = g_strdup_printf("Shot to screen %d ms (p50 %d, p90 %d)",
+                               (int)(elapsed / 1000), (int)(p50 / 1000), (int)(p90 / 1000));
+    else if (p50 >= 0)
+        text = g_strdup_printf("Shot to screen p50 %d ms, p90 %d ms",
+                               (int)(p50 / 1000), (int)(p90 / 1000));
+
+    gtk_label_set_text(GTK_LABEL(priv->latency), text ? text : "");
+    g_free(text);
+}
+
+
+static void entangle_image_statusbar_shot_completed(EntangleCaptureLatency *latency G_GNUC_UNUSED,
+                                                    const char *filename G_GNUC_UNUSED,
+                                                    gpointer data)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_STATUSBAR(data));
+
+    EntangleImageStatusbar *statusbar = ENTANGLE_IMAGE_STATUSBAR(data);
+
+    entangle_image_statusbar_update_latency(statusbar);
+}
+
+
 static void entangle_image_statusbar_image_metadata_notify(GObject *image G_GNUC_UNUSED,
                                                            GParamSpec *pspec G_GNUC_UNUSED,
                                                            gpointer data)
@@ -287,6 +364,7 @@ void entangle_image_statusbar_set_image(EntangleImageStatusbar *statusbar,
                                                statusbar);
     }
 
+    entangle_image_statusbar_update_latency(statusbar);
     gtk_widget_queue_draw(GTK_WIDGET(statusbar));
 }
 
@@ -308,6 +386,57 @@ EntangleImage *entangle_image_statusbar_get_image(EntangleImageStatusbar *status
     return priv->image;
 }
 
+
+/**
+ * entangle_image_statusbar_set_show_latency:
+ * @statusbar: (transfer none): the status bar widget
+ * @show: TRUE to show the capture latency
+ *
+ * If @show is TRUE, the time taken from capture until first
+ * display of the image is shown, along with the median and
+ * 90th percentile over recent shots
+ */
+void entangle_image_statusbar_set_show_latency(EntangleImageStatusbar *statusbar,
+                                               gboolean show)
+{
+    g_return_if_fail(ENTANGLE_IS_IMAGE_STATUSBAR(statusbar));
+
+    EntangleImageStatusbarPrivate *priv = statusbar->priv;
+    EntangleCaptureLatency *latency = entangle_capture_latency_get_default();
+
+    priv->showLatency = show;
+    if (show && !priv->latencyID) {
+        priv->latencyID = g_signal_connect(latency,
+                                           "shot-completed",
+                                           G_CALLBACK(entangle_image_statusbar_shot_completed),
+                                           statusbar);
+    } else if (!show && priv->latencyID) {
+        g_signal_handler_disconnect(latency, priv->latencyID);
+        priv->latencyID = 0;
+    }
+
+    gtk_widget_set_visible(priv->latency, show);
+    entangle_image_statusbar_update_latency(statusbar);
+}
+
+
+/**
+ * entangle_image_statusbar_get_show_latency:
+ * @statusbar: (transfer none): the status bar widget
+ *
+ * Determine if the capture latency is shown
+ *
+ * Returns: TRUE if the capture latency is shown
+ */
+gboolean entangle_image_statusbar_get_show_latency(EntangleImageStatusbar *statusbar)
+{
+    g_return_val_if_fail(ENTANGLE_IS_IMAGE_STATUSBAR(statusbar), FALSE);
+
+    EntangleImageStatusbarPrivate *priv = statusbar->priv;
+
+    return priv->showLatency;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -60,6 +60,10 @@ void entangle_image_statusbar_set_image(EntangleImageStatusbar *statusbar,
                                         EntangleImage *image);
 EntangleImage *entangle_image_statusbar_get_image(EntangleImageStatusbar *statusbar);
 
+void entangle_image_statusbar_set_show_latency(EntangleImageStatusbar *statusbar,
+                                               gboolean show);
+gboolean entangle_image_statusbar_get_show_latency(EntangleImageStatusbar *statusbar);
+
 G_END_DECLS
 
 #endif /* __ENTANGLE_IMAGE_STATUSBAR_H__ */
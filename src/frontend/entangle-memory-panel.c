@@ -0,0 +1,265 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+
+#include "entangle-debug.h"
+#include "entangle-memory-panel.h"
+#include "entangle-metrics.h"
+#include "entangle-window.h"
+
+
+#define ENTANGLE_MEMORY_PANEL_GET_PRIVATE(obj)                          \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_MEMORY_PANEL, EntangleMemoryPanelPrivate))
+
+gboolean do_memory_panel_close(GtkButton *src,
+                               gpointer data);
+gboolean do_memory_panel_delete(GtkWidget *src,
+                                GdkEvent *ev);
+void do_memory_panel_show(GtkWidget *src,
+                          gpointer data);
+void do_memory_panel_hide(GtkWidget *src,
+                          gpointer data);
+
+struct _EntangleMemoryPanelPrivate {
+    guint refreshID;
+
+    GtkBuilder *builder;
+};
+
+static void entangle_memory_panel_window_interface_init(gpointer g_iface,
+                                                        gpointer iface_data);
+
+G_DEFINE_TYPE_EXTENDED(EntangleMemoryPanel, entangle_memory_panel, GTK_TYPE_DIALOG, 0,
+                       G_IMPLEMENT_INTERFACE(ENTANGLE_TYPE_WINDOW, entangle_memory_panel_window_interface_init));
+
+enum {
+    FIELD_OWNER,
+    FIELD_BYTES,
+    FIELD_PEAK,
+    FIELD_BUFFERS,
+};
+
+
+static void entangle_memory_panel_finalize(GObject *object)
+{
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(object);
+    EntangleMemoryPanelPrivate *priv = panel->priv;
+
+    if (priv->refreshID)
+        g_source_remove(priv->refreshID);
+    g_object_unref(priv->builder);
+
+    G_OBJECT_CLASS(entangle_memory_panel_parent_class)->finalize(object);
+}
+
+static void do_entangle_memory_panel_set_builder(EntangleWindow *window,
+                                                 GtkBuilder *builder);
+static GtkBuilder *do_entangle_memory_panel_get_builder(EntangleWindow *window);
+
+static void entangle_memory_panel_window_interface_init(gpointer g_iface,
+                                                        gpointer iface_data G_GNUC_UNUSED)
+{
+    EntangleWindowInterface *iface = g_iface;
+    iface->set_builder = do_entangle_memory_panel_set_builder;
+    iface->get_builder = do_entangle_memory_panel_get_builder;
+}
+
+
+static void entangle_memory_panel_class_init(EntangleMemoryPanelClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = entangle_memory_panel_finalize;
+
+    g_type_class_add_private(klass, sizeof(EntangleMemoryPanelPrivate));
+}
+
+
+EntangleMemoryPanel *entangle_memory_panel_new(void)
+{
+    return ENTANGLE_MEMORY_PANEL(entangle_window_new(ENTANGLE_TYPE_MEMORY_PANEL,
+                                                     GTK_TYPE_DIALOG,
+                                                     "memory-panel"));
+}
+
+
+static gboolean do_memory_panel_refresh(gpointer data)
+{
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(data);
+
+    entangle_memory_panel_refresh(panel);
+    return TRUE;
+}
+
+
+gboolean do_memory_panel_close(GtkButton *src G_GNUC_UNUSED,
+                               gpointer data)
+{
+    g_return_val_if_fail(ENTANGLE_IS_MEMORY_PANEL(data), FALSE);
+
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(data);
+
+    ENTANGLE_DEBUG("memory panel close");
+
+    gtk_widget_hide(GTK_WIDGET(panel));
+    return FALSE;
+}
+
+
+gboolean do_memory_panel_delete(GtkWidget *src,
+                                GdkEvent *ev G_GNUC_UNUSED)
+{
+    g_return_val_if_fail(ENTANGLE_IS_MEMORY_PANEL(src), FALSE);
+
+    ENTANGLE_DEBUG("memory panel delete");
+
+    gtk_widget_hide(src);
+    return TRUE;
+}
+
+
+/* Only poll the counters while someone is looking at them */
+void do_memory_panel_show(GtkWidget *src,
+                          gpointer data G_GNUC_UNUSED)
+{
+    g_return_if_fail(ENTANGLE_IS_MEMORY_PANEL(src));
+
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(src);
+    EntangleMemoryPanelPrivate *priv = panel->priv;
+
+    entangle_memory_panel_refresh(panel);
+    if (!priv->refreshID)
+        priv->refreshID = g_timeout_add_seconds(1, do_memory_panel_refresh, panel);
+}
+
+
+void do_memory_panel_hide(GtkWidget *src,
+                          gpointer data G_GNUC_UNUSED)
+{
+    g_return_if_fail(ENTANGLE_IS_MEMORY_PANEL(src));
+
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(src);
+    EntangleMemoryPanelPrivate *priv = panel->priv;
+
+    if (priv->refreshID) {
+        g_source_remove(priv->refreshID);
+        priv->refreshID = 0;
+    }
+}
+
+
+static void do_entangle_memory_panel_set_builder(EntangleWindow *win,
+                                                 GtkBuilder *builder)
+{
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(win);
+    EntangleMemoryPanelPrivate *priv = panel->priv;
+
+    priv->builder = g_object_ref(builder);
+}
+
+
+static GtkBuilder *do_entangle_memory_panel_get_builder(EntangleWindow *window)
+{
+    EntangleMemoryPanel *panel = ENTANGLE_MEMORY_PANEL(window);
+    EntangleMemoryPanelPrivate *priv = panel->priv;
+
+    return priv->builder;
+}
+
+
+static void entangle_memory_panel_init(EntangleMemoryPanel *panel)
+{
+    panel->priv = ENTANGLE_MEMORY_PANEL_GET_PRIVATE(panel);
+}
+
+
+static void entangle_memory_panel_append(GtkListStore *store,
+                                         const char *owner,
+                                         gint64 bytes,
+                                         gint64 peak,
+                                         gint64 buffers)
+{
+    GtkTreeIter iter;
+    gchar *bytesstr = g_format_size(bytes);
+    gchar *peakstr = g_format_size(peak);
+
+    gtk_list_store_append(store, &iter);
+    gtk_list_store_set(store, &iter,
+                       FIELD_OWNER, owner,
+                       FIELD_BYTES, bytesstr,
+                       FIELD_PEAK, peakstr,
+                       FIELD_BUFFERS, buffers,
+                       -1);
+    g_free(bytesstr);
+    g_free(peakstr);
+}
+
+
+/**
+ * entangle_memory_panel_refresh:
+ * @panel: the memory panel
+ *
+ * Reload the memory held by each owner from the metrics,
+ * which is done automatically every second while the
+ * panel is visible
+ */
+void entangle_memory_panel_refresh(EntangleMemoryPanel *panel)
+{
+    g_return_if_fail(ENTANGLE_IS_MEMORY_PANEL(panel));
+
+    EntangleMemoryPanelPrivate *priv = panel->priv;
+    GtkListStore *store = GTK_LIST_STORE(gtk_builder_get_object(priv->builder, "memory-store"));
+    GVariant *memory = entangle_metrics_get_memory();
+    GVariantIter iter;
+    const char *owner;
+    gint64 bytes, peak, buffers;
+    gint64 totalBytes = 0, totalPeak = 0, totalBuffers = 0;
+
+    g_variant_ref_sink(memory);
+
+    gtk_list_store_clear(store);
+    g_variant_iter_init(&iter, memory);
+    while (g_variant_iter_next(&iter, "{&s(xxx)}", &owner, &bytes, &peak, &buffers)) {
+        entangle_memory_panel_append(store, owner, bytes, peak, buffers);
+        totalBytes += bytes;
+        totalPeak += peak;
+        totalBuffers += buffers;
+    }
+
+    /* Owners peak at different times, so this is an upper bound */
+    entangle_memory_panel_append(store, _("Total"),
+                                 totalBytes, totalPeak, totalBuffers);
+
+    g_variant_unref(memory);
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
@@ -0,0 +1,70 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_MEMORY_PANEL_H__
+#define __ENTANGLE_MEMORY_PANEL_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define ENTANGLE_TYPE_MEMORY_PANEL            (entangle_memory_panel_get_type ())
+#define ENTANGLE_MEMORY_PANEL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), ENTANGLE_TYPE_MEMORY_PANEL, EntangleMemoryPanel))
+#define ENTANGLE_MEMORY_PANEL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), ENTANGLE_TYPE_MEMORY_PANEL, EntangleMemoryPanelClass))
+#define ENTANGLE_IS_MEMORY_PANEL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ENTANGLE_TYPE_MEMORY_PANEL))
+#define ENTANGLE_IS_MEMORY_PANEL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ENTANGLE_TYPE_MEMORY_PANEL))
+#define ENTANGLE_MEMORY_PANEL_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), ENTANGLE_TYPE_MEMORY_PANEL, EntangleMemoryPanelClass))
+
+
+typedef struct _EntangleMemoryPanel EntangleMemoryPanel;
+typedef struct _EntangleMemoryPanelPrivate EntangleMemoryPanelPrivate;
+typedef struct _EntangleMemoryPanelClass EntangleMemoryPanelClass;
+
+struct _EntangleMemoryPanel
+{
+    GtkDialog parent;
+
+    EntangleMemoryPanelPrivate *priv;
+};
+
+struct _EntangleMemoryPanelClass
+{
+    GtkDialogClass parent_class;
+};
+
+GType entangle_memory_panel_get_type(void) G_GNUC_CONST;
+
+EntangleMemoryPanel* entangle_memory_panel_new(void);
+
+void entangle_memory_panel_refresh(EntangleMemoryPanel *panel);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_MEMORY_PANEL_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
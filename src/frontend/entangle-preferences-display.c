@@ -33,6 +33,7 @@
 #include "entangle-camera-picker.h"
 #include "entangle-camera-manager.h"
 #include "entangle-image-display.h"
+#include "entangle-session-writer.h"
 #include "entangle-window.h"
 
 
@@ -72,12 +73,17 @@ void do_cms_rendering_intent_changed(GtkComboBox *src, EntanglePreferencesDispla
 void do_interface_auto_connect_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
 void do_interface_screen_blank_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
 void do_interface_histogram_linear_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
+void do_interface_histogram_raw_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
+void do_interface_thumbnail_store_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
+void do_interface_thumbnail_cache_size_changed(GtkSpinButton *src, EntanglePreferencesDisplay *display);
 
 void do_capture_filename_pattern_changed(GtkEntry *src, EntanglePreferencesDisplay *display);
 void do_capture_continuous_preview_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
 void do_capture_electronic_shutter(GtkToggleButton *src, EntanglePreferencesDisplay *preferences);
 void do_capture_delete_file_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
 void do_capture_sync_clock_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
+void do_capture_latency_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
+void do_capture_durability_changed(GtkComboBox *src, EntanglePreferencesDisplay *display);
 
 void do_img_mask_enabled_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *display);
 void do_img_aspect_ratio_changed(GtkComboBox *src, EntanglePreferencesDisplay *display);
@@ -197,6 +203,34 @@ static void entangle_preferences_display_notify(GObject *object,
 
         if (newvalue != oldvalue)
             gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), newvalue);
+    } else if (strcmp(spec->name, "interface-histogram-raw") == 0) {
+        gboolean newvalue;
+        gboolean oldvalue;
+
+        g_object_get(object, spec->name, &newvalue, NULL);
+        oldvalue = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(tmp));
+
+        if (newvalue != oldvalue)
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), newvalue);
+    } else if (strcmp(spec->name, "interface-thumbnail-store") == 0) {
+        gboolean newvalue;
+        gboolean oldvalue;
+
+        g_object_get(object, spec->name, &newvalue, NULL);
+        oldvalue = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(tmp));
+
+        if (newvalue != oldvalue)
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), newvalue);
+    } else if (strcmp(spec->name, "interface-thumbnail-cache-size") == 0) {
+        GtkAdjustment *adjust = gtk_spin_button_get_adjustment(GTK_SPIN_BUTTON(tmp));
+        gint newvalue;
+        gfloat oldvalue;
+
+        g_object_get(object, spec->name, &newvalue, NULL);
+        oldvalue = gtk_adjustment_get_value(adjust);
+
+        if (fabs(newvalue - oldvalue)  > 0.0005)
+            gtk_adjustment_set_value(adjust, newvalue);
     } else if (strcmp(spec->name, "capture-filename-pattern") == 0) {
         gchar *newvalue;
         const gchar *oldvalue;
@@ -246,6 +280,43 @@ static void entangle_preferences_display_notify(GObject *object,
 
         if (newvalue != oldvalue)
             gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), newvalue);
+    } else if (strcmp(spec->name, "capture-latency") == 0) {
+        gboolean newvalue;
+        gboolean oldvalue;
+
+        g_object_get(object, spec->name, &newvalue, NULL);
+        oldvalue = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(tmp));
+
+        if (newvalue != oldvalue)
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), newvalue);
+    } else if (strcmp(spec->name, "capture-durability") == 0) {
+        gint newvalue;
+        gint oldvalue;
+        const gchar *oldid;
+        GEnumClass *enum_class;
+        GEnumValue *enum_value;
+
+        enum_class = g_type_class_ref(ENTANGLE_TYPE_SESSION_WRITER_DURABILITY);
+
+        g_object_get(object, spec->name, &newvalue, NULL);
+        oldid = gtk_combo_box_get_active_id(GTK_COMBO_BOX(tmp));
+
+        oldvalue = ENTANGLE_SESSION_WRITER_DURABILITY_NONE;
+        if (oldid) {
+            enum_value = g_enum_get_value_by_nick(enum_class, oldid);
+            if (enum_value != NULL)
+                oldvalue = enum_value->value;
+        }
+
+        if (newvalue != oldvalue) {
+            enum_value = g_enum_get_value(enum_class, newvalue);
+            if (enum_value != NULL)
+                gtk_combo_box_set_active_id(GTK_COMBO_BOX(tmp), enum_value->value_nick);
+            else
+                gtk_combo_box_set_active_id(GTK_COMBO_BOX(tmp), "none");
+        }
+
+        g_type_class_unref(enum_class);
     } else if (strcmp(spec->name, "img-mask-enabled") == 0) {
         gboolean newvalue;
         gboolean oldvalue;
@@ -416,6 +487,15 @@ static void entangle_preferences_display_refresh(EntanglePreferencesDisplay *pre
     tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "interface-histogram-linear"));
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp),
                                  entangle_preferences_interface_get_histogram_linear(prefs));
+    tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "interface-histogram-raw"));
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp),
+                                 entangle_preferences_interface_get_histogram_raw(prefs));
+    tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "interface-thumbnail-store"));
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp),
+                                 entangle_preferences_interface_get_thumbnail_store(prefs));
+    tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "interface-thumbnail-cache-size"));
+    gtk_adjustment_set_value(gtk_spin_button_get_adjustment(GTK_SPIN_BUTTON(tmp)),
+                             entangle_preferences_interface_get_thumbnail_cache_size(prefs));
 
     tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "capture-filename-pattern"));
     gtk_entry_set_text(GTK_ENTRY(tmp), entangle_preferences_capture_get_filename_pattern(prefs));
@@ -434,6 +514,18 @@ static void entangle_preferences_display_refresh(EntanglePreferencesDisplay *pre
     tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "capture-sync-clock"));
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), entangle_preferences_capture_get_sync_clock(prefs));
 
+    tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "capture-latency"));
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(tmp), entangle_preferences_capture_get_latency(prefs));
+
+    tmp = GTK_WIDGET(gtk_builder_get_object(priv->builder, "capture-durability"));
+    GEnumClass *durability_class = g_type_class_ref(ENTANGLE_TYPE_SESSION_WRITER_DURABILITY);
+    GEnumValue *durability_value = g_enum_get_value(durability_class,
+                                                    entangle_preferences_capture_get_durability(prefs));
+    g_type_class_unref(durability_class);
+
+    if (durability_value != NULL)
+        gtk_combo_box_set_active_id(GTK_COMBO_BOX(tmp), durability_value->value_nick);
+
     ratio = entangle_preferences_img_get_aspect_ratio(prefs);
     hasRatio = entangle_preferences_img_get_mask_enabled(prefs);
 
@@ -742,6 +834,40 @@ void do_interface_histogram_linear_toggled(GtkToggleButton *src, EntanglePrefere
 }
 
 
+void do_interface_histogram_raw_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *preferences)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
+
+    EntanglePreferences *prefs = entangle_preferences_display_get_preferences(preferences);
+    gboolean enabled = gtk_toggle_button_get_active(src);
+
+    entangle_preferences_interface_set_histogram_raw(prefs, enabled);
+}
+
+
+void do_interface_thumbnail_store_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *preferences)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
+
+    EntanglePreferences *prefs = entangle_preferences_display_get_preferences(preferences);
+    gboolean enabled = gtk_toggle_button_get_active(src);
+
+    entangle_preferences_interface_set_thumbnail_store(prefs, enabled);
+}
+
+
+void do_interface_thumbnail_cache_size_changed(GtkSpinButton *src, EntanglePreferencesDisplay *preferences)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
+
+    EntanglePreferences *prefs = entangle_preferences_display_get_preferences(preferences);
+    GtkAdjustment *adjust = gtk_spin_button_get_adjustment(src);
+
+    entangle_preferences_interface_set_thumbnail_cache_size(prefs,
+                                                            gtk_adjustment_get_value(adjust));
+}
+
+
 void do_capture_delete_file_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *preferences)
 {
     g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
@@ -764,6 +890,38 @@ void do_capture_sync_clock_toggled(GtkToggleButton *src, EntanglePreferencesDisp
 }
 
 
+void do_capture_latency_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *preferences)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
+
+    EntanglePreferences *prefs = entangle_preferences_display_get_preferences(preferences);
+    gboolean enabled = gtk_toggle_button_get_active(src);
+
+    entangle_preferences_capture_set_latency(prefs, enabled);
+}
+
+
+void do_capture_durability_changed(GtkComboBox *src, EntanglePreferencesDisplay *preferences)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
+
+    EntanglePreferences *prefs = entangle_preferences_display_get_preferences(preferences);
+    const gchar *id = gtk_combo_box_get_active_id(src);
+    EntangleSessionWriterDurability durability = ENTANGLE_SESSION_WRITER_DURABILITY_NONE;
+
+    if (id) {
+        GEnumClass *enum_class = g_type_class_ref(ENTANGLE_TYPE_SESSION_WRITER_DURABILITY);
+        GEnumValue *enum_value = g_enum_get_value_by_nick(enum_class, id);
+        g_type_class_unref(enum_class);
+
+        if (enum_value != NULL)
+            durability = enum_value->value;
+    }
+
+    entangle_preferences_capture_set_durability(prefs, durability);
+}
+
+
 void do_img_mask_enabled_toggled(GtkToggleButton *src, EntanglePreferencesDisplay *preferences)
 {
     g_return_if_fail(ENTANGLE_IS_PREFERENCES_DISPLAY(preferences));
@@ -930,6 +1088,7 @@ static void do_entangle_preferences_display_set_builder(EntangleWindow *win,
     GtkFileFilter *iccFilter;
     GtkComboBox *aspectRatio;
     GtkComboBox *gridLines;
+    GtkComboBox *durability;
     GtkIconTheme *theme = gtk_icon_theme_get_default();
 
     priv->builder = g_object_ref(builder);
@@ -1225,6 +1384,33 @@ static void do_entangle_preferences_display_set_builder(EntangleWindow *win,
     gtk_cell_layout_set_attributes(GTK_CELL_LAYOUT(gridLines),
                                    cellText, "text", 1, NULL);
 
+
+    durability = GTK_COMBO_BOX(gtk_builder_get_object(priv->builder, "capture-durability"));
+    list = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_STRING, -1);
+
+    gtk_list_store_append(list, &iter);
+    gtk_list_store_set(list, &iter,
+                       0, "none",
+                       1, _("Never"),
+                       -1);
+    gtk_list_store_append(list, &iter);
+    gtk_list_store_set(list, &iter,
+                       0, "file",
+                       1, _("After each file"),
+                       -1);
+    gtk_list_store_append(list, &iter);
+    gtk_list_store_set(list, &iter,
+                       0, "group",
+                       1, _("After each burst of files"),
+                       -1);
+    gtk_combo_box_set_model(GTK_COMBO_BOX(durability), GTK_TREE_MODEL(list));
+    gtk_combo_box_set_id_column(GTK_COMBO_BOX(durability), 0);
+
+    cellText = gtk_cell_renderer_text_new();
+    gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(durability), cellText, TRUE);
+    gtk_cell_layout_set_attributes(GTK_CELL_LAYOUT(durability),
+                                   cellText, "text", 1, NULL);
+
     g_signal_connect(selection, "changed", G_CALLBACK(do_page_changed), preferences);
 }
 
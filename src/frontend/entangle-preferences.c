@@ -52,6 +52,9 @@ G_DEFINE_TYPE(EntanglePreferences, entangle_preferences, G_TYPE_OBJECT);
 #define SETTING_INTERFACE_SCREEN_BLANK     "screen-blank"
 #define SETTING_INTERFACE_PLUGINS          "plugins"
 #define SETTING_INTERFACE_HISTOGRAM_LINEAR "histogram-linear"
+#define SETTING_INTERFACE_HISTOGRAM_RAW    "histogram-raw"
+#define SETTING_INTERFACE_THUMBNAIL_STORE  "thumbnail-store"
+#define SETTING_INTERFACE_THUMBNAIL_CACHE_SIZE "thumbnail-cache-size"
 
 #define SETTING_CAPTURE_FILENAME_PATTERN   "filename-pattern"
 #define SETTING_CAPTURE_LAST_SESSION       "last-session"
@@ -59,6 +62,8 @@ G_DEFINE_TYPE(EntanglePreferences, entangle_preferences, G_TYPE_OBJECT);
 #define SETTING_CAPTURE_ELECTRONIC_SHUTTER "electronic-shutter"
 #define SETTING_CAPTURE_DELETE_FILE        "delete-file"
 #define SETTING_CAPTURE_SYNC_CLOCK         "sync-clock"
+#define SETTING_CAPTURE_LATENCY            "latency"
+#define SETTING_CAPTURE_DURABILITY         "durability"
 
 #define SETTING_CMS_ENABLED                "enabled"
 #define SETTING_CMS_DETECT_SYSTEM_PROFILE  "detect-system-profile"
@@ -81,6 +86,9 @@ G_DEFINE_TYPE(EntanglePreferences, entangle_preferences, G_TYPE_OBJECT);
 #define PROP_NAME_INTERFACE_AUTO_CONNECT     SETTING_INTERFACE "-" SETTING_INTERFACE_AUTO_CONNECT
 #define PROP_NAME_INTERFACE_SCREEN_BLANK     SETTING_INTERFACE "-" SETTING_INTERFACE_SCREEN_BLANK
 #define PROP_NAME_INTERFACE_HISTOGRAM_LINEAR SETTING_INTERFACE "-" SETTING_INTERFACE_HISTOGRAM_LINEAR
+#define PROP_NAME_INTERFACE_HISTOGRAM_RAW    SETTING_INTERFACE "-" SETTING_INTERFACE_HISTOGRAM_RAW
+#define PROP_NAME_INTERFACE_THUMBNAIL_STORE  SETTING_INTERFACE "-" SETTING_INTERFACE_THUMBNAIL_STORE
+#define PROP_NAME_INTERFACE_THUMBNAIL_CACHE_SIZE SETTING_INTERFACE "-" SETTING_INTERFACE_THUMBNAIL_CACHE_SIZE
 
 #define PROP_NAME_CAPTURE_FILENAME_PATTERN   SETTING_CAPTURE "-" SETTING_CAPTURE_FILENAME_PATTERN
 #define PROP_NAME_CAPTURE_LAST_SESSION       SETTING_CAPTURE "-" SETTING_CAPTURE_LAST_SESSION
@@ -88,6 +96,8 @@ G_DEFINE_TYPE(EntanglePreferences, entangle_preferences, G_TYPE_OBJECT);
 #define PROP_NAME_CAPTURE_ELECTRONIC_SHUTTER SETTING_CAPTURE "-" SETTING_CAPTURE_ELECTRONIC_SHUTTER
 #define PROP_NAME_CAPTURE_DELETE_FILE        SETTING_CAPTURE "-" SETTING_CAPTURE_DELETE_FILE
 #define PROP_NAME_CAPTURE_SYNC_CLOCK         SETTING_CAPTURE "-" SETTING_CAPTURE_SYNC_CLOCK
+#define PROP_NAME_CAPTURE_LATENCY            SETTING_CAPTURE "-" SETTING_CAPTURE_LATENCY
+#define PROP_NAME_CAPTURE_DURABILITY         SETTING_CAPTURE "-" SETTING_CAPTURE_DURABILITY
 
 #define PROP_NAME_CMS_ENABLED                SETTING_CMS "-" SETTING_CMS_ENABLED
 #define PROP_NAME_CMS_DETECT_SYSTEM_PROFILE  SETTING_CMS "-" SETTING_CMS_DETECT_SYSTEM_PROFILE
@@ -112,6 +122,9 @@ enum {
     PROP_INTERFACE_AUTO_CONNECT,
     PROP_INTERFACE_SCREEN_BLANK,
     PROP_INTERFACE_HISTOGRAM_LINEAR,
+    PROP_INTERFACE_HISTOGRAM_RAW,
+    PROP_INTERFACE_THUMBNAIL_STORE,
+    PROP_INTERFACE_THUMBNAIL_CACHE_SIZE,
 
     PROP_CAPTURE_FILENAME_PATTERN,
     PROP_CAPTURE_LAST_SESSION,
@@ -119,6 +132,8 @@ enum {
     PROP_CAPTURE_ELECTRONIC_SHUTTER,
     PROP_CAPTURE_DELETE_FILE,
     PROP_CAPTURE_SYNC_CLOCK,
+    PROP_CAPTURE_LATENCY,
+    PROP_CAPTURE_DURABILITY,
 
     PROP_CMS_ENABLED,
     PROP_CMS_RGB_PROFILE,
@@ -194,6 +209,24 @@ static void entangle_preferences_get_property(GObject *object,
                                                        SETTING_INTERFACE_HISTOGRAM_LINEAR));
             break;
 
+        case PROP_INTERFACE_HISTOGRAM_RAW:
+            g_value_set_boolean(value,
+                                g_settings_get_boolean(priv->interfaceSettings,
+                                                       SETTING_INTERFACE_HISTOGRAM_RAW));
+            break;
+
+        case PROP_INTERFACE_THUMBNAIL_STORE:
+            g_value_set_boolean(value,
+                                g_settings_get_boolean(priv->interfaceSettings,
+                                                       SETTING_INTERFACE_THUMBNAIL_STORE));
+            break;
+
+        case PROP_INTERFACE_THUMBNAIL_CACHE_SIZE:
+            g_value_set_int(value,
+                            g_settings_get_int(priv->interfaceSettings,
+                                               SETTING_INTERFACE_THUMBNAIL_CACHE_SIZE));
+            break;
+
         case PROP_CAPTURE_LAST_SESSION:
             dir = g_settings_get_string(priv->captureSettings,
                                         SETTING_CAPTURE_LAST_SESSION);
@@ -233,6 +266,18 @@ static void entangle_preferences_get_property(GObject *object,
                                                        SETTING_CAPTURE_SYNC_CLOCK));
             break;
 
+        case PROP_CAPTURE_LATENCY:
+            g_value_set_boolean(value,
+                                g_settings_get_boolean(priv->captureSettings,
+                                                       SETTING_CAPTURE_LATENCY));
+            break;
+
+        case PROP_CAPTURE_DURABILITY:
+            g_value_set_int(value,
+                            g_settings_get_enum(priv->captureSettings,
+                                                SETTING_CAPTURE_DURABILITY));
+            break;
+
         case PROP_CMS_ENABLED:
             g_value_set_boolean(value,
                                 g_settings_get_boolean(priv->cmsSettings,
@@ -368,6 +413,24 @@ static void entangle_preferences_set_property(GObject *object,
                                    g_value_get_boolean(value));
             break;
 
+        case PROP_INTERFACE_HISTOGRAM_RAW:
+            g_settings_set_boolean(priv->interfaceSettings,
+                                   SETTING_INTERFACE_HISTOGRAM_RAW,
+                                   g_value_get_boolean(value));
+            break;
+
+        case PROP_INTERFACE_THUMBNAIL_STORE:
+            g_settings_set_boolean(priv->interfaceSettings,
+                                   SETTING_INTERFACE_THUMBNAIL_STORE,
+                                   g_value_get_boolean(value));
+            break;
+
+        case PROP_INTERFACE_THUMBNAIL_CACHE_SIZE:
+            g_settings_set_int(priv->interfaceSettings,
+                               SETTING_INTERFACE_THUMBNAIL_CACHE_SIZE,
+                               g_value_get_int(value));
+            break;
+
         case PROP_CAPTURE_LAST_SESSION:
             g_settings_set_string(priv->captureSettings,
                                   SETTING_CAPTURE_LAST_SESSION,
@@ -404,6 +467,18 @@ static void entangle_preferences_set_property(GObject *object,
                                    g_value_get_boolean(value));
             break;
 
+        case PROP_CAPTURE_LATENCY:
+            g_settings_set_boolean(priv->captureSettings,
+                                   SETTING_CAPTURE_LATENCY,
+                                   g_value_get_boolean(value));
+            break;
+
+        case PROP_CAPTURE_DURABILITY:
+            g_settings_set_enum(priv->captureSettings,
+                                SETTING_CAPTURE_DURABILITY,
+                                g_value_get_int(value));
+            break;
+
         case PROP_CMS_ENABLED:
             g_settings_set_boolean(priv->cmsSettings,
                                    SETTING_CMS_ENABLED,
@@ -570,6 +645,41 @@ static void entangle_preferences_class_init(EntanglePreferencesClass *klass)
                                                          G_PARAM_STATIC_NICK |
                                                          G_PARAM_STATIC_BLURB));
 
+    g_object_class_install_property(object_class,
+                                    PROP_INTERFACE_HISTOGRAM_RAW,
+                                    g_param_spec_boolean(PROP_NAME_INTERFACE_HISTOGRAM_RAW,
+                                                         "Raw histogram",
+                                                         "Use raw sensor histogram",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
+    g_object_class_install_property(object_class,
+                                    PROP_INTERFACE_THUMBNAIL_STORE,
+                                    g_param_spec_boolean(PROP_NAME_INTERFACE_THUMBNAIL_STORE,
+                                                         "Thumbnail store",
+                                                         "Keep session thumbnails in a packed store",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
+    g_object_class_install_property(object_class,
+                                    PROP_INTERFACE_THUMBNAIL_CACHE_SIZE,
+                                    g_param_spec_int(PROP_NAME_INTERFACE_THUMBNAIL_CACHE_SIZE,
+                                                     "Thumbnail cache size",
+                                                     "Thumbnail cache size limit in MB, 0 for unlimited",
+                                                     0,
+                                                     G_MAXINT,
+                                                     0,
+                                                     G_PARAM_READWRITE |
+                                                     G_PARAM_STATIC_NAME |
+                                                     G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
+
     g_object_class_install_property(object_class,
                                     PROP_CAPTURE_LAST_SESSION,
                                     g_param_spec_string(PROP_NAME_CAPTURE_LAST_SESSION,
@@ -614,6 +724,28 @@ static void entangle_preferences_class_init(EntanglePreferencesClass *klass)
                                                          G_PARAM_STATIC_NICK |
                                                          G_PARAM_STATIC_BLURB));
 
+    g_object_class_install_property(object_class,
+                                    PROP_CAPTURE_LATENCY,
+                                    g_param_spec_boolean(PROP_NAME_CAPTURE_LATENCY,
+                                                         "Capture latency",
+                                                         "Show and log the latency of each shot",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_NAME |
+                                                         G_PARAM_STATIC_NICK |
+                                                         G_PARAM_STATIC_BLURB));
+
+    g_object_class_install_property(object_class,
+                                    PROP_CAPTURE_DURABILITY,
+                                    g_param_spec_int(PROP_NAME_CAPTURE_DURABILITY,
+                                                     "Capture durability",
+                                                     "When captured files are flushed to disk",
+                                                     0, 2, 2,
+                                                     G_PARAM_READWRITE |
+                                                     G_PARAM_STATIC_NAME |
+                                                     G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
+
     g_object_class_install_property(object_class,
                                     PROP_CAPTURE_CONTINUOUS_PREVIEW,
                                     g_param_spec_boolean(PROP_NAME_CAPTURE_CONTINUOUS_PREVIEW,
@@ -977,6 +1109,127 @@ void entangle_preferences_interface_set_histogram_linear(EntanglePreferences *pr
 }
 
 
+/**
+ * entangle_preferences_interface_get_histogram_raw:
+ * @prefs: (transfer none): the preferences store
+ *
+ * Determine if the histogram of raw files will be taken
+ * from the sensor data rather than the developed image
+ *
+ * Returns: TRUE if the raw sensor data is used
+ */
+gboolean entangle_preferences_interface_get_histogram_raw(EntanglePreferences *prefs)
+{
+    g_return_val_if_fail(ENTANGLE_IS_PREFERENCES(prefs), FALSE);
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    return g_settings_get_boolean(priv->interfaceSettings,
+                                  SETTING_INTERFACE_HISTOGRAM_RAW);
+}
+
+
+/**
+ * entangle_preferences_interface_set_histogram_raw:
+ * @prefs: (transfer none): the preferences store
+ * @enabled: TRUE to use the raw sensor data
+ *
+ * If @enabled is TRUE then the histogram of raw files will
+ * be taken from the sensor data, with clipping reported
+ * for each colour
+ */
+void entangle_preferences_interface_set_histogram_raw(EntanglePreferences *prefs, gboolean enabled)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES(prefs));
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    g_settings_set_boolean(priv->interfaceSettings,
+                           SETTING_INTERFACE_HISTOGRAM_RAW, enabled);
+    g_object_notify(G_OBJECT(prefs), PROP_NAME_INTERFACE_HISTOGRAM_RAW);
+}
+
+
+/**
+ * entangle_preferences_interface_get_thumbnail_store:
+ * @prefs: (transfer none): the preferences store
+ *
+ * Determine if session thumbnails are kept in a packed store
+ * in addition to the freedesktop thumbnail cache
+ *
+ * Returns: TRUE if the packed store is used
+ */
+gboolean entangle_preferences_interface_get_thumbnail_store(EntanglePreferences *prefs)
+{
+    g_return_val_if_fail(ENTANGLE_IS_PREFERENCES(prefs), FALSE);
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    return g_settings_get_boolean(priv->interfaceSettings,
+                                  SETTING_INTERFACE_THUMBNAIL_STORE);
+}
+
+
+/**
+ * entangle_preferences_interface_set_thumbnail_store:
+ * @prefs: (transfer none): the preferences store
+ * @enabled: TRUE to use the packed store
+ *
+ * If @enabled is TRUE then session thumbnails will be kept
+ * in a packed store, which is faster to load from
+ */
+void entangle_preferences_interface_set_thumbnail_store(EntanglePreferences *prefs, gboolean enabled)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES(prefs));
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    g_settings_set_boolean(priv->interfaceSettings,
+                           SETTING_INTERFACE_THUMBNAIL_STORE, enabled);
+    g_object_notify(G_OBJECT(prefs), PROP_NAME_INTERFACE_THUMBNAIL_STORE);
+}
+
+
+/**
+ * entangle_preferences_interface_get_thumbnail_cache_size:
+ * @prefs: (transfer none): the preferences store
+ *
+ * Get the limit on the size of the thumbnail cache
+ *
+ * Returns: the limit in megabytes, or 0 if unlimited
+ */
+gint entangle_preferences_interface_get_thumbnail_cache_size(EntanglePreferences *prefs)
+{
+    g_return_val_if_fail(ENTANGLE_IS_PREFERENCES(prefs), 0);
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    return g_settings_get_int(priv->interfaceSettings,
+                              SETTING_INTERFACE_THUMBNAIL_CACHE_SIZE);
+}
+
+
+/**
+ * entangle_preferences_interface_set_thumbnail_cache_size:
+ * @prefs: (transfer none): the preferences store
+ * @megabytes: the limit in megabytes, or 0 if unlimited
+ *
+ * Set the limit on the size of the thumbnail cache, beyond
+ * which the least recently used thumbnails are deleted
+ */
+void entangle_preferences_interface_set_thumbnail_cache_size(EntanglePreferences *prefs,
+                                                             gint megabytes)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES(prefs));
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    g_settings_set_int(priv->interfaceSettings,
+                       SETTING_INTERFACE_THUMBNAIL_CACHE_SIZE, megabytes);
+    g_object_notify(G_OBJECT(prefs), PROP_NAME_INTERFACE_THUMBNAIL_CACHE_SIZE);
+}
+
+
 /**
  * entangle_preferences_interface_get_plugins:
  * @prefs: (transfer none): the preferences store
@@ -1313,6 +1566,86 @@ void entangle_preferences_capture_set_sync_clock(EntanglePreferences *prefs, gbo
 }
 
 
+/**
+ * entangle_preferences_capture_get_latency:
+ * @prefs: (transfer none): the preferences store
+ *
+ * Determines if the time taken by each stage of a shot, from
+ * the capture request to first display, will be shown in the
+ * status bar and logged to the session
+ *
+ * Returns: TRUE if capture latency is shown, FALSE otherwise
+ */
+gboolean entangle_preferences_capture_get_latency(EntanglePreferences *prefs)
+{
+    g_return_val_if_fail(ENTANGLE_IS_PREFERENCES(prefs), FALSE);
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    return g_settings_get_boolean(priv->captureSettings,
+                                  SETTING_CAPTURE_LATENCY);
+}
+
+
+/**
+ * entangle_preferences_capture_set_latency:
+ * @prefs: (transfer none): the preferences store
+ * @enabled: TRUE if capture latency should be shown
+ *
+ * If @enabled is TRUE, then the latency of each shot will be shown
+ * in the status bar and logged to the session
+ */
+void entangle_preferences_capture_set_latency(EntanglePreferences *prefs, gboolean enabled)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES(prefs));
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    g_settings_set_boolean(priv->captureSettings,
+                           SETTING_CAPTURE_LATENCY, enabled);
+    g_object_notify(G_OBJECT(prefs), PROP_NAME_CAPTURE_LATENCY);
+}
+
+
+/**
+ * entangle_preferences_capture_get_durability:
+ * @prefs: (transfer none): the preferences store
+ *
+ * Determine when captured files are flushed to disk, which is
+ * one of the values of #EntangleSessionWriterDurability
+ *
+ * Returns: the durability of captured files
+ */
+gint entangle_preferences_capture_get_durability(EntanglePreferences *prefs)
+{
+    g_return_val_if_fail(ENTANGLE_IS_PREFERENCES(prefs), 0);
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    return g_settings_get_enum(priv->captureSettings,
+                               SETTING_CAPTURE_DURABILITY);
+}
+
+
+/**
+ * entangle_preferences_capture_set_durability:
+ * @prefs: (transfer none): the preferences store
+ * @durability: the durability of captured files
+ *
+ * Set when captured files are flushed to disk
+ */
+void entangle_preferences_capture_set_durability(EntanglePreferences *prefs, gint durability)
+{
+    g_return_if_fail(ENTANGLE_IS_PREFERENCES(prefs));
+
+    EntanglePreferencesPrivate *priv = prefs->priv;
+
+    g_settings_set_enum(priv->captureSettings,
+                        SETTING_CAPTURE_DURABILITY, durability);
+    g_object_notify(G_OBJECT(prefs), PROP_NAME_CAPTURE_DURABILITY);
+}
+
+
 /**
  * entangle_preferences_cms_get_rgb_profile:
  * @prefs: (transfer none): the preferences store
@@ -66,6 +66,12 @@ void entangle_preferences_interface_add_plugin(EntanglePreferences *prefs, const
 void entangle_preferences_interface_remove_plugin(EntanglePreferences *prefs, const char *name);
 gboolean entangle_preferences_interface_get_histogram_linear(EntanglePreferences *prefs);
 void entangle_preferences_interface_set_histogram_linear(EntanglePreferences *prefs, gboolean enabled);
+gboolean entangle_preferences_interface_get_histogram_raw(EntanglePreferences *prefs);
+void entangle_preferences_interface_set_histogram_raw(EntanglePreferences *prefs, gboolean enabled);
+gboolean entangle_preferences_interface_get_thumbnail_store(EntanglePreferences *prefs);
+void entangle_preferences_interface_set_thumbnail_store(EntanglePreferences *prefs, gboolean enabled);
+gint entangle_preferences_interface_get_thumbnail_cache_size(EntanglePreferences *prefs);
+void entangle_preferences_interface_set_thumbnail_cache_size(EntanglePreferences *prefs, gint megabytes);
 
 char *entangle_preferences_capture_get_last_session(EntanglePreferences *prefs);
 void entangle_preferences_capture_set_last_session(EntanglePreferences *prefs, const gchar *dir);
@@ -79,6 +85,10 @@ gboolean entangle_preferences_capture_get_delete_file(EntanglePreferences *prefs
 void entangle_preferences_capture_set_delete_file(EntanglePreferences *prefs, gboolean enabled);
 gboolean entangle_preferences_capture_get_sync_clock(EntanglePreferences *prefs);
 void entangle_preferences_capture_set_sync_clock(EntanglePreferences *prefs, gboolean enabled);
+gboolean entangle_preferences_capture_get_latency(EntanglePreferences *prefs);
+void entangle_preferences_capture_set_latency(EntanglePreferences *prefs, gboolean enabled);
+gint entangle_preferences_capture_get_durability(EntanglePreferences *prefs);
+void entangle_preferences_capture_set_durability(EntanglePreferences *prefs, gint durability);
 
 gboolean entangle_preferences_cms_get_enabled(EntanglePreferences *prefs);
 void entangle_preferences_cms_set_enabled(EntanglePreferences *prefs, gboolean enabled);
@@ -0,0 +1,374 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <turbojpeg.h>
+
+#include "entangle-debug.h"
+#include "entangle-metrics.h"
+#include "entangle-preview-decoder.h"
+#include "entangle-tracer.h"
+
+/*
+ * Decodes the JPEG frames of a camera preview straight into
+ * a cairo surface, skipping the pixbuf and the copy the
+ * display would otherwise make. libjpeg-turbo can scale by
+ * M/8 while doing the inverse DCT, so a frame which will be
+ * drawn smaller than it arrived costs less to decode.
+ *
+ * Consecutive frames are nearly always the same size, so
+ * the pixel buffers behind the surfaces are pooled. Each
+ * surface hands its buffer back to the pool when cairo
+ * destroys it, ie once the widgets showing it have let go.
+ */
+
+#define ENTANGLE_PREVIEW_DECODER_GET_PRIVATE(obj)                       \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_PREVIEW_DECODER, EntanglePreviewDecoderPrivate))
+
+/* The byte order of a native endian CAIRO_FORMAT_ARGB32
+ * pixel. Decoding fills alpha with 0xff, and since opaque
+ * pixels are already premultiplied, cairo can use them as is */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define ENTANGLE_PREVIEW_DECODER_FORMAT TJPF_BGRA
+#else
+#define ENTANGLE_PREVIEW_DECODER_FORMAT TJPF_ARGB
+#endif
+
+/* One being shown, one being decoded into, and one spare
+ * for a widget which is slow to drop the last frame */
+#define ENTANGLE_PREVIEW_DECODER_SURFACES 3
+
+typedef struct _EntanglePreviewDecoderBuffer EntanglePreviewDecoderBuffer;
+
+struct _EntanglePreviewDecoderBuffer {
+    guchar *pixels;
+    gsize size;
+    gboolean busy;
+    /* Cleared when the buffer leaves the pool while
+     * a surface is still using it */
+    gboolean pooled;
+    EntangleMetricsMemory *memory;
+};
+
+struct _EntanglePreviewDecoderPrivate {
+    tjhandle handle;
+    tjscalingfactor *factors;
+    int nfactors;
+
+    EntanglePreviewDecoderBuffer *buffers[ENTANGLE_PREVIEW_DECODER_SURFACES];
+    int surfaceWidth;
+    int surfaceHeight;
+    EntangleMetricsMemory *memory;
+};
+
+G_DEFINE_TYPE(EntanglePreviewDecoder, entangle_preview_decoder, G_TYPE_OBJECT);
+
+static const cairo_user_data_key_t entangle_preview_decoder_buffer_key;
+
+
+static void entangle_preview_decoder_buffer_free(EntanglePreviewDecoderBuffer *buffer)
+{
+    entangle_metrics_memory_free(buffer->memory, buffer->size);
+    g_free(buffer->pixels);
+    g_free(buffer);
+}
+
+
+/* Called by cairo as the last reference to a surface goes */
+static void entangle_preview_decoder_buffer_release(void *data)
+{
+    EntanglePreviewDecoderBuffer *buffer = data;
+
+    if (buffer->pooled)
+        buffer->busy = FALSE;
+    else
+        entangle_preview_decoder_buffer_free(buffer);
+}
+
+
+static void entangle_preview_decoder_drain(EntanglePreviewDecoder *decoder)
+{
+    EntanglePreviewDecoderPrivate *priv = decoder->priv;
+    int i;
+
+    /* Buffers still on screen live on until the widgets
+     * release them, they just won't come back to the pool */
+    for (i = 0; i < ENTANGLE_PREVIEW_DECODER_SURFACES; i++) {
+        if (!priv->buffers[i])
+            continue;
+        if (priv->buffers[i]->busy)
+            priv->buffers[i]->pooled = FALSE;
+        else
+            entangle_preview_decoder_buffer_free(priv->buffers[i]);
+        priv->buffers[i] = NULL;
+    }
+}
+
+
+static void entangle_preview_decoder_finalize(GObject *object)
+{
+    EntanglePreviewDecoder *decoder = ENTANGLE_PREVIEW_DECODER(object);
+    EntanglePreviewDecoderPrivate *priv = decoder->priv;
+
+    entangle_preview_decoder_drain(decoder);
+    if (priv->handle)
+        tjDestroy(priv->handle);
+
+    G_OBJECT_CLASS(entangle_preview_decoder_parent_class)->finalize(object);
+}
+
+
+static void entangle_preview_decoder_class_init(EntanglePreviewDecoderClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = entangle_preview_decoder_finalize;
+
+    g_type_class_add_private(klass, sizeof(EntanglePreviewDecoderPrivate));
+}
+
+
+/**
+ * entangle_preview_decoder_new:
+ *
+ * Create a new decoder for camera preview frames. The
+ * decompressor is kept for the life of the decoder, so
+ * it should be reused for each frame.
+ *
+ * Returns: (transfer full): the new decoder
+ */
+EntanglePreviewDecoder *entangle_preview_decoder_new(void)
+{
+    return ENTANGLE_PREVIEW_DECODER(g_object_new(ENTANGLE_TYPE_PREVIEW_DECODER, NULL));
+}
+
+
+static void entangle_preview_decoder_init(EntanglePreviewDecoder *decoder)
+{
+    EntanglePreviewDecoderPrivate *priv;
+
+    priv = decoder->priv = ENTANGLE_PREVIEW_DECODER_GET_PRIVATE(decoder);
+
+    if (!(priv->handle = tjInitDecompress()))
+        ENTANGLE_DEBUG("Cannot create JPEG decompressor: %s", tjGetErrorStr());
+    priv->factors = tjGetScalingFactors(&priv->nfactors);
+    priv->memory = entangle_metrics_memory_owner("EntanglePreviewDecoder");
+}
+
+
+/*
+ * Get a surface to decode a frame into, backed by a buffer
+ * from the pool which no earlier surface is still using
+ */
+static cairo_surface_t *entangle_preview_decoder_acquire(EntanglePreviewDecoder *decoder,
+                                                         int width, int height)
+{
+    EntanglePreviewDecoderPrivate *priv = decoder->priv;
+    EntanglePreviewDecoderBuffer *buffer = NULL;
+    cairo_surface_t *surface;
+    int stride;
+    int spare = -1;
+    int i;
+
+    if (width != priv->surfaceWidth || height != priv->surfaceHeight) {
+        entangle_preview_decoder_drain(decoder);
+        priv->surfaceWidth = width;
+        priv->surfaceHeight = height;
+    }
+
+    stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+    if (stride < 0)
+        return NULL;
+
+    for (i = 0; i < ENTANGLE_PREVIEW_DECODER_SURFACES; i++) {
+        if (!priv->buffers[i]) {
+            if (spare == -1)
+                spare = i;
+        } else if (!priv->buffers[i]->busy) {
+            buffer = priv->buffers[i];
+            break;
+        }
+    }
+
+    if (buffer) {
+        entangle_metrics_liveview_buffer(TRUE);
+    } else {
+        buffer = g_new0(EntanglePreviewDecoderBuffer, 1);
+        buffer->size = (gsize)stride * height;
+        buffer->pixels = g_malloc(buffer->size);
+        buffer->memory = priv->memory;
+        entangle_metrics_memory_alloc(buffer->memory, buffer->size);
+        entangle_metrics_liveview_buffer(FALSE);
+
+        /* Beyond the pool the buffer goes with its surface */
+        if (spare != -1) {
+            buffer->pooled = TRUE;
+            priv->buffers[spare] = buffer;
+        }
+    }
+    buffer->busy = TRUE;
+
+    surface = cairo_image_surface_create_for_data(buffer->pixels,
+                                                  CAIRO_FORMAT_ARGB32,
+                                                  width, height, stride);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS ||
+        cairo_surface_set_user_data(surface,
+                                    &entangle_preview_decoder_buffer_key,
+                                    buffer,
+                                    entangle_preview_decoder_buffer_release) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        entangle_preview_decoder_buffer_release(buffer);
+        return NULL;
+    }
+
+    return surface;
+}
+
+
+/*
+ * Pick the smallest scaled size which still covers the
+ * target in both directions, so cairo only ever has to
+ * shrink the frame a little further when painting it
+ */
+static void entangle_preview_decoder_scale(EntanglePreviewDecoder *decoder,
+                                           int width, int height,
+                                           gint targetWidth, gint targetHeight,
+                                           int *scaledWidth, int *scaledHeight)
+{
+    EntanglePreviewDecoderPrivate *priv = decoder->priv;
+    int i;
+
+    *scaledWidth = width;
+    *scaledHeight = height;
+
+    if (targetWidth <= 0 || targetHeight <= 0 || !priv->factors)
+        return;
+
+    for (i = 0; i < priv->nfactors; i++) {
+        int sw = TJSCALED(width, priv->factors[i]);
+        int sh = TJSCALED(height, priv->factors[i]);
+
+        if (sw < targetWidth || sh < targetHeight)
+            continue;
+
+        if (sw < *scaledWidth) {
+            *scaledWidth = sw;
+            *scaledHeight = sh;
+        }
+    }
+}
+
+
+/**
+ * entangle_preview_decoder_decode:
+ * @decoder: (transfer none): the preview decoder
+ * @data: (array length=length): the JPEG data of the frame
+ * @length: the number of bytes in @data
+ * @targetWidth: the width the frame will be drawn at, or 0
+ * @targetHeight: the height the frame will be drawn at, or 0
+ * @width: (out): filled with the width of the frame
+ * @height: (out): filled with the height of the frame
+ *
+ * Decode a camera preview frame into a CAIRO_FORMAT_ARGB32
+ * surface. If a target size is given, the frame is scaled
+ * down while decoding, to the smallest size which is no
+ * smaller than the target. @width and @height are always
+ * filled with the unscaled dimensions of the frame.
+ *
+ * The pixels of the surface come from a pool, and will only
+ * be decoded into again once the surface has been destroyed.
+ *
+ * Returns: (transfer full)(allow-none): the decoded frame, or NULL if
+ * @data is not a JPEG image
+ */
+cairo_surface_t *entangle_preview_decoder_decode(EntanglePreviewDecoder *decoder,
+                                                 const guint8 *data,
+                                                 gsize length,
+                                                 gint targetWidth,
+                                                 gint targetHeight,
+                                                 gint *width,
+                                                 gint *height)
+{
+    g_return_val_if_fail(ENTANGLE_IS_PREVIEW_DECODER(decoder), NULL);
+    g_return_val_if_fail(data != NULL, NULL);
+    g_return_val_if_fail(width != NULL, NULL);
+    g_return_val_if_fail(height != NULL, NULL);
+
+    EntanglePreviewDecoderPrivate *priv = decoder->priv;
+    cairo_surface_t *surface = NULL;
+    int jpegWidth, jpegHeight, subsamp;
+    int scaledWidth, scaledHeight;
+
+    if (!priv->handle)
+        return NULL;
+
+    ENTANGLE_TRACE_BEGIN("preview-decode");
+
+    if (tjDecompressHeader2(priv->handle, (unsigned char *)data, length,
+                            &jpegWidth, &jpegHeight, &subsamp) < 0) {
+        ENTANGLE_DEBUG("Cannot read preview header: %s", tjGetErrorStr());
+        goto cleanup;
+    }
+
+    entangle_preview_decoder_scale(decoder, jpegWidth, jpegHeight,
+                                   targetWidth, targetHeight,
+                                   &scaledWidth, &scaledHeight);
+
+    if (!(surface = entangle_preview_decoder_acquire(decoder, scaledWidth, scaledHeight))) {
+        ENTANGLE_DEBUG("Cannot create %dx%d preview surface",
+                       scaledWidth, scaledHeight);
+        goto cleanup;
+    }
+
+    cairo_surface_flush(surface);
+    if (tjDecompress2(priv->handle, (unsigned char *)data, length,
+                      cairo_image_surface_get_data(surface),
+                      scaledWidth,
+                      cairo_image_surface_get_stride(surface),
+                      scaledHeight,
+                      ENTANGLE_PREVIEW_DECODER_FORMAT,
+                      TJFLAG_FASTDCT) < 0) {
+        ENTANGLE_DEBUG("Cannot decode preview: %s", tjGetErrorStr());
+        cairo_surface_destroy(surface);
+        surface = NULL;
+        goto cleanup;
+    }
+    cairo_surface_mark_dirty(surface);
+
+    ENTANGLE_DEBUG("Decoded %dx%d preview at %dx%d",
+                   jpegWidth, jpegHeight, scaledWidth, scaledHeight);
+    *width = jpegWidth;
+    *height = jpegHeight;
+
+ cleanup:
+    ENTANGLE_TRACE_END("preview-decode");
+    return surface;
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
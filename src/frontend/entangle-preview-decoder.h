@@ -0,0 +1,77 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __ENTANGLE_PREVIEW_DECODER_H__
+#define __ENTANGLE_PREVIEW_DECODER_H__
+
+#include <glib-object.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+#define ENTANGLE_TYPE_PREVIEW_DECODER            (entangle_preview_decoder_get_type ())
+#define ENTANGLE_PREVIEW_DECODER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), ENTANGLE_TYPE_PREVIEW_DECODER, EntanglePreviewDecoder))
+#define ENTANGLE_PREVIEW_DECODER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), ENTANGLE_TYPE_PREVIEW_DECODER, EntanglePreviewDecoderClass))
+#define ENTANGLE_IS_PREVIEW_DECODER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ENTANGLE_TYPE_PREVIEW_DECODER))
+#define ENTANGLE_IS_PREVIEW_DECODER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), ENTANGLE_TYPE_PREVIEW_DECODER))
+#define ENTANGLE_PREVIEW_DECODER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), ENTANGLE_TYPE_PREVIEW_DECODER, EntanglePreviewDecoderClass))
+
+
+typedef struct _EntanglePreviewDecoder EntanglePreviewDecoder;
+typedef struct _EntanglePreviewDecoderPrivate EntanglePreviewDecoderPrivate;
+typedef struct _EntanglePreviewDecoderClass EntanglePreviewDecoderClass;
+
+struct _EntanglePreviewDecoder
+{
+    GObject parent;
+
+    EntanglePreviewDecoderPrivate *priv;
+};
+
+struct _EntanglePreviewDecoderClass
+{
+    GObjectClass parent_class;
+};
+
+GType entangle_preview_decoder_get_type(void) G_GNUC_CONST;
+
+EntanglePreviewDecoder *entangle_preview_decoder_new(void);
+
+cairo_surface_t *entangle_preview_decoder_decode(EntanglePreviewDecoder *decoder,
+                                                 const guint8 *data,
+                                                 gsize length,
+                                                 gint targetWidth,
+                                                 gint targetHeight,
+                                                 gint *width,
+                                                 gint *height);
+
+G_END_DECLS
+
+#endif /* __ENTANGLE_PREVIEW_DECODER_H__ */
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
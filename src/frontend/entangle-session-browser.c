@@ -24,6 +24,8 @@
 
 #include "entangle-debug.h"
 #include "entangle-session-browser.h"
+#include "entangle-metrics.h"
+#include "entangle-tracer.h"
 
 #define ENTANGLE_SESSION_BROWSER_GET_PRIVATE(obj)                       \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj), ENTANGLE_TYPE_SESSION_BROWSER, EntangleSessionBrowserPrivate))
@@ -57,14 +59,23 @@ struct _EntangleSessionBrowserPrivate {
     GtkCellRenderer *pixbuf_cell;
 
     gulong sigImageAdded;
+    gulong sigImagesAdded;
+    gulong sigImageRemoved;
+    gulong sigLoading;
     gulong sigThumbReady;
     gulong context_changed_id;
 
     GdkPixbuf *blank;
+    EntangleMetricsMemory *memory;
 
     GtkTreeModel *model;
     EntangleImage *selected;
 
+    /* Selecting the end of the list waits for the session
+     * to finish loading, unless the user picks something */
+    gboolean followPending;
+    gint followFrom;
+
     GList *items;
 
     GtkAdjustment *hadjustment;
@@ -164,6 +175,79 @@ enum {
 static guint browser_signals[SIGNAL_LAST] = { 0 };
 
 
+static gsize entangle_session_browser_pixbuf_bytes(GdkPixbuf *pixbuf)
+{
+    return (gsize)gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
+}
+
+
+/* Thumbnails are accounted while the store holds them, the
+ * blank placeholder just once since all rows share it */
+static void entangle_session_browser_release_row(EntangleSessionBrowser *browser,
+                                                 GtkTreeIter *iter)
+{
+    EntangleSessionBrowserPrivate *priv = browser->priv;
+    GdkPixbuf *pixbuf;
+
+    gtk_tree_model_get(priv->model, iter, FIELD_PIXMAP, &pixbuf, -1);
+    if (!pixbuf)
+        return;
+    if (pixbuf != priv->blank)
+        entangle_metrics_memory_free(priv->memory,
+                                     entangle_session_browser_pixbuf_bytes(pixbuf));
+    g_object_unref(pixbuf);
+}
+
+
+#if GTK_CHECK_VERSION(3,10,0)
+/*
+ * Thumbnails are rendered at the display's scale factor, so
+ * are drawn via a surface with a matching device scale to
+ * keep the logical size the same. The surface is cached on
+ * the pixbuf, which is immutable once loaded.
+ */
+static void entangle_session_browser_pixbuf_cell_data(GtkCellLayout *layout G_GNUC_UNUSED,
+                                                      GtkCellRenderer *cell,
+                                                      GtkTreeModel *model,
+                                                      GtkTreeIter *iter,
+                                                      gpointer data)
+{
+    EntangleSessionBrowser *browser = data;
+    EntangleSessionBrowserPrivate *priv = browser->priv;
+    GdkPixbuf *pixbuf;
+    cairo_surface_t *surface;
+    int width, scale;
+
+    gtk_tree_model_get(model, iter, FIELD_PIXMAP, &pixbuf, -1);
+    if (!pixbuf || !priv->loader) {
+        g_object_set(cell, "pixbuf", pixbuf, NULL);
+        goto cleanup;
+    }
+
+    /* Rows loaded before a scale change keep their old size
+     * until reloaded, so go by the pixbuf rather than the loader */
+    g_object_get(priv->loader, "width", &width, NULL);
+    scale = MAX(1, (gdk_pixbuf_get_width(pixbuf) + width / 2) / width);
+    if (scale == 1) {
+        g_object_set(cell, "pixbuf", pixbuf, NULL);
+        goto cleanup;
+    }
+
+    surface = g_object_get_data(G_OBJECT(pixbuf), "entangle-surface");
+    if (!surface) {
+        surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, scale, NULL);
+        g_object_set_data_full(G_OBJECT(pixbuf), "entangle-surface", surface,
+                               (GDestroyNotify)cairo_surface_destroy);
+    }
+    g_object_set(cell, "surface", surface, NULL);
+
+ cleanup:
+    if (pixbuf)
+        g_object_unref(pixbuf);
+}
+#endif
+
+
 static void do_thumb_loaded(EntanglePixbufLoader *loader,
                             EntangleImage *image,
                             gpointer data)
@@ -188,8 +272,11 @@ static void do_thumb_loaded(EntanglePixbufLoader *loader,
 
         if (image == thisimage) {
             g_object_unref(thisimage);
+            entangle_session_browser_release_row(browser, &iter);
             gtk_list_store_set(GTK_LIST_STORE(priv->model),
                                &iter, FIELD_PIXMAP, pixbuf, -1);
+            entangle_metrics_memory_alloc(priv->memory,
+                                          entangle_session_browser_pixbuf_bytes(pixbuf));
             break;
         }
         g_object_unref(thisimage);
@@ -231,6 +318,111 @@ static void do_image_added(EntangleSession *session G_GNUC_UNUSED,
 }
 
 
+static GList *
+entangle_session_browser_get_selected_items(EntangleSessionBrowser *browser);
+
+/* The index of the selected image, or -1 if there is none */
+static gint entangle_session_browser_selected_index(EntangleSessionBrowser *browser)
+{
+    GList *selected = entangle_session_browser_get_selected_items(browser);
+    gint index = -1;
+
+    if (selected) {
+        gint *indices = gtk_tree_path_get_indices(selected->data);
+        index = indices[0];
+        g_list_free_full(selected, (GDestroyNotify)gtk_tree_path_free);
+    }
+
+    return index;
+}
+
+
+static void entangle_session_browser_select_last(EntangleSessionBrowser *browser)
+{
+    EntangleSessionBrowserPrivate *priv = browser->priv;
+    gint count = gtk_tree_model_iter_n_children(priv->model, NULL);
+    GtkTreePath *path;
+
+    if (!count)
+        return;
+
+    path = gtk_tree_path_new_from_indices(count - 1, -1);
+    entangle_session_browser_select_path(browser, path);
+    entangle_session_browser_scroll_to_path(browser, path, FALSE, 0, 0);
+    gtk_tree_path_free(path);
+}
+
+
+/* A batch of files from loading the session. Inserting each
+ * row with its values avoids the model re-sorting it several
+ * times, and selection follows the end of the list until the
+ * user picks something else. Selecting & scrolling for every
+ * batch would just churn the view, so it waits for the last. */
+static void do_images_added(EntangleSession *session,
+                            GPtrArray *images,
+                            gpointer data)
+{
+    EntangleSessionBrowser *browser = data;
+    EntangleSessionBrowserPrivate *priv = browser->priv;
+    gint count = gtk_tree_model_iter_n_children(priv->model, NULL);
+    gint current = entangle_session_browser_selected_index(browser);
+    gboolean follow;
+
+    ENTANGLE_DEBUG("Adding %u images", images->len);
+
+    if (priv->followPending)
+        follow = current == priv->followFrom;
+    else
+        follow = current == -1 || current == count - 1;
+
+    for (guint i = 0; i < images->len; i++) {
+        EntangleImage *img = g_ptr_array_index(images, i);
+        gchar *name = g_path_get_basename(entangle_image_get_filename(img));
+        GtkTreeIter iter;
+
+        gtk_list_store_insert_with_values(GTK_LIST_STORE(priv->model), &iter, -1,
+                                          FIELD_IMAGE, img,
+                                          FIELD_PIXMAP, priv->blank,
+                                          FIELD_LASTMOD, (int)entangle_image_get_last_modified(img),
+                                          FIELD_NAME, name,
+                                          -1);
+        g_free(name);
+
+        entangle_pixbuf_loader_load(ENTANGLE_PIXBUF_LOADER(priv->loader), img);
+    }
+
+    if (!follow) {
+        priv->followPending = FALSE;
+    } else if (entangle_session_is_loading(session)) {
+        if (!priv->followPending) {
+            priv->followPending = TRUE;
+            priv->followFrom = current;
+        }
+    } else {
+        priv->followPending = FALSE;
+        entangle_session_browser_select_last(browser);
+    }
+
+    gtk_widget_queue_resize(GTK_WIDGET(browser));
+}
+
+
+static void do_session_loading(GObject *object,
+                               GParamSpec *pspec G_GNUC_UNUSED,
+                               gpointer data)
+{
+    EntangleSessionBrowser *browser = data;
+    EntangleSessionBrowserPrivate *priv = browser->priv;
+
+    if (entangle_session_is_loading(ENTANGLE_SESSION(object)) ||
+        !priv->followPending)
+        return;
+
+    priv->followPending = FALSE;
+    if (entangle_session_browser_selected_index(browser) == priv->followFrom)
+        entangle_session_browser_select_last(browser);
+}
+
 
 static void do_image_removed(EntangleSession *session G_GNUC_UNUSED,
                              EntangleImage *img,
@@ -253,9 +445,12 @@ static void do_image_removed(EntangleSession *session G_GNUC_UNUSED,
         gtk_tree_model_get_value(priv->model, &iter, FIELD_IMAGE, &value);
         thisimg = g_value_get_object(&value);
         if (thisimg == img) {
+            g_value_unset(&value);
+            entangle_session_browser_release_row(browser, &iter);
             gtk_list_store_remove(GTK_LIST_STORE(priv->model), &iter);
             break;
         }
+        g_value_unset(&value);
     } while (gtk_tree_model_iter_next(priv->model, &iter));
 
     gtk_widget_queue_resize(GTK_WIDGET(browser));
@@ -268,12 +463,20 @@ static void do_model_unload(EntangleSessionBrowser *browser)
     g_return_if_fail(ENTANGLE_IS_SESSION_BROWSER(browser));
 
     EntangleSessionBrowserPrivate *priv = browser->priv;
+    GtkTreeIter iter;
     int count;
 
     ENTANGLE_DEBUG("Unload model");
 
     g_signal_handler_disconnect(priv->session,
                                 priv->sigImageAdded);
+    g_signal_handler_disconnect(priv->session,
+                                priv->sigImagesAdded);
+    g_signal_handler_disconnect(priv->session,
+                                priv->sigImageRemoved);
+    g_signal_handler_disconnect(priv->session,
+                                priv->sigLoading);
+    priv->followPending = FALSE;
     g_signal_handler_disconnect(priv->loader,
                                 priv->sigThumbReady);
 
@@ -283,6 +486,14 @@ static void do_model_unload(EntangleSessionBrowser *browser)
         entangle_pixbuf_loader_unload(ENTANGLE_PIXBUF_LOADER(priv->loader), img);
     }
 
+    if (gtk_tree_model_get_iter_first(priv->model, &iter)) {
+        do {
+            entangle_session_browser_release_row(browser, &iter);
+        } while (gtk_tree_model_iter_next(priv->model, &iter));
+    }
+
+    entangle_metrics_memory_free(priv->memory,
+                                 entangle_session_browser_pixbuf_bytes(priv->blank));
     g_object_unref(priv->blank);
     gtk_list_store_clear(GTK_LIST_STORE(priv->model));
 }
@@ -302,14 +513,22 @@ static void do_model_load(EntangleSessionBrowser *browser)
                  "width", &width,
                  "height", &height,
                  NULL);
+    width *= entangle_thumbnail_loader_get_scale(priv->loader);
+    height *= entangle_thumbnail_loader_get_scale(priv->loader);
 
     priv->blank = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, width, height);
     gdk_pixbuf_fill(priv->blank, 0x000000FF);
+    entangle_metrics_memory_alloc(priv->memory,
+                                  entangle_session_browser_pixbuf_bytes(priv->blank));
 
     priv->sigImageAdded = g_signal_connect(priv->session, "session-image-added",
                                            G_CALLBACK(do_image_added), browser);
-    priv->sigImageAdded = g_signal_connect(priv->session, "session-image-removed",
-                                           G_CALLBACK(do_image_removed), browser);
+    priv->sigImagesAdded = g_signal_connect(priv->session, "session-images-added",
+                                            G_CALLBACK(do_images_added), browser);
+    priv->sigImageRemoved = g_signal_connect(priv->session, "session-image-removed",
+                                             G_CALLBACK(do_image_removed), browser);
+    priv->sigLoading = g_signal_connect(priv->session, "notify::loading",
+                                        G_CALLBACK(do_session_loading), browser);
     priv->sigThumbReady = g_signal_connect(priv->loader, "pixbuf-loaded",
                                            G_CALLBACK(do_thumb_loaded), browser);
 
@@ -1660,6 +1879,7 @@ static void entangle_session_browser_init(EntangleSessionBrowser *browser)
 
     priv = browser->priv = ENTANGLE_SESSION_BROWSER_GET_PRIVATE(browser);
 
+    priv->memory = entangle_metrics_memory_owner("EntangleSessionBrowser");
     priv->model = GTK_TREE_MODEL(gtk_list_store_new(FIELD_LAST,
                                                     ENTANGLE_TYPE_IMAGE,
                                                     GDK_TYPE_PIXBUF,
@@ -1684,10 +1904,17 @@ static void entangle_session_browser_init(EntangleSessionBrowser *browser)
     priv->pixbuf_cell = gtk_cell_renderer_pixbuf_new();
     gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(browser), priv->pixbuf_cell, FALSE);
 
+#if GTK_CHECK_VERSION(3,10,0)
+    gtk_cell_layout_set_cell_data_func(GTK_CELL_LAYOUT(browser),
+                                       priv->pixbuf_cell,
+                                       entangle_session_browser_pixbuf_cell_data,
+                                       browser, NULL);
+#else
     gtk_cell_layout_set_attributes(GTK_CELL_LAYOUT(browser),
                                    priv->pixbuf_cell,
                                    "pixbuf", FIELD_PIXMAP,
                                    NULL);
+#endif
 
     g_object_set(priv->pixbuf_cell,
                  "xalign", 0.5,
@@ -2040,6 +2267,7 @@ entangle_session_browser_draw(GtkWidget *widget,
     GList *icons;
     int ww, wh; /* Available drawing area extents */
 
+    ENTANGLE_TRACE_BEGIN("session-browser-draw");
     ww = gdk_window_get_width(gtk_widget_get_window(widget));
     wh = gdk_window_get_height(gtk_widget_get_window(widget));
 
@@ -2047,8 +2275,10 @@ entangle_session_browser_draw(GtkWidget *widget,
     cairo_rectangle(cr, 0, 0, ww, wh);
     cairo_fill(cr);
 
-    if (!gtk_cairo_should_draw_window(cr, priv->bin_window))
+    if (!gtk_cairo_should_draw_window(cr, priv->bin_window)) {
+        ENTANGLE_TRACE_END("session-browser-draw");
         return FALSE;
+    }
 
     cairo_save(cr);
     gtk_cairo_transform_to_window(cr, widget, priv->bin_window);
@@ -2082,6 +2312,7 @@ entangle_session_browser_draw(GtkWidget *widget,
 
     cairo_restore(cr);
 
+    ENTANGLE_TRACE_END("session-browser-draw");
     return TRUE;
 }
 
@@ -0,0 +1,301 @@
+/*
+ *  Entangle: Tethered Camera Control & Capture
+ *
+ *  Copyright (C) 2009-2015 Daniel P. Berrange
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "entangle-debug.h"
+#include "entangle-camera.h"
+#include "entangle-camera-simulator.h"
+#include "entangle-control-group.h"
+
+/*
+ * Drives the simulated camera without any GUI, checking that
+ * captures, previews & control changes make the round trip,
+ * and reporting capture throughput, preview frame rate and
+ * control round trip latency as JSON for CI to track.
+ */
+
+static int entangle_simulator_test_captures = 10;
+static int entangle_simulator_test_previews = 50;
+static int entangle_simulator_test_controls = 10;
+static double entangle_simulator_test_min_capture_rate;
+static double entangle_simulator_test_min_preview_rate;
+static double entangle_simulator_test_max_control_ms;
+
+
+static void entangle_simulator_test_drain(void)
+{
+    /* Signals from the camera are deferred to idle callbacks */
+    while (g_main_context_iteration(NULL, FALSE))
+        ;
+}
+
+
+static double entangle_simulator_test_rate(int count, gint64 usecs)
+{
+    if (usecs <= 0)
+        return 0;
+    return count / (usecs / (double)G_USEC_PER_SEC);
+}
+
+
+static gboolean entangle_simulator_test_capture(EntangleCamera *cam,
+                                                double *rate)
+{
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < entangle_simulator_test_captures; i++) {
+        EntangleCameraFile *file;
+        GByteArray *data;
+        GError *error = NULL;
+
+        if (!(file = entangle_camera_capture_image(cam, &error))) {
+            g_printerr("Capture %d failed: %s\n", i, error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+
+        if (!entangle_camera_download_file(cam, file, &error) ||
+            !entangle_camera_delete_file(cam, file, &error)) {
+            g_printerr("Transfer of %s failed: %s\n",
+                       entangle_camera_file_get_name(file), error->message);
+            g_error_free(error);
+            g_object_unref(file);
+            return FALSE;
+        }
+
+        data = entangle_camera_file_get_data(file);
+        if (!data || !data->len) {
+            g_printerr("Capture %s has no data\n",
+                       entangle_camera_file_get_name(file));
+            g_object_unref(file);
+            return FALSE;
+        }
+
+        g_object_unref(file);
+        entangle_simulator_test_drain();
+    }
+
+    *rate = entangle_simulator_test_rate(entangle_simulator_test_captures,
+                                         g_get_monotonic_time() - start);
+    return TRUE;
+}
+
+
+static gboolean entangle_simulator_test_preview(EntangleCamera *cam,
+                                                double *rate)
+{
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < entangle_simulator_test_previews; i++) {
+        EntangleCameraFile *file;
+        GByteArray *data;
+        GError *error = NULL;
+
+        if (!(file = entangle_camera_preview_image(cam, &error))) {
+            g_printerr("Preview %d failed: %s\n", i, error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+
+        data = entangle_camera_file_get_data(file);
+        if (!data || !data->len) {
+            g_printerr("Preview %d has no data\n", i);
+            g_object_unref(file);
+            return FALSE;
+        }
+
+        g_object_unref(file);
+        entangle_simulator_test_drain();
+    }
+
+    *rate = entangle_simulator_test_rate(entangle_simulator_test_previews,
+                                         g_get_monotonic_time() - start);
+    return TRUE;
+}
+
+
+/*
+ * Each round trip writes a new ISO value, then reloads the
+ * controls from the camera and checks the value stuck
+ */
+static gboolean entangle_simulator_test_control(EntangleCamera *cam,
+                                                double *ms)
+{
+    static const char *const values[] = { "200", "400", "800", "1600" };
+    gint64 total = 0;
+
+    for (int i = 0; i < entangle_simulator_test_controls; i++) {
+        const char *want = values[i % G_N_ELEMENTS(values)];
+        EntangleControlGroup *root;
+        EntangleControl *control;
+        GError *error = NULL;
+        gchar *got = NULL;
+        gint64 start;
+
+        if (!(root = entangle_camera_get_controls(cam, &error))) {
+            g_printerr("No controls: %s\n", error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+        if (!(control = entangle_control_group_get_by_path(root, "/main/imgsettings/iso"))) {
+            g_printerr("No ISO control\n");
+            g_object_unref(root);
+            return FALSE;
+        }
+        g_object_set(control, "value", want, NULL);
+        g_object_unref(root);
+
+        start = g_get_monotonic_time();
+        if (!entangle_camera_save_controls(cam, &error) ||
+            !entangle_camera_load_controls(cam, &error)) {
+            g_printerr("Control round trip failed: %s\n", error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+        total += g_get_monotonic_time() - start;
+        entangle_simulator_test_drain();
+
+        root = entangle_camera_get_controls(cam, NULL);
+        control = root ? entangle_control_group_get_by_path(root, "/main/imgsettings/iso") : NULL;
+        if (control)
+            g_object_get(control, "value", &got, NULL);
+        if (root)
+            g_object_unref(root);
+        if (g_strcmp0(got, want) != 0) {
+            g_printerr("ISO is '%s' after setting '%s'\n", got, want);
+            g_free(got);
+            return FALSE;
+        }
+        g_free(got);
+    }
+
+    *ms = (total / 1000.0) / entangle_simulator_test_controls;
+    return TRUE;
+}
+
+
+int main(int argc, char **argv)
+{
+    GOptionContext *optContext;
+    GError *error = NULL;
+    gboolean debug_app = FALSE;
+    gchar *config = NULL;
+    const GOptionEntry entries[] = {
+        { "debug-entangle", 'd', 0, G_OPTION_ARG_NONE, &debug_app, "Enable debugging of application code", NULL },
+        { "config", 'c', 0, G_OPTION_ARG_FILENAME, &config, "Simulator key file", "FILE" },
+        { "captures", 0, 0, G_OPTION_ARG_INT, &entangle_simulator_test_captures, "Captures to take", "N" },
+        { "previews", 0, 0, G_OPTION_ARG_INT, &entangle_simulator_test_previews, "Preview frames to fetch", "N" },
+        { "controls", 0, 0, G_OPTION_ARG_INT, &entangle_simulator_test_controls, "Control round trips to make", "N" },
+        { "min-capture-rate", 0, 0, G_OPTION_ARG_DOUBLE, &entangle_simulator_test_min_capture_rate, "Fail below this many captures per second", "RATE" },
+        { "min-preview-rate", 0, 0, G_OPTION_ARG_DOUBLE, &entangle_simulator_test_min_preview_rate, "Fail below this many preview frames per second", "RATE" },
+        { "max-control-ms", 0, 0, G_OPTION_ARG_DOUBLE, &entangle_simulator_test_max_control_ms, "Fail above this control round trip time", "MS" },
+        { NULL, 0, 0, 0, NULL, NULL, NULL },
+    };
+    EntangleCamera *cam = NULL;
+    double captureRate = 0, previewRate = 0, controlMs = 0;
+    int ret = 1;
+
+    optContext = g_option_context_new("- exercise the simulated camera");
+    g_option_context_add_main_entries(optContext, entries, NULL);
+    if (!g_option_context_parse(optContext, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    g_option_context_free(optContext);
+
+    if (entangle_simulator_test_captures <= 0 ||
+        entangle_simulator_test_previews <= 0 ||
+        entangle_simulator_test_controls <= 0) {
+        g_printerr("Capture, preview and control counts must be positive\n");
+        return 1;
+    }
+
+    entangle_debug_setup(debug_app, FALSE);
+    entangle_camera_simulator_setup(config);
+
+    cam = entangle_camera_new(ENTANGLE_CAMERA_SIMULATOR_MODEL,
+                              entangle_camera_simulator_get_port(),
+                              TRUE, TRUE, TRUE);
+    if (!entangle_camera_connect(cam, &error) ||
+        !entangle_camera_load_controls(cam, &error)) {
+        g_printerr("Unable to connect to the simulator: %s\n", error->message);
+        g_error_free(error);
+        goto cleanup;
+    }
+
+    if (!entangle_simulator_test_capture(cam, &captureRate) ||
+        !entangle_simulator_test_preview(cam, &previewRate) ||
+        !entangle_simulator_test_control(cam, &controlMs))
+        goto cleanup;
+
+    printf("{\n"
+           "  \"capture_per_sec\": %.2f,\n"
+           "  \"preview_fps\": %.2f,\n"
+           "  \"control_round_trip_ms\": %.2f\n"
+           "}\n",
+           captureRate, previewRate, controlMs);
+
+    if (captureRate < entangle_simulator_test_min_capture_rate) {
+        g_printerr("Capture rate %.2f/s below %.2f/s\n",
+                   captureRate, entangle_simulator_test_min_capture_rate);
+        goto cleanup;
+    }
+    if (previewRate < entangle_simulator_test_min_preview_rate) {
+        g_printerr("Preview rate %.2f fps below %.2f fps\n",
+                   previewRate, entangle_simulator_test_min_preview_rate);
+        goto cleanup;
+    }
+    if (entangle_simulator_test_max_control_ms > 0 &&
+        controlMs > entangle_simulator_test_max_control_ms) {
+        g_printerr("Control round trip %.2f ms above %.2f ms\n",
+                   controlMs, entangle_simulator_test_max_control_ms);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (cam) {
+        if (entangle_camera_get_connected(cam))
+            entangle_camera_disconnect(cam, NULL);
+        entangle_simulator_test_drain();
+        g_object_unref(cam);
+    }
+    g_free(config);
+    return ret;
+}
+
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  tab-width: 8
+ * End:
+ */
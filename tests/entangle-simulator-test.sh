@@ -0,0 +1,12 @@
+#!/bin/sh
+#
+# Run by 'make check'. The thresholds are loose enough for a
+# loaded CI machine, and only catch gross regressions; the
+# JSON on stdout lands in the test log for closer tracking
+
+exec ./entangle-simulator-test \
+     --config="${srcdir:-.}/simulator.conf" \
+     --min-capture-rate=1 \
+     --min-preview-rate=5 \
+     --max-control-ms=1000 \
+     "$@"